@@ -0,0 +1,2 @@
+CREATE TABLE checkpoints ( id INTEGER PRIMARY KEY NOT NULL, address TEXT, currency VARCHAR(100), blockNumber INTEGER, blockHash TEXT NOT NULL DEFAULT '' );
+CREATE UNIQUE INDEX checkpointsUniqueIdx ON checkpoints ( address ASC, currency ASC, blockNumber ASC );
@@ -2,16 +2,187 @@
 
 #include <QByteArray>
 
+#include <algorithm>
+
 #include <openssl/bn.h>
 
 #include "check.h"
 
-BigNumber::BigNumber()
-    : ptr(BN_new(), BN_free)
-{
+namespace {
+
+using Words = std::array<uint32_t, 8>;
+
+const uint32_t DECIMAL_BASE = 1000000000;
+const int DECIMAL_BASE_DIGITS = 9;
+
+const size_t COUNT_BYTES = 32;
+
+bool isZero(const Words &words) {
+    for (const uint32_t word: words) {
+        if (word != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int compareMagnitude(const Words &lhs, const Words &rhs) {
+    for (size_t i = lhs.size(); i-- > 0;) {
+        if (lhs[i] != rhs[i]) {
+            return lhs[i] < rhs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Возвращает false при переполнении
+bool addMagnitude(Words &lhs, const Words &rhs) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < lhs.size(); i++) {
+        const uint64_t sum = uint64_t(lhs[i]) + rhs[i] + carry;
+        lhs[i] = uint32_t(sum);
+        carry = sum >> 32;
+    }
+    return carry == 0;
+}
 
+// lhs >= rhs
+void subMagnitude(Words &lhs, const Words &rhs) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < lhs.size(); i++) {
+        const uint64_t sub = uint64_t(lhs[i]) - rhs[i] - borrow;
+        lhs[i] = uint32_t(sub);
+        borrow = (sub >> 32) & 1;
+    }
 }
 
+bool mulAddSmall(Words &words, uint32_t mul, uint32_t add) {
+    uint64_t carry = add;
+    for (size_t i = 0; i < words.size(); i++) {
+        const uint64_t cur = uint64_t(words[i]) * mul + carry;
+        words[i] = uint32_t(cur);
+        carry = cur >> 32;
+    }
+    return carry == 0;
+}
+
+uint32_t divSmall(Words &words, uint32_t div) {
+    uint64_t rem = 0;
+    for (size_t i = words.size(); i-- > 0;) {
+        const uint64_t cur = (rem << 32) | words[i];
+        words[i] = uint32_t(cur / div);
+        rem = cur % div;
+    }
+    return uint32_t(rem);
+}
+
+// Разбирает только запись вида -?[0-9]+, помещающуюся в 256 бит
+bool parseDecimal(const QByteArray &dec, Words &words, bool &isNegative) {
+    const char *data = dec.constData();
+    const int size = dec.size();
+    int pos = 0;
+    isNegative = false;
+    if (size > 0 && data[0] == '-') {
+        isNegative = true;
+        pos++;
+    }
+    if (pos == size) {
+        return false;
+    }
+
+    words.fill(0);
+    while (pos < size) {
+        const int end = std::min(size, pos + DECIMAL_BASE_DIGITS);
+        uint32_t chunk = 0;
+        uint32_t mul = 1;
+        for (; pos < end; pos++) {
+            const char c = data[pos];
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            chunk = chunk * 10 + uint32_t(c - '0');
+            mul *= 10;
+        }
+        if (!mulAddSmall(words, mul, chunk)) {
+            return false;
+        }
+    }
+    if (isZero(words)) {
+        isNegative = false;
+    }
+    return true;
+}
+
+QByteArray formatDecimal(const Words &words, bool isNegative) {
+    if (isZero(words)) {
+        return QByteArray("0");
+    }
+
+    // 2^256 < 10^78, то есть не больше 9 блоков по 9 цифр
+    std::array<uint32_t, 9> chunks;
+    size_t countChunks = 0;
+    Words tmp = words;
+    while (!isZero(tmp)) {
+        chunks[countChunks++] = divSmall(tmp, DECIMAL_BASE);
+    }
+
+    QByteArray res;
+    res.reserve(int(countChunks) * DECIMAL_BASE_DIGITS + 1);
+    if (isNegative) {
+        res.append('-');
+    }
+    res.append(QByteArray::number(chunks[countChunks - 1]));
+    for (size_t i = countChunks - 1; i-- > 0;) {
+        char buffer[DECIMAL_BASE_DIGITS];
+        uint32_t chunk = chunks[i];
+        for (int j = DECIMAL_BASE_DIGITS; j-- > 0;) {
+            buffer[j] = char('0' + chunk % 10);
+            chunk /= 10;
+        }
+        res.append(buffer, DECIMAL_BASE_DIGITS);
+    }
+    return res;
+}
+
+BIGNUM* wordsToBignum(const Words &words, bool isNegative) {
+    unsigned char buffer[COUNT_BYTES];
+    for (size_t i = 0; i < words.size(); i++) {
+        const uint32_t word = words[words.size() - 1 - i];
+        buffer[i * 4 + 0] = (unsigned char)(word >> 24);
+        buffer[i * 4 + 1] = (unsigned char)(word >> 16);
+        buffer[i * 4 + 2] = (unsigned char)(word >> 8);
+        buffer[i * 4 + 3] = (unsigned char)(word);
+    }
+    BIGNUM *res = BN_bin2bn(buffer, COUNT_BYTES, nullptr);
+    CHECK(res != nullptr, "BN error");
+    BN_set_negative(res, isNegative ? 1 : 0);
+    return res;
+}
+
+bool bignumToWords(const BIGNUM *bn, Words &words, bool &isNegative) {
+    if (BN_num_bits(bn) > int(COUNT_BYTES * 8)) {
+        return false;
+    }
+    unsigned char buffer[COUNT_BYTES] = {0};
+    const int countBytes = BN_num_bytes(bn);
+    BN_bn2bin(bn, buffer + COUNT_BYTES - countBytes);
+    for (size_t i = 0; i < words.size(); i++) {
+        const unsigned char *p = buffer + COUNT_BYTES - (i + 1) * 4;
+        words[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+    isNegative = BN_is_negative(bn) && !isZero(words);
+    return true;
+}
+
+}
+
+void BigNumber::BignumDeleter::operator()(BIGNUM *p) const
+{
+    BN_free(p);
+}
+
+BigNumber::BigNumber() = default;
+
 BigNumber::BigNumber(const QByteArray &dec)
     : BigNumber()
 {
@@ -25,24 +196,73 @@ BigNumber::BigNumber(const QString &dec)
 }
 
 BigNumber::BigNumber(const BigNumber &bn)
-    : ptr(BN_dup(bn.ptr.get()), BN_free)
+    : words(bn.words)
+    , isNegative(bn.isNegative)
 {
+    if (bn.ptr != nullptr) {
+        ptr.reset(BN_dup(bn.ptr.get()));
+        CHECK(ptr != nullptr, "BN error");
+    }
+}
+
+BigNumber::BigNumber(BigNumber &&bn) noexcept = default;
+
+BigNumber::~BigNumber() = default;
+
+bool BigNumber::isBig() const
+{
+    return ptr != nullptr;
+}
 
+BigNumber::BignumPtr BigNumber::toBignum() const
+{
+    if (ptr != nullptr) {
+        BignumPtr res(BN_dup(ptr.get()));
+        CHECK(res != nullptr, "BN error");
+        return res;
+    }
+    return BignumPtr(wordsToBignum(words, isNegative));
+}
+
+void BigNumber::normalize()
+{
+    if (ptr != nullptr && bignumToWords(ptr.get(), words, isNegative)) {
+        ptr.reset();
+    }
 }
 
 void BigNumber::setDecimal(const QByteArray &dec)
 {
-    BIGNUM *p = ptr.get();
     if (dec.isEmpty()) {
-        BN_zero(p);
+        words.fill(0);
+        isNegative = false;
+        ptr.reset();
         return;
     }
+
+    Words parsed;
+    bool parsedNegative;
+    if (parseDecimal(dec, parsed, parsedNegative)) {
+        words = parsed;
+        isNegative = parsedNegative;
+        ptr.reset();
+        return;
+    }
+
+    // Больше 256 бит или нестандартная запись, разбор как раньше через OpenSSL
+    BignumPtr bn = toBignum();
+    BIGNUM *p = bn.get();
     QByteArray str = dec + '\0';
     BN_dec2bn(&p, str.data());
+    ptr = std::move(bn);
+    normalize();
 }
 
 QByteArray BigNumber::getDecimal() const
 {
+    if (ptr == nullptr) {
+        return formatDecimal(words, isNegative);
+    }
     char *str = BN_bn2dec(ptr.get());
     QByteArray res(str);
     OPENSSL_free(str);
@@ -51,22 +271,92 @@ QByteArray BigNumber::getDecimal() const
 
 BigNumber &BigNumber::operator=(const BigNumber &rhs)
 {
-    CHECK(BN_copy(this->ptr.get(), rhs.ptr.get()) == this->ptr.get(), "BN error");
+    if (this == &rhs) {
+        return *this;
+    }
+    words = rhs.words;
+    isNegative = rhs.isNegative;
+    if (rhs.ptr != nullptr) {
+        ptr = rhs.toBignum();
+    } else {
+        ptr.reset();
+    }
     return *this;
 }
 
+BigNumber &BigNumber::operator=(BigNumber &&rhs) noexcept = default;
+
+void BigNumber::addSigned(const BigNumber &rhs, bool isSubtract)
+{
+    if (ptr == nullptr && rhs.ptr == nullptr) {
+        const bool rhsNegative = rhs.isNegative != isSubtract;
+        if (isNegative == rhsNegative) {
+            Words sum = words;
+            if (addMagnitude(sum, rhs.words)) {
+                words = sum;
+                return;
+            }
+        } else {
+            if (compareMagnitude(words, rhs.words) >= 0) {
+                subMagnitude(words, rhs.words);
+            } else {
+                Words sub = rhs.words;
+                subMagnitude(sub, words);
+                words = sub;
+                isNegative = rhsNegative;
+            }
+            if (isZero(words)) {
+                isNegative = false;
+            }
+            return;
+        }
+    }
+
+    // Переполнение 256 бит или одно из чисел уже большое
+    if (ptr == nullptr) {
+        ptr = toBignum();
+    }
+    BignumPtr rhsBn;
+    const BIGNUM *rhsPtr = rhs.ptr.get();
+    if (rhsPtr == nullptr) {
+        rhsBn = rhs.toBignum();
+        rhsPtr = rhsBn.get();
+    }
+    if (isSubtract) {
+        CHECK(BN_sub(ptr.get(), ptr.get(), rhsPtr), "BN error");
+    } else {
+        CHECK(BN_add(ptr.get(), ptr.get(), rhsPtr), "BN error");
+    }
+    normalize();
+}
+
 BigNumber &BigNumber::operator+=(const BigNumber &rhs)
 {
-    CHECK(BN_add(this->ptr.get(), this->ptr.get(), rhs.ptr.get()), "BN error");
+    addSigned(rhs, false);
     return *this;
 }
 
 BigNumber &BigNumber::operator-=(const BigNumber &rhs)
 {
-    CHECK(BN_sub(this->ptr.get(), this->ptr.get(), rhs.ptr.get()), "BN error");
+    addSigned(rhs, true);
     return *this;
 }
 
+int BigNumber::compare(const BigNumber &rhs) const
+{
+    if (ptr == nullptr && rhs.ptr == nullptr) {
+        if (isNegative != rhs.isNegative) {
+            return isNegative ? -1 : 1;
+        }
+        const int cmp = compareMagnitude(words, rhs.words);
+        return isNegative ? -cmp : cmp;
+    }
+    const BignumPtr lhsBn = toBignum();
+    const BignumPtr rhsBn = rhs.toBignum();
+    const int cmp = BN_cmp(lhsBn.get(), rhsBn.get());
+    return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+}
+
 const BigNumber operator+(const BigNumber &lhs, const BigNumber &rhs)
 {
     BigNumber res(lhs);
@@ -80,3 +370,33 @@ const BigNumber operator-(const BigNumber &lhs, const BigNumber &rhs)
     res -= rhs;
     return res;
 }
+
+bool operator==(const BigNumber &lhs, const BigNumber &rhs)
+{
+    return lhs.compare(rhs) == 0;
+}
+
+bool operator!=(const BigNumber &lhs, const BigNumber &rhs)
+{
+    return lhs.compare(rhs) != 0;
+}
+
+bool operator<(const BigNumber &lhs, const BigNumber &rhs)
+{
+    return lhs.compare(rhs) < 0;
+}
+
+bool operator>(const BigNumber &lhs, const BigNumber &rhs)
+{
+    return lhs.compare(rhs) > 0;
+}
+
+bool operator<=(const BigNumber &lhs, const BigNumber &rhs)
+{
+    return lhs.compare(rhs) <= 0;
+}
+
+bool operator>=(const BigNumber &lhs, const BigNumber &rhs)
+{
+    return lhs.compare(rhs) >= 0;
+}
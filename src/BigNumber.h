@@ -3,31 +3,77 @@
 
 #include <QString>
 #include <memory>
-#include <functional>
+#include <array>
+
+#include <cstdint>
 
 class QByteArray;
 
 typedef struct bignum_st BIGNUM;
 
+/*
+   Числа, помещающиеся в 256 бит, хранятся внутри объекта (знак и модуль),
+   BIGNUM создается только для чисел большего размера.
+   */
 class BigNumber {
 public:
     BigNumber();
     BigNumber(const QByteArray &dec);
     BigNumber(const QString &dec);
     BigNumber(const BigNumber &bn);
+    BigNumber(BigNumber &&bn) noexcept;
+    ~BigNumber();
 
     void setDecimal(const QByteArray &dec);
     QByteArray getDecimal() const;
 
     BigNumber &operator=(const BigNumber &rhs);
+    BigNumber &operator=(BigNumber &&rhs) noexcept;
     BigNumber &operator+=(const BigNumber &rhs);
     BigNumber &operator-=(const BigNumber &rhs);
 
+    int compare(const BigNumber &rhs) const;
+
+    // Число не поместилось в 256 бит и хранится в BIGNUM
+    bool isBig() const;
+
+private:
+
+    struct BignumDeleter {
+        void operator()(BIGNUM *p) const;
+    };
+
+    using BignumPtr = std::unique_ptr<BIGNUM, BignumDeleter>;
+
+    static const size_t COUNT_WORDS = 8;
+
+    // Младшее слово первое
+    using Words = std::array<uint32_t, COUNT_WORDS>;
+
 private:
-    std::unique_ptr<BIGNUM, std::function<void(BIGNUM *)>> ptr;
+
+    void addSigned(const BigNumber &rhs, bool isSubtract);
+
+    BignumPtr toBignum() const;
+
+    void normalize();
+
+private:
+
+    Words words{};
+    bool isNegative = false;
+
+    BignumPtr ptr;
 };
 
 const BigNumber operator+(const BigNumber &lhs, const BigNumber &rhs);
 const BigNumber operator-(const BigNumber &lhs, const BigNumber &rhs);
 
+bool operator==(const BigNumber &lhs, const BigNumber &rhs);
+bool operator!=(const BigNumber &lhs, const BigNumber &rhs);
+bool operator<(const BigNumber &lhs, const BigNumber &rhs);
+bool operator>(const BigNumber &lhs, const BigNumber &rhs);
+bool operator<=(const BigNumber &lhs, const BigNumber &rhs);
+bool operator>=(const BigNumber &lhs, const BigNumber &rhs);
+
 #endif // BIGNUMBER_H
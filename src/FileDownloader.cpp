@@ -0,0 +1,394 @@
+#include "FileDownloader.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QCryptographicHash>
+#include <QTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "check.h"
+#include "Log.h"
+#include "SlotWrapper.h"
+#include "QRegister.h"
+#include "utils.h"
+
+SET_LOG_NAMESPACE("UPL");
+
+const static qint64 READ_BUFFER_SIZE = 1024 * 1024;
+
+const static qint64 PROGRESS_STEP = 1024 * 1024;
+
+const static qint64 HASH_CHUNK_SIZE = 1024 * 1024;
+
+struct FileDownloader::Download {
+    Download(const QUrl &url, const QString &filePath, const Callback &callback, milliseconds stallTimeout, milliseconds totalTimeout)
+        : url(url)
+        , filePath(filePath)
+        , tmpPath(filePath + ".part")
+        , metaPath(filePath + ".part.meta")
+        , callback(callback)
+        , file(tmpPath)
+        , md5(QCryptographicHash::Md5)
+        , sha256(QCryptographicHash::Sha256)
+        , stallTimeout(stallTimeout)
+        , totalTimeout(totalTimeout)
+    {}
+
+    const QUrl url;
+    const QString filePath;
+    const QString tmpPath;
+    const QString metaPath;
+    const Callback callback;
+
+    QFile file;
+    QCryptographicHash md5;
+    QCryptographicHash sha256;
+
+    qint64 received = 0;
+    qint64 total = -1;
+    qint64 lastProgress = 0;
+
+    // Смещение, с которого запрошен Range
+    qint64 offset = 0;
+    QString etag;
+    QString lastModified;
+
+    bool isHeadersProcessed = false;
+    // Тело ответа с ошибкой в файл не пишется
+    bool isBodyAccepted = false;
+
+    time_point timeBegin;
+    time_point lastData;
+
+    const milliseconds stallTimeout;
+    const milliseconds totalTimeout;
+
+    std::string abortReason;
+    // Сохранять ли .part для докачки после ошибки
+    bool isKeepPart = true;
+};
+
+static void removePart(QFile &file, const QString &metaPath) {
+    file.close();
+    file.remove();
+    QFile::remove(metaPath);
+}
+
+static void writeMeta(const QString &metaPath, qint64 total, const QString &etag, const QString &lastModified) {
+    QJsonObject meta;
+    meta.insert("total", QString::number(total));
+    meta.insert("etag", etag);
+    meta.insert("last_modified", lastModified);
+    writeToFile(metaPath, QJsonDocument(meta).toJson(QJsonDocument::Compact).toStdString(), false);
+}
+
+static bool parseContentRange(const QByteArray &header, qint64 &begin, qint64 &total) {
+    // bytes 100-199/200
+    const QByteArray BYTES = "bytes ";
+    if (!header.startsWith(BYTES)) {
+        return false;
+    }
+    const int dash = header.indexOf('-');
+    const int slash = header.indexOf('/');
+    if (dash < 0 || slash < dash) {
+        return false;
+    }
+    bool isSuccess1 = false;
+    begin = header.mid(BYTES.size(), dash - BYTES.size()).toLongLong(&isSuccess1);
+    const QByteArray totalStr = header.mid(slash + 1);
+    bool isSuccess2 = true;
+    total = totalStr == "*" ? -1 : totalStr.toLongLong(&isSuccess2);
+    return isSuccess1 && isSuccess2;
+}
+
+FileDownloader::FileDownloader(QObject *parent)
+    : QObject(parent)
+{
+    Q_REG2(SimpleClient::ReturnCallback, "SimpleClient::ReturnCallback", false);
+}
+
+FileDownloader::~FileDownloader() {
+    // .part остается на диске, следующая загрузка его докачает
+    for (auto &pair: downloads) {
+        pair.first->disconnect(this);
+        pair.first->abort();
+        pair.second->file.close();
+    }
+}
+
+void FileDownloader::startTimer1() {
+    if (timer == nullptr) {
+        timer = new QTimer(this);
+        CHECK(connect(timer, &QTimer::timeout, this, &FileDownloader::onTimerEvent), "not connect timeout");
+        timer->setInterval(milliseconds(1s).count());
+        timer->start();
+    }
+}
+
+size_t FileDownloader::countActive() const {
+    return downloads.size();
+}
+
+bool FileDownloader::prepareResume(Download &download) {
+    if (!download.file.exists() || !QFile::exists(download.metaPath)) {
+        return false;
+    }
+    const QJsonDocument document = QJsonDocument::fromJson(QByteArray::fromStdString(readFile(download.metaPath)));
+    const QJsonObject meta = document.object();
+    const qint64 total = meta.value("total").toString().toLongLong();
+    const qint64 size = download.file.size();
+    if (size <= 0 || total <= 0 || size >= total) {
+        return false;
+    }
+    if (!download.file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+
+    // Состояние QCryptographicHash не сериализуется, поэтому уже скачанная часть хэшируется заново с диска
+    qint64 hashed = 0;
+    while (hashed < size) {
+        const QByteArray chunk = download.file.read(std::min(HASH_CHUNK_SIZE, size - hashed));
+        if (chunk.isEmpty()) {
+            break;
+        }
+        download.md5.addData(chunk);
+        download.sha256.addData(chunk);
+        hashed += chunk.size();
+    }
+    if (hashed != size) {
+        download.file.close();
+        download.md5.reset();
+        download.sha256.reset();
+        return false;
+    }
+
+    download.offset = size;
+    download.received = size;
+    download.lastProgress = size;
+    download.total = total;
+    download.etag = meta.value("etag").toString();
+    download.lastModified = meta.value("last_modified").toString();
+    return true;
+}
+
+void FileDownloader::download(const QUrl &url, const QString &filePath, const Callback &callback, milliseconds stallTimeout, milliseconds totalTimeout) {
+    if (manager == nullptr) {
+        // Создаем в потоке объекта, а не в потоке конструктора
+        manager = new QNetworkAccessManager(this);
+    }
+    startTimer1();
+
+    std::unique_ptr<Download> download = std::make_unique<Download>(url, filePath, callback, stallTimeout, totalTimeout);
+    QNetworkRequest request(url);
+    if (prepareResume(*download)) {
+        LOG << "Resume download " << filePath << " from " << download->offset << "/" << download->total;
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(download->offset) + "-");
+        const QString validator = !download->etag.isEmpty() ? download->etag : download->lastModified;
+        if (!validator.isEmpty()) {
+            request.setRawHeader("If-Range", validator.toUtf8());
+        }
+    } else {
+        removePart(download->file, download->metaPath);
+        CHECK(download->file.open(QIODevice::WriteOnly), "File not open " + download->tmpPath.toStdString());
+    }
+    download->timeBegin = ::now();
+    download->lastData = download->timeBegin;
+
+    QNetworkReply *reply = manager->get(request);
+    reply->setReadBufferSize(READ_BUFFER_SIZE);
+    CHECK(connect(reply, &QNetworkReply::metaDataChanged, this, &FileDownloader::onMetaDataChanged), "not connect metaDataChanged");
+    CHECK(connect(reply, &QNetworkReply::readyRead, this, &FileDownloader::onReadyRead), "not connect readyRead");
+    CHECK(connect(reply, &QNetworkReply::finished, this, &FileDownloader::onFinished), "not connect finished");
+    downloads.emplace(reply, std::move(download));
+}
+
+void FileDownloader::processHeaders(QNetworkReply *reply, Download &download) {
+    if (download.isHeadersProcessed) {
+        return;
+    }
+    const QVariant statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+    if (!statusCode.isValid()) {
+        return;
+    }
+    download.isHeadersProcessed = true;
+    const int status = statusCode.toInt();
+    const QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+
+    if (status == 206) {
+        qint64 begin = 0;
+        qint64 total = -1;
+        if (!parseContentRange(reply->rawHeader("Content-Range"), begin, total) || begin != download.offset) {
+            download.abortReason = "Incorrect Content-Range " + reply->rawHeader("Content-Range").toStdString();
+            download.isKeepPart = false;
+            reply->abort();
+            return;
+        }
+        if (total < 0 && length.isValid()) {
+            total = begin + length.toLongLong();
+        }
+        download.total = total;
+    } else {
+        if (download.offset != 0 && status == 200) {
+            LOG << "Server ignored range, download again " << download.filePath;
+            download.file.resize(0);
+            download.file.seek(0);
+            download.md5.reset();
+            download.sha256.reset();
+            download.offset = 0;
+            download.received = 0;
+            download.lastProgress = 0;
+        }
+        if (status >= 400) {
+            // Например 416: сохраненная часть больше не подходит
+            download.isKeepPart = false;
+        }
+        download.total = length.isValid() ? length.toLongLong() : -1;
+    }
+
+    if (status == 200 || status == 206) {
+        download.isBodyAccepted = true;
+        download.etag = QString(reply->rawHeader("ETag"));
+        download.lastModified = QString(reply->rawHeader("Last-Modified"));
+        if (download.total > 0) {
+            writeMeta(download.metaPath, download.total, download.etag, download.lastModified);
+        }
+    }
+}
+
+void FileDownloader::onMetaDataChanged() {
+BEGIN_SLOT_WRAPPER
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    const auto found = downloads.find(reply);
+    CHECK(found != downloads.end(), "Download not found");
+    processHeaders(reply, *found->second);
+END_SLOT_WRAPPER
+}
+
+void FileDownloader::readAvailable(QNetworkReply *reply, Download &download) {
+    processHeaders(reply, download);
+    // Сюда попадаем и после abort, дочитывать уже не нужно
+    if (!download.abortReason.empty()) {
+        return;
+    }
+    if (!download.isBodyAccepted) {
+        reply->readAll();
+        return;
+    }
+
+    char buffer[64 * 1024];
+    while (reply->bytesAvailable() > 0) {
+        const qint64 size = reply->read(buffer, sizeof(buffer));
+        if (size <= 0) {
+            break;
+        }
+        if (download.file.write(buffer, size) != size) {
+            download.abortReason = "Not write file " + download.tmpPath.toStdString();
+            download.isKeepPart = false;
+            reply->abort();
+            return;
+        }
+        download.md5.addData(buffer, size);
+        download.sha256.addData(buffer, size);
+        download.received += size;
+    }
+    download.lastData = ::now();
+
+    if (download.received - download.lastProgress >= PROGRESS_STEP || download.received == download.total) {
+        download.lastProgress = download.received;
+        emit progress(download.filePath, download.received, download.total);
+    }
+}
+
+void FileDownloader::onReadyRead() {
+BEGIN_SLOT_WRAPPER
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    const auto found = downloads.find(reply);
+    CHECK(found != downloads.end(), "Download not found");
+    readAvailable(reply, *found->second);
+END_SLOT_WRAPPER
+}
+
+void FileDownloader::finish(QNetworkReply *reply, const Result &result, const SimpleClient::ServerException &exception) {
+    const auto found = downloads.find(reply);
+    CHECK(found != downloads.end(), "Download not found");
+    const Callback callback = found->second->callback;
+    downloads.erase(found);
+    reply->deleteLater();
+
+    emit callbackCall(std::bind(callback, result, exception));
+}
+
+void FileDownloader::onFinished() {
+BEGIN_SLOT_WRAPPER
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    const auto found = downloads.find(reply);
+    CHECK(found != downloads.end(), "Download not found");
+    Download &download = *found->second;
+
+    if (reply->error() == QNetworkReply::NoError) {
+        readAvailable(reply, download);
+    }
+    download.file.close();
+
+    const bool isKeepPart = download.isKeepPart && download.received > 0 && download.total > 0;
+    if (reply->error() != QNetworkReply::NoError || !download.abortReason.empty()) {
+        if (!isKeepPart) {
+            removePart(download.file, download.metaPath);
+        }
+        const std::string description = !download.abortReason.empty() ? download.abortReason : reply->errorString().toStdString();
+        LOG << "Download error " << download.url.toString() << " " << description << ". Received " << download.received << "/" << download.total;
+        finish(reply, Result(), SimpleClient::ServerException(download.url.toString().toStdString(), reply->error() != QNetworkReply::NoError ? reply->error() : QNetworkReply::UnknownContentError, description, ""));
+        return;
+    }
+    if (download.total >= 0 && download.received != download.total) {
+        if (!isKeepPart || download.received > download.total) {
+            removePart(download.file, download.metaPath);
+        }
+        finish(reply, Result(), SimpleClient::ServerException(download.url.toString().toStdString(), QNetworkReply::UnknownContentError, "Incomplete download " + std::to_string(download.received) + "/" + std::to_string(download.total), ""));
+        return;
+    }
+
+    QFile::remove(download.metaPath);
+    QFile::remove(download.filePath);
+    if (!QFile::rename(download.tmpPath, download.filePath)) {
+        download.file.remove();
+        finish(reply, Result(), SimpleClient::ServerException(download.url.toString().toStdString(), QNetworkReply::UnknownContentError, "Not rename " + download.tmpPath.toStdString(), ""));
+        return;
+    }
+
+    Result result;
+    result.filePath = download.filePath;
+    result.md5 = QString(download.md5.result().toHex());
+    result.sha256 = QString(download.sha256.result().toHex());
+    result.size = download.received;
+    result.resumedFrom = download.offset;
+    LOG << "Downloaded " << result.filePath << " " << result.size << " " << result.sha256 << " resumed from " << result.resumedFrom << " " << std::chrono::duration_cast<milliseconds>(::now() - download.timeBegin).count() << " ms";
+    finish(reply, result, SimpleClient::ServerException());
+END_SLOT_WRAPPER
+}
+
+void FileDownloader::onTimerEvent() {
+BEGIN_SLOT_WRAPPER
+    const time_point timeNow = ::now();
+    std::vector<QNetworkReply*> toAbort;
+    for (auto &pair: downloads) {
+        Download &download = *pair.second;
+        if (!download.abortReason.empty()) {
+            continue;
+        }
+        if (download.stallTimeout.count() > 0 && timeNow - download.lastData >= download.stallTimeout) {
+            download.abortReason = "Download stalled";
+            toAbort.emplace_back(pair.first);
+        } else if (download.totalTimeout.count() > 0 && timeNow - download.timeBegin >= download.totalTimeout) {
+            download.abortReason = "Download timeout";
+            toAbort.emplace_back(pair.first);
+        }
+    }
+    for (QNetworkReply *reply: toAbort) {
+        reply->abort();
+    }
+END_SLOT_WRAPPER
+}
@@ -0,0 +1,93 @@
+#ifndef FILEDOWNLOADER_H
+#define FILEDOWNLOADER_H
+
+#include <QObject>
+#include <QUrl>
+
+#include <map>
+#include <memory>
+#include <functional>
+
+#include "client.h"
+#include "duration.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+/*
+   Загрузка больших файлов сразу на диск.
+   Данные пишутся во временный файл filePath.part, хэши считаются по мере получения,
+   при успехе файл атомарно переименовывается в filePath.
+   При обрыве .part и filePath.part.meta сохраняются, и следующая загрузка того же файла
+   докачивает остаток через Range. Если сервер диапазоны не поддерживает, файл качается заново.
+   На каждый поток должен быть один экземпляр класса.
+   */
+class FileDownloader : public QObject {
+    Q_OBJECT
+public:
+
+    struct Result {
+        QString filePath;
+        QString md5;
+        QString sha256;
+        qint64 size = 0;
+        // С какого байта продолжена загрузка
+        qint64 resumedFrom = 0;
+    };
+
+    using Callback = std::function<void(const Result &result, const SimpleClient::ServerException &exception)>;
+
+public:
+
+    explicit FileDownloader(QObject *parent = nullptr);
+
+    ~FileDownloader() override;
+
+    void download(const QUrl &url, const QString &filePath, const Callback &callback, milliseconds stallTimeout, milliseconds totalTimeout);
+
+    size_t countActive() const;
+
+signals:
+
+    void progress(QString filePath, qint64 received, qint64 total);
+
+    void callbackCall(SimpleClient::ReturnCallback callback);
+
+private slots:
+
+    void onMetaDataChanged();
+
+    void onReadyRead();
+
+    void onFinished();
+
+    void onTimerEvent();
+
+private:
+
+    struct Download;
+
+private:
+
+    void startTimer1();
+
+    bool prepareResume(Download &download);
+
+    void processHeaders(QNetworkReply *reply, Download &download);
+
+    void readAvailable(QNetworkReply *reply, Download &download);
+
+    void finish(QNetworkReply *reply, const Result &result, const SimpleClient::ServerException &exception);
+
+private:
+
+    QNetworkAccessManager *manager = nullptr;
+
+    QTimer *timer = nullptr;
+
+    std::map<QNetworkReply*, std::unique_ptr<Download>> downloads;
+
+};
+
+#endif // FILEDOWNLOADER_H
@@ -0,0 +1,173 @@
+#include "HedgedRequest.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+#include <algorithm>
+
+#include "check.h"
+#include "SlotWrapper.h"
+#include "Log.h"
+
+SET_LOG_NAMESPACE("MW");
+
+// Победитель отдается в job потоком, до этого reply не должен вычитывать тело в память
+const static qint64 READ_BUFFER_SIZE = 512 * 1024;
+
+LatencyTracker::LatencyTracker(size_t maxCount)
+    : maxCount(maxCount)
+{}
+
+void LatencyTracker::add(milliseconds latency) {
+    latencies.emplace_back(latency);
+    while (latencies.size() > maxCount) {
+        latencies.pop_front();
+    }
+}
+
+milliseconds LatencyTracker::percentile(double p) const {
+    CHECK(!latencies.empty(), "Latencies empty");
+    std::vector<milliseconds> sorted(latencies.begin(), latencies.end());
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+size_t LatencyTracker::count() const {
+    return latencies.size();
+}
+
+HedgedRequest::HedgedRequest(QNetworkAccessManager &manager, const NextIp &nextIp, const MakeRequest &makeRequest, milliseconds delay, size_t maxRequests, QObject *parent)
+    : QObject(parent)
+    , manager(manager)
+    , nextIp(nextIp)
+    , makeRequest(makeRequest)
+    , delay(delay)
+    , maxRequests(maxRequests)
+{
+    CHECK(maxRequests >= 1, "Incorrect max requests");
+    timer.setSingleShot(true);
+    CHECK(connect(&timer, &QTimer::timeout, this, &HedgedRequest::onTimeout), "not connect timeout");
+}
+
+void HedgedRequest::start(const QString &firstIp) {
+    sendTo(firstIp);
+}
+
+size_t HedgedRequest::countStarted() const {
+    return usedIps.size();
+}
+
+bool HedgedRequest::isDone() const {
+    return isFinished;
+}
+
+bool HedgedRequest::hasWinner() const {
+    return winner != nullptr;
+}
+
+void HedgedRequest::sendTo(const QString &ip) {
+    usedIps.insert(ip);
+    QNetworkReply *reply = manager.get(makeRequest(ip));
+    reply->setReadBufferSize(READ_BUFFER_SIZE);
+    reply->setParent(this);
+    racers.push_back(Racer{reply, ip, ::now()});
+    CHECK(connect(reply, &QNetworkReply::metaDataChanged, [this, reply]() {
+    BEGIN_SLOT_WRAPPER
+        onMetaData(reply);
+    END_SLOT_WRAPPER
+    }), "not connect metaDataChanged");
+    CHECK(connect(reply, &QNetworkReply::finished, [this, reply]() {
+    BEGIN_SLOT_WRAPPER
+        onFinished(reply);
+    END_SLOT_WRAPPER
+    }), "not connect finished");
+
+    if (usedIps.size() < maxRequests) {
+        timer.start(delay.count());
+    }
+}
+
+bool HedgedRequest::sendNext() {
+    if (winner != nullptr || isFinished || usedIps.size() >= maxRequests) {
+        return false;
+    }
+    const QString ip = nextIp(usedIps);
+    if (ip.isEmpty() || usedIps.find(ip) != usedIps.end()) {
+        return false;
+    }
+    LOG_DEBUG << "Hedge request to " << ip;
+    sendTo(ip);
+    return true;
+}
+
+void HedgedRequest::onTimeout() {
+BEGIN_SLOT_WRAPPER
+    sendNext();
+END_SLOT_WRAPPER
+}
+
+void HedgedRequest::dropReply(QNetworkReply *reply) {
+    racers.erase(std::remove_if(racers.begin(), racers.end(), [reply](const Racer &racer) {
+        return racer.reply == reply;
+    }), racers.end());
+    reply->disconnect();
+    reply->abort();
+    reply->deleteLater();
+}
+
+void HedgedRequest::onMetaData(QNetworkReply *reply) {
+    if (winner != nullptr || isFinished) {
+        return;
+    }
+    const QVariant status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+    if (!status.isValid() || status.toInt() >= 500) {
+        return;
+    }
+    winner = reply;
+    timer.stop();
+
+    const auto found = std::find_if(racers.begin(), racers.end(), [reply](const Racer &racer) {
+        return racer.reply == reply;
+    });
+    CHECK(found != racers.end(), "Racer not found");
+    const QString ip = found->ip;
+    const milliseconds latency = std::chrono::duration_cast<milliseconds>(::now() - found->timeBegin);
+
+    std::vector<QNetworkReply*> losers;
+    for (const Racer &racer: racers) {
+        if (racer.reply != reply) {
+            losers.emplace_back(racer.reply);
+        }
+    }
+    for (QNetworkReply *loser: losers) {
+        dropReply(loser);
+    }
+
+    emit winnerSelected(ip, latency);
+    emit started(reply);
+}
+
+void HedgedRequest::onFinished(QNetworkReply *reply) {
+    if (isFinished) {
+        return;
+    }
+    if (winner == nullptr && reply->error() != QNetworkReply::NoError) {
+        if (racers.size() > 1) {
+            dropReply(reply);
+            return;
+        }
+        // Единственный запрос упал, не дожидаемся таймера
+        if (sendNext()) {
+            dropReply(reply);
+            return;
+        }
+    } else if (winner == nullptr) {
+        onMetaData(reply);
+    }
+
+    isFinished = true;
+    timer.stop();
+    emit finished(reply);
+}
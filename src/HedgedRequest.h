@@ -0,0 +1,113 @@
+#ifndef HEDGEDREQUEST_H
+#define HEDGEDREQUEST_H
+
+#include <QObject>
+#include <QTimer>
+
+#include <set>
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include "duration.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QNetworkRequest;
+
+// Задержки первых байтов последних ответов, по ним подбирается задержка перед повторным запросом
+class LatencyTracker {
+public:
+
+    explicit LatencyTracker(size_t maxCount = 100);
+
+    void add(milliseconds latency);
+
+    milliseconds percentile(double p) const;
+
+    size_t count() const;
+
+private:
+
+    const size_t maxCount;
+
+    std::deque<milliseconds> latencies;
+};
+
+// Запрос, который через delay дублируется на следующий ip.
+// Побеждает ответ, первым получивший заголовки, остальные прерываются
+class HedgedRequest : public QObject {
+    Q_OBJECT
+public:
+
+    using NextIp = std::function<QString(const std::set<QString> &excludes)>;
+
+    using MakeRequest = std::function<QNetworkRequest(const QString &ip)>;
+
+public:
+
+    HedgedRequest(QNetworkAccessManager &manager, const NextIp &nextIp, const MakeRequest &makeRequest, milliseconds delay, size_t maxRequests, QObject *parent = nullptr);
+
+    void start(const QString &firstIp);
+
+    size_t countStarted() const;
+
+    bool isDone() const;
+
+    bool hasWinner() const;
+
+signals:
+
+    void winnerSelected(QString ip, milliseconds latency);
+
+    // Победитель получил заголовки, тело еще может загружаться
+    void started(QNetworkReply *reply);
+
+    // Итоговый ответ: победитель либо последний упавший запрос
+    void finished(QNetworkReply *reply);
+
+private slots:
+
+    void onTimeout();
+
+private:
+
+    void sendTo(const QString &ip);
+
+    bool sendNext();
+
+    void onMetaData(QNetworkReply *reply);
+
+    void onFinished(QNetworkReply *reply);
+
+    void dropReply(QNetworkReply *reply);
+
+private:
+
+    struct Racer {
+        QNetworkReply *reply;
+        QString ip;
+        time_point timeBegin;
+    };
+
+private:
+
+    QNetworkAccessManager &manager;
+
+    const NextIp nextIp;
+    const MakeRequest makeRequest;
+
+    const milliseconds delay;
+    const size_t maxRequests;
+
+    std::vector<Racer> racers;
+    std::set<QString> usedIps;
+
+    QNetworkReply *winner = nullptr;
+
+    QTimer timer;
+
+    bool isFinished = false;
+};
+
+#endif // HEDGEDREQUEST_H
@@ -0,0 +1,184 @@
+#include "HtmlDeltaUpdate.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QNetworkReply>
+
+#include <deque>
+#include <memory>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "FileDownloader.h"
+#include "check.h"
+#include "Log.h"
+#include "utils.h"
+
+SET_LOG_NAMESPACE("UPL");
+
+struct HtmlDeltaUpdate::State {
+    QString newPath;
+    milliseconds stallTimeout;
+    milliseconds totalTimeout;
+    size_t maxParallel = 1;
+    Callback callback;
+
+    std::deque<FileInfo> toDownload;
+    size_t countActive = 0;
+
+    Stats stats;
+    time_point timeBegin;
+
+    bool isFailed = false;
+    bool isFinished = false;
+    SimpleClient::ServerException exception;
+};
+
+static bool isSafePath(const QString &path) {
+    if (path.isEmpty() || QDir::isAbsolutePath(path) || path.startsWith("/") || path.startsWith("\\")) {
+        return false;
+    }
+    for (const QString &part: QDir::fromNativeSeparators(path).split('/')) {
+        if (part == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+HtmlDeltaUpdate::Manifest HtmlDeltaUpdate::parseManifest(const QUrl &manifestUrl, const std::string &content) {
+    const QJsonDocument document = QJsonDocument::fromJson(QByteArray::fromStdString(content));
+    CHECK(document.isObject(), "Incorrect manifest");
+    const QJsonObject root = document.object();
+    CHECK(root.contains("files") && root.value("files").isArray(), "files field not found");
+
+    Manifest manifest;
+    for (const QJsonValue &fileJson: root.value("files").toArray()) {
+        CHECK(fileJson.isObject(), "Incorrect manifest file");
+        const QJsonObject fileObj = fileJson.toObject();
+        FileInfo info;
+        CHECK(fileObj.contains("path") && fileObj.value("path").isString(), "path field not found");
+        info.path = fileObj.value("path").toString();
+        CHECK(isSafePath(info.path), "Incorrect path " + info.path.toStdString());
+        CHECK(fileObj.contains("sha256") && fileObj.value("sha256").isString(), "sha256 field not found");
+        info.sha256 = fileObj.value("sha256").toString().toLower();
+        CHECK(fileObj.contains("size") && fileObj.value("size").isDouble(), "size field not found");
+        info.size = static_cast<qint64>(fileObj.value("size").toDouble());
+        if (fileObj.contains("url") && fileObj.value("url").isString()) {
+            info.url = QUrl(fileObj.value("url").toString());
+        } else {
+            // Файлы лежат рядом с манифестом
+            info.url = manifestUrl.resolved(QUrl(info.path));
+        }
+        manifest.files.emplace_back(info);
+    }
+    return manifest;
+}
+
+QString HtmlDeltaUpdate::fileSha256(const QString &filePath) {
+    QFile file(filePath);
+    CHECK(file.open(QIODevice::ReadOnly), "Not open file " + filePath.toStdString());
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    CHECK(hash.addData(&file), "Not read file " + filePath.toStdString());
+    return QString(hash.result().toHex());
+}
+
+bool HtmlDeltaUpdate::linkOrCopy(const QString &from, const QString &to) {
+    QFile::remove(to);
+#ifdef _WIN32
+    if (CreateHardLinkW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(to).utf16()), reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(from).utf16()), nullptr)) {
+        return true;
+    }
+#else
+    if (::link(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0) {
+        return true;
+    }
+#endif
+    return QFile::copy(from, to);
+}
+
+void HtmlDeltaUpdate::start(FileDownloader &downloader, const Manifest &manifest, const QString &oldPath, const QString &newPath, size_t maxParallel, milliseconds stallTimeout, milliseconds totalTimeout, const Callback &callback) {
+    CHECK(maxParallel > 0, "Incorrect maxParallel");
+    std::shared_ptr<State> state = std::make_shared<State>();
+    state->newPath = newPath;
+    state->stallTimeout = stallTimeout;
+    state->totalTimeout = totalTimeout;
+    state->maxParallel = maxParallel;
+    state->callback = callback;
+    state->timeBegin = ::now();
+
+    QDir newDir(newPath);
+    if (newDir.exists()) {
+        CHECK(newDir.removeRecursively(), "Not remove folder " + newPath.toStdString());
+    }
+    CHECK(QDir().mkpath(newPath), "Not create folder " + newPath.toStdString());
+
+    for (const FileInfo &info: manifest.files) {
+        const QString newFile = makePath(newPath, info.path);
+        CHECK(QDir().mkpath(QFileInfo(newFile).absolutePath()), "Not create folder for " + newFile.toStdString());
+
+        const QString oldFile = makePath(oldPath, info.path);
+        const QFileInfo oldInfo(oldFile);
+        if (!oldPath.isEmpty() && oldInfo.isFile() && oldInfo.size() == info.size && fileSha256(oldFile) == info.sha256) {
+            if (linkOrCopy(oldFile, newFile)) {
+                state->stats.countLinked++;
+                continue;
+            }
+            LOG << "Not link " << oldFile;
+        }
+        state->toDownload.emplace_back(info);
+    }
+
+    LOG << "Delta update " << newPath << ": linked " << state->stats.countLinked << ", download " << state->toDownload.size();
+    downloadNext(downloader, state);
+}
+
+void HtmlDeltaUpdate::downloadNext(FileDownloader &downloader, const std::shared_ptr<State> &state) {
+    if (state->isFinished) {
+        return;
+    }
+    while (!state->isFailed && !state->toDownload.empty() && state->countActive < state->maxParallel) {
+        const FileInfo info = state->toDownload.front();
+        state->toDownload.pop_front();
+        state->countActive++;
+
+        const auto callback = [&downloader, state, info](const FileDownloader::Result &result, const SimpleClient::ServerException &exception) {
+            state->countActive--;
+            if (exception.isSet()) {
+                state->isFailed = true;
+                state->exception = exception;
+            } else if (result.sha256 != info.sha256 || result.size != info.size) {
+                state->isFailed = true;
+                state->exception = SimpleClient::ServerException(info.url.toString().toStdString(), QNetworkReply::UnknownContentError, "Hash not equal manifest " + info.path.toStdString(), "");
+            } else {
+                state->stats.countDownloaded++;
+                state->stats.bytesDownloaded += result.size - result.resumedFrom;
+            }
+            downloadNext(downloader, state);
+        };
+
+        try {
+            downloader.download(info.url, makePath(state->newPath, info.path), callback, state->stallTimeout, state->totalTimeout);
+        } catch (const Exception &e) {
+            state->countActive--;
+            state->isFailed = true;
+            state->exception = SimpleClient::ServerException(info.url.toString().toStdString(), QNetworkReply::UnknownContentError, e, "");
+        }
+    }
+
+    if (state->countActive == 0 && (state->isFailed || state->toDownload.empty())) {
+        state->isFinished = true;
+        state->stats.time = std::chrono::duration_cast<milliseconds>(::now() - state->timeBegin);
+        LOG << "Delta update finished " << state->newPath << ": linked " << state->stats.countLinked << ", downloaded " << state->stats.countDownloaded << " " << state->stats.bytesDownloaded << " bytes, " << state->stats.time.count() << " ms" << (state->isFailed ? ", error " + state->exception.description : "");
+        state->callback(state->stats, state->exception);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef HTMLDELTAUPDATE_H
+#define HTMLDELTAUPDATE_H
+
+#include <QString>
+#include <QUrl>
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "client.h"
+#include "duration.h"
+
+class FileDownloader;
+
+/*
+   Обновление html-интерфейса по манифесту.
+   Сервер публикует список файлов версии с их sha256.
+   Файлы, совпадающие с текущей версией, переносятся в новую папку жесткой ссылкой,
+   скачиваются только изменившиеся.
+   */
+class HtmlDeltaUpdate {
+public:
+
+    struct FileInfo {
+        QString path;
+        QString sha256;
+        qint64 size = 0;
+        QUrl url;
+    };
+
+    struct Manifest {
+        std::vector<FileInfo> files;
+    };
+
+    struct Stats {
+        size_t countLinked = 0;
+        size_t countDownloaded = 0;
+        qint64 bytesDownloaded = 0;
+        milliseconds time{0};
+    };
+
+    using Callback = std::function<void(const Stats &stats, const SimpleClient::ServerException &exception)>;
+
+public:
+
+    static Manifest parseManifest(const QUrl &manifestUrl, const std::string &content);
+
+    // callback вызывается через FileDownloader::callbackCall
+    static void start(FileDownloader &downloader, const Manifest &manifest, const QString &oldPath, const QString &newPath, size_t maxParallel, milliseconds stallTimeout, milliseconds totalTimeout, const Callback &callback);
+
+    static QString fileSha256(const QString &filePath);
+
+    // Если жесткая ссылка не создалась (например, другой диск), файл копируется
+    static bool linkOrCopy(const QString &from, const QString &to);
+
+private:
+
+    struct State;
+
+    static void downloadNext(FileDownloader &downloader, const std::shared_ptr<State> &state);
+
+};
+
+#endif // HTMLDELTAUPDATE_H
@@ -10,101 +10,138 @@ using namespace std::placeholders;
 
 #include <QThread>
 
+#include <algorithm>
+
 QT_USE_NAMESPACE
 
 HttpSimpleClient::HttpSimpleClient() {
     Q_REG(HttpSimpleClient::ReturnCallback, "HttpSimpleClient::ReturnCallback");
 }
 
+HttpSimpleClient::~HttpSimpleClient() {
+    for (auto &pair: connections) {
+        for (HttpSocket *socket: pair.second) {
+            socket->disconnect(this);
+            delete socket;
+        }
+    }
+}
+
 void HttpSimpleClient::moveToThread(QThread *thread)
 {
     thread1 = thread;
     QObject::moveToThread(thread);
 }
 
-void HttpSimpleClient::startTimer1()
+void HttpSimpleClient::setMaxConnectionsPerHost(size_t count)
 {
-    if (timer == nullptr) {
-        timer = new QTimer();
-        CHECK(connect(timer, &QTimer::timeout, this, &HttpSimpleClient::onTimerEvent), "not connect timeout");
-        if (thread1 != nullptr) {
-            CHECK(connect(thread1, &QThread::finished, timer, &QTimer::stop), "not connect finished");
-        }
-        timer->setInterval(milliseconds(1s).count());
-        timer->start();
-    }
+    CHECK(count > 0, "Incorrect max connections");
+    maxConnectionsPerHost = count;
 }
 
-static void addRequestId(HttpSocket *socket, const int id)
+void HttpSimpleClient::setIdleTimeout(milliseconds timeout)
 {
-    socket->setRequestId(id);
+    idleTimeout = timeout;
 }
 
-static int getRequestId(HttpSocket *socket)
+void HttpSimpleClient::setPipelining(bool isPipelining)
 {
-    return socket->requestId();
+    this->isPipelining = isPipelining;
 }
 
-static void addBeginTime(HttpSocket *socket, time_point tp)
+void HttpSimpleClient::setMaxDecodedSize(int size)
 {
-    socket->setTimePoint(tp);
+    CHECK(size > 0, "Incorrect max decoded size");
+    maxDecodedSize = size;
 }
 
-static time_point getBeginTime(HttpSocket *socket)
+void HttpSimpleClient::setSizeCallback(const HttpCompression::SizeCallback &callback)
 {
-    return socket->timePoint();
+    sizeCallback = callback;
 }
 
-static void addTimeout(HttpSocket *socket, milliseconds timeout)
+void HttpSimpleClient::startTimer1()
 {
-    socket->setTimeOut(timeout);
+    if (timer == nullptr) {
+        timer = new QTimer();
+        CHECK(connect(timer, &QTimer::timeout, this, &HttpSimpleClient::onTimerEvent), "not connect timeout");
+        if (thread1 != nullptr) {
+            CHECK(connect(thread1, &QThread::finished, timer, &QTimer::stop), "not connect finished");
+        }
+        timer->setInterval(milliseconds(1s).count());
+        timer->start();
+    }
 }
 
-static milliseconds getTimeout(HttpSocket *socket)
+static QString hostKey(const QUrl &url)
 {
-    return  socket->timeOut();
+    return url.host() + ":" + QString::number(url.port(80));
 }
 
 void HttpSimpleClient::onTimerEvent()
 {
 BEGIN_SLOT_WRAPPER
-    std::vector<HttpSocket *> toStop;
-    const time_point timeEnd = ::now();
-    for (auto &iter: sockets) {
-        HttpSocket *socket = iter.second;
-        if (socket->hasTimeOut()) {
-            const milliseconds timeout = getTimeout(socket);
-            const time_point timeBegin = getBeginTime(socket);
-            const milliseconds duration = std::chrono::duration_cast<milliseconds>(timeEnd - timeBegin);
-            if (duration >= timeout) {
-                LOG << "Timeout request";
-                toStop.push_back(socket);
-            }
+    const time_point now = ::now();
+    std::vector<HttpSocket*> all;
+    for (const auto &pair: connections) {
+        all.insert(all.end(), pair.second.begin(), pair.second.end());
+    }
+    // Соединение может закрыться прямо в цикле и удалиться из connections
+    for (HttpSocket *socket: all) {
+        if (socket->isClosed()) {
+            continue;
+        }
+        socket->expireRequests(now);
+        if (!socket->isClosed() && now - socket->idleSince() >= idleTimeout) {
+            socket->closeIfIdle();
         }
     }
+END_SLOT_WRAPPER
+}
 
-    for (HttpSocket *socket: toStop) {
-        socket->stop();
+HttpSocket* HttpSimpleClient::getConnection(const QUrl &url)
+{
+    std::vector<HttpSocket*> &hostConnections = connections[hostKey(url)];
+    HttpSocket *best = nullptr;
+    for (HttpSocket *socket: hostConnections) {
+        if (socket->isClosed()) {
+            continue;
+        }
+        if (best == nullptr || socket->countRequests() < best->countRequests()) {
+            best = socket;
+        }
     }
-    END_SLOT_WRAPPER
+    if (best != nullptr && (best->countRequests() == 0 || hostConnections.size() >= maxConnectionsPerHost)) {
+        return best;
+    }
+
+    HttpSocket *socket = new HttpSocket(url, isPipelining);
+    CHECK(connect(socket, &HttpSocket::requestFinished, this, &HttpSimpleClient::onRequestFinished), "not connect requestFinished");
+    CHECK(connect(socket, &HttpSocket::closed, this, &HttpSimpleClient::onSocketClosed), "not connect closed");
+    hostConnections.emplace_back(socket);
+    LOG_DEBUG << "New connection " << hostKey(url) << " " << hostConnections.size();
+    return socket;
+}
+
+void HttpSimpleClient::sendRequest(const QUrl &url, const HttpSocket::Request &request)
+{
+    getConnection(url)->addRequest(request);
 }
 
 void HttpSimpleClient::sendMessagePost(const QUrl &url, const QString &message, const ClientCallback &callback, bool isTimeout, milliseconds timeout)
 {
     startTimer1();
 
-    std::unique_ptr<HttpSocket> socket(new HttpSocket(url, message));
-    callbacks[id] = callback;
-    sockets[id] = socket.get();
-    addRequestId(socket.get(), id);
-    id++;
+    HttpSocket::Request request;
+    request.id = id++;
+    request.data = HttpSocket::makeHttpPost(url, message);
     if (isTimeout) {
-        const time_point time = ::now();
-        addBeginTime(socket.get(), time);
-        addTimeout(socket.get(), timeout);
+        request.hasTimeOut = true;
+        request.timePoint = ::now();
+        request.timeOut = timeout;
     }
-    connect(socket.get(), &HttpSocket::finished, this, &HttpSimpleClient::onSocketFinished);
-    socket.release()->start();
+    callbacks[request.id] = callback;
+    sendRequest(url, request);
 }
 
 void HttpSimpleClient::sendMessagePost(const QUrl &url, const QString &message, const ClientCallback &callback)
@@ -120,180 +157,296 @@ template<class Callbacks, typename... Message>
 void HttpSimpleClient::runCallback(Callbacks &callbacks, const int id, Message&&... messages)
 {
     const auto foundCallback = callbacks.find(id);
-    CHECK(foundCallback != callbacks.end(), "not found callback on id " + id);
+    CHECK(foundCallback != callbacks.end(), "not found callback on id " + std::to_string(id));
     const auto callback = std::bind(foundCallback->second, std::forward<Message>(messages)...);
     emit callbackCall(callback);
     callbacks.erase(foundCallback);
-    sockets.erase(id);
 }
 
-
-void HttpSimpleClient::onSocketFinished()
+void HttpSimpleClient::onRequestFinished(int requestId, const QByteArray &reply, const QByteArray &encoding, const QString &error)
 {
 BEGIN_SLOT_WRAPPER
+    if (!error.isEmpty()) {
+        runCallback(callbacks, requestId, "", TypedException(TypeErrors::CLIENT_ERROR, error.toStdString()));
+        return;
+    }
+
+    HttpCompression::ResponseSize size;
     HttpSocket *socket = qobject_cast<HttpSocket *>(sender());
-    CHECK(socket, "Not socket object");
-    const int requestId = getRequestId(socket);
-    if (socket->hasError()) {
-        runCallback(callbacks, requestId, "", TypedException(TypeErrors::CLIENT_ERROR, std::to_string(socket->errorC()) + " " + socket->errorString().toStdString()));
-    } else {
-        QByteArray content = socket->getReply();
-        runCallback(callbacks, requestId, std::string(content.data(), content.size()), TypedException());
+    if (socket != nullptr) {
+        size.url = socket->hostUrl();
+    }
+    size.encoding = encoding;
+    size.wireBytes = reply.size();
+    QByteArray content;
+    try {
+        content = HttpCompression::decode(encoding, reply, maxDecodedSize);
+    } catch (const Exception &e) {
+        runCallback(callbacks, requestId, "", TypedException(TypeErrors::CLIENT_ERROR, e));
+        return;
+    }
+    size.decodedBytes = content.size();
+    trafficStats.add(size);
+    if (sizeCallback) {
+        sizeCallback(size);
     }
+    runCallback(callbacks, requestId, std::string(content.data(), content.size()), TypedException());
+END_SLOT_WRAPPER
+}
 
+void HttpSimpleClient::onSocketClosed()
+{
+BEGIN_SLOT_WRAPPER
+    HttpSocket *socket = qobject_cast<HttpSocket *>(sender());
+    CHECK(socket, "Not socket object");
+    std::vector<HttpSocket*> &hostConnections = connections[hostKey(socket->hostUrl())];
+    hostConnections.erase(std::remove(hostConnections.begin(), hostConnections.end(), socket), hostConnections.end());
+    const QUrl url = socket->hostUrl();
+    const std::vector<HttpSocket::Request> retry = socket->takeRetryRequests();
     socket->deleteLater();
 
+    for (const HttpSocket::Request &request: retry) {
+        sendRequest(url, request);
+    }
 END_SLOT_WRAPPER
 }
 
-HttpSocket::HttpSocket(const QUrl &url, const QString &message, QObject *parent)
+HttpSocket::HttpSocket(const QUrl &url, bool isPipelining, QObject *parent)
     : QTcpSocket(parent)
     , m_url(url)
-    , m_message(message)
+    , m_isPipelining(isPipelining)
+    , m_idleSince(::now())
 {
     connect(this, &QAbstractSocket::connected, this, &HttpSocket::onConnected);
+    connect(this, &QAbstractSocket::disconnected, this, &HttpSocket::onDisconnected);
     connect(this, static_cast<void (QTcpSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error), this, &HttpSocket::onError);
     connect(this, &QIODevice::readyRead, this, &HttpSocket::onReadyRead);
 }
 
-void HttpSocket::start()
+void HttpSocket::addRequest(const Request &request)
 {
-    connectToHost(m_url.host(), m_url.port(80));
+    CHECK(!m_isClosed, "Connection closed");
+    m_requests.emplace_back(request);
+    if (state() == QAbstractSocket::UnconnectedState) {
+        connectToHost(m_url.host(), m_url.port(80));
+    } else if (m_isConnected) {
+        sendPending();
+    }
 }
 
-void HttpSocket::stop()
+void HttpSocket::sendPending()
 {
-    abort();
-    m_error = true;
-    emit finished();
+    for (Request &request: m_requests) {
+        if (request.isSent) {
+            if (!m_isPipelining) {
+                return;
+            }
+            continue;
+        }
+        write(request.data);
+        request.isSent = true;
+        if (!m_isPipelining) {
+            return;
+        }
+    }
 }
 
-int HttpSocket::requestId() const
+void HttpSocket::expireRequests(const time_point &now)
 {
-    return m_requestId;
+    std::vector<int> expired;
+    bool isSentExpired = false;
+    for (auto iter = m_requests.begin(); iter != m_requests.end();) {
+        if (iter->hasTimeOut && now - iter->timePoint >= iter->timeOut) {
+            expired.emplace_back(iter->id);
+            isSentExpired = isSentExpired || iter->isSent;
+            iter = m_requests.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    if (expired.empty()) {
+        return;
+    }
+    if (m_requests.empty()) {
+        m_idleSince = now;
+    }
+    for (const int requestId: expired) {
+        LOG_DEBUG << "Timeout request";
+        emit requestFinished(requestId, "", "", "Timeout request");
+    }
+    if (isSentExpired) {
+        // Ответ на просроченный запрос еще может прийти и сдвинет очередь, соединение больше не годится
+        closeConnection("Connection aborted");
+    }
 }
 
-void HttpSocket::setRequestId(const int s)
+void HttpSocket::closeIfIdle()
 {
-    m_requestId = s;
+    if (m_requests.empty()) {
+        closeConnection("");
+    }
 }
 
-bool HttpSocket::hasTimeOut() const
+std::vector<HttpSocket::Request> HttpSocket::takeRetryRequests()
 {
-    return m_hasTimeOut;
+    std::vector<Request> result;
+    result.swap(m_retryRequests);
+    return result;
 }
 
-bool HttpSocket::hasError() const
+void HttpSocket::onConnected()
 {
-    return m_error;
+    m_isConnected = true;
+    sendPending();
 }
 
-time_point HttpSocket::timePoint() const
+void HttpSocket::onDisconnected()
 {
-    return m_timePoint;
+    closeConnection("Connection closed");
 }
 
-void HttpSocket::setTimePoint(time_point s)
+void HttpSocket::onError(QAbstractSocket::SocketError socketError)
 {
-    m_timePoint = s;
-    m_hasTimeOut = true;
+    closeConnection(QString::number(socketError) + " " + errorString());
 }
 
-milliseconds HttpSocket::timeOut() const
+void HttpSocket::onReadyRead()
 {
-    return m_timeOut;
+    m_data += readAll();
+    while (!m_isClosed && parseResponse()) {
+    }
 }
 
-void HttpSocket::setTimeOut(milliseconds s)
+void HttpSocket::resetResponse()
 {
-    m_timeOut = s;
+    m_firstHeaderStringParsed = false;
+    m_headerParsed = false;
+    m_statusOk = false;
+    m_statusLine.clear();
+    m_contentLength = -1;
+    m_contentEncoding.clear();
+    m_isCloseResponse = false;
 }
 
-QByteArray HttpSocket::getReply() const
+void HttpSocket::finishRequest(const QByteArray &reply, const QByteArray &encoding, const QString &error)
 {
-    return m_reply;
+    const Request request = m_requests.front();
+    m_requests.pop_front();
+    if (m_requests.empty()) {
+        m_idleSince = ::now();
+    }
+    emit requestFinished(request.id, reply, encoding, error);
 }
 
-void HttpSocket::onConnected()
+// Возвращает true, если ответ разобран целиком и в буфере может быть следующий
+bool HttpSocket::parseResponse()
 {
-    QByteArray d = getHttpPostHeader();
-    d += m_message.toLatin1();
-    write(d);
-}
+    if (m_requests.empty() || !m_requests.front().isSent) {
+        if (!m_data.isEmpty()) {
+            closeConnection("Unexpected response");
+        }
+        return false;
+    }
 
-void HttpSocket::onError(QAbstractSocket::SocketError socketError)
-{
-    errorCode = socketError;
-    m_error = true;
-    emit finished();
+    while (!m_headerParsed) {
+        const int index = m_data.indexOf('\n');
+        if (index == -1) {
+            return false;
+        }
+        QByteArray s = m_data.left(index);
+        m_data = m_data.mid(index + 1);
+        if (s.endsWith('\r')) {
+            s = s.left(s.length() - 1);
+        }
+        if (!m_firstHeaderStringParsed) {
+            m_statusLine = s;
+            m_statusOk = s.startsWith("HTTP/1.1 200") || s.startsWith("HTTP/1.0 200");
+            // HTTP/1.0 без явного keep-alive закрывает соединение
+            m_isCloseResponse = s.startsWith("HTTP/1.0");
+            m_firstHeaderStringParsed = true;
+            continue;
+        }
+        if (s.isEmpty()) {
+            m_headerParsed = true;
+            break;
+        }
+        const QByteArray lower = s.toLower();
+        if (lower.startsWith("content-length:")) {
+            m_contentLength = s.mid(15).trimmed().toInt();
+        } else if (lower.startsWith("content-encoding:")) {
+            m_contentEncoding = s.mid(17).trimmed();
+        } else if (lower.startsWith("connection:")) {
+            const QByteArray value = lower.mid(11).trimmed();
+            if (value == "close") {
+                m_isCloseResponse = true;
+            } else if (value == "keep-alive") {
+                m_isCloseResponse = false;
+            }
+        }
+    }
+
+    if (m_contentLength == -1) {
+        // Ответы без Content-Length не поддерживаются
+        finishRequest("", "", "Incorrect response: " + QString(m_statusLine));
+        closeConnection("Connection aborted");
+        return false;
+    }
+    if (m_data.length() < m_contentLength) {
+        return false;
+    }
+
+    const QByteArray reply = m_data.left(m_contentLength);
+    m_data = m_data.mid(m_contentLength);
+    const bool isClose = m_isCloseResponse;
+    const QByteArray encoding = m_contentEncoding;
+    const QString error = m_statusOk ? QString() : "HTTP error: " + QString(m_statusLine);
+    resetResponse();
+    finishRequest(reply, encoding, error);
+
+    if (isClose) {
+        closeConnection("Connection closed");
+        return false;
+    }
+    sendPending();
+    return true;
 }
 
-void HttpSocket::onReadyRead()
+void HttpSocket::closeConnection(const QString &error)
 {
-    QByteArray d = readAll();
-    m_data += d;
-    parseResponseHeader();
-    if (m_error) {
-        abort();
-        emit finished();
+    if (m_isClosed) {
+        return;
     }
-    if (m_headerParsed) {
-        if (m_contentLength != -1) {
-            if (m_data.length() >= m_contentLength) {
-                m_reply = m_data.left(m_contentLength);
-                emit finished();
-            }
+    m_isClosed = true;
+
+    std::deque<Request> requests;
+    requests.swap(m_requests);
+    for (Request &request: requests) {
+        // Переносятся только неотправленные запросы. Отправленный мог быть уже выполнен сервером
+        // (например, отправка транзакции), поэтому повтор оставляется вызывающему коду
+        if (m_isConnected && !request.isSent) {
+            m_retryRequests.emplace_back(request);
         } else {
-            m_error = true;
-            abort();
-            emit finished();
+            emit requestFinished(request.id, "", "", error.isEmpty() ? "Connection closed" : error);
         }
-
     }
+
+    abort();
+    emit closed();
 }
 
-QByteArray HttpSocket::getHttpPostHeader() const
+QByteArray HttpSocket::makeHttpPost(const QUrl &url, const QString &message)
 {
+    const QByteArray body = message.toLatin1();
     QString data;
 
     data += QStringLiteral("POST / HTTP/1.1\r\n");
-    data += QStringLiteral("Host: ") + m_url.host() + QStringLiteral(":") + QString::number(m_url.port(80)) + QStringLiteral("\r\n");
+    data += QStringLiteral("Host: ") + url.host() + QStringLiteral(":") + QString::number(url.port(80)) + QStringLiteral("\r\n");
     data += QStringLiteral("Content-Type: application/x-www-form-urlencoded\r\n");
     data += QStringLiteral("Accept: */*\r\n");
-    data += QStringLiteral("Accept-Encoding: identity\r\n");
-    data += QStringLiteral("Content-Length: %1\r\n").arg(m_message.toLatin1().length());
+    data += QStringLiteral("Accept-Encoding: ") + QString(HttpCompression::ACCEPT_ENCODING) + QStringLiteral("\r\n");
+    data += QStringLiteral("Connection: keep-alive\r\n");
+    data += QStringLiteral("Content-Length: %1\r\n").arg(body.length());
     data += QStringLiteral("\r\n");
 
-    return data.toLatin1();
-}
-
-void HttpSocket::parseResponseHeader()
-{
-    if (m_headerParsed)
-        return;
-    while(true) {
-        int index = m_data.indexOf('\n');
-        if (index == -1)
-            break;
-        QByteArray s = m_data.left(index);
-        if (!m_firstHeaderStringParsed) {
-            if (!s.startsWith("HTTP/1.1 200 OK") && !s.startsWith("HTTP/1.0 200 OK")) {
-                // HTTP error
-                m_error = true;
-                return;
-            }
-            m_firstHeaderStringParsed = true;
-        }
-        m_data = m_data.mid(index + 1);
-        if (s.isEmpty() || s == QByteArray("\r")) {
-            m_headerParsed = true;
-            return;
-        }
-        if (s.startsWith("Content-Length: ")) {
-            s = s.mid(16);
-            if (s.endsWith('\r'))
-                s = s.left(s.length() - 1);
-            m_contentLength = s.toInt();
-        }
-    }
+    return data.toLatin1() + body;
 }
@@ -9,69 +9,108 @@
 #include <memory>
 #include <functional>
 #include <map>
+#include <deque>
+#include <vector>
 #include <string>
 
 #include "duration.h"
+#include "HttpCompression.h"
 
 struct TypedException;
 
+/*
+   Соединение с одним хостом. Между запросами остается открытым (keep-alive).
+   Запросы уходят по очереди после ответа на предыдущий, с pipelining - не дожидаясь ответов.
+   */
 class HttpSocket : public QTcpSocket
 {
     Q_OBJECT
 public:
-    explicit HttpSocket(const QUrl &url, const QString &message, QObject *parent = nullptr);
 
-    void start();
-    void stop();
+    struct Request {
+        int id = 0;
+        QByteArray data;
+        time_point timePoint;
+        milliseconds timeOut{0};
+        bool hasTimeOut = false;
+        bool isSent = false;
+    };
+
+public:
+    explicit HttpSocket(const QUrl &url, bool isPipelining, QObject *parent = nullptr);
+
+    void addRequest(const Request &request);
 
-    int requestId() const;
-    void setRequestId(const int s);
+    // Запросы с истекшим таймаутом завершаются ошибкой. Если такой запрос уже отправлен, соединение закрывается
+    void expireRequests(const time_point &now);
 
-    bool hasTimeOut() const;
-    bool hasError() const;
+    // Закрывает соединение, если на нем нет запросов
+    void closeIfIdle();
 
-    time_point timePoint() const;
-    void setTimePoint(time_point s);
+    const QUrl& hostUrl() const {
+        return m_url;
+    }
 
-    milliseconds timeOut() const;
-    void setTimeOut(milliseconds s);
+    size_t countRequests() const {
+        return m_requests.size();
+    }
 
-    QByteArray getReply() const;
+    bool isClosed() const {
+        return m_isClosed;
+    }
 
-    int errorC() const {
-        return errorCode;
+    time_point idleSince() const {
+        return m_idleSince;
     }
 
+    // После закрытия: запросы, которые нужно повторить на другом соединении
+    std::vector<Request> takeRetryRequests();
+
+    static QByteArray makeHttpPost(const QUrl &url, const QString &message);
+
 signals:
-    void finished();
+    void requestFinished(int requestId, const QByteArray &reply, const QByteArray &encoding, const QString &error);
+
+    void closed();
 
 private slots:
     void onConnected();
+    void onDisconnected();
     void onError(QAbstractSocket::SocketError socketError);
     void onReadyRead();
 
 private:
-    QByteArray getHttpPostHeader() const;
-    void parseResponseHeader();
+    void sendPending();
+    bool parseResponse();
+    void resetResponse();
+    void finishRequest(const QByteArray &reply, const QByteArray &encoding, const QString &error);
+    void closeConnection(const QString &error);
 
-    int m_requestId;
-    time_point m_timePoint;
-    milliseconds m_timeOut;
-    bool m_hasTimeOut = false;
+private:
+    const QUrl m_url;
+    const bool m_isPipelining;
+
+    std::deque<Request> m_requests;
+    std::vector<Request> m_retryRequests;
 
-    QUrl m_url;
-    QString m_message;
     QByteArray m_data;
+    bool m_firstHeaderStringParsed = false;
     bool m_headerParsed = false;
+    bool m_statusOk = false;
+    QByteArray m_statusLine;
     int m_contentLength = -1;
-    QByteArray m_reply;
-    bool m_error = false;
-    bool m_firstHeaderStringParsed = false;
-    int errorCode = 0;
+    QByteArray m_contentEncoding;
+    bool m_isCloseResponse = false;
+
+    bool m_isConnected = false;
+    bool m_isClosed = false;
+    time_point m_idleSince;
 };
 
 /*
    На каждый поток должен быть один экземпляр класса.
+   Соединения переиспользуются: на хост держится не больше maxConnectionsPerHost,
+   простаивающие дольше idleTimeout закрываются.
    */
 class HttpSimpleClient : public QObject
 {
@@ -84,11 +123,28 @@ public:
 public:
     explicit HttpSimpleClient();
 
+    ~HttpSimpleClient() override;
+
     void sendMessagePost(const QUrl &url, const QString &message, const ClientCallback &callback);
     void sendMessagePost(const QUrl &url, const QString &message, const ClientCallback &callback, milliseconds timeout);
 
     void moveToThread(QThread *thread);
 
+    void setMaxConnectionsPerHost(size_t count);
+
+    void setIdleTimeout(milliseconds timeout);
+
+    void setPipelining(bool isPipelining);
+
+    void setMaxDecodedSize(int size);
+
+    void setSizeCallback(const HttpCompression::SizeCallback &callback);
+
+    // Читать из потока клиента
+    const HttpCompression::Stats& getTrafficStats() const {
+        return trafficStats;
+    }
+
 Q_SIGNALS:
 
     void callbackCall(HttpSimpleClient::ReturnCallback callback);
@@ -97,12 +153,17 @@ Q_SIGNALS:
     void closed();
 
 private slots:
-    void onSocketFinished();
+    void onRequestFinished(int requestId, const QByteArray &reply, const QByteArray &encoding, const QString &error);
+    void onSocketClosed();
     void onTimerEvent();
 
 private:
     void sendMessagePost(const QUrl &url, const QString &message, const ClientCallback &callback, bool isTimeout, milliseconds timeout);
 
+    void sendRequest(const QUrl &url, const HttpSocket::Request &request);
+
+    HttpSocket* getConnection(const QUrl &url);
+
     template<class Callbacks, typename... Message>
     void runCallback(Callbacks &callbacks, const int id, Message&&... messages);
 
@@ -110,7 +171,16 @@ private:
 
 private:
     std::map<int, ClientCallback> callbacks;
-    std::map<int, HttpSocket *> sockets;
+    // host:port -> соединения
+    std::map<QString, std::vector<HttpSocket*>> connections;
+
+    size_t maxConnectionsPerHost = 4;
+    milliseconds idleTimeout = 30s;
+    bool isPipelining = false;
+    int maxDecodedSize = HttpCompression::DEFAULT_MAX_DECODED_SIZE;
+
+    HttpCompression::SizeCallback sizeCallback;
+    HttpCompression::Stats trafficStats;
 
     QTimer* timer = nullptr;
     QThread *thread1 = nullptr;
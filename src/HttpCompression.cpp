@@ -0,0 +1,94 @@
+#include "HttpCompression.h"
+
+#include <cstring>
+
+#include <zlib.h>
+
+#include "check.h"
+
+namespace {
+
+const int CHUNK_SIZE = 16 * 1024;
+
+// gzip заголовок, автоопределение gzip/zlib
+const int WINDOW_BITS_GZIP = 15 + 32;
+const int WINDOW_BITS_ZLIB = 15;
+const int WINDOW_BITS_RAW = -15;
+
+class InflateStream {
+public:
+
+    explicit InflateStream(int windowBits) {
+        memset(&stream, 0, sizeof(stream));
+        CHECK(inflateInit2(&stream, windowBits) == Z_OK, "inflateInit error");
+    }
+
+    ~InflateStream() {
+        inflateEnd(&stream);
+    }
+
+    z_stream stream;
+};
+
+// Возвращает false, если данные не в этом формате
+bool inflateData(const QByteArray &data, int windowBits, int maxDecodedSize, QByteArray &result) {
+    InflateStream inflater(windowBits);
+    z_stream &stream = inflater.stream;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+
+    result.clear();
+    char buffer[CHUNK_SIZE];
+    int ret = Z_OK;
+    while (ret != Z_STREAM_END) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = CHUNK_SIZE;
+        ret = inflate(&stream, Z_NO_FLUSH);
+        // Z_BUF_ERROR - данные кончились раньше конца потока
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            return false;
+        }
+        const int produced = CHUNK_SIZE - static_cast<int>(stream.avail_out);
+        CHECK(result.size() <= maxDecodedSize - produced, "Decoded response exceeds " + std::to_string(maxDecodedSize) + " bytes");
+        result.append(buffer, produced);
+    }
+    return true;
+}
+
+}
+
+const QByteArray HttpCompression::ACCEPT_ENCODING = "gzip, deflate";
+
+void HttpCompression::Stats::add(const ResponseSize &size) {
+    countResponses++;
+    if (isCompressed(size.encoding)) {
+        countCompressed++;
+    }
+    wireBytes += static_cast<uint64_t>(size.wireBytes);
+    decodedBytes += static_cast<uint64_t>(size.decodedBytes);
+}
+
+bool HttpCompression::isCompressed(const QByteArray &encoding) {
+    const QByteArray enc = encoding.trimmed().toLower();
+    return !enc.isEmpty() && enc != "identity";
+}
+
+QByteArray HttpCompression::decode(const QByteArray &encoding, const QByteArray &data, int maxDecodedSize) {
+    const QByteArray enc = encoding.trimmed().toLower();
+    if (!isCompressed(enc)) {
+        return data;
+    }
+
+    QByteArray result;
+    if (enc == "gzip" || enc == "x-gzip") {
+        CHECK(inflateData(data, WINDOW_BITS_GZIP, maxDecodedSize, result), "Incorrect gzip response");
+    } else if (enc == "deflate") {
+        // По стандарту zlib-поток, но часть серверов шлет голый deflate
+        if (!inflateData(data, WINDOW_BITS_ZLIB, maxDecodedSize, result)) {
+            CHECK(inflateData(data, WINDOW_BITS_RAW, maxDecodedSize, result), "Incorrect deflate response");
+        }
+    } else {
+        throwErr("Unsupported content encoding " + enc.toStdString());
+    }
+    return result;
+}
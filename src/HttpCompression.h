@@ -0,0 +1,50 @@
+#ifndef HTTPCOMPRESSION_H
+#define HTTPCOMPRESSION_H
+
+#include <QByteArray>
+#include <QUrl>
+
+#include <functional>
+
+/*
+   Распаковка ответов с Content-Encoding gzip и deflate.
+   Распакованный размер ограничен, чтобы маленький ответ не развернулся в гигабайты.
+   */
+class HttpCompression {
+public:
+
+    struct ResponseSize {
+        QUrl url;
+        QByteArray encoding;
+        // Тело ответа как пришло по сети и после распаковки
+        qint64 wireBytes = 0;
+        qint64 decodedBytes = 0;
+    };
+
+    struct Stats {
+        uint64_t countResponses = 0;
+        uint64_t countCompressed = 0;
+        uint64_t wireBytes = 0;
+        uint64_t decodedBytes = 0;
+
+        void add(const ResponseSize &size);
+    };
+
+    // Вызывается в потоке клиента на каждый ответ
+    using SizeCallback = std::function<void(const ResponseSize &size)>;
+
+public:
+
+    static const QByteArray ACCEPT_ENCODING;
+
+    static const int DEFAULT_MAX_DECODED_SIZE = 64 * 1024 * 1024;
+
+    // Без кодировки или identity данные возвращаются как есть.
+    // Неизвестная кодировка, битые данные или превышение maxDecodedSize - исключение
+    static QByteArray decode(const QByteArray &encoding, const QByteArray &data, int maxDecodedSize);
+
+    static bool isCompressed(const QByteArray &encoding);
+
+};
+
+#endif // HTTPCOMPRESSION_H
@@ -1,11 +1,17 @@
 #include "Initializer.h"
 
+#include <algorithm>
+
 #include <QSettings>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
 
 #include "check.h"
 #include "SlotWrapper.h"
 #include "Paths.h"
 #include "QRegister.h"
+#include "utils.h"
 
 #include "InitializerJavascript.h"
 #include "InitInterface.h"
@@ -26,6 +32,7 @@ InitState::InitState(const QString &type, const QString &subType, const QString
 Initializer::Initializer(InitializerJavascript &javascriptWrapper, QObject *parent)
     : QObject(parent)
     , javascriptWrapper(javascriptWrapper)
+    , timeCreated(::now())
 {
     CHECK(connect(this, &Initializer::resendAllStatesSig, this, &Initializer::onResendAllStates), "not connect onGetAllStates");
     CHECK(connect(this, &Initializer::javascriptReadySig, this, &Initializer::onJavascriptReady), "not connect onJavascriptReady");
@@ -41,10 +48,184 @@ Initializer::Initializer(InitializerJavascript &javascriptWrapper, QObject *pare
     Q_REG(GetSubTypesCallback, "GetSubTypesCallback");
 }
 
-Initializer::~Initializer() = default;
+Initializer::~Initializer() {
+    // Дожидаемся запущенных шагов, пока они могут запускать новые
+    while (true) {
+        std::vector<std::future<void>> toWait;
+        {
+            std::lock_guard<std::mutex> lock(stepsMut);
+            toWait.swap(runners);
+        }
+        if (toWait.empty()) {
+            break;
+        }
+        for (std::future<void> &runner: toWait) {
+            runner.wait();
+        }
+    }
+}
 
 void Initializer::complete() {
-    isCompleteSets = true;
+    {
+        std::lock_guard<std::mutex> lock(stepsMut);
+        isCompleteSets = true;
+    }
+    writeProfile();
+}
+
+void Initializer::setProfilePath(const QString &path) {
+    std::lock_guard<std::mutex> lock(stepsMut);
+    profilePath = path;
+}
+
+void Initializer::addStep(const QString &name, const std::vector<QString> &dependencies, const std::vector<std::type_index> &dependencyTypes, std::type_index returnType, bool isDeferred, const std::function<bool()> &run) {
+    std::lock_guard<std::mutex> lock(stepsMut);
+    CHECK(steps.find(name) == steps.end(), "Step " + name.toStdString() + " already exist");
+    CHECK(dependencies.size() == dependencyTypes.size(), "Dependencies of " + name.toStdString() + " not match initialize arguments");
+    Step step;
+    step.profile.name = name;
+    step.profile.dependencies = dependencies;
+    step.profile.isDeferred = isDeferred;
+    step.profile.timeAdded = ::now();
+    step.returnType = returnType;
+    step.run = run;
+    for (size_t i = 0; i < dependencies.size(); i++) {
+        const QString &dependency = dependencies[i];
+        CHECK(std::count(dependencies.begin(), dependencies.end(), dependency) == 1, "Dependency " + dependency.toStdString() + " of " + name.toStdString() + " duplicated");
+        const auto found = steps.find(dependency);
+        CHECK(found != steps.end(), "Dependency " + dependency.toStdString() + " of " + name.toStdString() + " not added");
+        // Аргумент initialize с этим номером должен быть результатом именно этого шага
+        CHECK(found->second.returnType == dependencyTypes[i], "Dependency " + dependency.toStdString() + " of " + name.toStdString() + " returns " + found->second.returnType.name() + ", but argument " + std::to_string(i) + " expects " + dependencyTypes[i].name());
+        if (!found->second.profile.isFinished) {
+            step.countWaitDependencies++;
+            found->second.dependents.emplace_back(name);
+        }
+    }
+    if (step.countWaitDependencies == 0) {
+        step.profile.timeReady = step.profile.timeAdded;
+    }
+    steps.emplace(name, step);
+
+    if (!isDeferred && step.countWaitDependencies == 0) {
+        launchStep(name);
+    }
+}
+
+void Initializer::launchStep(const QString &name) {
+    // Вызывается под stepsMut
+    runners.emplace_back(std::async(std::launch::async, &Initializer::runStep, this, name));
+}
+
+void Initializer::runStep(const QString &name) {
+    std::function<bool()> run;
+    {
+        std::unique_lock<std::mutex> lock(stepsMut);
+        Step &step = steps.at(name);
+        // Отложенный шаг могут запросить раньше, чем завершатся его зависимости
+        stepsCond.wait(lock, [&step]() {
+            return step.countWaitDependencies == 0;
+        });
+        step.profile.timeBegin = ::now();
+        run = step.run;
+    }
+    const bool isSuccess = run();
+    finishStep(name, isSuccess);
+}
+
+void Initializer::finishStep(const QString &name, bool isSuccess) {
+    {
+        std::lock_guard<std::mutex> lock(stepsMut);
+        Step &step = steps.at(name);
+        step.profile.timeEnd = ::now();
+        step.profile.isFinished = true;
+        step.profile.isSuccess = isSuccess;
+        step.run = nullptr;
+        for (const QString &dependent: step.dependents) {
+            Step &next = steps.at(dependent);
+            next.countWaitDependencies--;
+            if (next.countWaitDependencies == 0) {
+                next.profile.timeReady = step.profile.timeEnd;
+                if (!next.profile.isDeferred) {
+                    launchStep(dependent);
+                }
+            }
+        }
+    }
+    stepsCond.notify_all();
+    writeProfile();
+}
+
+std::vector<InitStepProfile> Initializer::getProfile() const {
+    std::lock_guard<std::mutex> lock(stepsMut);
+    std::vector<InitStepProfile> result;
+    for (const auto &pair: steps) {
+        result.emplace_back(pair.second.profile);
+    }
+    return result;
+}
+
+QString Initializer::getProfileJson() const {
+    std::lock_guard<std::mutex> lock(stepsMut);
+    return makeProfileJson();
+}
+
+QString Initializer::makeProfileJson() const {
+    const auto toMs = [this](const time_point &tp) -> qint64 {
+        return std::chrono::duration_cast<milliseconds>(tp - timeCreated).count();
+    };
+
+    QJsonArray stepsJson;
+    qint64 totalMs = 0;
+    for (const auto &pair: steps) {
+        const InitStepProfile &profile = pair.second.profile;
+        QJsonObject stepJson;
+        stepJson.insert("name", profile.name);
+        QJsonArray dependenciesJson;
+        for (const QString &dependency: profile.dependencies) {
+            dependenciesJson.push_back(dependency);
+        }
+        stepJson.insert("dependencies", dependenciesJson);
+        stepJson.insert("deferred", profile.isDeferred);
+        stepJson.insert("finished", profile.isFinished);
+        stepJson.insert("success", profile.isSuccess);
+        stepJson.insert("added_ms", toMs(profile.timeAdded));
+        if (profile.isFinished) {
+            stepJson.insert("ready_ms", toMs(profile.timeReady));
+            stepJson.insert("begin_ms", toMs(profile.timeBegin));
+            stepJson.insert("end_ms", toMs(profile.timeEnd));
+            stepJson.insert("wait_dependencies_ms", toMs(profile.timeReady) - toMs(profile.timeAdded));
+            stepJson.insert("duration_ms", toMs(profile.timeEnd) - toMs(profile.timeBegin));
+            totalMs = std::max(totalMs, toMs(profile.timeEnd));
+        }
+        stepsJson.push_back(stepJson);
+    }
+    QJsonObject root;
+    root.insert("steps", stepsJson);
+    root.insert("total_ms", totalMs);
+    return QString(QJsonDocument(root).toJson(QJsonDocument::Compact));
+}
+
+void Initializer::writeProfile() {
+    QString json;
+    QString path;
+    {
+        std::lock_guard<std::mutex> lock(stepsMut);
+        if (!isCompleteSets || isProfileWritten) {
+            return;
+        }
+        for (const auto &pair: steps) {
+            if (!pair.second.profile.isFinished) {
+                return;
+            }
+        }
+        isProfileWritten = true;
+        json = makeProfileJson();
+        path = profilePath;
+    }
+    LOG << "Startup profile " << json;
+    if (!path.isEmpty()) {
+        writeToFile(path, json.toStdString(), false);
+    }
 }
 
 void Initializer::sendStateToJs(const InitState &state, int number, int numberCritical) {
@@ -5,10 +5,16 @@
 #include <map>
 #include <future>
 #include <set>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <type_traits>
+#include <typeindex>
 
 #include "TypedException.h"
 #include "check.h"
 #include "CallbackWrapper.h"
+#include "duration.h"
 
 #include <QString>
 #include <QThread>
@@ -31,6 +37,48 @@ struct InitState {
     InitState(const QString &type, const QString &subType, const QString &message, bool isCritical, bool isScipped, const TypedException &exception);
 };
 
+// Время выполнения шага инициализации
+struct InitStepProfile {
+    QString name;
+    std::vector<QString> dependencies;
+    bool isDeferred = false;
+
+    time_point timeAdded;
+    // Все зависимости завершились
+    time_point timeReady;
+    time_point timeBegin;
+    time_point timeEnd;
+
+    bool isFinished = false;
+    bool isSuccess = false;
+};
+
+template<typename T>
+struct SharedFutureType {
+    static void add(std::vector<std::type_index> &) {}
+};
+
+template<typename T>
+struct SharedFutureType<std::shared_future<T>> {
+    static void add(std::vector<std::type_index> &result) {
+        result.emplace_back(typeid(T));
+    }
+};
+
+// Типы результатов, которые ждет initialize, в порядке аргументов
+template<typename... Args>
+std::vector<std::type_index> getSharedFutureTypes() {
+    std::vector<std::type_index> result;
+    (void)std::initializer_list<int>{(SharedFutureType<typename std::decay<Args>::type>::add(result), 0)...};
+    return result;
+}
+
+/*
+   Каждый Init объявляет свои зависимости в dependencies().
+   Шаг запускается в отдельном потоке, только когда завершились все его зависимости,
+   независимые шаги выполняются параллельно.
+   Отложенный шаг выполняется в потоке, который вызвал get() у его future.
+   */
 class Initializer: public QObject {
     Q_OBJECT
 public:
@@ -77,23 +125,54 @@ public:
 
     template<class Init, bool isDefferred=false, typename... Args>
     std::shared_future<typename Init::Return> addInit(Args&& ...args) {
+        using Return = typename Init::Return;
+
         CHECK(!isCompleteSets, "Already complete initializer");
 
         totalStates += Init::countEvents();
         totalCriticalStates += Init::countCriticalEvents();
 
-        CHECK(countStatesForInits.find(Init::stateName()) == countStatesForInits.end(), "Conflict name: " + Init::stateName().toStdString() + " already exist");
-        countStatesForInits[Init::stateName()] = Init::countEvents();
-        CHECK(countCriticalStatesForInits.find(Init::stateName()) == countCriticalStatesForInits.end(), "Conflict name: " + Init::stateName().toStdString() + " already exist");
-        countCriticalStatesForInits[Init::stateName()] = Init::countCriticalEvents();
+        const QString name = Init::stateName();
+        CHECK(countStatesForInits.find(name) == countStatesForInits.end(), "Conflict name: " + name.toStdString() + " already exist");
+        countStatesForInits[name] = Init::countEvents();
+        CHECK(countCriticalStatesForInits.find(name) == countCriticalStatesForInits.end(), "Conflict name: " + name.toStdString() + " already exist");
+        countCriticalStatesForInits[name] = Init::countCriticalEvents();
+
+        const std::vector<QString> dependencies = Init::dependencies();
+        const std::vector<std::type_index> dependencyTypes = getSharedFutureTypes<Args...>();
+        CHECK(dependencies.size() == dependencyTypes.size(), "Dependencies of " + name.toStdString() + " not match initialize arguments");
 
         std::unique_ptr<Init> result = std::make_unique<Init>(QThread::currentThread(), *this);
-        auto fut = std::async((isDefferred ? std::launch::deferred : std::launch::async), &Init::initialize, result.get(), std::forward<Args>(args)...);
+        const auto task = std::make_shared<std::packaged_task<Return()>>(std::bind(&Init::initialize, result.get(), std::forward<Args>(args)...));
+        const std::shared_future<Return> fut = task->get_future().share();
         initializiers.emplace_back(std::move(result));
 
+        addStep(name, dependencies, dependencyTypes, typeid(Return), isDefferred, [task, fut]() {
+            (*task)();
+            try {
+                fut.get();
+                return true;
+            } catch (...) {
+                return false;
+            }
+        });
+
+        if (isDefferred) {
+            return std::async(std::launch::deferred, [this, name, fut]() -> Return {
+                runStep(name);
+                return fut.get();
+            }).share();
+        }
         return fut;
     }
 
+    void setProfilePath(const QString &path);
+
+    std::vector<InitStepProfile> getProfile() const;
+
+    // Профиль в json: времена в мс от создания Initializer
+    QString getProfileJson() const;
+
 signals:
 
     void sendState(const InitState &state);
@@ -110,6 +189,18 @@ private:
 
     void sendCriticalInitializedToJs(bool isErrorExist);
 
+    void addStep(const QString &name, const std::vector<QString> &dependencies, const std::vector<std::type_index> &dependencyTypes, std::type_index returnType, bool isDeferred, const std::function<bool()> &run);
+
+    void launchStep(const QString &name);
+
+    void runStep(const QString &name);
+
+    void finishStep(const QString &name, bool isSuccess);
+
+    QString makeProfileJson() const;
+
+    void writeProfile();
+
 signals:
 
     void resendAllStatesSig(const GetAllStatesCallback &callback);
@@ -161,6 +252,30 @@ private:
     std::map<QString, int> countStatesForInits;
 
     std::map<QString, int> countCriticalStatesForInits;
+
+private:
+
+    struct Step {
+        InitStepProfile profile;
+        std::type_index returnType = typeid(void);
+        std::function<bool()> run;
+        size_t countWaitDependencies = 0;
+        std::vector<QString> dependents;
+    };
+
+    const time_point timeCreated;
+
+    mutable std::mutex stepsMut;
+
+    std::condition_variable stepsCond;
+
+    std::map<QString, Step> steps;
+
+    std::vector<std::future<void>> runners;
+
+    QString profilePath;
+
+    bool isProfileWritten = false;
 };
 
 }
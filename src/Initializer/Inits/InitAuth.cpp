@@ -1,5 +1,7 @@
 #include "InitAuth.h"
 
+#include "InitMainwindow.h"
+
 #include <functional>
 using namespace std::placeholders;
 
@@ -20,6 +22,10 @@ QString InitAuth::stateName() {
     return "auth";
 }
 
+std::vector<QString> InitAuth::dependencies() {
+    return {InitMainWindow::stateName()};
+}
+
 InitAuth::InitAuth(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, true)
 {
@@ -1,5 +1,11 @@
 #include "InitJavascriptWrapper.h"
 
+#include "InitWebSocket.h"
+#include "InitNsLookup.h"
+#include "InitMainwindow.h"
+#include "InitTransactions.h"
+#include "InitAuth.h"
+
 #include <functional>
 using namespace std::placeholders;
 
@@ -20,6 +26,10 @@ QString InitJavascriptWrapper::stateName() {
     return "jsWrapper";
 }
 
+std::vector<QString> InitJavascriptWrapper::dependencies() {
+    return {InitWebSocket::stateName(), InitNsLookup::stateName(), InitMainWindow::stateName(), InitTransactions::stateName(), InitAuth::stateName()};
+}
+
 InitJavascriptWrapper::InitJavascriptWrapper(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, false)
 {
@@ -15,6 +15,10 @@ QString InitMainWindow::stateName() {
     return "window";
 }
 
+std::vector<QString> InitMainWindow::dependencies() {
+    return {};
+}
+
 InitMainWindow::InitMainWindow(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, false)
 {
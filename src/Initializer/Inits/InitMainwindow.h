@@ -40,6 +40,8 @@ public:
 
     static QString stateName();
 
+    static std::vector<QString> dependencies();
+
 private:
 
     void sendInitSuccess(const TypedException &exception);
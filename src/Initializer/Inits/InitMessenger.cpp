@@ -1,5 +1,10 @@
 #include "InitMessenger.h"
 
+#include "InitMainwindow.h"
+#include "InitAuth.h"
+#include "InitTransactions.h"
+#include "InitJavascriptWrapper.h"
+
 #include <functional>
 using namespace std::placeholders;
 
@@ -24,6 +29,10 @@ QString InitMessenger::stateName() {
     return "messenger";
 }
 
+std::vector<QString> InitMessenger::dependencies() {
+    return {InitMainWindow::stateName(), InitAuth::stateName(), InitTransactions::stateName(), InitJavascriptWrapper::stateName()};
+}
+
 InitMessenger::InitMessenger(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, false)
 {
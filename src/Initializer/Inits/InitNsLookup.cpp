@@ -13,6 +13,10 @@ QString InitNsLookup::stateName() {
     return "nslookup";
 }
 
+std::vector<QString> InitNsLookup::dependencies() {
+    return {};
+}
+
 InitNsLookup::InitNsLookup(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, true)
 {
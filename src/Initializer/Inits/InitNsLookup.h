@@ -41,6 +41,8 @@ public:
 
     static QString stateName();
 
+    static std::vector<QString> dependencies();
+
 signals:
 
     void serversFlushed(const TypedException &exception);
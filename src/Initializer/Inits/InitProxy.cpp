@@ -1,5 +1,7 @@
 #include "InitProxy.h"
 
+#include "InitMainwindow.h"
+
 #include <QTimer>
 
 #include <functional>
@@ -28,6 +30,10 @@ QString InitProxy::stateName() {
     return "proxy";
 }
 
+std::vector<QString> InitProxy::dependencies() {
+    return {InitMainWindow::stateName()};
+}
+
 InitProxy::InitProxy(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, true)
 {
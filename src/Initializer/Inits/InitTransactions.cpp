@@ -1,5 +1,8 @@
 #include "InitTransactions.h"
 
+#include "InitMainwindow.h"
+#include "InitNsLookup.h"
+
 #include <functional>
 using namespace std::placeholders;
 
@@ -22,6 +25,10 @@ QString InitTransactions::stateName() {
     return "transactions";
 }
 
+std::vector<QString> InitTransactions::dependencies() {
+    return {InitMainWindow::stateName(), InitNsLookup::stateName()};
+}
+
 InitTransactions::InitTransactions(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, false)
 {
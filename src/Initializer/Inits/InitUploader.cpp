@@ -1,5 +1,7 @@
 ﻿#include "InitUploader.h"
 
+#include "InitMainwindow.h"
+
 #include "uploader.h"
 
 #include "check.h"
@@ -13,6 +15,10 @@ QString InitUploader::stateName() {
     return "uploader";
 }
 
+std::vector<QString> InitUploader::dependencies() {
+    return {InitMainWindow::stateName()};
+}
+
 InitUploader::InitUploader(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, true)
 {
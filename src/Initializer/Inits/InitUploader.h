@@ -42,6 +42,8 @@ public:
 
     static QString stateName();
 
+    static std::vector<QString> dependencies();
+
 signals:
 
     void checkedUpdatesHtmls(const TypedException &exception);
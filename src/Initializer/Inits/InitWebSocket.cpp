@@ -22,6 +22,10 @@ QString InitWebSocket::stateName() {
     return "websocket";
 }
 
+std::vector<QString> InitWebSocket::dependencies() {
+    return {};
+}
+
 InitWebSocket::InitWebSocket(QThread *mainThread, Initializer &manager)
     : InitInterface(stateName(), mainThread, manager, true)
 {
@@ -41,6 +41,8 @@ public:
 
     static QString stateName();
 
+    static std::vector<QString> dependencies();
+
 signals:
 
     void connectedSock(const TypedException &exception);
@@ -0,0 +1,98 @@
+#include "JsDeliveryQueue.h"
+
+#include "check.h"
+#include "SlotWrapper.h"
+
+JsDeliveryQueue::JsDeliveryQueue(const RunFunc &runFunc, const milliseconds &frameInterval, QObject *parent)
+    : QObject(parent)
+    , runFunc(runFunc)
+{
+    timer.setSingleShot(true);
+    timer.setInterval(frameInterval.count());
+    CHECK(connect(&timer, &QTimer::timeout, this, &JsDeliveryQueue::onTimer), "not connect onTimer");
+}
+
+void JsDeliveryQueue::setBatching(bool isBatching) {
+    this->isBatching = isBatching;
+    if (!isBatching) {
+        flush();
+    }
+}
+
+void JsDeliveryQueue::startTimer() {
+    if (!timer.isActive()) {
+        timer.start();
+    }
+}
+
+void JsDeliveryQueue::add(const QString &script) {
+    if (!isBatching) {
+        runs++;
+        runFunc(script);
+        return;
+    }
+
+    items.emplace_back(script);
+    countActual++;
+    startTimer();
+}
+
+void JsDeliveryQueue::addLatest(const QString &key, const QString &script) {
+    if (!isBatching) {
+        runs++;
+        runFunc(script);
+        return;
+    }
+
+    const auto found = latestItems.find(key);
+    if (found != latestItems.end()) {
+        items[found->second].isActual = false;
+        countActual--;
+    }
+    latestItems[key] = items.size();
+    items.emplace_back(script);
+    countActual++;
+    startTimer();
+}
+
+void JsDeliveryQueue::flush() {
+    timer.stop();
+    if (items.empty()) {
+        return;
+    }
+
+    // Каждый вызов оборачивается в try, чтобы исключение в одном не отменило остальные
+    QString script;
+    for (const Item &item: items) {
+        if (item.isActual) {
+            script += "try {" + item.script + "} catch (e) {console.error(e);}\n";
+        }
+    }
+    items.clear();
+    latestItems.clear();
+    countActual = 0;
+
+    runs++;
+    runFunc(script);
+}
+
+void JsDeliveryQueue::clear() {
+    timer.stop();
+    items.clear();
+    latestItems.clear();
+    countActual = 0;
+}
+
+size_t JsDeliveryQueue::countPending() const {
+    return countActual;
+}
+
+size_t JsDeliveryQueue::countRuns() const {
+    return runs;
+}
+
+void JsDeliveryQueue::onTimer() {
+BEGIN_SLOT_WRAPPER
+    flush();
+END_SLOT_WRAPPER
+}
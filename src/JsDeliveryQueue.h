@@ -0,0 +1,77 @@
+#ifndef JSDELIVERYQUEUE_H
+#define JSDELIVERYQUEUE_H
+
+#include <QObject>
+#include <QTimer>
+
+#include <functional>
+#include <vector>
+#include <map>
+
+#include "duration.h"
+
+// Накапливает javascript вызовы и отдает их странице одним скриптом раз в кадр
+class JsDeliveryQueue : public QObject
+{
+    Q_OBJECT
+public:
+
+    using RunFunc = std::function<void(const QString &script)>;
+
+public:
+
+    JsDeliveryQueue(const RunFunc &runFunc, const milliseconds &frameInterval, QObject *parent = nullptr);
+
+    void setBatching(bool isBatching);
+
+    void add(const QString &script);
+
+    // Из нескольких ожидающих скриптов с одинаковым ключом будет выполнен только последний
+    void addLatest(const QString &key, const QString &script);
+
+    void flush();
+
+    // Отбрасывает ожидающие скрипты, например перед переходом на другую страницу
+    void clear();
+
+    size_t countPending() const;
+
+    size_t countRuns() const;
+
+private slots:
+
+    void onTimer();
+
+private:
+
+    void startTimer();
+
+private:
+
+    struct Item {
+        QString script;
+        bool isActual = true;
+
+        Item(const QString &script)
+            : script(script)
+        {}
+    };
+
+private:
+
+    RunFunc runFunc;
+
+    QTimer timer;
+
+    bool isBatching = true;
+
+    std::vector<Item> items;
+
+    size_t countActual = 0;
+
+    std::map<QString, size_t> latestItems;
+
+    size_t runs = 0;
+};
+
+#endif // JSDELIVERYQUEUE_H
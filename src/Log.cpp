@@ -8,9 +8,25 @@
 #include <iostream>
 #include <iomanip>
 #include <map>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <array>
+#include <limits>
+#include <condition_variable>
 
 #include <QDateTime>
 #include <QString>
+#include <QSettings>
+#include <QFile>
+#include <QFileInfo>
+
+#include <quazip/quagzipfile.h>
+
+#ifndef TARGET_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "utils.h"
 #include "Paths.h"
@@ -23,6 +39,323 @@ static std::ofstream __log_file2__;
 
 static std::mutex mutGlobal;
 
+const static size_t MAX_LOG_FILES = 20;
+
+static QString logFolder;
+static QString currentLogFile;
+static size_t currentLogSize = 0;
+static time_point currentLogOpened;
+
+// 0 - ограничение выключено
+static std::atomic<uint64_t> maxLogFileSize{50 * 1024 * 1024};
+static std::atomic<int64_t> maxLogFileAgeSeconds{std::chrono::duration_cast<seconds>(24h).count()};
+static std::atomic<uint64_t> maxLogTotalSize{500 * 1024 * 1024};
+
+// Копия log.txt рядом с бинарником не ротируется и не учитывается в max_total_size, поэтому только по явной настройке
+static std::atomic<bool> isDuplicateLog{false};
+
+// Сообщения, записанные до initLog
+static std::string pendingLog;
+static const size_t MAX_PENDING_LOG_SIZE = 1024 * 1024;
+
+static std::thread compressThread;
+
+static bool rotateLogIfNeeded(QString &rotatedFile, QString &newFile);
+
+static void compressRotatedLog(const QString &rotatedFile, const QString &newFile);
+
+#ifndef TARGET_WINDOWS
+// Путь текущего файла лога для обработчика сигналов, которому нельзя трогать QString и ofstream
+static char crashLogPath[4096] = {0};
+
+static void writeToFd(int fd, const std::string &str) {
+    if (fd < 0) {
+        return;
+    }
+    const char *data = str.data();
+    size_t size = str.size();
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        size -= size_t(written);
+    }
+}
+#endif
+
+namespace {
+
+struct LogRecord {
+    uint64_t sequence;
+    std::string coutStr;
+    std::string fileStr;
+};
+
+// Кольцевой буфер на один поток-писатель и один поток-читатель
+class LogRing {
+public:
+
+    bool push(LogRecord &&record) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t next = (h + 1) % CAPACITY;
+        if (next == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        buffer[h] = std::move(record);
+        head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    template<class Func>
+    void popAll(const Func &func) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        const size_t h = head.load(std::memory_order_acquire);
+        while (t != h) {
+            func(std::move(buffer[t]));
+            t = (t + 1) % CAPACITY;
+        }
+        tail.store(t, std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    // Чтение без извлечения для обработчика сигналов. Поток записи в это время может забрать те же записи
+    template<class Func>
+    void peekAll(const Func &func) const {
+        size_t t = tail.load(std::memory_order_acquire);
+        const size_t h = head.load(std::memory_order_acquire);
+        while (t != h) {
+            func(buffer[t]);
+            t = (t + 1) % CAPACITY;
+        }
+    }
+
+private:
+
+    static const size_t CAPACITY = 8192;
+
+    std::vector<LogRecord> buffer = std::vector<LogRecord>(CAPACITY);
+
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+};
+
+class LogWriter {
+public:
+
+    ~LogWriter() {
+        stop();
+    }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutRings);
+        if (isStarted.load()) {
+            return;
+        }
+        isStopped = false;
+        thread = std::thread(&LogWriter::run, this);
+        isStarted = true;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutRings);
+            if (!isStarted.load()) {
+                return;
+            }
+            isStopped = true;
+        }
+        cond.notify_one();
+        // exit() из самого потока записи: join бросил бы исключение
+        if (thread.get_id() == std::this_thread::get_id()) {
+            thread.detach();
+        } else {
+            thread.join();
+        }
+        isStarted = false;
+        writeBatch();
+        if (compressThread.joinable()) {
+            compressThread.join();
+        }
+    }
+
+    bool started() const {
+        return isStarted.load(std::memory_order_relaxed);
+    }
+
+    void push(std::string &&coutStr, std::string &&fileStr) {
+        thread_local std::shared_ptr<LogRing> ring;
+        if (ring == nullptr) {
+            ring = std::make_shared<LogRing>();
+            std::lock_guard<std::mutex> lock(mutRings);
+            rings.emplace_back(ring);
+        }
+        LogRecord record{sequence.fetch_add(1, std::memory_order_relaxed), std::move(coutStr), std::move(fileStr)};
+        if (!ring->push(std::move(record))) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void flush() {
+        if (!started()) {
+            return;
+        }
+        const uint64_t target = sequence.load();
+        std::unique_lock<std::mutex> lock(mutRings);
+        condFlushed.wait(lock, [this, target]{
+            return written + dropped.load() >= target || !isStarted.load();
+        });
+    }
+
+    size_t getDropped() const {
+        return dropped.load();
+    }
+
+#ifndef TARGET_WINDOWS
+    // Вызывается из обработчика сигналов: без ожидания блокировок и без выделения памяти.
+    // mutRings мог держать упавший поток, поэтому при занятом мьютексе ничего не пишем.
+    // Записи, которые поток записи уже забрал в batch, но не записал, теряются
+    void drainOnCrash(int coutFd, int fileFd) {
+        if (!isStarted.load() || !mutRings.try_lock()) {
+            return;
+        }
+        for (const std::shared_ptr<LogRing> &ring: rings) {
+            ring->peekAll([coutFd, fileFd](const LogRecord &record) {
+                writeToFd(coutFd, record.coutStr);
+                writeToFd(fileFd, record.fileStr);
+            });
+        }
+        mutRings.unlock();
+    }
+#endif
+
+private:
+
+    void run() {
+        while (true) {
+            writeBatch();
+            std::unique_lock<std::mutex> lock(mutRings);
+            if (isStopped) {
+                break;
+            }
+            condFlushed.notify_all();
+            cond.wait_for(lock, 20ms);
+        }
+    }
+
+    void writeBatch() {
+        std::vector<std::shared_ptr<LogRing>> currentRings;
+        {
+            std::lock_guard<std::mutex> lock(mutRings);
+            // Буферы завершившихся потоков удаляются, когда из них все прочитано
+            rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<LogRing> &r) {
+                return r.use_count() == 1 && r->empty();
+            }), rings.end());
+            currentRings = rings;
+        }
+
+        batch.clear();
+        for (const std::shared_ptr<LogRing> &ring: currentRings) {
+            ring->popAll([this](LogRecord &&record) {
+                batch.emplace_back(std::move(record));
+            });
+        }
+
+        const size_t currDropped = dropped.load();
+        if (batch.empty() && currDropped == reportedDropped) {
+            return;
+        }
+
+        std::sort(batch.begin(), batch.end(), [](const LogRecord &first, const LogRecord &second) {
+            return first.sequence < second.sequence;
+        });
+
+        coutBuffer.clear();
+        fileBuffer.clear();
+        if (currDropped != reportedDropped) {
+            fileBuffer += "Log overloaded. Dropped " + std::to_string(currDropped - reportedDropped) + " messages\n";
+            reportedDropped = currDropped;
+        }
+        for (const LogRecord &record: batch) {
+            coutBuffer += record.coutStr;
+            fileBuffer += record.fileStr;
+        }
+
+        QString rotatedFile;
+        QString newFile;
+        bool isRotated;
+        {
+            std::lock_guard<std::mutex> lock(mutGlobal);
+            std::cout << coutBuffer << std::flush;
+            __log_file__ << fileBuffer << std::flush;
+            if (__log_file2__.is_open()) {
+                __log_file2__ << fileBuffer << std::flush;
+            }
+            currentLogSize += fileBuffer.size();
+            isRotated = rotateLogIfNeeded(rotatedFile, newFile);
+        }
+        // Сжатие может идти долго, ждем его вне mutGlobal, чтобы не останавливать остальные потоки
+        if (isRotated) {
+            compressRotatedLog(rotatedFile, newFile);
+        }
+
+        std::lock_guard<std::mutex> lock(mutRings);
+        written += batch.size();
+    }
+
+private:
+
+    std::mutex mutRings;
+    std::vector<std::shared_ptr<LogRing>> rings;
+
+    std::condition_variable cond;
+    std::condition_variable condFlushed;
+
+    std::thread thread;
+    std::atomic<bool> isStarted{false};
+    bool isStopped = false;
+
+    std::atomic<uint64_t> sequence{0};
+    uint64_t written = 0;
+
+    std::atomic<size_t> dropped{0};
+    size_t reportedDropped = 0;
+
+    std::vector<LogRecord> batch;
+    std::string coutBuffer;
+    std::string fileBuffer;
+};
+
+}
+
+static LogWriter logWriter;
+
+// Форматирование времени дорогое, поэтому строка пересчитывается не чаще раза в секунду на поток
+static const std::string& getCachedTime() {
+    thread_local time_t cachedSeconds = 0;
+    thread_local std::string cachedTime;
+    const time_t currSeconds = std::chrono::system_clock::to_time_t(::system_now());
+    if (currSeconds != cachedSeconds || cachedTime.empty()) {
+        cachedSeconds = currSeconds;
+        cachedTime = QDateTime::fromMSecsSinceEpoch(qint64(currSeconds) * 1000).toString("yyyy.MM.dd_hh:mm:ss").toStdString();
+    }
+    return cachedTime;
+}
+
+static const std::string& getThreadIdStr() {
+    thread_local std::string threadId;
+    if (threadId.empty()) {
+        std::stringstream ss;
+        ss << std::hex << std::noshowbase << std::this_thread::get_id();
+        threadId = ss.str();
+    }
+    return threadId;
+}
+
 struct PeriodicStruct {
     std::string content;
     std::vector<milliseconds> periods;
@@ -35,8 +368,18 @@ struct PeriodicStruct {
     }
 };
 
-static std::map<std::string, PeriodicStruct> periodics;
-static std::mutex mutPeriodics;
+// Периодические сообщения разнесены по шардам, чтобы разные periodic не ждали друг друга
+struct PeriodicShard {
+    std::mutex mut;
+    std::map<std::string, PeriodicStruct> periodics;
+};
+
+static const size_t PERIODIC_SHARDS_COUNT = 16;
+
+static PeriodicShard& getPeriodicShard(const std::string &name) {
+    static std::array<PeriodicShard, PERIODIC_SHARDS_COUNT> shards;
+    return shards[std::hash<std::string>()(name) % PERIODIC_SHARDS_COUNT];
+}
 
 static std::map<std::string, std::string>& getFileNamesImpl(bool isRead) {
     static const auto mainThreadId = std::this_thread::get_id();
@@ -70,6 +413,97 @@ static size_t& getMaxAliasSize() {
     return aliasSize;
 }
 
+static std::atomic<int> globalLogLevel{static_cast<int>(LogLevel::Info)};
+static std::atomic<int> logFormat{static_cast<int>(LogFormat::Text)};
+
+static std::mutex mutModuleLevels;
+
+// Уровень -1 означает, что используется глобальный уровень
+static std::atomic<int>& getModuleLevel(const std::string &module) {
+    static std::map<std::string, std::unique_ptr<std::atomic<int>>> levels;
+    std::lock_guard<std::mutex> lock(mutModuleLevels);
+    std::unique_ptr<std::atomic<int>> &level = levels[module];
+    if (level == nullptr) {
+        level.reset(new std::atomic<int>(-1));
+    }
+    return *level;
+}
+
+static const std::string& getModuleName(const std::string &fileName) {
+    const auto found = getFileNamesC().find(fileName);
+    if (found != getFileNamesC().end()) {
+        return found->second;
+    } else {
+        return fileName;
+    }
+}
+
+static const char* logLevelToString(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace:
+        return "trace";
+    case LogLevel::Debug:
+        return "debug";
+    case LogLevel::Info:
+        return "info";
+    case LogLevel::Warning:
+        return "warning";
+    case LogLevel::Error:
+        return "error";
+    }
+    return "info";
+}
+
+static LogLevel logLevelFromString(const QString &level) {
+    const QString l = level.toLower();
+    if (l == "trace") {
+        return LogLevel::Trace;
+    } else if (l == "debug") {
+        return LogLevel::Debug;
+    } else if (l == "warning") {
+        return LogLevel::Warning;
+    } else if (l == "error") {
+        return LogLevel::Error;
+    } else {
+        return LogLevel::Info;
+    }
+}
+
+static void escapeTo(std::string &result, const std::string &str) {
+    for (const char c: str) {
+        switch (c) {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned int>(c));
+                result += buf;
+            } else {
+                result += c;
+            }
+        }
+    }
+}
+
+LogSite_::LogSite_(const std::string &fileName)
+    : moduleLevel(&getModuleLevel(getModuleName(fileName)))
+    , globalLevel(&globalLogLevel)
+{}
+
 PeriodicLog::PeriodicLog() = default;
 
 PeriodicLog::PeriodicLog(const std::string &str)
@@ -94,23 +528,76 @@ Log_ &Log_::operator <<(const PeriodicLog &p) {
     CHECK(periodic.notSet(), "Periodic already set");
     CHECK(!p.notSet(), "Periodic not set");
     periodic = p;
-    ssLog << ": \'" << p.str << "\'";
     return *this;
 }
 
-Log_::Log_(const std::string &fileName) {
-    const QDateTime now = QDateTime::currentDateTime();
-    const std::string time = now.toString("yyyy.MM.dd_hh:mm:ss").toStdString();
-    const auto tId = std::this_thread::get_id();
-    ssLog << std::hex << std::noshowbase << tId << std::dec << " " << time;
+Log_::Log_(const std::string &fileName)
+    : Log_(fileName, LogLevel::Info)
+{}
 
+Log_::Log_(const std::string &fileName, LogLevel level)
+    : level(level)
+{
     const auto found = getFileNamesC().find(fileName);
     if (found != getFileNamesC().end()) {
-        const std::string &alias = found->second;
-        ssLog << " " << std::setfill(' ') << std::setw(getMaxAliasSize()) << alias;
+        alias = &found->second;
+    }
+}
+
+std::string Log_::formatLine(const std::string &message) const {
+    const LogFormat format = static_cast<LogFormat>(logFormat.load(std::memory_order_relaxed));
+    const std::string emptyAlias;
+    const std::string &module = alias != nullptr ? *alias : emptyAlias;
+
+    std::string result;
+    result.reserve(message.size() + 64);
+    if (format == LogFormat::Text) {
+        result += getThreadIdStr();
+        result += " ";
+        result += getCachedTime();
+        result += " ";
+        result += std::string(getMaxAliasSize() - std::min(getMaxAliasSize(), module.size()), ' ');
+        result += module;
+        if (!periodic.notSet()) {
+            result += ": \'" + periodic.str + "\'";
+        }
+        result += ": ";
+        result += message;
+    } else if (format == LogFormat::KeyValue) {
+        result += "ts=" + getCachedTime();
+        result += " thread=" + getThreadIdStr();
+        result += " level=";
+        result += logLevelToString(level);
+        if (!module.empty()) {
+            result += " module=" + module;
+        }
+        if (!periodic.notSet()) {
+            result += " periodic=" + periodic.str;
+        }
+        result += " msg=\"";
+        escapeTo(result, message);
+        result += "\"";
     } else {
-        ssLog << std::setfill(' ') << std::setw(getMaxAliasSize() + 1) << " ";
+        result += "{\"ts\":\"" + getCachedTime() + "\"";
+        result += ",\"thread\":\"" + getThreadIdStr() + "\"";
+        result += ",\"level\":\"";
+        result += logLevelToString(level);
+        result += "\"";
+        if (!module.empty()) {
+            result += ",\"module\":\"";
+            escapeTo(result, module);
+            result += "\"";
+        }
+        if (!periodic.notSet()) {
+            result += ",\"periodic\":\"";
+            escapeTo(result, periodic.str);
+            result += "\"";
+        }
+        result += ",\"msg\":\"";
+        escapeTo(result, message);
+        result += "\"}";
     }
+    return result;
 }
 
 bool Log_::processPeriodic(const std::string &s, std::string &addedStr) {
@@ -129,9 +616,10 @@ bool Log_::processPeriodic(const std::string &s, std::string &addedStr) {
 
         const time_point now = ::now();
         bool to_return;
-        std::lock_guard<std::mutex> lock(mutPeriodics);
-        auto found = periodics.find(periodic.str);
-        if (found != periodics.end()) {
+        PeriodicShard &shard = getPeriodicShard(periodic.str);
+        std::lock_guard<std::mutex> lock(shard.mut);
+        auto found = shard.periodics.find(periodic.str);
+        if (found != shard.periodics.end()) {
             PeriodicStruct &p = found->second;
             if (p.content == s) {
                 const milliseconds interval = p.calcInterval(now);
@@ -154,7 +642,7 @@ bool Log_::processPeriodic(const std::string &s, std::string &addedStr) {
             PeriodicStruct p;
             p.content = s;
             p.lastPeriod = now;
-            periodics[periodic.str] = p;
+            shard.periodics[periodic.str] = p;
             to_return = true;
         }
         return to_return;
@@ -164,20 +652,34 @@ bool Log_::processPeriodic(const std::string &s, std::string &addedStr) {
 void Log_::finalize(std::ostream &(*pManip)(std::ostream &)) noexcept {
     try {
         const std::string &toCoutStr = ssCout.str();
-        const std::string &toLogStr = ssLog.str() + ": ";
 
         std::string addedStr;
         const bool isPrint = processPeriodic(toCoutStr, addedStr);
 
-        std::lock_guard<std::mutex> lock(mutGlobal);
-        std::cout << toCoutStr << *pManip;
+        std::string fileStr;
         if (!addedStr.empty()) {
-            __log_file__ << toLogStr << addedStr << *pManip;
-            __log_file2__ << toLogStr << addedStr << *pManip;
+            fileStr += formatLine(addedStr) + "\n";
         }
         if (isPrint) {
-            __log_file__ << toLogStr << toCoutStr << *pManip;
-            __log_file2__ << toLogStr << toCoutStr << *pManip;
+            fileStr += formatLine(toCoutStr) + "\n";
+        }
+
+        if (logWriter.started()) {
+            logWriter.push(toCoutStr + "\n", std::move(fileStr));
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutGlobal);
+        std::cout << toCoutStr << *pManip;
+        if (!__log_file__.is_open()) {
+            if (pendingLog.size() + fileStr.size() <= MAX_PENDING_LOG_SIZE) {
+                pendingLog += fileStr;
+            }
+            return;
+        }
+        __log_file__ << fileStr << std::flush;
+        if (__log_file2__.is_open()) {
+            __log_file2__ << fileStr << std::flush;
         }
     } catch (...) {
         std::cerr << "Error";
@@ -185,38 +687,226 @@ void Log_::finalize(std::ostream &(*pManip)(std::ostream &)) noexcept {
 }
 
 void initLog() {
-    const QString logPath = getLogPath();
+    initLog(getLogPath());
+}
+
+#ifdef TARGET_WINDOWS
+static std::wstring toStreamPath(const QString &path) {
+    return path.toStdWString();
+}
+#else
+static std::string toStreamPath(const QString &path) {
+    return path.toStdString();
+}
+#endif
+
+static uint64_t getLogFileTimestamp(const QFileInfo &fileInfo) {
+    return fileInfo.fileName().section('.', 1, 1).toULongLong();
+}
 
-    const size_t MAX_LOG_FILES = 20;
-    const QDate today = QDate::currentDate();
+// Удаляет самые старые файлы, пока не уложимся в ограничения по количеству и суммарному размеру
+static void pruneLogs(const QString &logPath, const QString &exceptFile) {
     std::vector<QFileInfo> files;
-    const auto tmp = QDir(logPath).entryInfoList(QStringList("log.*.txt"), QDir::Files);
+    const auto tmp = QDir(logPath).entryInfoList(QStringList{"log.*.txt", "log.*.txt.gz"}, QDir::Files);
     std::copy(tmp.begin(), tmp.end(), std::back_inserter(files));
-    std::sort(files.begin(), files.end(), [&today](const QFileInfo &f1, const QFileInfo &f2) {
-        return f1.created().date().daysTo(today) < f2.created().date().daysTo(today);
+    std::sort(files.begin(), files.end(), [](const QFileInfo &f1, const QFileInfo &f2) {
+        return getLogFileTimestamp(f1) > getLogFileTimestamp(f2);
     });
-    files.erase(files.begin(), files.begin() + std::min(MAX_LOG_FILES, files.size()));
 
+    uint64_t maxTotalSize = maxLogTotalSize.load();
+    if (maxTotalSize == 0) {
+        maxTotalSize = std::numeric_limits<uint64_t>::max();
+    }
+    uint64_t totalSize = 0;
+    size_t countFiles = 0;
     for (const QFileInfo &fileInfo: files) {
         const QString filepath = fileInfo.absoluteFilePath();
-        removeFile(filepath);
+        if (isPathEquals(filepath, exceptFile)) {
+            totalSize += fileInfo.size();
+            countFiles++;
+            continue;
+        }
+        if (countFiles >= MAX_LOG_FILES || totalSize + fileInfo.size() > maxTotalSize) {
+            QFile::remove(filepath);
+        } else {
+            totalSize += fileInfo.size();
+            countFiles++;
+        }
     }
+}
 
-    const system_time_point now = ::system_now();
-    const QString logFile = QString::fromStdString("log." + std::to_string(systemTimePointToInt(now)) + ".txt");
-    const QString logFile2 = makePath(QApplication::applicationDirPath(), "log.txt");
+static void compressLog(const QString &file) {
+    QFile src(file);
+    if (!src.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    const QString gzFile = file + ".gz";
+    QuaGzipFile dest(gzFile);
+    if (!dest.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    bool isOk = true;
+    while (!src.atEnd()) {
+        const QByteArray chunk = src.read(1024 * 1024);
+        if (dest.write(chunk) != chunk.size()) {
+            isOk = false;
+            break;
+        }
+    }
+    dest.close();
+    src.close();
+    if (isOk) {
+        QFile::remove(file);
+    } else {
+        QFile::remove(gzFile);
+    }
+}
 
-    const QString fullLogPath = makePath(logPath, logFile);
-#ifdef TARGET_WINDOWS
-    auto path = fullLogPath.toStdWString();
-    auto path2 = logFile2.toStdWString();
-#else
-    auto path = fullLogPath.toStdString();
-    auto path2 = logFile2.toStdString();
+static void openNewLogFile() {
+    size_t timestamp = systemTimePointToInt(::system_now());
+    // Две ротации в одну миллисекунду не должны писать в один файл
+    while (true) {
+        const QString logFile = QString::fromStdString("log." + std::to_string(timestamp) + ".txt");
+        currentLogFile = makePath(logFolder, logFile);
+        if (!isExistFile(currentLogFile) && !isExistFile(currentLogFile + ".gz")) {
+            break;
+        }
+        timestamp++;
+    }
+    currentLogSize = 0;
+    currentLogOpened = ::now();
+    __log_file__.open(toStreamPath(currentLogFile), std::ios_base::trunc);
+#ifndef TARGET_WINDOWS
+    const QByteArray crashPath = QFile::encodeName(currentLogFile);
+    if (size_t(crashPath.size()) < sizeof(crashLogPath)) {
+        std::copy(crashPath.begin(), crashPath.end(), crashLogPath);
+        crashLogPath[crashPath.size()] = 0;
+    } else {
+        crashLogPath[0] = 0;
+    }
+#endif
+}
+
+// Вызывается из потока записи под mutGlobal
+static bool rotateLogIfNeeded(QString &rotatedFile, QString &newFile) {
+    const uint64_t maxSize = maxLogFileSize.load();
+    const int64_t maxAgeSeconds = maxLogFileAgeSeconds.load();
+    const bool isSizeExceeded = maxSize != 0 && currentLogSize >= maxSize;
+    const bool isAgeExceeded = maxAgeSeconds > 0 && ::now() - currentLogOpened >= seconds(maxAgeSeconds);
+    if (!isSizeExceeded && !isAgeExceeded) {
+        return false;
+    }
+
+    rotatedFile = currentLogFile;
+    __log_file__.close();
+    openNewLogFile();
+    newFile = currentLogFile;
+    return true;
+}
+
+// Вызывается из потока записи без mutGlobal
+static void compressRotatedLog(const QString &rotatedFile, const QString &newFile) {
+    if (compressThread.joinable()) {
+        compressThread.join();
+    }
+    const QString logPath = logFolder;
+    compressThread = std::thread([rotatedFile, newFile, logPath]{
+        compressLog(rotatedFile);
+        pruneLogs(logPath, newFile);
+    });
+}
+
+void initLog(const QString &logPath) {
+    {
+        std::lock_guard<std::mutex> lock(mutGlobal);
+        logFolder = logPath;
+        openNewLogFile();
+
+        if (isDuplicateLog.load()) {
+            const QString logFile2 = makePath(QApplication::applicationDirPath(), "log.txt");
+            __log_file2__.open(toStreamPath(logFile2), std::ios_base::trunc);
+        }
+
+        __log_file__ << pendingLog << std::flush;
+        if (__log_file2__.is_open()) {
+            __log_file2__ << pendingLog << std::flush;
+        }
+        currentLogSize += pendingLog.size();
+        pendingLog.clear();
+    }
+    pruneLogs(logFolder, currentLogFile);
+
+    logWriter.start();
+}
+
+void flushLog() {
+    logWriter.flush();
+}
+
+void flushLogOnCrash() {
+#ifndef TARGET_WINDOWS
+    const int fd = crashLogPath[0] != 0 ? ::open(crashLogPath, O_WRONLY | O_APPEND) : -1;
+    logWriter.drainOnCrash(STDOUT_FILENO, fd);
+    if (fd >= 0) {
+        ::close(fd);
+    }
 #endif
+}
+
+size_t getLogDroppedCount() {
+    return logWriter.getDropped();
+}
+
+void setLogFormat(LogFormat format) {
+    logFormat = static_cast<int>(format);
+}
 
-    __log_file__.open(path, std::ios_base::trunc);
-    __log_file2__.open(path2, std::ios_base::trunc);
+void setLogLevel(LogLevel level) {
+    globalLogLevel = static_cast<int>(level);
+}
+
+void setLogLevel(const std::string &module, LogLevel level) {
+    getModuleLevel(module) = static_cast<int>(level);
+}
+
+void setLogRotation(int64_t maxFileSize, int64_t maxFileAgeSeconds, int64_t maxTotalSize) {
+    maxLogFileSize = static_cast<uint64_t>(std::max<int64_t>(maxFileSize, 0));
+    maxLogFileAgeSeconds = std::max<int64_t>(maxFileAgeSeconds, 0);
+    maxLogTotalSize = static_cast<uint64_t>(std::max<int64_t>(maxTotalSize, 0));
+}
+
+void initLogSettings() {
+    QSettings settings(getSettingsPath(), QSettings::IniFormat);
+    settings.beginGroup("log");
+    setLogLevel(logLevelFromString(settings.value("level", "info").toString()));
+
+    const QString format = settings.value("format", "text").toString().toLower();
+    if (format == "kv") {
+        setLogFormat(LogFormat::KeyValue);
+    } else if (format == "json") {
+        setLogFormat(LogFormat::Json);
+    } else {
+        setLogFormat(LogFormat::Text);
+    }
+
+    const int64_t MB = 1024 * 1024;
+    setLogRotation(
+        settings.value("max_file_size_mb", qlonglong(maxLogFileSize.load() / MB)).toLongLong() * MB,
+        settings.value("max_file_age_hours", qlonglong(maxLogFileAgeSeconds.load() / 3600)).toLongLong() * 3600,
+        settings.value("max_total_size_mb", qlonglong(maxLogTotalSize.load() / MB)).toLongLong() * MB
+    );
+    isDuplicateLog = settings.value("duplicate_log", false).toBool();
+    if (!isDuplicateLog.load()) {
+        std::lock_guard<std::mutex> lock(mutGlobal);
+        __log_file2__.close();
+    }
+
+    settings.beginGroup("modules");
+    for (const QString &module: settings.childKeys()) {
+        setLogLevel(module.toStdString(), logLevelFromString(settings.value(module).toString()));
+    }
+    settings.endGroup();
+    settings.endGroup();
 }
 
 AddFileNameAlias_::AddFileNameAlias_(const std::string &fileName, const std::string &alias) {
@@ -3,9 +3,30 @@
 
 #include <sstream>
 #include <string>
+#include <atomic>
+#include <cstdint>
 
 class QString;
 
+enum class LogLevel: int {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warning = 3,
+    Error = 4
+};
+
+enum class LogFormat: int {
+    Text = 0,
+    KeyValue = 1,
+    Json = 2
+};
+
+// Сообщения ниже этого уровня вырезаются на этапе компиляции
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
 class PeriodicLog {
     friend struct Log_;
 public:
@@ -29,6 +50,8 @@ struct Log_ {
 
     Log_(const std::string &fileName);
 
+    Log_(const std::string &fileName, LogLevel level);
+
     template<typename T>
     Log_& operator <<(T t) {
         print(t);
@@ -54,8 +77,13 @@ private:
 
     bool processPeriodic(const std::string &s, std::string &addedStr);
 
+    std::string formatLine(const std::string &message) const;
+
     std::stringstream ssCout;
-    std::stringstream ssLog;
+
+    LogLevel level;
+
+    const std::string *alias = nullptr;
 
     PeriodicLog periodic;
 
@@ -63,13 +91,67 @@ private:
 
 void initLog();
 
+void initLog(const QString &logPath);
+
+// Дожидается, пока фоновый поток запишет все накопленные сообщения
+void flushLog();
+
+// Только для обработчика сигналов: без блокировок дописывает в лог и stdout то, что еще лежит в буферах потоков.
+// Порядок между потоками не восстанавливается
+void flushLogOnCrash();
+
+size_t getLogDroppedCount();
+
+// Читает уровни, формат и ротацию логов из секции log файла настроек. Вызывать до initLog, чтобы ротация применилась и к первому файлу
+void initLogSettings();
+
+// Размеры в байтах. Значение <= 0 выключает соответствующее ограничение
+void setLogRotation(int64_t maxFileSize, int64_t maxFileAgeSeconds, int64_t maxTotalSize);
+
+void setLogFormat(LogFormat format);
+
+void setLogLevel(LogLevel level);
+
+// module - имя из SET_LOG_NAMESPACE, либо имя файла для файлов без него
+void setLogLevel(const std::string &module, LogLevel level);
+
+struct LogSite_ {
+
+    explicit LogSite_(const std::string &fileName);
+
+    bool isEnabled(LogLevel level) const {
+        const int moduleLevel = this->moduleLevel->load(std::memory_order_relaxed);
+        const int currLevel = moduleLevel >= 0 ? moduleLevel : globalLevel->load(std::memory_order_relaxed);
+        return static_cast<int>(level) >= currLevel;
+    }
+
+private:
+
+    const std::atomic<int> *moduleLevel;
+
+    const std::atomic<int> *globalLevel;
+};
+
 struct AddFileNameAlias_ {
 
     AddFileNameAlias_(const std::string &fileName, const std::string &alias);
 
 };
 
-#define LOG Log_(std::string(__FILE__))
+// Приводит выражение с Log_ к void, чтобы обе ветки ?: в LOG_LEVEL_ имели один тип. Приоритет & ниже <<, но выше ?:
+struct LogVoidify_ {
+    void operator&(const Log_&) {}
+};
+
+// Аргументы отключенного сообщения не вычисляются. Раскрывается в выражение, а не в if/else, чтобы не перехватывать чужой else
+#define LOG_LEVEL_(level) \
+    (static_cast<int>(level) < LOG_COMPILE_LEVEL || !([]() -> const LogSite_& { static const LogSite_ site(std::string(__FILE__)); return site; }().isEnabled(level))) ? (void)0 : LogVoidify_() & Log_(std::string(__FILE__), level)
+
+#define LOG_TRACE LOG_LEVEL_(LogLevel::Trace)
+#define LOG_DEBUG LOG_LEVEL_(LogLevel::Debug)
+#define LOG LOG_LEVEL_(LogLevel::Info)
+#define LOG_WARN LOG_LEVEL_(LogLevel::Warning)
+#define LOG_ERROR LOG_LEVEL_(LogLevel::Error)
 
 #define LOG2(file) Log_(file)
 
@@ -115,10 +115,14 @@ Messenger::Messenger(MessengerJavascript &javascriptWrapper, MessengerDBStorage
     CHECK(settings.contains("messenger/saveDecryptedMessage"), "settings timeout not found");
     isDecryptDataSave = settings.value("messenger/saveDecryptedMessage").toBool();
 
+    wssClient.setBatchMessages(settings.value("web_socket/messenger_batch", false).toBool());
+    wssClient.setCompressMessages(settings.value("web_socket/messenger_compress", false).toBool());
+
     CHECK(connect(this, &Messenger::callbackCall, this, &Messenger::onCallbackCall), "not connect onCallbackCall");
 
     CHECK(connect(this, &TimerClass::timerEvent, this, &Messenger::onTimerEvent), "not connect onTimerEvent");
     CHECK(connect(&wssClient, &WebSocketClient::messageReceived, this, &Messenger::onWssMessageReceived), "not connect wssClient");
+    CHECK(connect(&wssClient, &WebSocketClient::connectedSock, this, &Messenger::onWssConnected), "not connect onWssConnected");
     CHECK(connect(this, &TimerClass::startedEvent, this, &Messenger::onRun), "not connect run");
 
     CHECK(connect(this, &Messenger::registerAddress, this, &Messenger::onRegisterAddress), "not connect onRegisterAddress");
@@ -222,27 +226,47 @@ void Messenger::getMessagesFromChannelFromWss(const QString &fromAddress, const
     emit wssClient.sendMessage(message);
 }
 
-void Messenger::clearAddressesToMonitored() {
-    emit wssClient.setHelloString(std::vector<QString>{}, "Messenger");
+std::vector<QString> Messenger::makeHelloMessagesForAddress(const QString &address) {
+    const QString pubkeyHex = db.getUserPublicKey(address);
+    if (pubkeyHex.isEmpty()) {
+        return {};
+    }
+
+    const QString signHexChannels = getSignFromMethod(address, makeTextForGetMyChannelsRequest());
+    const QString messageGetMyChannels = makeGetMyChannelsRequest(pubkeyHex, signHexChannels, id.get());
+
+    // Передаем последний подтвержденный counter, чтобы после переподключения сервер присылал только новые сообщения
+    const Message::Counter lastCounter = db.getMessageMaxConfirmedCounter(address);
+    const QString signHex = getSignFromMethod(address, makeTextForMsgAppendKeyOnlineRequest());
+    const QString messageAppendKey = makeAppendKeyOnlineRequest(pubkeyHex, signHex, lastCounter, id.get());
+
+    return {messageGetMyChannels, messageAppendKey};
 }
 
 void Messenger::addAddressToMonitored(const QString &address) {
-    const QString pubkeyHex = db.getUserPublicKey(address);
-    const bool pubkeyFound = !pubkeyHex.isEmpty();
+    const std::vector<QString> messages = makeHelloMessagesForAddress(address);
+    const bool pubkeyFound = !messages.empty();
     LOG << "Add address to monitored " << address << " " << pubkeyFound;
     if (!pubkeyFound) {
         return;
     }
 
-    const QString signHexChannels = getSignFromMethod(address, makeTextForGetMyChannelsRequest());
-    const QString messageGetMyChannels = makeGetMyChannelsRequest(pubkeyHex, signHexChannels, id.get());
-    emit wssClient.addHelloString(messageGetMyChannels, "Messenger");
-    emit wssClient.sendMessage(messageGetMyChannels);
+    emit wssClient.sendMessages(messages);
+}
 
-    const QString signHex = getSignFromMethod(address, makeTextForMsgAppendKeyOnlineRequest());
-    const QString message = makeAppendKeyOnlineRequest(pubkeyHex, signHex, id.get());
-    emit wssClient.addHelloString(message, "Messenger");
-    emit wssClient.sendMessage(message);
+std::vector<QString> Messenger::makeHelloMessages() {
+    const std::vector<QString> monitoredAddresses = getMonitoredAddresses();
+    std::vector<QString> helloMessages;
+    for (const QString &address: monitoredAddresses) {
+        const TypedException exception = apiVrapper2([&]{
+            const std::vector<QString> messages = makeHelloMessagesForAddress(address);
+            helloMessages.insert(helloMessages.end(), messages.begin(), messages.end());
+        });
+        if (exception.isSet()) {
+            LOG << "Monitored address exception: " << address << " " << exception.description;
+        }
+    }
+    return helloMessages;
 }
 
 void Messenger::processMyChannels(const QString &address, const std::vector<ChannelInfo> &channels) {
@@ -338,17 +362,16 @@ QString Messenger::getSignFromMethod(const QString &address, const QString &meth
 
 void Messenger::onRun() {
 BEGIN_SLOT_WRAPPER
-    const std::vector<QString> monitoredAddresses = getMonitoredAddresses();
-    LOG << "Monitored addresses: " << monitoredAddresses.size();
-    clearAddressesToMonitored();
-    for (const QString &address: monitoredAddresses) {
-        const TypedException exception = apiVrapper2([&]{
-            addAddressToMonitored(address);
-        });
-        if (exception.isSet()) {
-            LOG << "Monitored address exception: " << address << " " << exception.description;
-        }
-    }
+    // Подписка на адреса уходит из onWssConnected, в том числе при первом подключении
+    LOG << "Monitored addresses: " << getMonitoredAddresses().size();
+END_SLOT_WRAPPER
+}
+
+void Messenger::onWssConnected(const TypedException &/*exception*/) {
+BEGIN_SLOT_WRAPPER
+    const std::vector<QString> helloMessages = makeHelloMessages();
+    LOG << "Send hello messages after connect: " << helloMessages.size();
+    emit wssClient.sendMessages(helloMessages);
 END_SLOT_WRAPPER
 }
 
@@ -418,7 +441,7 @@ void Messenger::processMessages(const QString &address, const std::vector<NewMes
             CHECK(address == m.username, "Incorrect message");
 
             if (m.isInput) {
-                LOG << "Add message " << m.username << " " << channel << " " << m.collocutor << " " << m.counter;
+                LOG_DEBUG << "Add message " << m.username << " " << channel << " " << m.collocutor << " " << m.counter;
                 db.addMessage(m);
                 const QString collocutorOrChannel = isChannel ? channel : m.collocutor;
                 const Message::Counter savedPos = db.getLastReadCounterForUserContact(m.username, collocutorOrChannel, isChannel); // TODO вместо метода get сделать метод is
@@ -975,7 +998,7 @@ BEGIN_SLOT_WRAPPER
         }
 
         const QString messageGetMyChannels = makeAddAllKeysRequest(addresses, size_t(-1));
-        emit wssClient.addHelloString(messageGetMyChannels, "Messenger");
+        emit wssClient.addHelloString(messageGetMyChannels, "MessengerFolders");
         emit wssClient.sendMessage(messageGetMyChannels);
     });
     callback.emitFunc(exception);
@@ -338,16 +338,21 @@ private slots:
 
     void onWssMessageReceived(QString message);
 
+    void onWssConnected(const TypedException &exception);
+
 private:
 
     void getMessagesFromAddressFromWss(const QString &fromAddress, Message::Counter from, Message::Counter to);
 
     void getMessagesFromChannelFromWss(const QString &fromAddress, const QString &channelSha, Message::Counter from, Message::Counter to);
 
-    void clearAddressesToMonitored();
-
     void addAddressToMonitored(const QString &address);
 
+    std::vector<QString> makeHelloMessagesForAddress(const QString &address);
+
+    // Собирается в потоке мессенджера при каждом подключении, поэтому counter в hello всегда актуальный
+    std::vector<QString> makeHelloMessages();
+
     void processMessages(const QString &address, const std::vector<NewMessageResponse> &messages, bool isChannel);
 
     bool checkSignsAddress(const QString &address) const;
@@ -13,8 +13,8 @@ SET_LOG_NAMESPACE("MSG");
 namespace messenger {
 
 
-MessengerDBStorage::MessengerDBStorage(const QString &path)
-    : DBStorage(path, databaseName)
+MessengerDBStorage::MessengerDBStorage(const QString &path, const TuningProfile &profile)
+    : DBStorage(path, databaseName, profile)
 {
 
 }
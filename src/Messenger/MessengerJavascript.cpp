@@ -69,7 +69,8 @@ END_SLOT_WRAPPER
 
 template<typename... Args>
 void MessengerJavascript::makeAndRunJsFuncParams(const QString &function, const TypedException &exception, Args&& ...args) {
-    const QString res = makeJsFunc3<false>(function, "", exception, std::forward<Args>(args)...);
+    const bool isLiteral = isJsonLiteralResults.load();
+    const QString res = makeJsFunc3<false>(function, "", exception, jsonArg(isLiteral, std::forward<Args>(args))...);
     runJs(res);
 }
 
@@ -1057,6 +1058,15 @@ BEGIN_SLOT_WRAPPER
 END_SLOT_WRAPPER
 }
 
+void MessengerJavascript::setJsonLiteralResults(bool isLiteral) {
+BEGIN_SLOT_WRAPPER
+    const QString JS_NAME_RESULT = "msgSetJsonLiteralResultsResultJs";
+    LOG << "Set json literal results " << isLiteral;
+    isJsonLiteralResults = isLiteral;
+    makeAndRunJsFuncParams(JS_NAME_RESULT, TypedException(), isLiteral);
+END_SLOT_WRAPPER
+}
+
 void MessengerJavascript::unlockWallet(QString address, QString password, QString passwordRsa, int timeSeconds) {
 BEGIN_SLOT_WRAPPER
     CHECK(messenger != nullptr, "Messenger not set");
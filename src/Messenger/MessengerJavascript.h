@@ -4,6 +4,7 @@
 #include <QObject>
 
 #include <functional>
+#include <atomic>
 
 #include "Message.h"
 
@@ -135,6 +136,9 @@ public slots:
 
     Q_INVOKABLE void setMhcType(bool isMhc);
 
+    // Json результаты передаются в функции страницы объектами вместо строк
+    Q_INVOKABLE void setJsonLiteralResults(bool isLiteral);
+
     Q_INVOKABLE void unlockWallet(QString address, QString password, QString passwordRsa, int timeSeconds);
 
     Q_INVOKABLE void lockWallet();
@@ -175,6 +179,8 @@ private:
 
     std::function<void(const std::function<void()> &callback)> signalFunc;
 
+    std::atomic<bool> isJsonLiteralResults{false};
+
 };
 
 }
@@ -271,7 +271,7 @@ QString makeGetMyChannelsRequest(const QString &pubkeyHex, const QString &signHe
     return QJsonDocument(json).toJson(QJsonDocument::Compact);
 }
 
-QString makeAppendKeyOnlineRequest(const QString &pubkeyHex, const QString &signHex, size_t id) {
+QString makeAppendKeyOnlineRequest(const QString &pubkeyHex, const QString &signHex, Message::Counter lastCounter, size_t id) {
     QJsonObject json;
     json.insert("jsonrpc", "2.0");
     json.insert("method", MSG_APPEND_KEY_ONLINE_REQUEST);
@@ -279,6 +279,7 @@ QString makeAppendKeyOnlineRequest(const QString &pubkeyHex, const QString &sign
     QJsonObject params;
     params.insert("pubkey", pubkeyHex);
     params.insert("sign", signHex);
+    params.insert("last_counter", QString::fromStdString(std::to_string(lastCounter)));
     json.insert("params", params);
     return QJsonDocument(json).toJson(QJsonDocument::Compact);
 }
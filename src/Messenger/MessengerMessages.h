@@ -61,7 +61,7 @@ QString makeGetChannelsRequest(const QString &pubkeyHex, const QString &signHex,
 
 QString makeGetMyChannelsRequest(const QString &pubkeyHex, const QString &signHex, size_t id);
 
-QString makeAppendKeyOnlineRequest(const QString &pubkeyHex, const QString &signHex, size_t id);
+QString makeAppendKeyOnlineRequest(const QString &pubkeyHex, const QString &signHex, Message::Counter lastCounter, size_t id);
 
 QString makeAddAllKeysRequest(const std::vector<QString> &wallets, size_t id);
 
@@ -0,0 +1,653 @@
+#include "MhContentCache.h"
+
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QLocale>
+
+#include <algorithm>
+#include <vector>
+#include <future>
+
+#include "check.h"
+#include "utils.h"
+#include "Log.h"
+
+SET_LOG_NAMESPACE("MW");
+
+const static QString INDEX_NAME = "index.json";
+
+const static milliseconds INDEX_SAVE_INTERVAL = 1s;
+
+bool MhContentCache::Entry::isFresh(const system_time_point &now) const {
+    return now - storedTime < maxAge;
+}
+
+bool MhContentCache::Entry::hasValidators() const {
+    return !etag.isEmpty() || !lastModified.isEmpty();
+}
+
+MhContentCache::MhContentCache(const QString &folder, size_t maxMemorySize, size_t maxDiskSize)
+    : folder(folder)
+    , maxMemorySize(maxMemorySize)
+    , maxDiskSize(maxDiskSize)
+{
+    createFolder(folder);
+    // Недописанные файлы прошлого запуска
+    for (const QString &tmpFile: QDir(folder).entryList(QStringList("*.tmp"), QDir::Files)) {
+        QFile::remove(makePath(folder, tmpFile));
+    }
+    try {
+        loadIndex();
+    } catch (const Exception &e) {
+        LOG << "Mh cache index corrupted: " << e;
+        index.clear();
+        hashRefs.clear();
+        diskSize = 0;
+    }
+    worker = std::thread(&MhContentCache::runWorker, this);
+}
+
+MhContentCache::~MhContentCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutTasks);
+        isStopped = true;
+    }
+    condTasks.notify_one();
+    worker.join();
+    try {
+        saveIndex(true);
+    } catch (const Exception &e) {
+        LOG << "Mh cache index not saved: " << e;
+    } catch (...) {
+        LOG << "Mh cache index not saved";
+    }
+}
+
+void MhContentCache::addTask(std::function<void()> &&task) {
+    {
+        std::lock_guard<std::mutex> lock(mutTasks);
+        tasks.emplace_back(std::move(task));
+    }
+    condTasks.notify_one();
+}
+
+void MhContentCache::runWorker() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutTasks);
+            condTasks.wait_for(lock, INDEX_SAVE_INTERVAL, [this]{
+                return isStopped || !tasks.empty();
+            });
+            if (!tasks.empty()) {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            } else if (isStopped) {
+                break;
+            }
+        }
+        try {
+            if (task) {
+                task();
+            }
+            saveIndex(false);
+        } catch (const Exception &e) {
+            LOG << "Mh cache worker error: " << e;
+        } catch (...) {
+            LOG << "Mh cache worker unknown error";
+        }
+    }
+}
+
+void MhContentCache::flush() {
+    std::promise<void> done;
+    std::future<void> future = done.get_future();
+    addTask([this, &done]{
+        saveIndex(true);
+        done.set_value();
+    });
+    future.wait();
+}
+
+QString MhContentCache::bodyPath(const QByteArray &contentHash) const {
+    return makePath(folder, QString(contentHash));
+}
+
+void MhContentCache::loadIndex() {
+    const QString path = makePath(folder, INDEX_NAME);
+    if (!isExistFile(path)) {
+        return;
+    }
+    const std::string content = readFile(path);
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(QByteArray::fromStdString(content), &parseError);
+    CHECK(parseError.error == QJsonParseError::NoError, "Json parse error: " + parseError.errorString().toStdString());
+    CHECK(document.isArray(), "Incorrect index");
+    for (const QJsonValue &value: document.array()) {
+        CHECK(value.isObject(), "Incorrect index element");
+        const QJsonObject obj = value.toObject();
+        Entry entry;
+        entry.url = obj.value("url").toString();
+        entry.mime = obj.value("mime").toString().toUtf8();
+        entry.etag = obj.value("etag").toString().toUtf8();
+        entry.lastModified = obj.value("lastModified").toString().toUtf8();
+        entry.contentHash = obj.value("hash").toString().toUtf8();
+        entry.storedTime = intToSystemTimePoint(obj.value("stored").toString().toULongLong());
+        entry.lastAccess = intToSystemTimePoint(obj.value("access").toString().toULongLong());
+        entry.maxAge = seconds(obj.value("maxAge").toInt());
+        entry.size = obj.value("size").toString().toULongLong();
+        CHECK(!entry.url.isEmpty() && !entry.contentHash.isEmpty(), "Incorrect index element");
+        if (!isExistFile(bodyPath(entry.contentHash))) {
+            continue;
+        }
+
+        size_t &refs = hashRefs[entry.contentHash];
+        if (refs == 0) {
+            diskSize += entry.size;
+        }
+        refs++;
+        index[entry.url] = entry;
+    }
+}
+
+// Вызывается из потока записи
+void MhContentCache::saveIndex(bool isForce) {
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mut);
+        if (!isIndexDirty || (!isForce && ::now() - lastIndexSave < INDEX_SAVE_INTERVAL)) {
+            return;
+        }
+        isIndexDirty = false;
+        lastIndexSave = ::now();
+        entries.reserve(index.size());
+        for (const auto &pair: index) {
+            // Записи, тело которых еще не на диске, попадут в индекс при следующем сохранении
+            if (!pair.second.contentHash.isEmpty() && pending.find(pair.first) == pending.end()) {
+                entries.emplace_back(pair.second);
+            }
+        }
+    }
+
+    QJsonArray arr;
+    for (const Entry &entry: entries) {
+        QJsonObject obj;
+        obj.insert("url", entry.url);
+        obj.insert("mime", QString(entry.mime));
+        obj.insert("etag", QString(entry.etag));
+        obj.insert("lastModified", QString(entry.lastModified));
+        obj.insert("hash", QString(entry.contentHash));
+        obj.insert("stored", QString::number(systemTimePointToInt(entry.storedTime)));
+        obj.insert("access", QString::number(systemTimePointToInt(entry.lastAccess)));
+        obj.insert("maxAge", static_cast<int>(entry.maxAge.count()));
+        obj.insert("size", QString::number(entry.size));
+        arr.push_back(obj);
+    }
+    const QString path = makePath(folder, INDEX_NAME);
+    const QString tmpPath = path + ".tmp";
+    removeFile(tmpPath);
+    writeToFile(tmpPath, QJsonDocument(arr).toJson(QJsonDocument::Compact).toStdString(), false);
+    removeFile(path);
+    CHECK(QFile::rename(tmpPath, path), "Not rename mh cache index");
+}
+
+void MhContentCache::addToMemory(const QString &url, const QByteArray &body) {
+    removeFromMemory(url);
+    if (static_cast<size_t>(body.size()) > maxMemorySize / 4) {
+        return;
+    }
+    memoryLru.push_front(url);
+    memory[url] = MemoryElement{body, memoryLru.begin()};
+    memorySize += body.size();
+    while (memorySize > maxMemorySize && !memoryLru.empty()) {
+        removeFromMemory(memoryLru.back());
+    }
+}
+
+void MhContentCache::removeFromMemory(const QString &url) {
+    const auto found = memory.find(url);
+    if (found == memory.end()) {
+        return;
+    }
+    memorySize -= found->second.body.size();
+    memoryLru.erase(found->second.lruIt);
+    memory.erase(found);
+}
+
+void MhContentCache::touch(const QString &url) {
+    const auto found = memory.find(url);
+    if (found != memory.end()) {
+        memoryLru.splice(memoryLru.begin(), memoryLru, found->second.lruIt);
+    }
+    const auto foundIndex = index.find(url);
+    if (foundIndex != index.end()) {
+        foundIndex->second.lastAccess = ::system_now();
+    }
+}
+
+void MhContentCache::removeEntryInternal(const QString &url) {
+    removeFromMemory(url);
+    pending.erase(url);
+    const auto found = index.find(url);
+    if (found == index.end()) {
+        return;
+    }
+    const QByteArray hash = found->second.contentHash;
+    const size_t size = found->second.size;
+    index.erase(found);
+    isIndexDirty = true;
+    if (hash.isEmpty()) {
+        return;
+    }
+
+    const auto foundRefs = hashRefs.find(hash);
+    CHECK(foundRefs != hashRefs.end(), "Incorrect mh cache refs");
+    foundRefs->second--;
+    if (foundRefs->second == 0) {
+        hashRefs.erase(foundRefs);
+        // Через поток записи, чтобы удаление не обогнало еще не завершенную запись этого файла
+        addTask([path=bodyPath(hash)]{
+            removeFile(path);
+        });
+        diskSize -= size;
+    }
+}
+
+void MhContentCache::shrinkDisk() {
+    if (diskSize <= maxDiskSize) {
+        return;
+    }
+    std::vector<std::pair<system_time_point, QString>> byAccess;
+    byAccess.reserve(index.size());
+    for (const auto &pair: index) {
+        byAccess.emplace_back(pair.second.lastAccess, pair.first);
+    }
+    std::sort(byAccess.begin(), byAccess.end());
+    for (const auto &pair: byAccess) {
+        if (diskSize <= maxDiskSize) {
+            break;
+        }
+        removeEntryInternal(pair.second);
+    }
+}
+
+bool MhContentCache::findMeta(const QString &url, Entry &entry) const {
+    std::lock_guard<std::mutex> lock(mut);
+    const auto found = index.find(url);
+    if (found == index.end()) {
+        return false;
+    }
+    entry = found->second;
+    return true;
+}
+
+void MhContentCache::loadBody(const QString &url, const BodyCallback &callback) {
+    Entry entry;
+    bool isFound = false;
+    bool isInMemory = false;
+    {
+        std::lock_guard<std::mutex> lock(mut);
+        const auto found = index.find(url);
+        if (found != index.end()) {
+            isFound = true;
+            entry = found->second;
+            const auto foundMemory = memory.find(url);
+            const auto foundPending = pending.find(url);
+            if (foundMemory != memory.end()) {
+                entry.body = foundMemory->second.body;
+                isInMemory = true;
+            } else if (foundPending != pending.end() && foundPending->second.filePath.isEmpty()) {
+                entry.body = foundPending->second.body;
+                isInMemory = true;
+            }
+            if (isInMemory) {
+                touch(url);
+            }
+        }
+    }
+    if (!isFound) {
+        callback(false, Entry());
+        return;
+    }
+    if (isInMemory) {
+        callback(true, entry);
+        return;
+    }
+
+    // Задачи выполняются по порядку, поэтому тело из временного файла к началу чтения уже перенесено на место
+    addTask([this, url, callback]{
+        Entry entry;
+        bool isFound = false;
+        try {
+            isFound = readBody(url, entry);
+        } catch (const Exception &e) {
+            LOG << "Mh cache read error " << url << ": " << e;
+        }
+        callback(isFound, entry);
+    });
+}
+
+// Вызывается из потока записи
+bool MhContentCache::readBody(const QString &url, Entry &entry) {
+    {
+        std::lock_guard<std::mutex> lock(mut);
+        const auto found = index.find(url);
+        if (found == index.end() || found->second.contentHash.isEmpty()) {
+            return false;
+        }
+        entry = found->second;
+    }
+
+    QFile file(bodyPath(entry.contentHash));
+    const bool isOpened = file.open(QIODevice::ReadOnly);
+    if (isOpened) {
+        entry.body = file.readAll();
+    }
+    const bool isCorrupted = isOpened && static_cast<size_t>(entry.body.size()) != entry.size;
+
+    std::lock_guard<std::mutex> lock(mut);
+    const auto found = index.find(url);
+    if (found == index.end() || found->second.contentHash != entry.contentHash) {
+        // Запись заменили, пока читали файл
+        return false;
+    }
+    if (!isOpened || isCorrupted) {
+        if (isCorrupted) {
+            LOG << "Mh cache body corrupted " << url;
+        }
+        removeEntryInternal(url);
+        return false;
+    }
+    addToMemory(url, entry.body);
+    touch(url);
+    return true;
+}
+
+void MhContentCache::addConditionalHeaders(QNetworkRequest &request, const Entry &entry) const {
+    if (!entry.etag.isEmpty()) {
+        request.setRawHeader("If-None-Match", entry.etag);
+    }
+    if (!entry.lastModified.isEmpty()) {
+        request.setRawHeader("If-Modified-Since", entry.lastModified);
+    }
+}
+
+static QDateTime parseHttpDate(const QByteArray &value) {
+    QDateTime result = QLocale::c().toDateTime(QString::fromLatin1(value.trimmed()), "ddd, dd MMM yyyy HH:mm:ss 'GMT'");
+    result.setTimeSpec(Qt::UTC);
+    return result;
+}
+
+// Свежесть берется только из Cache-Control: max-age или Expires, без эвристик.
+// Возвращает false, если ответ нельзя сохранять
+static bool parseFreshness(const QNetworkReply &reply, seconds &maxAge, bool &isExplicit) {
+    maxAge = 0s;
+    isExplicit = false;
+    bool isNoCache = false;
+    for (const QByteArray &partRaw: reply.rawHeader("Cache-Control").split(',')) {
+        const QByteArray part = partRaw.trimmed().toLower();
+        if (part == "no-store") {
+            return false;
+        } else if (part == "no-cache") {
+            isNoCache = true;
+        } else if (part.startsWith("max-age=")) {
+            bool isOk = false;
+            const long value = part.mid(8).toLong(&isOk);
+            if (isOk && value >= 0) {
+                maxAge = seconds(value);
+                isExplicit = true;
+            }
+        }
+    }
+    if (!isExplicit && reply.hasRawHeader("Expires")) {
+        const QDateTime expires = parseHttpDate(reply.rawHeader("Expires"));
+        QDateTime date = parseHttpDate(reply.rawHeader("Date"));
+        if (!date.isValid()) {
+            date = QDateTime::currentDateTimeUtc();
+        }
+        isExplicit = true;
+        if (expires.isValid() && expires > date) {
+            maxAge = seconds(date.secsTo(expires));
+        }
+    }
+    if (isNoCache) {
+        maxAge = 0s;
+    }
+    return true;
+}
+
+bool MhContentCache::processNotModified(const QString &url, const QNetworkReply &reply) {
+    if (reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 304) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mut);
+    const auto found = index.find(url);
+    if (found == index.end()) {
+        return false;
+    }
+    seconds maxAge;
+    bool isExplicit;
+    parseFreshness(reply, maxAge, isExplicit);
+    found->second.storedTime = ::system_now();
+    found->second.maxAge = maxAge;
+    if (reply.hasRawHeader("ETag")) {
+        found->second.etag = reply.rawHeader("ETag");
+    }
+    isIndexDirty = true;
+    return true;
+}
+
+bool MhContentCache::processReply(const QString &url, QNetworkReply &reply, Entry &entry) {
+    const int status = reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status != 200) {
+        return false;
+    }
+
+    storeBody(url, reply, reply.readAll(), entry);
+    return true;
+}
+
+size_t MhContentCache::getMaxEntrySize() const {
+    return maxDiskSize / 4;
+}
+
+bool MhContentCache::makeEntry(const QString &url, const QNetworkReply &reply, size_t size, Entry &entry) {
+    entry = Entry();
+    entry.url = url;
+    QByteArray mime = reply.header(QNetworkRequest::ContentTypeHeader).toByteArray();
+    const int pos = mime.indexOf(';');
+    if (pos != -1) {
+        mime = mime.left(pos);
+    }
+    entry.mime = mime;
+    entry.etag = reply.rawHeader("ETag");
+    entry.lastModified = reply.rawHeader("Last-Modified");
+    entry.size = size;
+    entry.storedTime = ::system_now();
+    entry.lastAccess = entry.storedTime;
+
+    seconds maxAge;
+    bool isExplicit;
+    const bool isStore = parseFreshness(reply, maxAge, isExplicit);
+    entry.maxAge = maxAge;
+    // Без срока свежести и без валидаторов запись нельзя ни отдать, ни проверить
+    const bool isUseful = (isExplicit && maxAge > 0s) || entry.hasValidators();
+    return isStore && isUseful && entry.size <= getMaxEntrySize();
+}
+
+uint64_t MhContentCache::addPending(const QString &url, const Entry &entry, const PendingElement &element) {
+    removeEntryInternal(url);
+    const uint64_t storeId = ++lastStoreId;
+    pending[url] = element;
+    pending[url].storeId = storeId;
+
+    Entry meta = entry;
+    meta.body.clear();
+    index[url] = meta;
+    return storeId;
+}
+
+void MhContentCache::storeBody(const QString &url, const QNetworkReply &reply, const QByteArray &body, Entry &entry) {
+    if (!makeEntry(url, reply, body.size(), entry)) {
+        remove(url);
+        entry.body = body;
+        return;
+    }
+    entry.body = body;
+
+    std::lock_guard<std::mutex> lock(mut);
+    const uint64_t storeId = addPending(url, entry, PendingElement{0, body, QString()});
+    addToMemory(url, entry.body);
+
+    addTask([this, url, storeId, body]{
+        writeBody(url, storeId, body);
+    });
+}
+
+void MhContentCache::storeFile(const QString &url, const QNetworkReply &reply, const QString &path) {
+    Entry entry;
+    if (!makeEntry(url, reply, QFileInfo(path).size(), entry)) {
+        remove(url);
+        addTask([path]{
+            QFile::remove(path);
+        });
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mut);
+    const uint64_t storeId = addPending(url, entry, PendingElement{0, QByteArray(), path});
+    addTask([this, url, storeId, path]{
+        moveFile(url, storeId, path);
+    });
+}
+
+QString MhContentCache::makeCapturePath() {
+    std::lock_guard<std::mutex> lock(mut);
+    lastCaptureId++;
+    return makePath(folder, "stream_" + QString::number(systemTimePointToInt(::system_now())) + "_" + QString::number(lastCaptureId) + ".tmp");
+}
+
+bool MhContentCache::assignHash(const QString &url, uint64_t storeId, const QByteArray &contentHash, bool &isNewFile) {
+    std::lock_guard<std::mutex> lock(mut);
+    const auto foundPending = pending.find(url);
+    if (foundPending == pending.end() || foundPending->second.storeId != storeId) {
+        return false;
+    }
+    const auto found = index.find(url);
+    CHECK(found != index.end(), "Incorrect mh cache pending");
+    found->second.contentHash = contentHash;
+    size_t &refs = hashRefs[contentHash];
+    isNewFile = refs == 0;
+    refs++;
+    if (isNewFile) {
+        diskSize += found->second.size;
+    }
+    return true;
+}
+
+void MhContentCache::finishPendingInternal(const QString &url, uint64_t storeId, bool isWritten) {
+    const auto foundPending = pending.find(url);
+    if (foundPending == pending.end() || foundPending->second.storeId != storeId) {
+        return;
+    }
+    pending.erase(foundPending);
+    if (!isWritten) {
+        removeEntryInternal(url);
+        return;
+    }
+    isIndexDirty = true;
+    shrinkDisk();
+}
+
+// Вызывается из потока записи
+void MhContentCache::writeBody(const QString &url, uint64_t storeId, const QByteArray &body) {
+    const QByteArray contentHash = QCryptographicHash::hash(body, QCryptographicHash::Sha256).toHex();
+
+    bool isNewFile = false;
+    if (!assignHash(url, storeId, contentHash, isNewFile)) {
+        return;
+    }
+
+    bool isWritten = true;
+    if (isNewFile) {
+        const QString path = bodyPath(contentHash);
+        const QString tmpPath = path + ".tmp";
+        QFile file(tmpPath);
+        isWritten = file.open(QIODevice::WriteOnly) && file.write(body) == body.size();
+        file.close();
+        if (isWritten) {
+            removeFile(path);
+            isWritten = QFile::rename(tmpPath, path);
+        }
+        if (!isWritten) {
+            LOG << "Not write mh cache file " << path;
+            QFile::remove(tmpPath);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mut);
+    finishPendingInternal(url, storeId, isWritten);
+}
+
+// Вызывается из потока записи
+void MhContentCache::moveFile(const QString &url, uint64_t storeId, const QString &path) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QFile file(path);
+    const bool isOpened = file.open(QIODevice::ReadOnly);
+    if (isOpened) {
+        hash.addData(&file);
+        file.close();
+    }
+    const QByteArray contentHash = hash.result().toHex();
+
+    bool isNewFile = false;
+    if (!isOpened || !assignHash(url, storeId, contentHash, isNewFile)) {
+        std::lock_guard<std::mutex> lock(mut);
+        QFile::remove(path);
+        finishPendingInternal(url, storeId, false);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mut);
+    bool isWritten = true;
+    if (isNewFile) {
+        const QString targetPath = bodyPath(contentHash);
+        removeFile(targetPath);
+        isWritten = QFile::rename(path, targetPath);
+        if (!isWritten) {
+            LOG << "Not move mh cache file " << targetPath;
+        }
+    }
+    if (!isWritten || !isNewFile) {
+        QFile::remove(path);
+    }
+    finishPendingInternal(url, storeId, isWritten);
+}
+
+void MhContentCache::remove(const QString &url) {
+    std::lock_guard<std::mutex> lock(mut);
+    removeEntryInternal(url);
+}
+
+size_t MhContentCache::countEntries() const {
+    std::lock_guard<std::mutex> lock(mut);
+    return index.size();
+}
+
+size_t MhContentCache::getMemorySize() const {
+    std::lock_guard<std::mutex> lock(mut);
+    return memorySize;
+}
+
+size_t MhContentCache::getDiskSize() const {
+    std::lock_guard<std::mutex> lock(mut);
+    return diskSize;
+}
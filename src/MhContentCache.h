@@ -0,0 +1,177 @@
+#ifndef MHCONTENTCACHE_H
+#define MHCONTENTCACHE_H
+
+#include <QString>
+#include <QByteArray>
+
+#include <map>
+#include <list>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "duration.h"
+
+class QNetworkRequest;
+class QNetworkReply;
+
+// Кэш ресурсов mh:// в памяти и на диске.
+// Ключ записи - url, тело хранится на диске в файле с именем sha256 содержимого.
+// Хэширование, чтение и запись файлов и индекса выполняются в отдельном потоке, индекс пишется не чаще раза в секунду.
+// Хэш тела проверяется один раз при записи, при чтении с диска сверяется только размер
+class MhContentCache {
+public:
+
+    struct Entry {
+        QString url;
+        QByteArray mime;
+        QByteArray etag;
+        QByteArray lastModified;
+        QByteArray contentHash;
+        system_time_point storedTime;
+        system_time_point lastAccess;
+        seconds maxAge{0};
+        size_t size = 0;
+
+        QByteArray body;
+
+        bool isFresh(const system_time_point &now) const;
+
+        bool hasValidators() const;
+    };
+
+    using BodyCallback = std::function<void(bool isFound, const Entry &entry)>;
+
+public:
+
+    MhContentCache(const QString &folder, size_t maxMemorySize, size_t maxDiskSize);
+
+    ~MhContentCache();
+
+    // Только метаданные записи, без тела и без обращения к диску
+    bool findMeta(const QString &url, Entry &entry) const;
+
+    // Тело из памяти отдается сразу в вызывающем потоке, тело с диска читается в потоке записи, и callback вызывается там же
+    void loadBody(const QString &url, const BodyCallback &callback);
+
+    void addConditionalHeaders(QNetworkRequest &request, const Entry &entry) const;
+
+    // Обрабатывает ответ 304: продлевает свежесть записи. Тело потом берется через loadBody.
+    // Возвращает false, если ответ не 304 или записи уже нет
+    bool processNotModified(const QString &url, const QNetworkReply &reply);
+
+    // Обрабатывает ответ 200: тело вычитывается из reply и сохраняется.
+    // Для остальных кодов возвращает false и не трогает reply
+    bool processReply(const QString &url, QNetworkReply &reply, Entry &entry);
+
+    // Сохраняет тело, уже полученное из reply со статусом 200.
+    // Сохраняются только ответы с явным сроком свежести или с ETag/Last-Modified
+    void storeBody(const QString &url, const QNetworkReply &reply, const QByteArray &body, Entry &entry);
+
+    // То же, что storeBody, но тело уже лежит в файле path, полученном из makeCapturePath. Файл переходит кэшу
+    void storeFile(const QString &url, const QNetworkReply &reply, const QString &path);
+
+    // Путь для временного файла с копией тела, который потом передается в storeFile
+    QString makeCapturePath();
+
+    // Дожидается записи на диск всех сохраненных тел и индекса
+    void flush();
+
+    size_t getMaxEntrySize() const;
+
+    void remove(const QString &url);
+
+    size_t countEntries() const;
+
+    size_t getMemorySize() const;
+
+    size_t getDiskSize() const;
+
+private:
+
+    struct MemoryElement {
+        QByteArray body;
+        std::list<QString>::iterator lruIt;
+    };
+
+    // Тело, которое еще не записано на диск. Лежит либо в body, либо во временном файле filePath
+    struct PendingElement {
+        uint64_t storeId;
+        QByteArray body;
+        QString filePath;
+    };
+
+private:
+
+    void loadIndex();
+
+    void saveIndex(bool isForce);
+
+    void addTask(std::function<void()> &&task);
+
+    void runWorker();
+
+    bool makeEntry(const QString &url, const QNetworkReply &reply, size_t size, Entry &entry);
+
+    uint64_t addPending(const QString &url, const Entry &entry, const PendingElement &element);
+
+    void writeBody(const QString &url, uint64_t storeId, const QByteArray &body);
+
+    void moveFile(const QString &url, uint64_t storeId, const QString &path);
+
+    bool readBody(const QString &url, Entry &entry);
+
+    // Под mut отмечает тело с хэшем contentHash записанным для url. Возвращает false, если запись уже заменена
+    bool assignHash(const QString &url, uint64_t storeId, const QByteArray &contentHash, bool &isNewFile);
+
+    void finishPendingInternal(const QString &url, uint64_t storeId, bool isWritten);
+
+    QString bodyPath(const QByteArray &contentHash) const;
+
+    void addToMemory(const QString &url, const QByteArray &body);
+
+    void removeFromMemory(const QString &url);
+
+    void removeEntryInternal(const QString &url);
+
+    void shrinkDisk();
+
+    void touch(const QString &url);
+
+private:
+
+    const QString folder;
+
+    const size_t maxMemorySize;
+    const size_t maxDiskSize;
+
+    mutable std::mutex mut;
+
+    std::map<QString, Entry> index;
+    std::map<QByteArray, size_t> hashRefs;
+
+    std::map<QString, MemoryElement> memory;
+    std::list<QString> memoryLru;
+    size_t memorySize = 0;
+
+    size_t diskSize = 0;
+
+    std::map<QString, PendingElement> pending;
+    uint64_t lastStoreId = 0;
+    uint64_t lastCaptureId = 0;
+
+    bool isIndexDirty = false;
+    time_point lastIndexSave;
+
+    std::mutex mutTasks;
+    std::condition_variable condTasks;
+    std::deque<std::function<void()>> tasks;
+    bool isStopped = false;
+
+    std::thread worker;
+
+};
+
+#endif // MHCONTENTCACHE_H
@@ -24,12 +24,16 @@ SET_LOG_NAMESPACE("NSL");
 
 const static QString FILL_NODES_PATH = "fill_nodes.txt";
 
+const static QString NODES_CACHE_PATH = "fill_nodes.bin";
+
 const static std::string CURRENT_VERSION = "v3";
 
 const static milliseconds MAX_PING = 100s;
 
 const static milliseconds UPDATE_PERIOD = days(1);
 
+const static milliseconds DNS_CACHE_PERIOD = 1h;
+
 const static size_t ACCEPTABLE_COUNT_ADDRESSES = 3;
 
 static QString makeAddress(const QString &ipAndPort) {
@@ -80,8 +84,13 @@ NsLookup::NsLookup(QObject *parent)
     CHECK(settings.contains("ns_lookup/use_users_servers"), "settings ns_lookup/use_users_servers field not found");
     useUsersServers = settings.value("ns_lookup/use_users_servers").toBool();
 
-    savedNodesPath = makePath(getNsLookupPath(), FILL_NODES_PATH);
-    const system_time_point lastFill = fillNodesFromFile(savedNodesPath, nodes);
+    savedNodesPath = makePath(getNsLookupPath(), NODES_CACHE_PATH);
+    legacyNodesPath = makePath(getNsLookupPath(), FILL_NODES_PATH);
+    system_time_point lastFill = fillNodesFromCache(savedNodesPath, nodes);
+    if (lastFill == intToSystemTimePoint(0)) {
+        lastFill = fillNodesFromFile(legacyNodesPath, nodes);
+    }
+    lastFullScan = lastFill;
     const system_time_point now = system_now();
     passedTime = std::chrono::duration_cast<milliseconds>(now - lastFill);
     if (lastFill - now >= hours(1)) {
@@ -128,6 +137,7 @@ NsLookup::~NsLookup() {
 
     if (isResetFilledFile.load()) {
         removeFile(savedNodesPath);
+        removeFile(legacyNodesPath);
     }
 }
 
@@ -154,6 +164,13 @@ BEGIN_SLOT_WRAPPER
 
     allNodesForTypesNew.clear();
 
+    if (isSafeCheck && isCacheUsable()) {
+        // Кеш свежий: отдаем сервера из него сразу, проверка идет в фоне
+        LOG << "Warm start from nodes cache";
+        isWarmStartFlushed = true;
+        emit serversFlushed(TypedException());
+    }
+
     LOG << "Dns scan start";
     continueResolve(nodes.begin());
 END_SLOT_WRAPPER
@@ -167,8 +184,10 @@ void NsLookup::finalizeLookup() {
     sortAll();
     lock.unlock();
     if (!isSafeCheck) {
-        saveToFile(savedNodesPath, system_now(), nodes);
+        lastFullScan = system_now();
     }
+    // После проверки тоже сохраняем: пинги и состояние нод свежие, время сканирования прежнее
+    saveToFile(savedNodesPath, lastFullScan, nodes);
 
     const time_point stopScan = ::now();
     LOG << "Dns scan time " << std::chrono::duration_cast<seconds>(stopScan - startScanTime).count() << " seconds";
@@ -202,7 +221,10 @@ void NsLookup::finalizeLookup() {
         isSuccessFl = true;
     }
     if (isSuccessFl) {
-        emit serversFlushed(TypedException());
+        if (!isWarmStartFlushed) {
+            emit serversFlushed(TypedException());
+        }
+        isWarmStartFlushed = false;
 
         if (useUsersServers) {
             startScanTime = ::now();
@@ -275,7 +297,7 @@ void NsLookup::continueResolve(std::map<QString, NodeType>::const_iterator node)
     }
 
     const time_point now = ::now();
-    if (now - cacheDns.lastUpdate >= 1h) {
+    if (now - cacheDns.lastUpdate >= DNS_CACHE_PERIOD) {
         cacheDns.cache.clear();
     }
     ipsTemp = cacheDns.cache[node->second.node.str()];
@@ -296,6 +318,7 @@ static NodeInfo parseNodeInfo(const QString &address, const milliseconds &time,
     info.address = address;
     info.ping = time.count();
     info.isChecked = true;
+    info.lastCheck = system_now();
 
     if (message.empty()) {
         info.ping = MAX_PING.count();
@@ -627,27 +650,76 @@ system_time_point NsLookup::fillNodesFromFile(const QString &file, const std::ma
     return timePoint;
 }
 
+system_time_point NsLookup::fillNodesFromCache(const QString &file, const std::map<QString, NodeType> &expectedNodes) {
+    NsLookupCache cache;
+    if (!NsLookupCache::load(file, QByteArray::fromStdString(calcHashNodes(expectedNodes)), cache)) {
+        return intToSystemTimePoint(0);
+    }
+
+    size_t count = 0;
+    for (const auto &pair: cache.nodes) {
+        std::vector<NodeInfo> &infos = allNodesForTypes[NodeType::Node(pair.first)];
+        for (NodeInfo info: pair.second) {
+            // Состояние из кеша нужно перепроверить
+            info.isChecked = false;
+            infos.emplace_back(info);
+            count++;
+        }
+    }
+
+    const system_time_point now = system_now();
+    if (cache.dnsTime <= now && now - cache.dnsTime < DNS_CACHE_PERIOD) {
+        cacheDns.cache = cache.dns;
+        cacheDns.lastUpdate = ::now() - std::chrono::duration_cast<milliseconds>(now - cache.dnsTime);
+    }
+
+    LOG << "Filled nodes from cache: " << count << ". Dns cached: " << cacheDns.cache.size();
+
+    sortAll();
+
+    createSymlink(file);
+
+    return cache.scanTime;
+}
+
 void NsLookup::saveToFile(const QString &file, const system_time_point &tp, const std::map<QString, NodeType> &expectedNodes) {
-    std::string content;
-    content += CURRENT_VERSION + "\n";
-    content += calcHashNodes(expectedNodes) + "\n";
-    content += std::to_string(systemTimePointToInt(tp)) + "\n";
-    for (const auto &nodeTypeIter: nodes) {
-        const NodeType &nodeType = nodeTypeIter.second;
-        for (const NodeInfo &node: allNodesForTypes[nodeType.node]) {
-            content += nodeType.type.toStdString() + " ";
-            content += node.address.toStdString() + " ";
-            content += std::to_string(node.ping) + " ";
-            content += (node.isTimeout ? "1" : "0") + std::string(" ");
-            content += "\n";
+    NsLookupCache cache;
+    cache.scanTime = tp;
+    if (!cacheDns.cache.empty()) {
+        cache.dns = cacheDns.cache;
+        cache.dnsTime = system_now() - std::chrono::duration_cast<milliseconds>(::now() - cacheDns.lastUpdate);
+    }
+    for (const auto &nodeTypeIter: expectedNodes) {
+        const NodeType::Node &node = nodeTypeIter.second.node;
+        const auto found = allNodesForTypes.find(node);
+        if (found != allNodesForTypes.end()) {
+            cache.nodes[node.str()] = found->second;
         }
     }
 
-    writeToFile(file, content, false);
+    NsLookupCache::save(file, QByteArray::fromStdString(calcHashNodes(expectedNodes)), cache);
+    removeFile(legacyNodesPath);
 
     createSymlink(file);
 }
 
+bool NsLookup::isCacheUsable() const {
+    std::unique_lock<std::mutex> lock(nodeMutex);
+    for (const auto &pair: nodes) {
+        const auto found = allNodesForTypes.find(pair.second.node);
+        if (found == allNodesForTypes.end()) {
+            return false;
+        }
+        const size_t countAlive = std::count_if(found->second.begin(), found->second.end(), [](const NodeInfo &info) {
+            return !info.isTimeout;
+        });
+        if (countAlive < ACCEPTABLE_COUNT_ADDRESSES) {
+            return false;
+        }
+    }
+    return true;
+}
+
 std::vector<QString> NsLookup::getRandomWithoutHttp(const QString &type, size_t limit, size_t count) const {
     return getRandom(type, limit, count, [](const NodeInfo &node) {return QUrl(node.address).host() + ":" + QString::fromStdString(std::to_string(QUrl(node.address).port()));});
 }
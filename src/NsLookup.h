@@ -17,6 +17,8 @@
 
 #include "UdpSocketClient.h"
 
+#include "NsLookupCache.h"
+
 struct TypedException;
 
 struct NodeType {
@@ -49,29 +51,6 @@ struct NodeType {
     SubType subtype = SubType::none;
 };
 
-struct NodeInfo {
-    QString address;
-
-    size_t ping;
-
-    bool isChecked = false;
-    bool isTimeout = false;
-
-    bool operator< (const NodeInfo &second) const {
-        if (this->isTimeout) {
-            return false;
-        } else if (second.isTimeout) {
-            return true;
-        } else if (this->isChecked && !second.isChecked) {
-            return true;
-        } else if (!this->isChecked && second.isChecked) {
-            return false;
-        } else {
-            return this->ping < second.ping;
-        }
-    }
-};
-
 class NsLookup : public QObject
 {
     Q_OBJECT
@@ -115,8 +94,12 @@ private:
 
     system_time_point fillNodesFromFile(const QString &file, const std::map<QString, NodeType> &expectedNodes);
 
+    system_time_point fillNodesFromCache(const QString &file, const std::map<QString, NodeType> &expectedNodes);
+
     void saveToFile(const QString &file, const system_time_point &tp, const std::map<QString, NodeType> &expectedNodes);
 
+    bool isCacheUsable() const;
+
     void continueResolve(std::map<QString, NodeType>::const_iterator node);
 
     void continuePing(std::vector<QString>::const_iterator ipsIter, std::map<QString, NodeType>::const_iterator node);
@@ -146,6 +129,11 @@ private:
 
     QString savedNodesPath;
 
+    // Текстовый файл прошлых версий, читается, если бинарного кеша еще нет
+    QString legacyNodesPath;
+
+    system_time_point lastFullScan;
+
     std::map<QString, NodeType> nodes;
 
     std::vector<QString> ipsTemp;
@@ -172,6 +160,9 @@ private:
 
     bool isSafeCheck = false;
 
+    // serversFlushed уже отправлен из кеша при теплом старте, после проверки повторно не шлем
+    bool isWarmStartFlushed = false;
+
     milliseconds passedTime;
 
     std::atomic<bool> isStopped{false};
@@ -0,0 +1,139 @@
+#include "NsLookupCache.h"
+
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QSaveFile>
+
+#include "check.h"
+#include "utils.h"
+#include "Log.h"
+
+SET_LOG_NAMESPACE("NSL");
+
+const quint32 NsLookupCache::VERSION = 1;
+
+const static quint32 MAGIC = 0x4D474E53; // MGNS
+
+const static QDataStream::Version STREAM_VERSION = QDataStream::Qt_5_6;
+
+static QByteArray checksum(const QByteArray &data) {
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+bool NsLookupCache::load(const QString &file, const QByteArray &nodesHash, NsLookupCache &cache) {
+    if (!isExistFile(file)) {
+        return false;
+    }
+    const QByteArray content = QByteArray::fromStdString(readFileBinary(file));
+
+    QDataStream stream(content);
+    stream.setVersion(STREAM_VERSION);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != MAGIC || version != VERSION) {
+        LOG << "Nodes cache: other version " << version;
+        return false;
+    }
+    QByteArray payload;
+    QByteArray sum;
+    stream >> payload >> sum;
+    if (stream.status() != QDataStream::Ok || sum != checksum(payload)) {
+        LOG << "Nodes cache corrupted";
+        return false;
+    }
+
+    QDataStream in(payload);
+    in.setVersion(STREAM_VERSION);
+    QByteArray hash;
+    in >> hash;
+    if (hash != nodesHash) {
+        LOG << "Nodes cache: nodes changed";
+        return false;
+    }
+
+    NsLookupCache result;
+    quint64 scanTime = 0;
+    quint64 dnsTime = 0;
+    in >> scanTime >> dnsTime;
+    result.scanTime = intToSystemTimePoint(scanTime);
+    result.dnsTime = intToSystemTimePoint(dnsTime);
+
+    quint32 countDns = 0;
+    in >> countDns;
+    for (quint32 i = 0; i < countDns && in.status() == QDataStream::Ok; i++) {
+        QString name;
+        quint32 countIps = 0;
+        in >> name >> countIps;
+        std::vector<QString> &ips = result.dns[name];
+        for (quint32 j = 0; j < countIps && in.status() == QDataStream::Ok; j++) {
+            QString ip;
+            in >> ip;
+            ips.emplace_back(ip);
+        }
+    }
+
+    quint32 countNodes = 0;
+    in >> countNodes;
+    for (quint32 i = 0; i < countNodes && in.status() == QDataStream::Ok; i++) {
+        QString name;
+        quint32 countInfos = 0;
+        in >> name >> countInfos;
+        std::vector<NodeInfo> &infos = result.nodes[name];
+        for (quint32 j = 0; j < countInfos && in.status() == QDataStream::Ok; j++) {
+            NodeInfo info;
+            quint64 ping = 0;
+            quint64 lastCheck = 0;
+            in >> info.address >> ping >> info.isChecked >> info.isTimeout >> lastCheck;
+            info.ping = ping;
+            info.lastCheck = intToSystemTimePoint(lastCheck);
+            infos.emplace_back(info);
+        }
+    }
+    if (in.status() != QDataStream::Ok) {
+        LOG << "Nodes cache corrupted";
+        return false;
+    }
+
+    cache = result;
+    return true;
+}
+
+void NsLookupCache::save(const QString &file, const QByteArray &nodesHash, const NsLookupCache &cache) {
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(STREAM_VERSION);
+        out << nodesHash;
+        out << quint64(systemTimePointToInt(cache.scanTime)) << quint64(systemTimePointToInt(cache.dnsTime));
+
+        out << quint32(cache.dns.size());
+        for (const auto &pair: cache.dns) {
+            out << pair.first << quint32(pair.second.size());
+            for (const QString &ip: pair.second) {
+                out << ip;
+            }
+        }
+
+        out << quint32(cache.nodes.size());
+        for (const auto &pair: cache.nodes) {
+            out << pair.first << quint32(pair.second.size());
+            for (const NodeInfo &info: pair.second) {
+                out << info.address << quint64(info.ping) << info.isChecked << info.isTimeout << quint64(systemTimePointToInt(info.lastCheck));
+            }
+        }
+    }
+
+    QByteArray content;
+    {
+        QDataStream out(&content, QIODevice::WriteOnly);
+        out.setVersion(STREAM_VERSION);
+        out << MAGIC << VERSION << payload << checksum(payload);
+    }
+
+    // QSaveFile пишет во временный файл и атомарно подменяет им кеш в commit
+    QSaveFile saveFile(file);
+    CHECK(saveFile.open(QIODevice::WriteOnly), "Not open nodes cache " + file.toStdString());
+    CHECK(saveFile.write(content) == content.size(), "Not write nodes cache " + file.toStdString());
+    CHECK(saveFile.commit(), "Not commit nodes cache " + file.toStdString());
+}
@@ -0,0 +1,64 @@
+#ifndef NSLOOKUPCACHE_H
+#define NSLOOKUPCACHE_H
+
+#include <QString>
+#include <QByteArray>
+
+#include <map>
+#include <vector>
+
+#include "duration.h"
+
+struct NodeInfo {
+    QString address;
+
+    size_t ping;
+
+    bool isChecked = false;
+    bool isTimeout = false;
+
+    // Время последней проверки
+    system_time_point lastCheck;
+
+    bool operator< (const NodeInfo &second) const {
+        if (this->isTimeout) {
+            return false;
+        } else if (second.isTimeout) {
+            return true;
+        } else if (this->isChecked && !second.isChecked) {
+            return true;
+        } else if (!this->isChecked && second.isChecked) {
+            return false;
+        } else {
+            return this->ping < second.ping;
+        }
+    }
+};
+
+/*
+   Бинарный кеш нод для быстрого старта NsLookup.
+   Файл: magic, версия, данные, sha256 данных.
+   Файл другой версии, с другим списком нод из настроек или с неверной суммой игнорируется.
+   */
+struct NsLookupCache {
+
+    static const quint32 VERSION;
+
+    // Время последнего полного сканирования
+    system_time_point scanTime;
+
+    system_time_point dnsTime;
+
+    // Имя ноды -> ответ dns
+    std::map<QString, std::vector<QString>> dns;
+
+    // Имя ноды -> адреса с последним пингом и состоянием
+    std::map<QString, std::vector<NodeInfo>> nodes;
+
+    static bool load(const QString &file, const QByteArray &nodesHash, NsLookupCache &cache);
+
+    static void save(const QString &file, const QByteArray &nodesHash, const NsLookupCache &cache);
+
+};
+
+#endif // NSLOOKUPCACHE_H
@@ -7,6 +7,8 @@
 
 #include <QUrl>
 
+#include <random>
+
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonValue>
@@ -85,13 +87,23 @@ void PagesMappings::addMappingsMh(QString mapping) {
         if (element.contains("ip") && element.value("ip").isArray()) {
             for (const QJsonValue &ip: element.value("ip").toArray()) {
                 CHECK(ip.isString(), "ips array incorrect type");
-                const QString ipHttp = ipToHttp(ip.toString());
-                page->ips.emplace_back(ipHttp);
+                page->addIp(ipToHttp(ip.toString()));
+            }
+        }
 
-                urlToName[ipHttp] = page;
+        std::vector<QString> aliases;
+        if (element.contains("aliases") && element.value("aliases").isArray()) {
+            for (const QJsonValue &alias: element.value("aliases").toArray()) {
+                CHECK(alias.isString(), "aliases array incorrect type");
+                aliases.emplace_back(alias.toString());
             }
         }
 
+        // Все проверки пройдены, меняем таблицы
+        for (const QString &ipHttp: page->ips) {
+            urlToName[ipHttp] = page;
+        }
+
         std::shared_ptr<PageInfo> pageCopy = std::make_shared<PageInfo>(*page);
         if (url.endsWith('/')) {
             if (!pageCopy->printedName.endsWith('/')) {
@@ -102,8 +114,11 @@ void PagesMappings::addMappingsMh(QString mapping) {
 
         auto addToMap = [](auto &map, const QString &key, const std::shared_ptr<PageInfo> &page) {
             const Name name(key);
-            if (map.find(name) == map.end() || *map[name] != *page) {
-                map[name] = page;
+            auto found = map.find(name);
+            if (found == map.end()) {
+                map.emplace(name, page);
+            } else if (*found->second != *page) {
+                found->second = page;
             }
         };
 
@@ -111,20 +126,18 @@ void PagesMappings::addMappingsMh(QString mapping) {
         addToMap(mappingsPages, url, page);
         addToMap(mappingsPages, page->printedName, page);
 
-        if (element.contains("aliases") && element.value("aliases").isArray()) {
-            for (const QJsonValue &alias: element.value("aliases").toArray()) {
-                CHECK(alias.isString(), "aliases array incorrect type");
-                addToMap(mappingsPages, alias.toString(), page);
-            }
+        for (const QString &alias: aliases) {
+            addToMap(mappingsPages, alias, page);
         }
     } else {
+        std::vector<QString> ips;
         if (element.contains("ip") && element.value("ip").isArray()) {
             for (const QJsonValue &ip: element.value("ip").toArray()) {
                 CHECK(ip.isString(), "ips array incorrect type");
-                const QString ipHttp = ipToHttp(ip.toString());
-                defaultMhIps.emplace_back(ipHttp);
+                ips.emplace_back(ipToHttp(ip.toString()));
             }
         }
+        defaultMhIps.insert(defaultMhIps.end(), ips.begin(), ips.end());
         if (!defaultMhIps.empty()) {
             defaultMhIp = ::getRandom(defaultMhIps);
         } else {
@@ -139,7 +152,10 @@ void PagesMappings::clearMappings() {
 }
 
 void PagesMappings::setMappings(QString mapping) {
-    clearMappings();
+    // Новые таблицы строятся отдельно и подменяют текущие только при успешном разборе
+    decltype(mappingsPages) newMappingsPages;
+    decltype(urlToName) newUrlToName;
+    PageInfo newSearchPage = searchPage;
 
     QJsonParseError parseError;
     const QJsonDocument document = QJsonDocument::fromJson(mapping.toUtf8(), &parseError);
@@ -176,17 +192,21 @@ void PagesMappings::setMappings(QString mapping) {
             pageInfo->printedName = name;
         }
         pageInfo->isApp = !name.startsWith(METAHASH_URL);
-        mappingsPages[Name(name)] = pageInfo;
+        newMappingsPages[Name(name)] = pageInfo;
 
         if (isDefault) {
-            searchPage = *pageInfo;
+            newSearchPage = *pageInfo;
         }
 
-        auto foundUrlToName = urlToName.find(url);
-        if (foundUrlToName == urlToName.end() || isPreferred) {
-            urlToName[url] = pageInfo;
+        auto foundUrlToName = newUrlToName.find(url);
+        if (foundUrlToName == newUrlToName.end() || isPreferred) {
+            newUrlToName[url] = pageInfo;
         }
     }
+
+    mappingsPages.swap(newMappingsPages);
+    urlToName.swap(newUrlToName);
+    searchPage = newSearchPage;
 }
 
 struct PathParsed {
@@ -323,6 +343,29 @@ void PagesMappings::setDefaultIpPage(const QString &name, const QString &ip) {
     found->second->changeDefaultIp(ip);
 }
 
+std::shared_ptr<PageInfo> PagesMappings::findPageInternal(const QString &url) const {
+    const auto found = mappingsPages.find(Name(url));
+    if (found != mappingsPages.end()) {
+        return found->second;
+    }
+    const int foundSlash = findSlashInternal(url);
+    if (foundSlash != -1) {
+        const auto found2 = mappingsPages.find(Name(url.left(foundSlash)));
+        if (found2 != mappingsPages.end()) {
+            return found2->second;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<PageInfo> PagesMappings::findPage(const QString &text) const {
+    std::shared_ptr<PageInfo> page = findPageInternal(text);
+    if (page == nullptr && !text.startsWith(METAHASH_URL) && !text.startsWith(APP_URL) && !text.startsWith(METAHASH_PAY_URL)) {
+        page = findPageInternal(APP_URL + text);
+    }
+    return page;
+}
+
 const std::vector<QString>& PagesMappings::getDefaultIps() const {
     return defaultMhIps;
 }
@@ -383,15 +426,30 @@ Optional<PageInfo> PagesMappings::findName(const QString &url) const {
 }
 
 QString PagesMappings::getIp(const QString &text, const std::set<QString> &excludes) {
-    const PageInfo pageInfo = find(text);
-    const QString ip = pageInfo.getIp(excludes);
-    setDefaultIpPage(pageInfo.printedName, ip);
+    const std::shared_ptr<PageInfo> page = findPage(text);
+    if (page == nullptr) {
+        return defaultMhIp;
+    }
+    const QString ip = page->getIp(excludes);
     if (ip.isNull()) {
         return defaultMhIp;
     }
+    setDefaultIpPage(page->printedName, ip);
     return ip;
 }
 
+void PagesMappings::setPreferredHost(const QString &text, const QString &host) {
+    const std::shared_ptr<PageInfo> page = findPage(text);
+    if (page == nullptr) {
+        return;
+    }
+    const auto found = std::find(page->ipHosts.begin(), page->ipHosts.end(), host);
+    if (found == page->ipHosts.end()) {
+        return;
+    }
+    setDefaultIpPage(page->printedName, page->ips[std::distance(page->ipHosts.begin(), found)]);
+}
+
 PageInfo PagesMappings::find(const QString &text) const {
     auto isFullUrl = [](const QString &text) {
         if (text.size() != 52) {
@@ -436,14 +494,47 @@ bool PagesMappings::UrlName::operator<(const PagesMappings::UrlName &second) con
     return this->name < second.name;
 }
 
+bool PagesMappings::UrlName::operator==(const PagesMappings::UrlName &second) const {
+    return this->name == second.name;
+}
+
+void PageInfo::addIp(const QString &ip) {
+    ips.emplace_back(ip);
+    ipHosts.emplace_back(QUrl(ip).host());
+}
+
 QString PageInfo::getIp(const std::set<QString> &excludes) const {
-    if (!defaultIp.isEmpty() && excludes.find(QUrl(defaultIp).host()) == excludes.end()) {
-        return defaultIp;
+    CHECK(ips.size() == ipHosts.size(), "Incorrect ips");
+    if (!defaultIp.isEmpty()) {
+        const auto found = std::find(ips.begin(), ips.end(), defaultIp);
+        if (found != ips.end() && excludes.find(ipHosts[std::distance(ips.begin(), found)]) == excludes.end()) {
+            return defaultIp;
+        }
     }
-    std::vector<QString> copyIps = ips;
-    copyIps.erase(std::remove_if(copyIps.begin(), copyIps.end(), [&excludes](const QString &element) {
-        return excludes.find(QUrl(element).host()) != excludes.end();
-    }), copyIps.end());
 
-    return  ::getRandom(copyIps);;
-}
+    std::vector<bool> excludedMask(ips.size(), false);
+    size_t countAllowed = ips.size();
+    if (!excludes.empty()) {
+        for (size_t i = 0; i < ipHosts.size(); i++) {
+            if (excludes.find(ipHosts[i]) != excludes.end()) {
+                excludedMask[i] = true;
+                countAllowed--;
+            }
+        }
+    }
+    if (countAllowed == 0) {
+        return QString();
+    }
+
+    thread_local std::mt19937 generator(std::random_device{}());
+    size_t index = std::uniform_int_distribution<size_t>(0, countAllowed - 1)(generator);
+    for (size_t i = 0; i < ips.size(); i++) {
+        if (!excludedMask[i]) {
+            if (index == 0) {
+                return ips[i];
+            }
+            index--;
+        }
+    }
+    throwErr("Incorrect ips mask");
+}
\ No newline at end of file
@@ -2,11 +2,13 @@
 #define PAGESMAPPINGS_H
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 #include <set>
 
 #include <QString>
+#include <QHash>
 
 const extern QString METAHASH_URL;
 const extern QString METAHASH_PAY_URL;
@@ -54,6 +56,11 @@ struct PageInfo {
     QString defaultIp;
 
     std::vector<QString> ips;
+    // Хосты ips, посчитанные заранее, чтобы не разбирать url при каждом запросе
+    std::vector<QString> ipHosts;
+
+    void addIp(const QString &ip);
+
     QString getIp(const std::set<QString> &excludes) const;
 
     void changeDefaultIp(const QString &ip);
@@ -96,6 +103,12 @@ private:
 
     };
 
+    struct NameHash {
+        size_t operator()(const Name &name) const {
+            return qHash(name.toString());
+        }
+    };
+
 public:
 
     PagesMappings();
@@ -122,12 +135,19 @@ public:
 
     QString getIp(const QString &text, const std::set<QString> &excludes={});
 
+    // Хост, ответивший первым, становится предпочтительным для страницы
+    void setPreferredHost(const QString &text, const QString &host);
+
     static QString getHost(const QString &url);
 
 private:
 
     Optional<PageInfo> findInternal(const QString &url) const;
 
+    std::shared_ptr<PageInfo> findPageInternal(const QString &url) const;
+
+    std::shared_ptr<PageInfo> findPage(const QString &text) const;
+
     void setDefaultIpPage(const QString &name, const QString &ip);
 
     static int findSlashInternal(const QString &url);
@@ -142,16 +162,24 @@ private:
         /*explicit*/ UrlName(const QString &name);
 
         bool operator<(const UrlName &second) const;
+
+        bool operator==(const UrlName &second) const;
+    };
+
+    struct UrlNameHash {
+        size_t operator()(const UrlName &name) const {
+            return qHash(name.name);
+        }
     };
 
 private:
 
-    std::map<Name, std::shared_ptr<PageInfo>> mappingsPages;
+    std::unordered_map<Name, std::shared_ptr<PageInfo>, NameHash> mappingsPages;
 
     std::vector<QString> defaultMhIps;
     QString defaultMhIp;
 
-    std::map<UrlName, std::shared_ptr<PageInfo>> urlToName;
+    std::unordered_map<UrlName, std::shared_ptr<PageInfo>, UrlNameHash> urlToName;
 
     PageInfo searchPage;
 
@@ -21,6 +21,10 @@ const static QString LOG_PATH = "logs/";
 
 const static QString PAGES_PATH = "pages/";
 
+const static QString MH_CACHE_PATH = "mh_cache/";
+
+const static QString DOWNLOADS_PATH = "downloads/";
+
 const static QString SETTINGS_NAME = "settings.ini";
 
 const static QString SETTINGS_NAME_OLD = "settingsOld.ini";
@@ -170,6 +174,18 @@ static void initializeSettingsPath() {
     isInitializeSettingsPath = true;
 }
 
+QString getMhCachePath() {
+    const QString res = makePath(QStandardPaths::writableLocation(QStandardPaths::HomeLocation), METAGATE_COMMON_PATH, MH_CACHE_PATH);
+    createFolder(res);
+    return res;
+}
+
+QString getDownloadsPath() {
+    const QString res = makePath(QStandardPaths::writableLocation(QStandardPaths::HomeLocation), METAGATE_COMMON_PATH, DOWNLOADS_PATH);
+    createFolder(res);
+    return res;
+}
+
 QString getSettingsPath() {
     CHECK(isInitializeSettingsPath, "Not initialize settings path");
 
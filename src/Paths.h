@@ -13,6 +13,10 @@ QString getNsLookupPath();
 
 QString getPagesPath();
 
+QString getMhCachePath();
+
+QString getDownloadsPath();
+
 QString getSettingsPath();
 
 QString getStoragePath();
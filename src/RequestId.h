@@ -1,6 +1,8 @@
 #ifndef REQUESTID_H
 #define REQUESTID_H
 
+#include <atomic>
+
 class RequestId {
 public:
 
@@ -10,7 +12,7 @@ public:
 
 private:
 
-    size_t id = 0;
+    std::atomic<size_t> id{0};
 
 };
 
@@ -0,0 +1,147 @@
+#include "StreamingReplyDevice.h"
+
+#include <QNetworkReply>
+
+#include "check.h"
+#include "SlotWrapper.h"
+#include "Log.h"
+
+SET_LOG_NAMESPACE("MW");
+
+StreamingReplyDevice::StreamingReplyDevice(QNetworkReply *reply, QObject *parent)
+    : QIODevice(parent)
+    , reply(reply)
+{
+    CHECK(reply != nullptr, "Empty reply");
+    reply->setReadBufferSize(READ_BUFFER_SIZE);
+    isReplyFinished = reply->isFinished();
+
+    CHECK(connect(reply, &QNetworkReply::readyRead, this, &StreamingReplyDevice::readyRead), "not connect readyRead");
+    CHECK(connect(reply, &QNetworkReply::finished, this, &StreamingReplyDevice::onReplyFinished), "not connect finished");
+    CHECK(connect(reply, &QNetworkReply::destroyed, this, [this]() {
+        this->reply = nullptr;
+    }), "not connect destroyed");
+
+    open(QIODevice::ReadOnly);
+}
+
+StreamingReplyDevice::~StreamingReplyDevice() {
+    dropCapture();
+}
+
+void StreamingReplyDevice::setCaptureFile(const QString &path, qint64 limit) {
+    dropCapture();
+    captureLimit = limit;
+    isCaptureOverflow = false;
+    isCaptureCompleted = false;
+    captureFile.setFileName(path);
+    if (!captureFile.open(QIODevice::WriteOnly)) {
+        LOG << "Stream capture file not open " << path;
+        isCaptureOverflow = true;
+    }
+}
+
+void StreamingReplyDevice::dropCapture() {
+    if (captureFile.fileName().isEmpty()) {
+        return;
+    }
+    captureFile.close();
+    captureFile.remove();
+    captureFile.setFileName(QString());
+}
+
+bool StreamingReplyDevice::isCaptured() const {
+    return !captureFile.fileName().isEmpty() && !isCaptureOverflow && !isFailedState && isCaptureCompleted;
+}
+
+void StreamingReplyDevice::checkCaptureCompleted() {
+    if (isCaptureCompleted || !captureFile.isOpen() || isCaptureOverflow || isFailedState) {
+        return;
+    }
+    if (!isReplyFinished || reply == nullptr || reply->bytesAvailable() != 0) {
+        return;
+    }
+    isCaptureCompleted = true;
+    captureFile.close();
+    emit captureCompleted();
+}
+
+QString StreamingReplyDevice::takeCaptured() {
+    CHECK(isCaptured(), "Body not captured");
+    captureFile.close();
+    const QString path = captureFile.fileName();
+    captureFile.setFileName(QString());
+    return path;
+}
+
+void StreamingReplyDevice::fail(const QString &error) {
+    if (isFailedState) {
+        return;
+    }
+    LOG << "Stream reply failed " << error;
+    isFailedState = true;
+    setErrorString(error);
+    dropCapture();
+    emit readChannelFinished();
+}
+
+bool StreamingReplyDevice::isFailed() const {
+    return isFailedState;
+}
+
+qint64 StreamingReplyDevice::countRead() const {
+    return readCount;
+}
+
+bool StreamingReplyDevice::isSequential() const {
+    return true;
+}
+
+qint64 StreamingReplyDevice::bytesAvailable() const {
+    if (isFailedState) {
+        return 0;
+    }
+    const qint64 available = reply != nullptr ? reply->bytesAvailable() : 0;
+    return available + QIODevice::bytesAvailable();
+}
+
+bool StreamingReplyDevice::atEnd() const {
+    return isFailedState || ((reply == nullptr || (isReplyFinished && reply->bytesAvailable() == 0)) && QIODevice::bytesAvailable() == 0);
+}
+
+qint64 StreamingReplyDevice::readData(char *data, qint64 maxSize) {
+    if (reply == nullptr || isFailedState) {
+        return -1;
+    }
+    // Читаем только из буфера reply: пока потребитель не забрал данные, reply не читает сокет дальше
+    const qint64 size = reply->read(data, maxSize);
+    if (size <= 0) {
+        return isReplyFinished ? -1 : 0;
+    }
+    readCount += size;
+    if (captureFile.isOpen() && !isCaptureOverflow) {
+        if (readCount > captureLimit || captureFile.write(data, size) != size) {
+            isCaptureOverflow = true;
+            dropCapture();
+        }
+    }
+    checkCaptureCompleted();
+    return size;
+}
+
+qint64 StreamingReplyDevice::writeData(const char */*data*/, qint64 /*maxSize*/) {
+    return -1;
+}
+
+void StreamingReplyDevice::onReplyFinished() {
+BEGIN_SLOT_WRAPPER
+    isReplyFinished = true;
+    if (reply->error() != QNetworkReply::NoError) {
+        fail(reply->errorString());
+        return;
+    }
+    checkCaptureCompleted();
+    emit readyRead();
+    emit readChannelFinished();
+END_SLOT_WRAPPER
+}
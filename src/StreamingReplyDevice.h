@@ -0,0 +1,83 @@
+#ifndef STREAMINGREPLYDEVICE_H
+#define STREAMINGREPLYDEVICE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QFile>
+
+class QNetworkReply;
+
+// Отдает тело QNetworkReply по мере получения.
+// Объем буфера reply ограничен, поэтому сокет читается только по мере чтения из устройства.
+// Копия тела для кэша пишется в файл, а не копится в памяти
+class StreamingReplyDevice : public QIODevice {
+    Q_OBJECT
+public:
+
+    static const qint64 READ_BUFFER_SIZE = 512 * 1024;
+
+public:
+
+    StreamingReplyDevice(QNetworkReply *reply, QObject *parent = nullptr);
+
+    ~StreamingReplyDevice() override;
+
+    // Копия тела пишется в path, пока не превышен limit. Файл удаляется вместе с устройством, если его не забрали через takeCaptured
+    void setCaptureFile(const QString &path, qint64 limit);
+
+    // Тело прочитано полностью, без ошибок и уместилось в лимит
+    bool isCaptured() const;
+
+    QString takeCaptured();
+
+    // Прерывает отдачу: дальнейшее чтение возвращает ошибку
+    void fail(const QString &error);
+
+    bool isFailed() const;
+
+    qint64 countRead() const;
+
+    bool isSequential() const override;
+
+    qint64 bytesAvailable() const override;
+
+    bool atEnd() const override;
+
+protected:
+
+    qint64 readData(char *data, qint64 maxSize) override;
+
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+signals:
+
+    // Все тело прочитано и записано в файл копии
+    void captureCompleted();
+
+private slots:
+
+    void onReplyFinished();
+
+private:
+
+    void dropCapture();
+
+    void checkCaptureCompleted();
+
+private:
+
+    QNetworkReply *reply;
+
+    bool isReplyFinished = false;
+
+    bool isFailedState = false;
+
+    QFile captureFile;
+    qint64 captureLimit = 0;
+    bool isCaptureOverflow = false;
+    bool isCaptureCompleted = false;
+
+    qint64 readCount = 0;
+};
+
+#endif // STREAMINGREPLYDEVICE_H
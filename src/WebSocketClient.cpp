@@ -9,11 +9,30 @@
 #include "QRegister.h"
 
 #include <QTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
 
 #include <thread>
 
+const static milliseconds RECONNECT_TIMEOUT_MIN = 1s;
+const static milliseconds RECONNECT_TIMEOUT_MAX = 5min;
+
+const static size_t MAX_BATCH_COUNT = 100;
+const static int MAX_BATCH_SIZE = 512 * 1024;
+const static int MIN_COMPRESS_SIZE = 1024;
+// Заявленный в заголовке qCompress размер проверяется до распаковки
+const static quint32 MAX_UNCOMPRESSED_SIZE = 16 * 1024 * 1024;
+
+// Старый сервер ответит на неизвестный метод ошибкой, и batch со сжатием останутся выключенными
+const static QString CAPABILITIES_ID = "wss_capabilities";
+const static QString CAPABILITIES_METHOD = "capabilities";
+// Столько ждем ответа на capabilities, прежде чем отправить hello и очередь без batch и сжатия
+const static milliseconds NEGOTIATION_TIMEOUT = 3s;
+
 WebSocketClient::WebSocketClient(const QString &url, QObject *parent)
     : TimerClass(1min, parent)
+    , randomGenerator(std::random_device()())
 {
     Q_REG2(QAbstractSocket::SocketState, "QAbstractSocket::SocketState", false);
     Q_REG2(std::vector<QString>, "std::vector<QString>", false);
@@ -37,16 +56,8 @@ WebSocketClient::WebSocketClient(const QString &url, QObject *parent)
     CHECK(connect(&m_webSocket, &QWebSocket::connected, this, &WebSocketClient::onConnected), "not connect connected");
     CHECK(connect(&m_webSocket, &QWebSocket::pong, this, &WebSocketClient::onPong), "not connect onPong");
     CHECK(connect(&m_webSocket, &QWebSocket::textMessageReceived, this, &WebSocketClient::onTextMessageReceived), "not connect textMessageReceived");
-    CHECK(connect(&m_webSocket, &QWebSocket::disconnected, [this]{
-        BEGIN_SLOT_WRAPPER
-        LOG << "Wss client disconnected. Url " << m_url.toString();
-        m_webSocket.close();
-        if (!isStopped) {
-            QTimer::singleShot(milliseconds(10s).count(), this, SLOT(onStarted()));
-        }
-        isConnected = false;
-        END_SLOT_WRAPPER
-    }), "not connect disconnected");
+    CHECK(connect(&m_webSocket, &QWebSocket::binaryMessageReceived, this, &WebSocketClient::onBinaryMessageReceived), "not connect binaryMessageReceived");
+    CHECK(connect(&m_webSocket, &QWebSocket::disconnected, this, &WebSocketClient::onDisconnected), "not connect disconnected");
     CHECK(connect(&thread1, &QThread::finished, [this]{
         BEGIN_SLOT_WRAPPER
         LOG << "Wss client finished " << m_url.toString();
@@ -72,9 +83,71 @@ BEGIN_SLOT_WRAPPER
 END_SLOT_WRAPPER
 }
 
+milliseconds WebSocketClient::nextReconnectTimeout() {
+    // Экспоненциальный рост с "полным" джиттером, чтобы клиенты не переподключались одновременно после рестарта сервера
+    const size_t shift = std::min(reconnectAttempt, size_t(16));
+    const milliseconds ceil = std::min(RECONNECT_TIMEOUT_MAX, RECONNECT_TIMEOUT_MIN * (1 << shift));
+    reconnectAttempt++;
+    std::uniform_int_distribution<milliseconds::rep> distribution(RECONNECT_TIMEOUT_MIN.count(), ceil.count());
+    return milliseconds(distribution(randomGenerator));
+}
+
+void WebSocketClient::onDisconnected() {
+BEGIN_SLOT_WRAPPER
+    const bool wasConnected = isConnected.exchange(false);
+    isNegotiating = false;
+    if (wasConnected) {
+        isOffline = true;
+        disconnectedTime = ::now();
+        emit disconnectedSock();
+    }
+    m_webSocket.close();
+    if (!isStopped) {
+        const milliseconds timeout = nextReconnectTimeout();
+        LOG << "Wss client disconnected. Url " << m_url.toString() << ". Reconnect after " << timeout.count() << " ms. Attempt " << reconnectAttempt;
+        QTimer::singleShot(timeout.count(), this, SLOT(onStarted()));
+    } else {
+        LOG << "Wss client disconnected. Url " << m_url.toString();
+    }
+END_SLOT_WRAPPER
+}
+
+void WebSocketClient::setBatchMessages(bool isBatch) {
+    isBatchMessages = isBatch;
+}
+
+void WebSocketClient::setCompressMessages(bool isCompress) {
+    isCompressMessages = isCompress;
+}
+
+void WebSocketClient::setHelloBuilder(const QString &tag, const HelloBuilder &builder) {
+    CHECK(!thread1.isRunning(), "Hello builder set after start");
+    helloBuilders[tag] = builder;
+}
+
+bool WebSocketClient::isBatchNegotiated() const {
+    return isPeerBatch.load();
+}
+
+bool WebSocketClient::isCompressNegotiated() const {
+    return isPeerCompress.load();
+}
+
+size_t WebSocketClient::getReconnectCount() const {
+    return reconnectCount.load();
+}
+
+milliseconds WebSocketClient::getOfflineTime() const {
+    return milliseconds(offlineTimeMs.load());
+}
+
 void WebSocketClient::onTimerEvent() {
 BEGIN_SLOT_WRAPPER
-    LOG << "Wss check ping " << m_url.toString();
+    LOG_DEBUG << "Wss check ping " << m_url.toString();
+    if (reconnectCount.load() != loggedReconnectCount) {
+        loggedReconnectCount = reconnectCount.load();
+        LOG << "Wss stats " << m_url.toString() << ". Reconnects " << loggedReconnectCount << ". Total offline " << offlineTimeMs.load() << " ms";
+    }
     const time_point now = ::now();
     if (std::chrono::duration_cast<seconds>(now - prevPongTime) >= 3min) {
         LOG << "Wss close " << m_url.toString();
@@ -86,7 +159,7 @@ END_SLOT_WRAPPER
 }
 
 void WebSocketClient::onPong(quint64 elapsedTime, const QByteArray &payload) {
-    LOG << "Wss check pong " << m_url.toString();
+    LOG_DEBUG << "Wss check pong " << m_url.toString();
     prevPongTime = ::now();
 }
 
@@ -105,31 +178,135 @@ void WebSocketClient::start() {
 
 void WebSocketClient::onConnected() {
 BEGIN_SLOT_WRAPPER
-    LOG << "Wss client connected " << m_url.toString();
     isConnected = true;
     prevPongTime = ::now();
+    reconnectAttempt = 0;
+    isPeerBatch = false;
+    isPeerCompress = false;
+    isNegotiating = false;
+    if (isBatchMessages.load() || isCompressMessages.load()) {
+        QJsonObject params;
+        params.insert("batch", isBatchMessages.load());
+        params.insert("compress", isCompressMessages.load() ? "zlib" : "");
+        QJsonObject request;
+        request.insert("jsonrpc", "2.0");
+        request.insert("id", CAPABILITIES_ID);
+        request.insert("method", CAPABILITIES_METHOD);
+        request.insert("params", params);
+        m_webSocket.sendTextMessage(QJsonDocument(request).toJson(QJsonDocument::Compact));
+
+        // Hello и накопленная очередь ждут ответа, чтобы уйти после переподключения одним batch-фреймом
+        isNegotiating = true;
+        const size_t currNegotiationId = ++negotiationId;
+        QTimer::singleShot(NEGOTIATION_TIMEOUT.count(), this, [this, currNegotiationId]{
+            BEGIN_SLOT_WRAPPER
+            if (isNegotiating && currNegotiationId == negotiationId) {
+                LOG << "Wss capabilities timeout " << m_url.toString();
+                finishNegotiation();
+            }
+            END_SLOT_WRAPPER
+        });
+    }
+    if (isOffline) {
+        isOffline = false;
+        reconnectCount++;
+        const milliseconds offline = std::chrono::duration_cast<milliseconds>(::now() - disconnectedTime);
+        offlineTimeMs += offline.count();
+        LOG << "Wss client reconnected " << m_url.toString() << ". Offline " << offline.count() << " ms. Reconnects " << reconnectCount.load() << ". Total offline " << offlineTimeMs.load() << " ms";
+    } else {
+        LOG << "Wss client connected " << m_url.toString();
+    }
+    if (!isNegotiating) {
+        finishNegotiation();
+    }
+    emit connectedSock(TypedException());
+END_SLOT_WRAPPER
+}
+
+void WebSocketClient::finishNegotiation() {
+    isNegotiating = false;
+    std::vector<QString> messages = makeHelloMessages();
+    messages.insert(messages.end(), messageQueue.begin(), messageQueue.end());
+    messageQueue.clear();
+    sendMessagesToSocket(messages);
+}
+
+std::vector<QString> WebSocketClient::makeHelloMessages() {
+    std::vector<QString> helloMessages;
     for (const auto &pair: helloStrings) {
+        if (helloBuilders.find(pair.first) != helloBuilders.end()) {
+            continue;
+        }
         for (const QString &helloString: pair.second) {
             LOG << "Wss send hello message " << helloString;
-            m_webSocket.sendTextMessage(helloString);
+            helloMessages.emplace_back(helloString);
         }
     }
-
-    sendMessagesInternal();
-    emit connectedSock(TypedException());
-END_SLOT_WRAPPER
+    for (const auto &pair: helloBuilders) {
+        const TypedException exception = apiVrapper2([&]{
+            const std::vector<QString> messages = pair.second();
+            LOG << "Wss send hello messages " << pair.first << ": " << messages.size();
+            helloMessages.insert(helloMessages.end(), messages.begin(), messages.end());
+        });
+        if (exception.isSet()) {
+            LOG << "Wss hello builder exception " << pair.first << ": " << exception.description;
+        }
+    }
+    return helloMessages;
 }
 
 void WebSocketClient::sendMessagesInternal() {
-    if (isConnected.load()) {
-        LOG << "Wss client send message " << (!messageQueue.empty() ? messageQueue.back() : "") << ". Count " << messageQueue.size();
-        for (const QString &m: messageQueue) {
-            m_webSocket.sendTextMessage(m);
-        }
+    if (isConnected.load() && !isNegotiating) {
+        LOG_DEBUG << "Wss client send message " << (!messageQueue.empty() ? messageQueue.back() : "") << ". Count " << messageQueue.size();
+        sendMessagesToSocket(messageQueue);
         messageQueue.clear();
     }
 }
 
+void WebSocketClient::sendFrame(const QString &frame) {
+    if (isCompressMessages.load() && isPeerCompress.load()) {
+        const QByteArray utf8 = frame.toUtf8();
+        if (utf8.size() >= MIN_COMPRESS_SIZE) {
+            m_webSocket.sendBinaryMessage(qCompress(utf8));
+            return;
+        }
+    }
+    m_webSocket.sendTextMessage(frame);
+}
+
+void WebSocketClient::sendMessagesToSocket(const std::vector<QString> &messages) {
+    if (!isBatchMessages.load() || !isPeerBatch.load()) {
+        for (const QString &m: messages) {
+            sendFrame(m);
+        }
+        return;
+    }
+
+    // Сообщения json-rpc 2.0, поэтому несколько сообщений объединяются в batch-массив одним фреймом
+    QString batch;
+    size_t countInBatch = 0;
+    const auto flush = [&]{
+        if (countInBatch == 1) {
+            sendFrame(batch);
+        } else if (countInBatch > 1) {
+            sendFrame("[" + batch + "]");
+        }
+        batch.clear();
+        countInBatch = 0;
+    };
+    for (const QString &m: messages) {
+        if (countInBatch != 0 && (countInBatch >= MAX_BATCH_COUNT || batch.size() + m.size() > MAX_BATCH_SIZE)) {
+            flush();
+        }
+        if (countInBatch != 0) {
+            batch += ",";
+        }
+        batch += m;
+        countInBatch++;
+    }
+    flush();
+}
+
 void WebSocketClient::onSendMessage(QString message) {
 BEGIN_SLOT_WRAPPER
     if (!message.isNull() && !message.isEmpty()) {
@@ -167,9 +344,58 @@ BEGIN_SLOT_WRAPPER
 END_SLOT_WRAPPER
 }
 
+bool WebSocketClient::processCapabilities(const QString &frame) {
+    if (!frame.contains(CAPABILITIES_ID)) {
+        return false;
+    }
+    const QJsonDocument json = QJsonDocument::fromJson(frame.toUtf8());
+    if (!json.isObject() || json.object().value("id").toString() != CAPABILITIES_ID) {
+        return false;
+    }
+    const QJsonObject result = json.object().value("result").toObject();
+    isPeerBatch = isBatchMessages.load() && result.value("batch").toBool();
+    isPeerCompress = isCompressMessages.load() && result.value("compress").toString() == "zlib";
+    LOG << "Wss capabilities " << m_url.toString() << ". Batch " << isPeerBatch.load() << ". Compress " << isPeerCompress.load();
+    if (isNegotiating) {
+        finishNegotiation();
+    }
+    return true;
+}
+
+void WebSocketClient::processReceivedFrame(const QString &frame) {
+    if (processCapabilities(frame)) {
+        return;
+    }
+    if (!frame.startsWith('[')) {
+        emit messageReceived(frame);
+        return;
+    }
+
+    const QJsonDocument json = QJsonDocument::fromJson(frame.toUtf8());
+    CHECK(json.isArray(), "Incorrect batch frame");
+    for (const QJsonValue &value: json.array()) {
+        CHECK(value.isObject(), "Incorrect batch frame element");
+        emit messageReceived(QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact));
+    }
+}
+
 void WebSocketClient::onTextMessageReceived(QString message) {
 BEGIN_SLOT_WRAPPER
-    LOG << "Wss received part: " << message.left(2000);
-    emit messageReceived(message);
+    LOG_DEBUG << "Wss received part: " << message.left(2000);
+    processReceivedFrame(message);
+END_SLOT_WRAPPER
+}
+
+void WebSocketClient::onBinaryMessageReceived(const QByteArray &message) {
+BEGIN_SLOT_WRAPPER
+    // qCompress: 4 байта big endian с размером исходных данных, затем zlib-поток
+    CHECK(message.size() > 4, "Incorrect compressed frame");
+    const quint32 declaredSize = (quint32(quint8(message[0])) << 24) | (quint32(quint8(message[1])) << 16) | (quint32(quint8(message[2])) << 8) | quint32(quint8(message[3]));
+    CHECK(declaredSize <= MAX_UNCOMPRESSED_SIZE, "Compressed frame too large: " + std::to_string(declaredSize));
+    const QByteArray uncompressed = qUncompress(message);
+    CHECK(!uncompressed.isEmpty(), "Incorrect compressed frame");
+    const QString frame = QString::fromUtf8(uncompressed);
+    LOG_DEBUG << "Wss received compressed part: " << message.size() << " " << uncompressed.size() << " " << frame.left(2000);
+    processReceivedFrame(frame);
 END_SLOT_WRAPPER
 }
@@ -4,6 +4,9 @@
 #include <QObject>
 #include <QThread>
 #include <map>
+#include <random>
+#include <atomic>
+#include <functional>
 #include <QtWebSockets/QWebSocket>
 
 #include "TimerClass.h"
@@ -13,6 +16,11 @@ struct TypedException;
 class WebSocketClient : public TimerClass
 {
     Q_OBJECT
+public:
+
+    // Вызывается в потоке сокета при каждом подключении
+    using HelloBuilder = std::function<std::vector<QString>()>;
+
 public:
     explicit WebSocketClient(const QString &url, QObject *parent = nullptr);
 
@@ -20,6 +28,22 @@ public:
 
     void start();
 
+    void setBatchMessages(bool isBatch);
+
+    void setCompressMessages(bool isCompress);
+
+    // Hello для тега собирается заново перед отправкой, а не берется из setHelloString. Вызывать до start()
+    void setHelloBuilder(const QString &tag, const HelloBuilder &builder);
+
+    // Сервер подтвердил поддержку batch и сжатия на текущем соединении
+    bool isBatchNegotiated() const;
+
+    bool isCompressNegotiated() const;
+
+    size_t getReconnectCount() const;
+
+    milliseconds getOfflineTime() const;
+
 signals:
 
     void closed();
@@ -36,6 +60,8 @@ signals:
 
     void connectedSock(const TypedException &exception);
 
+    void disconnectedSock();
+
 signals:
 
     void messageReceived(QString message);
@@ -47,6 +73,8 @@ public slots:
     void onConnected();
     void onTextMessageReceived(QString message);
 
+    void onBinaryMessageReceived(const QByteArray &message);
+
     void onSendMessage(QString message);
 
     void onSendMessages(const std::vector<QString> &messages);
@@ -63,10 +91,27 @@ private slots:
 
     void onPong(quint64 elapsedTime, const QByteArray &payload);
 
+    void onDisconnected();
+
 private:
 
     void sendMessagesInternal();
 
+    // Отправляет hello и очередь, накопленную до ответа на capabilities
+    void finishNegotiation();
+
+    std::vector<QString> makeHelloMessages();
+
+    void sendMessagesToSocket(const std::vector<QString> &messages);
+
+    void sendFrame(const QString &frame);
+
+    void processReceivedFrame(const QString &frame);
+
+    bool processCapabilities(const QString &frame);
+
+    milliseconds nextReconnectTimeout();
+
 private:
 
     QWebSocket m_webSocket;
@@ -80,7 +125,35 @@ private:
 
     std::map<QString, std::vector<QString>> helloStrings;
 
+    std::map<QString, HelloBuilder> helloBuilders;
+
     time_point prevPongTime;
+
+    std::atomic<bool> isBatchMessages{false};
+
+    std::atomic<bool> isCompressMessages{false};
+
+    std::atomic<bool> isPeerBatch{false};
+
+    std::atomic<bool> isPeerCompress{false};
+
+    bool isNegotiating = false;
+
+    size_t negotiationId = 0;
+
+    size_t reconnectAttempt = 0;
+
+    std::mt19937 randomGenerator;
+
+    bool isOffline = false;
+
+    time_point disconnectedTime;
+
+    std::atomic<size_t> reconnectCount{0};
+
+    std::atomic<milliseconds::rep> offlineTimeMs{0};
+
+    size_t loggedReconnectCount = 0;
 };
 
 #endif // WEBSOCKETCLIENT_H
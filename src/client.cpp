@@ -120,6 +120,29 @@ void SimpleClient::moveToThread(QThread *thread) {
     QObject::moveToThread(thread);
 }
 
+void SimpleClient::setMaxDecodedSize(int size) {
+    CHECK(size > 0, "Incorrect max decoded size");
+    maxDecodedSize = size;
+}
+
+void SimpleClient::setSizeCallback(const HttpCompression::SizeCallback &callback) {
+    sizeCallback = callback;
+}
+
+QByteArray SimpleClient::decodeContent(const QNetworkReply &reply, const QByteArray &content) {
+    HttpCompression::ResponseSize size;
+    size.url = reply.url();
+    size.encoding = reply.rawHeader("Content-Encoding");
+    size.wireBytes = content.size();
+    const QByteArray decoded = HttpCompression::decode(size.encoding, content, maxDecodedSize);
+    size.decodedBytes = decoded.size();
+    trafficStats.add(size);
+    if (sizeCallback) {
+        sizeCallback(size);
+    }
+    return decoded;
+}
+
 void SimpleClient::startTimer1() {
     if (timer == nullptr) {
         timer = new QTimer();
@@ -185,7 +208,7 @@ BEGIN_SLOT_WRAPPER
             const time_point timeBegin = getBeginTime(reply);
             const milliseconds duration = std::chrono::duration_cast<milliseconds>(timeEnd - timeBegin);
             if (duration >= timeout) {
-                LOG << PeriodicLog::make("cl_tm") << "Timeout request";
+                LOG_DEBUG << PeriodicLog::make("cl_tm") << "Timeout request";
                 toDelete.emplace_back(reply);
             }
         }
@@ -217,6 +240,8 @@ void SimpleClient::sendMessageInternal(
     callbacks[requestId] = callback;
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+    // Заданный вручную Accept-Encoding отключает распаковку в QNetworkAccessManager, ответ распаковывается в decodeContent
+    request.setRawHeader("Accept-Encoding", HttpCompression::ACCEPT_ENCODING);
     addRequestId(request, requestId);
     if (isTimeout) {
         const time_point time = ::now();
@@ -310,8 +335,12 @@ BEGIN_SLOT_WRAPPER
 
     std::string response;
     if (reply->isReadable()) {
-        QByteArray content = reply->readAll();
-        response = std::string(content.data(), content.size());
+        try {
+            const QByteArray content = decodeContent(*reply, reply->readAll());
+            response = std::string(content.data(), content.size());
+        } catch (const Exception &e) {
+            LOG << "Incorrect ping response " << reply->url().toString() << ": " << e;
+        }
     }
 
     runCallback(pingCallbacks_, requestId, duration, response);
@@ -328,14 +357,28 @@ BEGIN_SLOT_WRAPPER
 
     if (reply->error() == QNetworkReply::NoError) {
         QByteArray content;
+        std::string decodeError;
         if (reply->isReadable()) {
-            content = reply->readAll();
+            try {
+                content = decodeContent(*reply, reply->readAll());
+            } catch (const Exception &e) {
+                decodeError = e;
+            }
+        }
+        if (!decodeError.empty()) {
+            runCallback(callbacks_, requestId, "", ServerException(reply->url().toString().toStdString(), QNetworkReply::UnknownContentError, decodeError, ""));
+        } else {
+            runCallback(callbacks_, requestId, std::string(content.data(), content.size()), ServerException());
         }
-        runCallback(callbacks_, requestId, std::string(content.data(), content.size()), ServerException());
     } else {
         std::string errorStr;
         if (reply->isReadable()) {
-            errorStr = QString(reply->readAll()).toStdString();
+            const QByteArray content = reply->readAll();
+            try {
+                errorStr = QString(decodeContent(*reply, content)).toStdString();
+            } catch (const Exception &) {
+                errorStr = QString(content).toStdString();
+            }
         }
 
         runCallback(callbacks_, requestId, "", ServerException(reply->url().toString().toStdString(), reply->error(), reply->errorString().toStdString(), errorStr));
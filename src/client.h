@@ -10,6 +10,7 @@
 #include <string>
 
 #include "duration.h"
+#include "HttpCompression.h"
 
 class QNetworkAccessManager;
 class QTimer;
@@ -89,6 +90,16 @@ public:
 
     void moveToThread(QThread *thread);
 
+    // Ответы запрашиваются сжатыми, больше maxDecodedSize после распаковки считаются ошибкой
+    void setMaxDecodedSize(int size);
+
+    void setSizeCallback(const HttpCompression::SizeCallback &callback);
+
+    // Читать из потока клиента
+    const HttpCompression::Stats& getTrafficStats() const {
+        return trafficStats;
+    }
+
 Q_SIGNALS:
 
     void callbackCall(SimpleClient::ReturnCallback callback);
@@ -129,6 +140,8 @@ private:
 
     void startTimer1();
 
+    QByteArray decodeContent(const QNetworkReply &reply, const QByteArray &content);
+
 private:
     std::unique_ptr<QNetworkAccessManager> manager;
     std::unordered_map<std::string, ClientCallback> callbacks_;
@@ -141,6 +154,12 @@ private:
     QThread *thread1 = nullptr;
 
     int id = 0;
+
+    int maxDecodedSize = HttpCompression::DEFAULT_MAX_DECODED_SIZE;
+
+    HttpCompression::SizeCallback sizeCallback;
+
+    HttpCompression::Stats trafficStats;
 };
 
 #endif // CLIENT_H
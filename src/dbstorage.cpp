@@ -1,16 +1,36 @@
 #include "dbstorage.h"
 
 #include <QtSql>
+#include <QThread>
+#include <QThreadStorage>
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
 
 #include "utils.h"
 #include "check.h"
 #include "Log.h"
+#include "duration.h"
 
 static const QString dbFileNameSuffix = "db";
 
 static const QString sqliteSettings = "PRAGMA foreign_keys=on";
-static const QString sqliteSettings1 = "PRAGMA synchronous=NORMAL";
-static const QString sqliteSettings2 = "PRAGMA journal_mode=WAL";
+
+static const QString pragmaJournalMode = "PRAGMA journal_mode=%1";
+static const QString pragmaSynchronous = "PRAGMA synchronous=%1";
+static const QString pragmaCacheSize = "PRAGMA cache_size=%1";
+static const QString pragmaMmapSize = "PRAGMA mmap_size=%1";
+static const QString pragmaTempStore = "PRAGMA temp_store=%1";
+static const QString pragmaWalAutocheckpoint = "PRAGMA wal_autocheckpoint=%1";
+static const QString pragmaWalCheckpoint = "PRAGMA wal_checkpoint(%1)";
+
+static const QString writeConnectOptions = "QSQLITE_BUSY_TIMEOUT=5000";
+static const QString readConnectOptions = "QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000";
+static const size_t defaultMaxReadConnections = 4;
+// Если лимит заняли потоки, которые больше не читают, после ожидания открываем соединение сверх лимита
+static const milliseconds readConnectionWaitTimeout = 5s;
 
 static const QString dropTable = "DROP TABLE IF EXISTS %1";
 
@@ -25,20 +45,207 @@ static const QString insertSettingsKeyValue = "INSERT OR REPLACE INTO settings (
 static const QString selectSettingsKeyValue = "SELECT value from SETTINGS WHERE key = :key";
 
 static const QString settingsDBVersion = "dbversion";
+
+static const QString attachDatabase = "ATTACH DATABASE :path AS src";
+static const QString detachDatabase = "DETACH DATABASE src";
+static const QString selectSchemaObjects = "SELECT type, name, sql FROM src.sqlite_master "
+                                           "WHERE sql IS NOT NULL AND substr(name, 1, 7) != 'sqlite_' "
+                                           "ORDER BY CASE type WHEN 'table' THEN 0 WHEN 'index' THEN 1 ELSE 2 END";
+static const QString selectSequenceTable = "SELECT name FROM src.sqlite_master WHERE name = 'sqlite_sequence'";
+static const QString copyTableData = "INSERT INTO main.\"%1\" SELECT * FROM src.\"%1\"";
+static const QString clearSequence = "DELETE FROM main.sqlite_sequence";
+static const QString copySequence = "INSERT INTO main.sqlite_sequence SELECT * FROM src.sqlite_sequence";
 static const QString updatesLocationPrefix = ":/";
+// Базы больше этого размера проверяются на копии в файле, а не в памяти
+static const qint64 maxDryRunMemorySize = 64 * 1024 * 1024;
 
 const DBStorage::DbId DBStorage::not_found = -1;
 
-DBStorage::DBStorage(const QString &dbpath, const QString &dbname)
+struct DBStorage::QueryCache {
+    struct Entry {
+        explicit Entry(const QSqlDatabase &db)
+            : query(db)
+        {}
+
+        QSqlQuery query;
+        std::atomic<bool> isBusy{false};
+    };
+
+    std::mutex mut;
+
+    std::map<QString, std::unique_ptr<Entry>> queries;
+
+    CachedQuery get(const QSqlDatabase &db, const QString &sql) {
+        std::lock_guard<std::mutex> lock(mut);
+        auto found = queries.find(sql);
+        if (found == queries.end()) {
+            std::unique_ptr<Entry> entry = std::make_unique<Entry>(db);
+            CHECK(entry->query.prepare(sql), entry->query.lastError().text().toStdString());
+            found = queries.emplace(sql, std::move(entry)).first;
+        }
+        Entry &entry = *found->second;
+        if (entry.isBusy.exchange(true)) {
+            // Тот же запрос уже выполняется выше по стеку или в другом потоке
+            std::unique_ptr<QSqlQuery> query = std::make_unique<QSqlQuery>(db);
+            CHECK(query->prepare(sql), query->lastError().text().toStdString());
+            return CachedQuery(std::move(query));
+        }
+        return CachedQuery(&entry.query, &entry.isBusy);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mut);
+        queries.clear();
+    }
+};
+
+struct DBStorage::ReadConnection {
+    QString name;
+    QSqlDatabase db;
+    QueryCache queries;
+    // Вложенные ReadGuard одного потока
+    size_t countGuards = 0;
+};
+
+struct DBStorage::ReadPool {
+    std::mutex mut;
+    std::condition_variable cond;
+    size_t maxConnections = defaultMaxReadConnections;
+    size_t countOpened = 0;
+    size_t countWaiting = 0;
+    int countCreated = 0;
+    // DBStorage удален, соединения закрываются в своих потоках
+    bool isClosed = false;
+};
+
+// Соединения для чтения одного потока ко всем базам.
+// Удаляется QThreadStorage при выходе из потока, поэтому соединение всегда закрывается в создавшем его потоке
+struct DBStorage::ThreadReadConnections {
+    struct Item {
+        std::shared_ptr<ReadPool> pool;
+        std::unique_ptr<ReadConnection> connection;
+    };
+
+    // Item держит пул, поэтому адрес ключа не переиспользуется, пока запись существует
+    std::map<const ReadPool*, Item> items;
+
+    ~ThreadReadConnections() {
+        for (auto &pair: items) {
+            close(pair.second);
+        }
+    }
+
+    ReadConnection* find(const ReadPool *pool) const {
+        const auto found = items.find(pool);
+        if (found == items.end()) {
+            return nullptr;
+        }
+        return found->second.connection.get();
+    }
+
+    ReadConnection* add(const std::shared_ptr<ReadPool> &pool, std::unique_ptr<ReadConnection> &&connection) {
+        Item &item = items[pool.get()];
+        item.pool = pool;
+        item.connection = std::move(connection);
+        return item.connection.get();
+    }
+
+    void remove(const ReadPool *pool) {
+        const auto found = items.find(pool);
+        if (found != items.end()) {
+            close(found->second);
+            items.erase(found);
+        }
+    }
+
+    void removeClosed() {
+        for (auto iter = items.begin(); iter != items.end();) {
+            bool isClosed;
+            {
+                std::lock_guard<std::mutex> lock(iter->second.pool->mut);
+                isClosed = iter->second.pool->isClosed;
+            }
+            if (isClosed && iter->second.connection->countGuards == 0) {
+                close(iter->second);
+                iter = items.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+private:
+
+    static void close(Item &item) {
+        ReadConnection &connection = *item.connection;
+        connection.queries.clear();
+        connection.db.close();
+        connection.db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connection.name);
+        {
+            std::lock_guard<std::mutex> lock(item.pool->mut);
+            item.pool->countOpened--;
+        }
+        item.pool->cond.notify_all();
+    }
+};
+
+static void execPragmaOn(const QSqlDatabase &db, const QString &sql)
+{
+    QSqlQuery query(db);
+    CHECK(query.prepare(sql), query.lastError().text().toStdString());
+    CHECK(query.exec(), query.lastError().text().toStdString());
+}
+
+DBStorage::TuningProfile::TuningProfile()
+    : journalMode("WAL")
+    , synchronous("NORMAL")
+    , cacheSize(0)
+    , mmapSize(-1)
+    , walAutocheckpoint(-1)
+{
+
+}
+
+DBStorage::TuningProfile DBStorage::TuningProfile::sqliteDefault()
+{
+    TuningProfile profile;
+    profile.journalMode = "DELETE";
+    profile.synchronous = "FULL";
+    return profile;
+}
+
+DBStorage::TuningProfile DBStorage::TuningProfile::largeDatabase()
+{
+    TuningProfile profile;
+    profile.cacheSize = -32 * 1024;
+    profile.mmapSize = 256 * 1024 * 1024;
+    profile.tempStore = "MEMORY";
+    profile.walAutocheckpoint = 4000;
+    return profile;
+}
+
+DBStorage::DBStorage(const QString &dbpath, const QString &dbname, const TuningProfile &profile)
     : m_dbExist(false)
     , m_dbPath(dbpath)
     , m_dbName(dbname)
+    , m_profile(profile)
+    , m_writeQueries(std::make_unique<QueryCache>())
+    , m_readPool(std::make_shared<ReadPool>())
+    , m_transactionThread(nullptr)
 {
     openDB();
 }
 
 DBStorage::~DBStorage()
 {
+    {
+        std::lock_guard<std::mutex> lock(m_readPool->mut);
+        m_readPool->isClosed = true;
+    }
+    // Соединения других потоков закроются при их следующем beginRead или при выходе из потока
+    threadReadConnections().remove(m_readPool.get());
+    m_writeQueries->clear();
     m_db.close();
     m_db = QSqlDatabase();
     QSqlDatabase::removeDatabase(m_dbName);
@@ -57,15 +264,13 @@ QString DBStorage::dbFileName() const
 bool DBStorage::init()
 {
     if (dbExist()) {
-        execPragma(sqliteSettings1);
-        execPragma(sqliteSettings2);
+        applyTuningProfile();
         return updateDB();
     }
     LOG << "Create DB " << dbName();
     // Create settings
     execPragma(sqliteSettings);
-    execPragma(sqliteSettings1);
-    execPragma(sqliteSettings2);
+    applyTuningProfile();
     createTable(QStringLiteral("settings"), createSettingsTable);
     setSettings(settingsDBVersion, currentVersion());
 
@@ -73,9 +278,9 @@ bool DBStorage::init()
     return true;
 }
 
-QVariant DBStorage::getSettings(const QString &key)
+static QVariant getSettingsFrom(const QSqlDatabase &db, const QString &key)
 {
-    QSqlQuery query(m_db);
+    QSqlQuery query(db);
     CHECK(query.prepare(selectSettingsKeyValue), query.lastError().text().toStdString());
     query.bindValue(":key", key);
     CHECK(query.exec(), query.lastError().text().toStdString());
@@ -85,26 +290,183 @@ QVariant DBStorage::getSettings(const QString &key)
     return QString();
 }
 
-void DBStorage::setSettings(const QString &key, const QVariant &value)
+static void setSettingsTo(const QSqlDatabase &db, const QString &key, const QVariant &value)
 {
-    QSqlQuery query(m_db);
+    QSqlQuery query(db);
     CHECK(query.prepare(insertSettingsKeyValue), query.lastError().text().toStdString());
     query.bindValue(":key", key);
     query.bindValue(":value", value);
     CHECK(query.exec(), query.lastError().text().toStdString());
 }
 
+QVariant DBStorage::getSettings(const QString &key)
+{
+    return getSettingsFrom(m_db, key);
+}
+
+void DBStorage::setSettings(const QString &key, const QVariant &value)
+{
+    setSettingsTo(m_db, key, value);
+}
+
 void DBStorage::execPragma(const QString &sql)
 {
-    QSqlQuery query(m_db);
-    CHECK(query.prepare(sql), query.lastError().text().toStdString());
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    execPragmaOn(m_db, sql);
 }
 
 DBStorage::TransactionGuard DBStorage::beginTransaction() {
     return TransactionGuard(*this);
 }
 
+const DBStorage::TuningProfile& DBStorage::tuningProfile() const
+{
+    return m_profile;
+}
+
+DBStorage::CachedQuery DBStorage::cachedQuery(const QString &sql)
+{
+    return m_writeQueries->get(m_db, sql);
+}
+
+DBStorage::ReadGuard DBStorage::beginRead() const
+{
+    QThread *currentThread = QThread::currentThread();
+    if (m_transactionThread.load() == currentThread) {
+        // Внутри своей транзакции нужно видеть незакоммиченные изменения
+        return ReadGuard(*this, nullptr);
+    }
+
+    ThreadReadConnections &connections = threadReadConnections();
+    connections.removeClosed();
+    ReadConnection *connection = connections.find(m_readPool.get());
+    if (connection != nullptr) {
+        connection->countGuards++;
+        return ReadGuard(*this, connection);
+    }
+
+    QString name;
+    {
+        std::unique_lock<std::mutex> lock(m_readPool->mut);
+        if (m_readPool->countOpened >= m_readPool->maxConnections) {
+            // Соединение sqlite можно закрыть только в создавшем его потоке, поэтому ждем, пока его отдадут
+            m_readPool->countWaiting++;
+            const bool isFree = m_readPool->cond.wait_for(lock, readConnectionWaitTimeout, [this]() {
+                return m_readPool->countOpened < m_readPool->maxConnections;
+            });
+            m_readPool->countWaiting--;
+            if (!isFree) {
+                LOG << "Read connections " << dbName() << " limit " << m_readPool->maxConnections << " reached. Open additional connection";
+            }
+        }
+        m_readPool->countOpened++;
+        name = QString("%1_read_%2").arg(m_dbName).arg(m_readPool->countCreated++);
+    }
+
+    std::unique_ptr<ReadConnection> newConnection;
+    try {
+        newConnection = openReadConnection(name);
+    } catch (...) {
+        QSqlDatabase::removeDatabase(name);
+        {
+            std::lock_guard<std::mutex> lock(m_readPool->mut);
+            m_readPool->countOpened--;
+        }
+        m_readPool->cond.notify_all();
+        throw;
+    }
+    connection = connections.add(m_readPool, std::move(newConnection));
+    connection->countGuards++;
+    return ReadGuard(*this, connection);
+}
+
+void DBStorage::setMaxReadConnections(size_t count)
+{
+    CHECK(count > 0, "Incorrect read connections count");
+    {
+        std::lock_guard<std::mutex> lock(m_readPool->mut);
+        m_readPool->maxConnections = count;
+    }
+    m_readPool->cond.notify_all();
+}
+
+DBStorage::ThreadReadConnections& DBStorage::threadReadConnections()
+{
+    static QThreadStorage<ThreadReadConnections*> storage;
+    if (!storage.hasLocalData()) {
+        storage.setLocalData(new ThreadReadConnections());
+    }
+    return *storage.localData();
+}
+
+std::unique_ptr<DBStorage::ReadConnection> DBStorage::openReadConnection(const QString &name) const
+{
+    std::unique_ptr<ReadConnection> connection = std::make_unique<ReadConnection>();
+    connection->name = name;
+    connection->db = QSqlDatabase::addDatabase("QSQLITE", connection->name);
+    connection->db.setDatabaseName(makePath(m_dbPath, dbFileName()));
+    connection->db.setConnectOptions(readConnectOptions);
+    CHECK(connection->db.open(), "DB open error");
+
+    if (m_profile.cacheSize != 0) {
+        execPragmaOn(connection->db, pragmaCacheSize.arg(m_profile.cacheSize));
+    }
+    if (m_profile.mmapSize >= 0) {
+        execPragmaOn(connection->db, pragmaMmapSize.arg(m_profile.mmapSize));
+    }
+    if (!m_profile.tempStore.isEmpty()) {
+        execPragmaOn(connection->db, pragmaTempStore.arg(m_profile.tempStore));
+    }
+    return connection;
+}
+
+void DBStorage::releaseReadConnection(ReadConnection *connection) const
+{
+    connection->countGuards--;
+    if (connection->countGuards != 0) {
+        return;
+    }
+    bool isNeedClose;
+    {
+        std::lock_guard<std::mutex> lock(m_readPool->mut);
+        isNeedClose = m_readPool->countWaiting != 0 || m_readPool->isClosed;
+    }
+    if (isNeedClose) {
+        // Освобождаем место для потока, который ждет соединение
+        threadReadConnections().remove(m_readPool.get());
+    }
+}
+
+DBStorage::CheckpointResult DBStorage::walCheckpoint(CheckpointMode mode)
+{
+    QString modeName;
+    switch (mode) {
+    case CheckpointMode::Passive:
+        modeName = "PASSIVE";
+        break;
+    case CheckpointMode::Full:
+        modeName = "FULL";
+        break;
+    case CheckpointMode::Restart:
+        modeName = "RESTART";
+        break;
+    case CheckpointMode::Truncate:
+        modeName = "TRUNCATE";
+        break;
+    }
+
+    QSqlQuery query(m_db);
+    CHECK(query.prepare(pragmaWalCheckpoint.arg(modeName)), query.lastError().text().toStdString());
+    CHECK(query.exec(), query.lastError().text().toStdString());
+    CheckpointResult result;
+    if (query.next()) {
+        result.isBusy = query.value(0).toInt() != 0;
+        result.logFrames = query.value(1).toInt();
+        result.checkpointedFrames = query.value(2).toInt();
+    }
+    LOG << "Checkpoint " << dbName() << " " << modeName << ": busy " << result.isBusy << ", log " << result.logFrames << ", checkpointed " << result.checkpointedFrames;
+    return result;
+}
+
 void DBStorage::setPath(const QString &path)
 {
     m_dbPath = path;
@@ -117,6 +479,8 @@ void DBStorage::openDB()
     m_dbExist = QFile::exists(pathToDB);
     m_db = QSqlDatabase::addDatabase("QSQLITE", m_dbName);
     m_db.setDatabaseName(pathToDB);
+    // busy_timeout нужен и без WAL: иначе запись падает сразу, пока читатель держит блокировку
+    m_db.setConnectOptions(writeConnectOptions);
     CHECK(m_db.open(), "DB open error");
 }
 
@@ -157,24 +521,156 @@ bool DBStorage::updateDB()
         return true;
     if (ver > nver)
         return false; //DB version greater than current
-    auto transactionGuard = beginTransaction();
-    for (int v = ver; v < nver; v++) {
-        updateToNewVersion(v, v + 1);
+    if (m_isMigrationDryRun) {
+        CHECK(dryRunUpdate(), "Migration check failed for " + dbName().toStdString());
     }
-    setSettings(settingsDBVersion, nver);
-    transactionGuard.commit();
+    migrate(m_db, ver, nver);
     return true;
 }
 
-void DBStorage::updateToNewVersion(int vcur, int vnew)
+bool DBStorage::dryRunUpdate()
+{
+    const int ver = getSettings(settingsDBVersion).toInt();
+    const int nver = currentVersion();
+    if (ver >= nver) {
+        return ver == nver;
+    }
+
+    const QString connectionName = m_dbName + "_dryrun";
+    const QString dbPath = makePath(m_dbPath, dbFileName());
+    const qint64 dbSize = QFileInfo(dbPath).size();
+    const bool isInMemory = dbSize <= maxDryRunMemorySize;
+    const QString copyPath = makePath(m_dbPath, QString("%1_dryrun.%2").arg(m_dbName).arg(dbFileNameSuffix));
+    if (!isInMemory) {
+        QFile::remove(copyPath);
+    }
+    bool result = true;
+    {
+        QSqlDatabase copyDb = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        copyDb.setDatabaseName(isInMemory ? ":memory:" : copyPath);
+        try {
+            CHECK(copyDb.open(), "DB open error");
+            if (!isInMemory) {
+                // Копия нужна только на время проверки
+                execPragmaOn(copyDb, pragmaJournalMode.arg("OFF"));
+                execPragmaOn(copyDb, pragmaSynchronous.arg("OFF"));
+            }
+            const time_point begin = ::now();
+            copyDatabase(dbPath, copyDb);
+            LOG << "Dry run " << dbName() << ": copied " << dbSize << " bytes " << (isInMemory ? "to memory" : "to file") << " in " << std::chrono::duration_cast<milliseconds>(::now() - begin).count() << " ms";
+            migrate(copyDb, ver, nver);
+            CHECK(getSettingsFrom(copyDb, settingsDBVersion).toInt() == nver, "Incorrect version after migration");
+        } catch (const Exception &e) {
+            LOG << "Dry run " << dbName() << " failed: " << e;
+            result = false;
+        }
+        copyDb.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    if (!isInMemory) {
+        QFile::remove(copyPath);
+    }
+    return result;
+}
+
+void DBStorage::setMigrationDryRun(bool isDryRun)
+{
+    m_isMigrationDryRun = isDryRun;
+}
+
+void DBStorage::migrate(const QSqlDatabase &db, int ver, int nver)
+{
+    const time_point beginAll = ::now();
+    for (int v = ver; v < nver; v++) {
+        // Каждый шаг вместе с номером версии в своей транзакции:
+        // при ошибке следующий запуск продолжит с последнего успешного шага
+        const time_point begin = ::now();
+        QSqlDatabase database = db;
+        CHECK(database.transaction(), "Transaction not open");
+        try {
+            updateToNewVersion(db, v, v + 1);
+            setSettingsTo(db, settingsDBVersion, v + 1);
+        } catch (...) {
+            if (!database.rollback()) {
+                LOG << "Error while rollback db commit";
+            }
+            throw;
+        }
+        CHECK(database.commit(), "Transaction not commit");
+        LOG << "Update " << dbName() << " version " << v << "->" << v + 1 << " done in " << std::chrono::duration_cast<milliseconds>(::now() - begin).count() << " ms";
+    }
+    LOG << "Update " << dbName() << " " << ver << "->" << nver << " done in " << std::chrono::duration_cast<milliseconds>(::now() - beginAll).count() << " ms";
+}
+
+void DBStorage::copyDatabase(const QString &path, const QSqlDatabase &to)
+{
+    QSqlQuery query(to);
+    CHECK(query.prepare(attachDatabase), query.lastError().text().toStdString());
+    query.bindValue(":path", path);
+    CHECK(query.exec(), query.lastError().text().toStdString());
+
+    struct SchemaObject {
+        QString type;
+        QString name;
+        QString sql;
+    };
+    std::vector<SchemaObject> objects;
+    CHECK(query.exec(selectSchemaObjects), query.lastError().text().toStdString());
+    while (query.next()) {
+        objects.push_back(SchemaObject{query.value("type").toString(), query.value("name").toString(), query.value("sql").toString()});
+    }
+    bool hasSequence = false;
+    CHECK(query.exec(selectSequenceTable), query.lastError().text().toStdString());
+    if (query.next()) {
+        hasSequence = true;
+    }
+    query.finish();
+
+    // Сначала таблицы, индексы создаются после заполнения
+    for (const SchemaObject &object: objects) {
+        CHECK(query.exec(object.sql), query.lastError().text().toStdString());
+        if (object.type == "table") {
+            CHECK(query.exec(copyTableData.arg(object.name)), query.lastError().text().toStdString());
+        }
+    }
+    if (hasSequence) {
+        CHECK(query.exec(clearSequence), query.lastError().text().toStdString());
+        CHECK(query.exec(copySequence), query.lastError().text().toStdString());
+    }
+    CHECK(query.exec(detachDatabase), query.lastError().text().toStdString());
+}
+
+void DBStorage::updateToNewVersion(const QSqlDatabase &db, int vcur, int vnew)
 {
     CHECK(vcur + 1 == vnew, "possible update to incremented version");
     LOG << "Update " << dbName() << " version " << vcur << "->" << vnew;
     QString filename = updatesLocationPrefix + QStringLiteral("%1_%2to%3.sql").arg(dbName()).arg(vcur).arg(vnew);
-    execFromFile(filename);
+    execFromFile(db, filename);
 }
 
-void DBStorage::execFromFile(const QString &filename)
+void DBStorage::applyTuningProfile()
+{
+    if (!m_profile.journalMode.isEmpty()) {
+        execPragma(pragmaJournalMode.arg(m_profile.journalMode));
+    }
+    if (!m_profile.synchronous.isEmpty()) {
+        execPragma(pragmaSynchronous.arg(m_profile.synchronous));
+    }
+    if (m_profile.cacheSize != 0) {
+        execPragma(pragmaCacheSize.arg(m_profile.cacheSize));
+    }
+    if (m_profile.mmapSize >= 0) {
+        execPragma(pragmaMmapSize.arg(m_profile.mmapSize));
+    }
+    if (!m_profile.tempStore.isEmpty()) {
+        execPragma(pragmaTempStore.arg(m_profile.tempStore));
+    }
+    if (m_profile.walAutocheckpoint >= 0) {
+        execPragma(pragmaWalAutocheckpoint.arg(m_profile.walAutocheckpoint));
+    }
+}
+
+void DBStorage::execFromFile(const QSqlDatabase &db, const QString &filename)
 {
     LOG << "DB update " << filename;
     QFile file(filename);
@@ -183,7 +679,7 @@ void DBStorage::execFromFile(const QString &filename)
     QTextStream in(&file);
     QString data = in.readAll();
     QStringList sqls = data.split(';');
-    QSqlQuery query(m_db);
+    QSqlQuery query(db);
     for (const QString &sql : sqls) {
         if (sql.trimmed().isEmpty())
             continue;
@@ -196,12 +692,14 @@ DBStorage::TransactionGuard::TransactionGuard(const DBStorage &storage)
     : storage(storage)
 {
     CHECK(storage.database().transaction(), "Transaction not open");
+    storage.m_transactionThread = QThread::currentThread();
 
     isClose = true;
 }
 
 DBStorage::TransactionGuard::~TransactionGuard() {
     if (isClose) {
+        storage.m_transactionThread = nullptr;
         if (!storage.database().rollback()) {
             LOG << "Error while rollback db commit";
         }
@@ -220,6 +718,82 @@ DBStorage::TransactionGuard::TransactionGuard(DBStorage::TransactionGuard &&seco
 void DBStorage::TransactionGuard::commit() {
     CHECK(!isCommited, "already commited");
     CHECK(storage.database().commit(), "Transaction not commit");
+    storage.m_transactionThread = nullptr;
     isCommited = true;
     isClose = false;
 }
+
+DBStorage::CachedQuery::CachedQuery(QSqlQuery *query, std::atomic<bool> *isBusy)
+    : query(query)
+    , isBusy(isBusy)
+{
+
+}
+
+DBStorage::CachedQuery::CachedQuery(std::unique_ptr<QSqlQuery> &&ownQuery)
+    : ownQuery(std::move(ownQuery))
+    , query(this->ownQuery.get())
+    , isBusy(nullptr)
+{
+
+}
+
+DBStorage::CachedQuery::~CachedQuery() {
+    if (query != nullptr) {
+        query->finish();
+    }
+    if (isBusy != nullptr) {
+        *isBusy = false;
+    }
+}
+
+DBStorage::CachedQuery::CachedQuery(DBStorage::CachedQuery &&second)
+    : ownQuery(std::move(second.ownQuery))
+    , query(second.query)
+    , isBusy(second.isBusy)
+{
+    second.query = nullptr;
+    second.isBusy = nullptr;
+}
+
+QSqlQuery& DBStorage::CachedQuery::operator*() const {
+    return *query;
+}
+
+QSqlQuery* DBStorage::CachedQuery::operator->() const {
+    return query;
+}
+
+DBStorage::ReadGuard::ReadGuard(const DBStorage &storage, ReadConnection *connection)
+    : storage(storage)
+    , connection(connection)
+{
+
+}
+
+DBStorage::ReadGuard::~ReadGuard() {
+    if (connection != nullptr) {
+        storage.releaseReadConnection(connection);
+    }
+}
+
+DBStorage::ReadGuard::ReadGuard(DBStorage::ReadGuard &&second)
+    : storage(second.storage)
+    , connection(second.connection)
+{
+    second.connection = nullptr;
+}
+
+QSqlDatabase DBStorage::ReadGuard::database() const {
+    if (connection == nullptr) {
+        return storage.m_db;
+    }
+    return connection->db;
+}
+
+DBStorage::CachedQuery DBStorage::ReadGuard::query(const QString &sql) {
+    if (connection == nullptr) {
+        return storage.m_writeQueries->get(storage.m_db, sql);
+    }
+    return connection->queries.get(connection->db, sql);
+}
@@ -2,11 +2,79 @@
 #define DBSTORAGE_H
 
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QVariant>
 
+#include <memory>
+#include <atomic>
+
+class QThread;
+
 class DBStorage {
+private:
+
+    struct QueryCache;
+    struct ReadConnection;
+    struct ReadPool;
+    struct ThreadReadConnections;
+
 public:
 
+    // Подготовленный запрос из кэша соединения.
+    // В деструкторе вызывается finish(), чтобы sqlite не держал открытым чтение
+    class CachedQuery {
+    public:
+
+        CachedQuery(QSqlQuery *query, std::atomic<bool> *isBusy);
+
+        explicit CachedQuery(std::unique_ptr<QSqlQuery> &&ownQuery);
+
+        ~CachedQuery();
+
+        CachedQuery(CachedQuery &&second);
+
+        CachedQuery(const CachedQuery &second) = delete;
+        CachedQuery& operator=(const CachedQuery &second) = delete;
+        CachedQuery& operator=(CachedQuery &&second) = delete;
+
+        QSqlQuery& operator*() const;
+        QSqlQuery* operator->() const;
+
+    private:
+
+        std::unique_ptr<QSqlQuery> ownQuery;
+        QSqlQuery *query;
+        std::atomic<bool> *isBusy;
+    };
+
+    // Соединение для чтения текущего потока. Использовать только в потоке, вызвавшем beginRead
+    class ReadGuard {
+        friend class DBStorage;
+    public:
+
+        ~ReadGuard();
+
+        ReadGuard(ReadGuard &&second);
+
+        ReadGuard(const ReadGuard &second) = delete;
+        ReadGuard& operator=(const ReadGuard &second) = delete;
+        ReadGuard& operator=(ReadGuard &&second) = delete;
+
+        QSqlDatabase database() const;
+
+        CachedQuery query(const QString &sql);
+
+    private:
+
+        ReadGuard(const DBStorage &storage, ReadConnection *connection);
+
+    private:
+
+        const DBStorage &storage;
+        // nullptr - чтение внутри транзакции писателя, используется его соединение
+        ReadConnection *connection;
+    };
+
     class TransactionGuard {
     public:
 
@@ -29,12 +97,40 @@ public:
         bool isCommited = false;
     };
 
+    // Настройки sqlite, применяемые при каждом открытии базы
+    struct TuningProfile {
+        TuningProfile();
+
+        // Пустая строка, 0 для cacheSize и -1 для остальных чисел - значение sqlite по умолчанию
+        QString journalMode;
+        QString synchronous;
+        int cacheSize; // как в PRAGMA cache_size: отрицательное значение в КиБ
+        qint64 mmapSize;
+        QString tempStore;
+        int walAutocheckpoint;
+
+        // Поведение sqlite без дополнительных настроек
+        static TuningProfile sqliteDefault();
+        // Для баз с сотнями тысяч строк
+        static TuningProfile largeDatabase();
+    };
+
+    enum class CheckpointMode {
+        Passive, Full, Restart, Truncate
+    };
+
+    struct CheckpointResult {
+        bool isBusy = false;
+        int logFrames = -1;
+        int checkpointedFrames = -1;
+    };
+
 public:
     using DbId = qint64;
 
     const static DbId not_found;
 
-    explicit DBStorage(const QString &dbpath, const QString &dbname);
+    explicit DBStorage(const QString &dbpath, const QString &dbname, const TuningProfile &profile = TuningProfile());
     virtual ~DBStorage();
 
     QString dbName() const;
@@ -43,12 +139,31 @@ public:
 
     bool init();
 
+    // Проверяет цепочку миграций на копии базы, сама база не меняется. Большие базы копируются во временный файл, а не в память
+    bool dryRunUpdate();
+    // Перед обновлением базы в init() сначала выполнять dryRunUpdate()
+    void setMigrationDryRun(bool isDryRun);
+
     QVariant getSettings(const QString &key);
     void setSettings(const QString &key, const QVariant &value);
 
     void execPragma(const QString &sql);
     TransactionGuard beginTransaction();
 
+    const TuningProfile& tuningProfile() const;
+
+    // Запрос на соединении писателя. Запись идет только через него
+    CachedQuery cachedQuery(const QString &sql);
+
+    // Можно вызывать из любого потока. У каждого потока свое соединение,
+    // оно закрывается при выходе из потока или отдается ждущему потоку, если достигнут лимит
+    ReadGuard beginRead() const;
+
+    void setMaxReadConnections(size_t count);
+
+    // Работает только в режиме WAL и вне транзакции
+    CheckpointResult walCheckpoint(CheckpointMode mode = CheckpointMode::Passive);
+
 protected:
     void setPath(const QString &path);
     void openDB();
@@ -61,13 +176,27 @@ protected:
 
 private:
     bool updateDB();
-    void updateToNewVersion(int vcur, int vnew);
-    void execFromFile(const QString &filename);
+    void migrate(const QSqlDatabase &db, int ver, int nver);
+    static void copyDatabase(const QString &path, const QSqlDatabase &to);
+    void updateToNewVersion(const QSqlDatabase &db, int vcur, int vnew);
+    static void execFromFile(const QSqlDatabase &db, const QString &filename);
+    void applyTuningProfile();
+    static ThreadReadConnections& threadReadConnections();
+    std::unique_ptr<ReadConnection> openReadConnection(const QString &name) const;
+    void releaseReadConnection(ReadConnection *connection) const;
 
     QSqlDatabase m_db;
     bool m_dbExist;
     QString m_dbPath;
     QString m_dbName;
+    TuningProfile m_profile;
+    bool m_isMigrationDryRun = false;
+
+    std::unique_ptr<QueryCache> m_writeQueries;
+    // Соединения потоков держат пул, пока не закроются
+    std::shared_ptr<ReadPool> m_readPool;
+    // Поток, открывший транзакцию на соединении писателя
+    mutable std::atomic<QThread*> m_transactionThread;
 };
 
 #endif // DBSTORAGE_H
@@ -25,6 +25,7 @@
 #include "StopApplication.h"
 #include "TypedException.h"
 #include "Paths.h"
+#include "utils.h"
 
 #include "Initializer/Initializer.h"
 #include "Initializer/InitializerJavascript.h"
@@ -50,11 +51,14 @@ static void crash_handler(int sig) {
     void *array[50];
     const size_t size = backtrace(array, 50);
 
+    flushLogOnCrash();
+
     fprintf(stdout, "Error: signal %d:\n", sig);
     backtrace_symbols_fd(array, size, STDOUT_FILENO);
     fflush(stdout);
     signal(SIGINT, nullptr);
-    exit(1);
+    // exit() запустил бы деструкторы статиков, в том числе остановку потока лога, который мог упасть сам
+    _exit(1);
 }
 #endif
 
@@ -98,9 +102,10 @@ int main(int argc, char *argv[]) {
         QApplication app(argc, argv);
         MhPayEventHandler mhPayEventHandler(guard);
         app.installEventFilter(&mhPayEventHandler);
+        initializeAllPaths();
+        initLogSettings();
         initLog();
         InitOpenSSL();
-        initializeAllPaths();
         initializeMachineUid();
         initModules();
 
@@ -131,17 +136,21 @@ int main(int argc, char *argv[]) {
 
         using namespace initializer;
 
+        initManager.setProfilePath(makePath(getLogPath(), "startup_profile.json"));
+
         const std::shared_future<InitMainWindow::Return> mainWindow = initManager.addInit<InitMainWindow, true>(std::ref(initJavascript), versionString, typeString, GIT_CURRENT_SHA1, std::ref(mhPayEventHandler));
+
+        // Не зависят от mainWindow, поэтому стартуют до его создания
+        const std::shared_future<InitNsLookup::Return> nsLookup = initManager.addInit<InitNsLookup>();
+
+        const std::shared_future<InitWebSocket::Return> webSocketClient = initManager.addInit<InitWebSocket>();
+
         mainWindow.get(); // Сразу делаем здесь получение, чтобы инициализация происходила в этом потоке
 
         const std::shared_future<InitAuth::Return> auth = initManager.addInit<InitAuth>(mainWindow);
 
-        const std::shared_future<InitNsLookup::Return> nsLookup = initManager.addInit<InitNsLookup>();
-
         const std::shared_future<InitTransactions::Return> transactions = initManager.addInit<InitTransactions>(mainWindow, nsLookup);
 
-        const std::shared_future<InitWebSocket::Return> webSocketClient = initManager.addInit<InitWebSocket>();
-
         const std::shared_future<InitJavascriptWrapper::Return> jsWrapper = initManager.addInit<InitJavascriptWrapper>(webSocketClient, nsLookup, mainWindow, transactions, auth, QString::fromStdString(versionString));
 
         const std::shared_future<InitUploader::Return> uploader = initManager.addInit<InitUploader>(mainWindow);
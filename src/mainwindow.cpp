@@ -74,6 +74,9 @@ MainWindow::MainWindow(initializer::InitializerJavascript &initializerJs, QWidge
     , ui(std::make_unique<Ui::MainWindow>())
     , last_htmls(Uploader::getLastHtmlVersion())
     , currentUserName(DEFAULT_USERNAME)
+    , jsQueue([this](const QString &script) {
+        ui->webView->page()->runJavaScript(script);
+    }, 16ms)
 {
     ui->setupUi(this);
 
@@ -159,6 +162,8 @@ void MainWindow::unregisterAllWebChannels() {
         return;
     }
     LOG << "Unregister all channels";
+    // Also called after the url has changed, so pending scripts of the old page are dropped, not sent
+    jsQueue.clear();
     for (const auto &pair: registeredWebChannels) {
         channel->deregisterObject(pair.second);
     }
@@ -225,6 +230,7 @@ BEGIN_SLOT_WRAPPER
     const TypedException exception = apiVrapper2([&, this] {
         CHECK(transactionsJavascript != nullptr, "Incorrect transactionsJavascript");
         CHECK(connect(transactionsJavascript, &transactions::TransactionsJavascript::jsRunSig, this, &MainWindow::onJsRun), "not connect jsRunSig");
+        CHECK(connect(transactionsJavascript, &transactions::TransactionsJavascript::jsRunLatestSig, this, &MainWindow::onJsRunLatest), "not connect jsRunLatestSig");
         registerWebChannel(QString("transactions"), transactionsJavascript);
     });
     callback.emitFunc(exception);
@@ -555,7 +561,7 @@ BEGIN_SLOT_WRAPPER
     const QString currentVersion = VERSION_STRING;
     const QString jsScript = "window.onQtAppUpdate  && window.onQtAppUpdate(\"" + appVersion + "\", \"" + reference + "\", \"" + currentVersion + "\", \"" + message + "\");";
     LOG << "Update script " << jsScript;
-    ui->webView->page()->runJavaScript(jsScript);
+    jsQueue.add(jsScript);
 END_SLOT_WRAPPER
 }
 
@@ -568,7 +574,7 @@ void MainWindow::softReloadPage() {
         lock.unlock();
         loadFile("core/loader/index.html");
     } else {
-        ui->webView->page()->runJavaScript("updateReady();");
+        jsQueue.add("updateReady();");
     }
 }
 
@@ -584,6 +590,8 @@ void MainWindow::loadUrl(const QString &page) {
     if (url.path().isEmpty()) {
         url.setPath("/");
     }
+    // Scripts queued for the current page must not run on the next one
+    jsQueue.clear();
     ui->webView->load(url);
     LOG << "Reload ok";
 }
@@ -673,7 +681,7 @@ END_SLOT_WRAPPER
 
 void MainWindow::onSetHasNativeToolbarVariable() {
 BEGIN_SLOT_WRAPPER
-    ui->webView->page()->runJavaScript("window.hasNativeToolbar = true;");
+    jsQueue.add("window.hasNativeToolbar = true;");
 END_SLOT_WRAPPER
 }
 
@@ -703,7 +711,17 @@ END_SLOT_WRAPPER
 void MainWindow::onJsRun(QString jsString) {
 BEGIN_SLOT_WRAPPER
     if (isRegisteredWebChannels) {
-        ui->webView->page()->runJavaScript(jsString);
+        jsQueue.add(jsString);
+    } else {
+        LOG << "Revert javascript";
+    }
+END_SLOT_WRAPPER
+}
+
+void MainWindow::onJsRunLatest(QString key, QString jsString) {
+BEGIN_SLOT_WRAPPER
+    if (isRegisteredWebChannels) {
+        jsQueue.addLatest(key, jsString);
     } else {
         LOG << "Revert javascript";
     }
@@ -725,6 +743,14 @@ QString MainWindow::getServerIp(const QString &text, const std::set<QString> &ex
     }
 }
 
+void MainWindow::setServerIpPreferred(const QString &text, const QString &ip) {
+    try {
+        pagesMappings.setPreferredHost(text, ip);
+    } catch (const Exception &e) {
+        LOG << "Error " << e;
+    }
+}
+
 LastHtmlVersion MainWindow::getCurrentHtmls() const {
     std::lock_guard<std::mutex> lock(mutLastHtmls);
     return last_htmls;
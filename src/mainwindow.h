@@ -12,6 +12,7 @@
 
 #include "PagesMappings.h"
 #include "CallbackWrapper.h"
+#include "JsDeliveryQueue.h"
 
 class WebSocketClient;
 class JavascriptWrapper;
@@ -83,6 +84,8 @@ public:
 
     QString getServerIp(const QString &text, const std::set<QString> &excludesIps);
 
+    void setServerIpPreferred(const QString &text, const QString &ip);
+
     LastHtmlVersion getCurrentHtmls() const;
 
 signals:
@@ -167,6 +170,8 @@ private slots:
 
     void onJsRun(QString jsString);
 
+    void onJsRunLatest(QString key, QString jsString);
+
     void onSetHasNativeToolbarVariable();
 
     void onSetCommandLineText(QString text);
@@ -228,6 +233,8 @@ private:
 
     std::vector<std::pair<QString, QObject*>> registeredWebChannels;
     bool isRegisteredWebChannels = true;
+
+    JsDeliveryQueue jsQueue;
 };
 
 #endif // MAINWINDOW_H
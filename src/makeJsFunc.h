@@ -3,6 +3,9 @@
 
 #include <QString>
 #include <QJsonDocument>
+#include <QJsonValue>
+#include <QJsonArray>
+#include <QJsonObject>
 
 #include <string>
 
@@ -39,17 +42,109 @@ struct Opt {
 };
 
 inline QString toJsString(const QString &arg) {
-    QString copy = arg;
-    copy.replace("\\", "\\\\");
-    copy.replace('\"', "\\\"");
-    copy.replace("\n", "\\n");
-    copy.replace("\r", "");
-    return "\"" + copy + "\"";
+    QString result;
+    result.reserve(arg.size() + arg.size() / 8 + 2);
+    result += '\"';
+    for (const QChar c: arg) {
+        const ushort code = c.unicode();
+        if (code == '\\') {
+            result += "\\\\";
+        } else if (code == '\"') {
+            result += "\\\"";
+        } else if (code == '\n') {
+            result += "\\n";
+        } else if (code == '\r') {
+            // skip
+        } else if (code == 0x2028) {
+            result += "\\u2028";
+        } else if (code == 0x2029) {
+            result += "\\u2029";
+        } else {
+            result += c;
+        }
+    }
+    result += '\"';
+    return result;
+}
+
+// Экранирует utf8 json без промежуточных копий. В компактном json нет переводов строк, поэтому достаточно кавычек и слешей
+inline QString jsonToJsString(const QByteArray &json) {
+    QByteArray result;
+    result.reserve(json.size() + json.size() / 8 + 2);
+    result += '\"';
+    for (int i = 0; i < json.size(); i++) {
+        const char c = json[i];
+        if (c == '\\') {
+            result += "\\\\";
+        } else if (c == '\"') {
+            result += "\\\"";
+        } else if (c == '\xE2' && i + 2 < json.size() && json[i + 1] == '\x80' && (json[i + 2] == '\xA8' || json[i + 2] == '\xA9')) {
+            result += json[i + 2] == '\xA8' ? "\\u2028" : "\\u2029";
+            i += 2;
+        } else {
+            result += c;
+        }
+    }
+    result += '\"';
+    return QString::fromUtf8(result);
 }
 
 inline QString toJsString(const QJsonDocument &arg) {
-    QString json = arg.toJson(QJsonDocument::Compact);
-    return toJsString(json);
+    return jsonToJsString(arg.toJson(QJsonDocument::Compact));
+}
+
+// Json, который передается в javascript литералом объекта или массива, а не строкой, и не требует JSON.parse на странице
+struct JsJson {
+    QJsonValue value;
+
+    explicit JsJson(const QJsonValue &value)
+        : value(value)
+    {}
+
+    explicit JsJson(const QJsonDocument &doc)
+        : value(doc.isArray() ? QJsonValue(doc.array()) : QJsonValue(doc.object()))
+    {}
+};
+
+inline QString toJsString(const JsJson &arg) {
+    QByteArray json;
+    if (arg.value.isArray()) {
+        json = QJsonDocument(arg.value.toArray()).toJson(QJsonDocument::Compact);
+    } else if (arg.value.isObject()) {
+        json = QJsonDocument(arg.value.toObject()).toJson(QJsonDocument::Compact);
+    } else {
+        json = QJsonDocument(QJsonArray{arg.value}).toJson(QJsonDocument::Compact);
+        json = json.mid(1, json.size() - 2);
+    }
+    // Эти символы допустимы в json, но не в строковых литералах старых версий javascript
+    json.replace("\xE2\x80\xA8", "\\u2028");
+    json.replace("\xE2\x80\xA9", "\\u2029");
+    return QString::fromUtf8(json);
+}
+
+// Уже закодированный фрагмент javascript, вставляется в вызов как есть
+struct JsCode {
+    QString code;
+};
+
+inline QString toJsString(const JsCode &arg) {
+    return arg.code;
+}
+
+template<typename T>
+inline const T& jsonArg(bool /*isLiteral*/, const T &arg) {
+    return arg;
+}
+
+// Json документ передается литералом, если страница включила такой режим, иначе строкой, как раньше
+inline JsCode jsonArg(bool isLiteral, const QJsonDocument &arg) {
+    if (!isLiteral) {
+        return JsCode{toJsString(arg)};
+    } else if (arg.isNull()) {
+        return JsCode{"null"};
+    } else {
+        return JsCode{toJsString(JsJson(arg))};
+    }
 }
 
 inline QString toJsString(const std::string &arg) {
@@ -4,10 +4,18 @@
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
+#include <QBuffer>
+#include <QSettings>
+#include <QPointer>
 
 #include "mainwindow.h"
 #include "SlotWrapper.h"
 #include "check.h"
+#include "Paths.h"
+#include "MhContentCache.h"
+#include "HedgedRequest.h"
+#include "StreamingReplyDevice.h"
+#include "QRegister.h"
 
 SET_LOG_NAMESPACE("MW");
 
@@ -15,6 +23,7 @@ const static QNetworkRequest::Attribute REQUEST_ID_FIELD = QNetworkRequest::Attr
 const static QNetworkRequest::Attribute TIME_BEGIN_FIELD = QNetworkRequest::Attribute(QNetworkRequest::User + 1);
 const static QNetworkRequest::Attribute TIMOUT_FIELD = QNetworkRequest::Attribute(QNetworkRequest::User + 2);
 const static QNetworkRequest::Attribute IGNORE_ERRORS_FIELD = QNetworkRequest::Attribute(QNetworkRequest::User + 3);
+const static QNetworkRequest::Attribute CACHE_URL_FIELD = QNetworkRequest::Attribute(QNetworkRequest::User + 4);
 
 static void addRequestId(QNetworkRequest &request, const std::string &id) {
     request.setAttribute(REQUEST_ID_FIELD, QString::fromStdString(id));
@@ -70,16 +79,86 @@ static bool getIgnoreError(const QNetworkReply &reply) {
     return reply.request().attribute(IGNORE_ERRORS_FIELD).toBool();
 }
 
+// Ответ уже отдается в job потоком, по завершении остается только обновить кэш
+const static char * const STREAMED_PROPERTY = "mhStreamed";
+
+static bool isStreamed(const QNetworkReply &reply) {
+    return reply.property(STREAMED_PROPERTY).toBool();
+}
+
+static QByteArray getMime(const QNetworkReply &reply) {
+    QByteArray mime = reply.header(QNetworkRequest::ContentTypeHeader).toByteArray();
+    const int pos = mime.indexOf(';');
+    if (pos != -1) {
+        mime = mime.left(pos);
+    }
+    return mime;
+}
+
+static void addCacheUrl(QNetworkRequest &request, const QString &url) {
+    request.setAttribute(CACHE_URL_FIELD, url);
+}
+
+static bool isCacheUrl(const QNetworkReply &reply) {
+    return reply.request().attribute(CACHE_URL_FIELD).userType() == QMetaType::QString;
+}
+
+static QString getCacheUrl(const QNetworkReply &reply) {
+    CHECK(isCacheUrl(reply), "Cache url field not set");
+    return reply.request().attribute(CACHE_URL_FIELD).toString();
+}
+
 MHUrlSchemeHandler::MHUrlSchemeHandler(QObject *parent)
     : QWebEngineUrlSchemeHandler(parent)
 {
     m_manager = new QNetworkAccessManager(this);
 
+    Q_REG(MHUrlSchemeHandler::Callback, "MHUrlSchemeHandler::Callback");
+    CHECK(connect(this, &MHUrlSchemeHandler::callbackCall, this, &MHUrlSchemeHandler::onCallbackCall), "not connect onCallbackCall");
+
+    QSettings settings(getSettingsPath(), QSettings::IniFormat);
+    settings.beginGroup("mh_cache");
+    if (settings.value("enabled", true).toBool()) {
+        const size_t MB = 1024 * 1024;
+        cache = std::make_unique<MhContentCache>(
+            getMhCachePath(),
+            settings.value("memory_size_mb", 32).toULongLong() * MB,
+            settings.value("disk_size_mb", 256).toULongLong() * MB
+        );
+    }
+    staleTimeout = milliseconds(settings.value("stale_timeout_ms", 300).toLongLong());
+    settings.endGroup();
+
+    // Дублирование запроса на второй ip, если первый не ответил за адаптивную задержку
+    settings.beginGroup("mh_hedge");
+    hedgeMaxRequests = settings.value("max_requests", 1).toUInt();
+    hedgeInitialDelay = milliseconds(settings.value("delay_ms", 200).toLongLong());
+    hedgeMinDelay = milliseconds(settings.value("min_delay_ms", 30).toLongLong());
+    hedgeMaxDelay = milliseconds(settings.value("max_delay_ms", 1000).toLongLong());
+    settings.endGroup();
+
     CHECK(connect(&timer, &QTimer::timeout, this, &MHUrlSchemeHandler::onTimerEvent), "not connect timeout");
     timer.setInterval(milliseconds(1s).count());
     timer.start();
 }
 
+MHUrlSchemeHandler::~MHUrlSchemeHandler() {
+    // Поток кэша может еще вызывать callbackCall, поэтому останавливаем его, пока объект цел
+    cache.reset();
+}
+
+void MHUrlSchemeHandler::onCallbackCall(MHUrlSchemeHandler::Callback callback) {
+BEGIN_SLOT_WRAPPER
+    callback();
+END_SLOT_WRAPPER
+}
+
+void MHUrlSchemeHandler::loadFromCache(const QString &cacheUrl, const CacheBodyCallback &callback) {
+    cache->loadBody(cacheUrl, [this, callback](bool isFound, const MhContentCache::Entry &entry) {
+        emit callbackCall(std::bind(callback, isFound, entry.mime, entry.body));
+    });
+}
+
 void MHUrlSchemeHandler::setLog() {
     isLog = true;
 }
@@ -97,7 +176,7 @@ BEGIN_SLOT_WRAPPER
             const time_point timeBegin = getBeginTime(*reply);
             const milliseconds duration = std::chrono::duration_cast<milliseconds>(timeEnd - timeBegin);
             if (duration >= timeout) {
-                LOG << "Timeout request";
+                LOG_DEBUG << "Timeout request";
                 return false;
             }
         }
@@ -122,6 +201,78 @@ void MHUrlSchemeHandler::removeOnRequestId(const std::string &requestId) {
     }), requests.end());
 }
 
+QNetworkRequest MHUrlSchemeHandler::makeRequest(const QUrl &url, const QString &host, const QString &ip, bool isCacheable) const {
+    QUrl newurl(url);
+    newurl.setScheme(QStringLiteral("http"));
+    newurl.setHost(ip);
+    QNetworkRequest req(newurl);
+    req.setRawHeader(QByteArray("Host"), host.toUtf8());
+    if (isCacheable) {
+        addCacheUrl(req, url.toString());
+        MhContentCache::Entry entry;
+        if (cache->findMeta(url.toString(), entry)) {
+            cache->addConditionalHeaders(req, entry);
+        }
+    }
+    return req;
+}
+
+void MHUrlSchemeHandler::serveStaleLater(QWebEngineUrlRequestJob *job, QObject *request, const QString &cacheUrl, const std::function<bool()> &isAnswered) {
+    // Сервер отвечает медленно - отдаем устаревшую копию, ответ только обновит кэш
+    QTimer::singleShot(staleTimeout.count(), request, [this, request, job, cacheUrl, isAnswered]() {
+    BEGIN_SLOT_WRAPPER
+        if (request->parent() != job || isAnswered()) {
+            return;
+        }
+        QPointer<QObject> requestPtr(request);
+        loadFromCache(cacheUrl, [this, requestPtr, job, cacheUrl, isAnswered](bool isFound, const QByteArray &mime, const QByteArray &body) {
+            // Пока читалось тело, мог прийти ответ или завершиться job
+            if (!isFound || requestPtr.isNull() || requestPtr->parent() != job || isAnswered()) {
+                return;
+            }
+            LOG_DEBUG << "Serve stale " << cacheUrl;
+            requestPtr->setParent(this);
+            replyFromCache(job, mime, body);
+        });
+    END_SLOT_WRAPPER
+    });
+}
+
+milliseconds MHUrlSchemeHandler::hedgeDelay() const {
+    if (hedgeLatencies.count() < 10) {
+        return hedgeInitialDelay;
+    }
+    return std::min(hedgeMaxDelay, std::max(hedgeMinDelay, hedgeLatencies.percentile(0.95)));
+}
+
+void MHUrlSchemeHandler::processHedgedRequest(QWebEngineUrlRequestJob *job, MainWindow *win, const QUrl &url, const QString &host, const QString &ip, bool isCacheable, bool hasCached) {
+    const QString textUrl = url.toString();
+    HedgedRequest *hedged = new HedgedRequest(*m_manager, [win, textUrl](const std::set<QString> &excludes) {
+        return win->getServerIp(textUrl, excludes);
+    }, [this, url, host, isCacheable](const QString &ip) {
+        return makeRequest(url, host, ip, isCacheable);
+    }, hedgeDelay(), hedgeMaxRequests, job);
+    CHECK(connect(hedged, &HedgedRequest::winnerSelected, [this, win, textUrl](QString ip, milliseconds latency) {
+    BEGIN_SLOT_WRAPPER
+        hedgeLatencies.add(latency);
+        win->setServerIpPreferred(textUrl, ip);
+    END_SLOT_WRAPPER
+    }), "not connect winnerSelected");
+    CHECK(connect(hedged, &HedgedRequest::started, [this, hedged](QNetworkReply *reply) {
+    BEGIN_SLOT_WRAPPER
+        tryStartStreaming(qobject_cast<QWebEngineUrlRequestJob *>(hedged->parent()), reply);
+    END_SLOT_WRAPPER
+    }), "not connect started");
+    CHECK(connect(hedged, &HedgedRequest::finished, this, &MHUrlSchemeHandler::onHedgedFinished), "not connect finished");
+    hedged->start(ip);
+
+    if (hasCached) {
+        serveStaleLater(job, hedged, textUrl, [hedged]() {
+            return hedged->isDone() || hedged->hasWinner();
+        });
+    }
+}
+
 void MHUrlSchemeHandler::processRequest(QWebEngineUrlRequestJob *job, MainWindow *win, const QUrl &url, const QString &host, const std::set<QString> &excludesIps) {
     CHECK(win, "mainwin cast");
     const QString ip = win->getServerIp(url.toString(), excludesIps);
@@ -129,14 +280,21 @@ void MHUrlSchemeHandler::processRequest(QWebEngineUrlRequestJob *job, MainWindow
         job->fail(QWebEngineUrlRequestJob::UrlNotFound);
         return;
     }
-    QUrl newurl(url);
-    newurl.setScheme(QStringLiteral("http"));
-    newurl.setHost(ip);
     if (isLog) {
-        LOG << "MHUrlSchemeHandler: " << url.toString() << " " << ip << " " << host << " " << newurl.toString();
+        LOG << "MHUrlSchemeHandler: " << url.toString() << " " << ip << " " << host;
         isLog = false;
     }
-    QNetworkRequest req(newurl);
+
+    const bool isCacheable = cache != nullptr && job->requestMethod() == "GET";
+    MhContentCache::Entry entry;
+    const bool hasCached = isCacheable && cache->findMeta(url.toString(), entry);
+
+    if (hedgeMaxRequests > 1 && !isFirstRun) {
+        processHedgedRequest(job, win, url, host, ip, isCacheable, hasCached);
+        return;
+    }
+
+    QNetworkRequest req = makeRequest(url, host, ip, isCacheable);
     unsigned long reqId = 0;
     if (isFirstRun) {
         reqId = requestId++;
@@ -146,13 +304,36 @@ void MHUrlSchemeHandler::processRequest(QWebEngineUrlRequestJob *job, MainWindow
         addBeginTime(req, time);
         addTimeout(req, 5s);
     }
-    req.setRawHeader(QByteArray("Host"), host.toUtf8());
+
     QNetworkReply *reply = m_manager->get(req);
+    // Ограничиваем буфер сразу, чтобы до начала отдачи в job reply не вычитал тело в память
+    reply->setReadBufferSize(StreamingReplyDevice::READ_BUFFER_SIZE);
     reply->setParent(job);
     CHECK(connect(reply, &QNetworkReply::finished, this, &MHUrlSchemeHandler::onRequestFinished), "connect finished fail");
+    CHECK(connect(reply, &QNetworkReply::metaDataChanged, [this, reply]() {
+    BEGIN_SLOT_WRAPPER
+        tryStartStreaming(qobject_cast<QWebEngineUrlRequestJob *>(reply->parent()), reply);
+    END_SLOT_WRAPPER
+    }), "connect metaDataChanged fail");
+    if (hasCached) {
+        serveStaleLater(job, reply, url.toString(), [reply]() {
+            return reply->isFinished() || isStreamed(*reply);
+        });
+    }
     if (isFirstRun) {
-        CHECK(connect(reply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::error), [this, job, win, url, host, ip, excludesIps](QNetworkReply::NetworkError err) {
+        CHECK(connect(reply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::error), [this, reply, job, win, url, host, ip, excludesIps](QNetworkReply::NetworkError err) {
         BEGIN_SLOT_WRAPPER
+            if (reply->parent() != job) {
+                return;
+            }
+            if (isStreamed(*reply)) {
+                // Job уже получил устройство, повторный reply в тот же job недопустим
+                StreamingReplyDevice *device = job->findChild<StreamingReplyDevice*>(QString(), Qt::FindDirectChildrenOnly);
+                if (device != nullptr) {
+                    device->fail(reply->errorString());
+                }
+                return;
+            }
             LOG << "Error request MHUrlSchemeHandler " << ip;
             std::set<QString> copyExcludes = excludesIps;
             copyExcludes.insert(ip);
@@ -176,9 +357,48 @@ void MHUrlSchemeHandler::requestStarted(QWebEngineUrlRequestJob *job) {
     const QString host = url.host();
 
     MainWindow *win = qobject_cast<MainWindow *>(parent());
+    if (cache != nullptr && job->requestMethod() == "GET") {
+        MhContentCache::Entry entry;
+        if (cache->findMeta(url.toString(), entry) && entry.isFresh(::system_now())) {
+            QPointer<QWebEngineUrlRequestJob> jobPtr(job);
+            loadFromCache(url.toString(), [this, jobPtr, win, url, host](bool isFound, const QByteArray &mime, const QByteArray &body) {
+                if (jobPtr.isNull()) {
+                    return;
+                }
+                if (isFound) {
+                    replyFromCache(jobPtr, mime, body);
+                } else {
+                    processRequest(jobPtr, win, url, host, {});
+                }
+            });
+            return;
+        }
+    }
+
     processRequest(job, win, url, host, {});
 }
 
+void MHUrlSchemeHandler::replyFromCache(QWebEngineUrlRequestJob *job, const QByteArray &mime, const QByteArray &body) {
+    QBuffer *buffer = new QBuffer(job);
+    buffer->setData(body);
+    buffer->open(QIODevice::ReadOnly);
+    job->reply(mime, buffer);
+}
+
+void MHUrlSchemeHandler::replyFromCacheOrFail(QWebEngineUrlRequestJob *job, const QString &cacheUrl) {
+    QPointer<QWebEngineUrlRequestJob> jobPtr(job);
+    loadFromCache(cacheUrl, [this, jobPtr](bool isFound, const QByteArray &mime, const QByteArray &body) {
+        if (jobPtr.isNull()) {
+            return;
+        }
+        if (!isFound) {
+            jobPtr->fail(QWebEngineUrlRequestJob::UrlNotFound);
+            return;
+        }
+        replyFromCache(jobPtr, mime, body);
+    });
+}
+
 void MHUrlSchemeHandler::onRequestFinished() {
 BEGIN_SLOT_WRAPPER
     QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
@@ -192,24 +412,90 @@ BEGIN_SLOT_WRAPPER
     }
 
     QWebEngineUrlRequestJob *job = qobject_cast<QWebEngineUrlRequestJob *>(reply->parent());
+    processFinishedReply(job, reply);
+END_SLOT_WRAPPER
+}
+
+void MHUrlSchemeHandler::onHedgedFinished(QNetworkReply *reply) {
+BEGIN_SLOT_WRAPPER
+    HedgedRequest *hedged = qobject_cast<HedgedRequest *>(sender());
+    CHECK(hedged, "hedged request cast");
+    QWebEngineUrlRequestJob *job = qobject_cast<QWebEngineUrlRequestJob *>(hedged->parent());
+    reply->setParent(hedged->parent());
+    hedged->deleteLater();
+    processFinishedReply(job, reply);
+END_SLOT_WRAPPER
+}
+
+bool MHUrlSchemeHandler::tryStartStreaming(QWebEngineUrlRequestJob *job, QNetworkReply *reply) {
+    if (job == nullptr || isStreamed(*reply) || reply->error() != QNetworkReply::NoError) {
+        return false;
+    }
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
+        return false;
+    }
+    reply->setProperty(STREAMED_PROPERTY, true);
+    if (isRequestId(*reply)) {
+        // Таймаут первого запуска ограничивает ожидание заголовков, а не загрузку всего тела
+        removeOnRequestId(getRequestId(*reply));
+    }
+
+    StreamingReplyDevice *device = new StreamingReplyDevice(reply, job);
+    if (cache != nullptr && isCacheUrl(*reply)) {
+        device->setCaptureFile(cache->makeCapturePath(), cache->getMaxEntrySize());
+        CHECK(connect(device, &StreamingReplyDevice::captureCompleted, [this, device, reply, cacheUrl=getCacheUrl(*reply)]() {
+        BEGIN_SLOT_WRAPPER
+            cache->storeFile(cacheUrl, *reply, device->takeCaptured());
+        END_SLOT_WRAPPER
+        }), "connect captureCompleted fail");
+    }
+    job->reply(getMime(*reply), device);
+    return true;
+}
+
+void MHUrlSchemeHandler::processFinishedReply(QWebEngineUrlRequestJob *job, QNetworkReply *reply) {
+    if (isStreamed(*reply)) {
+        return;
+    }
+    const bool isCacheable = cache != nullptr && isCacheUrl(*reply);
     if (!job) {
+        if (isCacheable) {
+            // Фоновая ревалидация после отдачи устаревшей копии
+            if (!reply->error() && !cache->processNotModified(getCacheUrl(*reply), *reply)) {
+                MhContentCache::Entry entry;
+                cache->processReply(getCacheUrl(*reply), *reply, entry);
+            }
+            reply->deleteLater();
+        }
         return;
     }
     if (reply->error()) {
         if (isIgnoreError(*reply) && getIgnoreError(*reply)) {
             return;
         }
+        const QVariant status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+        MhContentCache::Entry entry;
+        if (isCacheable && (!status.isValid() || status.toInt() >= 500) && cache->findMeta(getCacheUrl(*reply), entry)) {
+            LOG << "Serve stale after error " << entry.url;
+            replyFromCacheOrFail(job, entry.url);
+            return;
+        }
         job->fail(QWebEngineUrlRequestJob::UrlNotFound);
         return;
     }
 
-    QVariant contentMimeType = reply->header(QNetworkRequest::ContentTypeHeader);
-    QByteArray mime = contentMimeType.toByteArray();
-    const int pos = mime.indexOf(';');
-    if (pos != -1) {
-        mime = mime.left(pos);
+    if (isCacheable) {
+        const QString cacheUrl = getCacheUrl(*reply);
+        if (cache->processNotModified(cacheUrl, *reply)) {
+            replyFromCacheOrFail(job, cacheUrl);
+            return;
+        }
+        MhContentCache::Entry entry;
+        if (cache->processReply(cacheUrl, *reply, entry)) {
+            replyFromCache(job, entry.mime, entry.body);
+            return;
+        }
     }
 
-    job->reply(mime, reply);
-END_SLOT_WRAPPER
+    job->reply(getMime(*reply), reply);
 }
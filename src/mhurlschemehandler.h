@@ -4,36 +4,80 @@
 #include <set>
 #include <unordered_map>
 #include <atomic>
+#include <memory>
+#include <functional>
 
 #include <QTimer>
 #include <QWebEngineUrlSchemeHandler>
 
+#include "duration.h"
+#include "HedgedRequest.h"
+
 class QNetworkAccessManager;
 class QWebEngineUrlRequestJob;
 class MainWindow;
 class QNetworkReply;
+class QNetworkRequest;
+class MhContentCache;
 
 class MHUrlSchemeHandler : public QWebEngineUrlSchemeHandler {
+    Q_OBJECT
+public:
+
+    using Callback = std::function<void()>;
+
+    using CacheBodyCallback = std::function<void(bool isFound, const QByteArray &mime, const QByteArray &body)>;
+
 public:
     explicit MHUrlSchemeHandler(QObject *parent = nullptr);
 
+    ~MHUrlSchemeHandler() override;
+
     void requestStarted(QWebEngineUrlRequestJob *job) override;
 
     void setLog();
 
     void setFirstRun();
 
+signals:
+
+    void callbackCall(MHUrlSchemeHandler::Callback callback);
+
 private slots:
+
+    void onCallbackCall(MHUrlSchemeHandler::Callback callback);
+
     void onRequestFinished();
 
     void onTimerEvent();
 
+    void onHedgedFinished(QNetworkReply *reply);
+
 private:
 
     void processRequest(QWebEngineUrlRequestJob *job, MainWindow *win, const QUrl &url, const QString &host, const std::set<QString> &excludesIps);
 
     void removeOnRequestId(const std::string &requestId);
 
+    void replyFromCache(QWebEngineUrlRequestJob *job, const QByteArray &mime, const QByteArray &body);
+
+    // The body is read in the cache thread, the callback is called in the handler thread
+    void loadFromCache(const QString &cacheUrl, const CacheBodyCallback &callback);
+
+    void replyFromCacheOrFail(QWebEngineUrlRequestJob *job, const QString &cacheUrl);
+
+    QNetworkRequest makeRequest(const QUrl &url, const QString &host, const QString &ip, bool isCacheable) const;
+
+    void serveStaleLater(QWebEngineUrlRequestJob *job, QObject *request, const QString &cacheUrl, const std::function<bool()> &isAnswered);
+
+    void processHedgedRequest(QWebEngineUrlRequestJob *job, MainWindow *win, const QUrl &url, const QString &host, const QString &ip, bool isCacheable, bool hasCached);
+
+    milliseconds hedgeDelay() const;
+
+    void processFinishedReply(QWebEngineUrlRequestJob *job, QNetworkReply *reply);
+
+    bool tryStartStreaming(QWebEngineUrlRequestJob *job, QNetworkReply *reply);
+
 private:
     QNetworkAccessManager *m_manager;
 
@@ -47,6 +91,17 @@ private:
 
     std::atomic<size_t> requestId{0};
 
+    std::unique_ptr<MhContentCache> cache;
+
+    milliseconds staleTimeout;
+
+    size_t hedgeMaxRequests = 1;
+    milliseconds hedgeInitialDelay;
+    milliseconds hedgeMinDelay;
+    milliseconds hedgeMaxDelay;
+
+    LatencyTracker hedgeLatencies;
+
 };
 
 #endif // MHURLSCHEMEHANDLER_H
@@ -39,6 +39,7 @@ SOURCES += main.cpp mainwindow.cpp \
     utils.cpp \
     ethtx/utils2.cpp \
     NsLookup.cpp \
+    NsLookupCache.cpp \
     dns/datatransformer.cpp \
     dns/dnspacket.cpp \
     dns/resourcerecord.cpp \
@@ -46,6 +47,11 @@ SOURCES += main.cpp mainwindow.cpp \
     JavascriptWrapper.cpp \
     PagesMappings.cpp \
     mhurlschemehandler.cpp \
+    MhContentCache.cpp \
+    HedgedRequest.cpp \
+    StreamingReplyDevice.cpp \
+    FileDownloader.cpp \
+    HtmlDeltaUpdate.cpp \
     Paths.cpp \
     BigNumber.cpp \
     RunGuard.cpp \
@@ -62,8 +68,11 @@ SOURCES += main.cpp mainwindow.cpp \
     transactions/Transactions.cpp \
     transactions/TransactionsMessages.cpp \
     transactions/TransactionsDBStorage.cpp \
+    transactions/ForkPointSearch.cpp \
+    transactions/TransactionsSubscription.cpp \
     transactions/TransactionsJavascript.cpp \
     HttpClient.cpp \
+    HttpCompression.cpp \
     proxy/UPnPDevices.cpp \
     proxy/UPnPRouter.cpp \
     proxy/ProxyServer.cpp \
@@ -91,7 +100,8 @@ SOURCES += main.cpp mainwindow.cpp \
     UdpSocketClient.cpp \
     MhPayEventHandler.cpp \
     WalletNames/WalletNamesDbStorage.cpp \
-    WalletNames/WalletNames.cpp
+    WalletNames/WalletNames.cpp \
+    JsDeliveryQueue.cpp
 
 unix: SOURCES += machine_uid_unix.cpp
 SOURCES +=  proxy/http_parser.c
@@ -129,6 +139,7 @@ HEADERS += mainwindow.h \
     utils.h \
     ethtx/utils2.h \
     NsLookup.h \
+    NsLookupCache.h \
     dns/datatransformer.h \
     dns/dnspacket.h \
     dns/resourcerecord.h \
@@ -138,6 +149,11 @@ HEADERS += mainwindow.h \
     PagesMappings.h \
     SlotWrapper.h \
     mhurlschemehandler.h \
+    MhContentCache.h \
+    HedgedRequest.h \
+    StreamingReplyDevice.h \
+    FileDownloader.h \
+    HtmlDeltaUpdate.h \
     Paths.h \
     BigNumber.h \
     RunGuard.h \
@@ -156,8 +172,11 @@ HEADERS += mainwindow.h \
     transactions/TransactionsMessages.h \
     transactions/Transaction.h \
     transactions/TransactionsDBStorage.h \
+    transactions/ForkPointSearch.h \
+    transactions/TransactionsSubscription.h \
     transactions/TransactionsJavascript.h \
     HttpClient.h \
+    HttpCompression.h \
     duration.h \
     proxy/UPnPDevices.h \
     proxy/UPnPRouter.h \
@@ -189,7 +208,8 @@ HEADERS += mainwindow.h \
     WalletNames/WalletNamesDbStorage.h \
     WalletNames/WalletNamesDbRes.h \
     WalletNames/WalletInfo.h \
-    WalletNames/WalletNames.h
+    WalletNames/WalletNames.h \
+    JsDeliveryQueue.h
 
 FORMS += mainwindow.ui
 
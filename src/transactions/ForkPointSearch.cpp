@@ -0,0 +1,92 @@
+#include "ForkPointSearch.h"
+
+#include <algorithm>
+
+#include "check.h"
+#include "Log.h"
+
+SET_LOG_NAMESPACE("TXS");
+
+namespace transactions {
+
+struct ForkPointSearch::State {
+    std::vector<BlockCheckpoint> checkpoints;
+    size_t countCandidates = 0;
+    GetBlockHash getBlockHash;
+    Callback callback;
+
+    // Индексы на 1 больше, 0 - ни один checkpoint не совпал
+    size_t low = 0;
+    size_t high = 0;
+
+    Result result;
+};
+
+void ForkPointSearch::start(const std::vector<BlockCheckpoint> &checkpoints, int64_t serverBlockNumber, const GetBlockHash &getBlockHash, const Callback &callback) {
+    std::shared_ptr<State> state = std::make_shared<State>();
+    state->checkpoints = checkpoints;
+    state->getBlockHash = getBlockHash;
+    state->callback = callback;
+
+    CHECK(std::is_sorted(checkpoints.begin(), checkpoints.end(), [](const BlockCheckpoint &first, const BlockCheckpoint &second) {
+        return first.blockNumber < second.blockNumber;
+    }), "Checkpoints not sorted");
+    // Блоков выше высоты сервера в его цепочке нет
+    while (state->countCandidates < checkpoints.size() && checkpoints[state->countCandidates].blockNumber <= serverBlockNumber) {
+        state->countCandidates++;
+    }
+
+    state->low = 0;
+    state->high = state->countCandidates + 1;
+    if (state->countCandidates == 0) {
+        finish(state);
+        return;
+    }
+    probe(state, state->countCandidates - 1);
+}
+
+void ForkPointSearch::probe(const std::shared_ptr<State> &state, size_t index) {
+    const BlockCheckpoint &checkpoint = state->checkpoints[index];
+    state->result.countRequests++;
+    const QString expectedHash = checkpoint.blockHash;
+    const int64_t blockNumber = checkpoint.blockNumber;
+    state->getBlockHash(blockNumber, [state, index, expectedHash, blockNumber](const QString &hash, const TypedException &exception) {
+        if (exception.isSet()) {
+            LOG << "Fork point search stopped: block " << blockNumber << " not received: " << exception.description;
+            state->result.isFailed = true;
+            state->callback(state->result);
+            return;
+        }
+        onProbed(state, index, hash == expectedHash);
+    });
+}
+
+void ForkPointSearch::onProbed(const std::shared_ptr<State> &state, size_t index, bool isEqual) {
+    if (isEqual) {
+        state->low = index + 1;
+    } else {
+        state->high = index + 1;
+    }
+
+    if (state->high - state->low <= 1) {
+        finish(state);
+        return;
+    }
+    const size_t middle = state->low + (state->high - state->low) / 2;
+    probe(state, middle - 1);
+}
+
+void ForkPointSearch::finish(const std::shared_ptr<State> &state) {
+    Result &result = state->result;
+    if (state->low != 0) {
+        result.isFound = true;
+        result.forkPoint = state->checkpoints[state->low - 1];
+        result.isLast = state->low == state->checkpoints.size();
+    }
+    if (!result.isLast) {
+        LOG << "Fork point " << (result.isFound ? QString::number(result.forkPoint.blockNumber) : QString("not found")) << ", checkpoints " << state->checkpoints.size() << ", requests " << result.countRequests;
+    }
+    state->callback(result);
+}
+
+}
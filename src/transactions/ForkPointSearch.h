@@ -0,0 +1,58 @@
+#ifndef FORKPOINTSEARCH_H
+#define FORKPOINTSEARCH_H
+
+#include <QString>
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "Transaction.h"
+#include "TypedException.h"
+
+namespace transactions {
+
+/*
+   Поиск последнего checkpoint-а адреса, который остался в цепочке сервера после реорганизации.
+   Совпадающие checkpoint-ы образуют префикс списка, поэтому хэши блоков запрашиваются бинарным поиском.
+   Первым проверяется самый новый checkpoint, без реорганизации это единственный запрос.
+   */
+class ForkPointSearch {
+public:
+
+    struct Result {
+        bool isFound = false;
+        // Совпал самый новый checkpoint, откатывать нечего
+        bool isLast = false;
+        BlockCheckpoint forkPoint;
+        size_t countRequests = 0;
+        // Хэш блока не получен, точка расхождения неизвестна и откатывать ничего нельзя
+        bool isFailed = false;
+    };
+
+    using BlockHashCallback = std::function<void(const QString &hash, const TypedException &exception)>;
+
+    using GetBlockHash = std::function<void(int64_t blockNumber, const BlockHashCallback &callback)>;
+
+    using Callback = std::function<void(const Result &result)>;
+
+public:
+
+    // checkpoints упорядочены по возрастанию номера блока
+    static void start(const std::vector<BlockCheckpoint> &checkpoints, int64_t serverBlockNumber, const GetBlockHash &getBlockHash, const Callback &callback);
+
+private:
+
+    struct State;
+
+    static void probe(const std::shared_ptr<State> &state, size_t index);
+
+    static void onProbed(const std::shared_ptr<State> &state, size_t index, bool isEqual);
+
+    static void finish(const std::shared_ptr<State> &state);
+
+};
+
+}
+
+#endif // FORKPOINTSEARCH_H
@@ -94,6 +94,22 @@ struct BlockInfo {
     int64_t number;
 };
 
+struct BlockCheckpoint {
+    QString address;
+    QString currency;
+    int64_t blockNumber = 0;
+    QString blockHash;
+
+    BlockCheckpoint(const QString &address, const QString &currency, int64_t blockNumber, const QString &blockHash)
+        : address(address)
+        , currency(currency)
+        , blockNumber(blockNumber)
+        , blockHash(blockHash)
+    {}
+
+    BlockCheckpoint() = default;
+};
+
 struct SendParameters {
     size_t countServersSend;
     size_t countServersGet;
@@ -15,8 +15,10 @@ using namespace std::placeholders;
 #include "TransactionsMessages.h"
 #include "TransactionsJavascript.h"
 #include "TransactionsDBStorage.h"
+#include "TransactionsSubscription.h"
 
 #include <memory>
+#include <algorithm>
 
 SET_LOG_NAMESPACE("TXS");
 
@@ -25,8 +27,16 @@ namespace transactions {
 static const uint64_t ADD_TO_COUNT_TXS = 10;
 
 Transactions::Transactions(NsLookup &nsLookup, TransactionsJavascript &javascriptWrapper, TransactionsDBStorage &db, QObject *parent)
+    : Transactions([&nsLookup](const QString &type, size_t limit, size_t count) {
+        return nsLookup.getRandom(type, limit, count);
+    }, getSettingsPath(), javascriptWrapper, db, parent)
+{
+    this->nsLookup = &nsLookup;
+}
+
+Transactions::Transactions(const GetServersFunc &getServers, const QString &settingsPath, TransactionsJavascript &javascriptWrapper, TransactionsDBStorage &db, QObject *parent)
     : TimerClass(5s, parent)
-    , nsLookup(nsLookup)
+    , getServers(getServers)
     , javascriptWrapper(javascriptWrapper)
     , db(db)
 {
@@ -71,14 +81,20 @@ Transactions::Transactions(NsLookup &nsLookup, TransactionsJavascript &javascrip
 
     Q_REG(std::vector<AddressInfo>, "std::vector<AddressInfo>");
 
-    QSettings settings(getSettingsPath(), QSettings::IniFormat);
+    QSettings settings(settingsPath, QSettings::IniFormat);
     CHECK(settings.contains("timeouts_sec/transactions"), "settings timeout not found");
     timeout = seconds(settings.value("timeouts_sec/transactions").toInt());
+    qtimer.setInterval(settings.value("transactions/poll_period_ms", 5000).toInt());
+    pollAddresses = settings.value("transactions/poll_addresses", 20).toUInt();
+    CHECK(pollAddresses > 0, "Incorrect transactions/poll_addresses");
 
     client.setParent(this);
     CHECK(connect(&client, &SimpleClient::callbackCall, this, &Transactions::callbackCall), "not connect callbackCall");
     client.moveToThread(&thread1);
 
+    tcpClient.setIdleTimeout(seconds(settings.value("http_client/idle_timeout_sec", 30).toInt()));
+    tcpClient.setMaxConnectionsPerHost(settings.value("http_client/max_connections_per_host", 4).toUInt());
+    tcpClient.setPipelining(settings.value("http_client/pipelining", false).toBool());
     CHECK(connect(&tcpClient, &HttpSimpleClient::callbackCall, this, &Transactions::callbackCall), "not connect callbackCall");
     tcpClient.moveToThread(&thread1);
 
@@ -87,11 +103,27 @@ Transactions::Transactions(NsLookup &nsLookup, TransactionsJavascript &javascrip
     CHECK(connect(&timerSendTx, &QTimer::timeout, this, &Transactions::onFindTxOnTorrentEvent), "not connect onFindTxOnTorrentEvent");
     CHECK(connect(&thread1, &QThread::finished, &timerSendTx, &QTimer::stop), "not connect stop");
 
+    const QString subscriptionUrl = settings.value("web_socket/transactions", "").toString();
+    if (!subscriptionUrl.isEmpty()) {
+        subscriptionPollPeriod = seconds(settings.value("transactions/subscription_poll_sec", 300).toInt());
+        subscription = std::make_unique<TransactionsSubscription>(subscriptionUrl);
+        subscription->setHeartbeatTimeout(seconds(settings.value("transactions/subscription_heartbeat_sec", 60).toInt()));
+        subscription->moveToThread(&thread1);
+        LOG << "Transactions subscription " << subscriptionUrl << ", poll period " << subscriptionPollPeriod.count() << " s";
+    }
+
     javascriptWrapper.setTransactions(*this);
 
     moveToThread(&thread1); // TODO вызывать в TimerClass
 }
 
+Transactions::~Transactions() {
+    // Поток останавливается раньше, чем разрушатся живущие в нем клиенты и подписка.
+    // Ждем без таймаута: terminate посреди записи в базу оставил бы ее в неизвестном состоянии
+    thread1.quit();
+    thread1.wait();
+}
+
 void Transactions::onCallbackCall(Callback callback) {
 BEGIN_SLOT_WRAPPER
     callback();
@@ -100,6 +132,9 @@ END_SLOT_WRAPPER
 
 void Transactions::onRun() {
 BEGIN_SLOT_WRAPPER
+    if (subscription != nullptr) {
+        subscription->start();
+    }
 END_SLOT_WRAPPER
 }
 
@@ -114,13 +149,14 @@ uint64_t Transactions::calcCountTxs(const QString &address, const QString &curre
     return  countReceived + countSpent;
 }
 
-void Transactions::newBalance(const QString &address, const QString &currency, uint64_t savedCountTxs, const BalanceInfo &balance, const std::vector<Transaction> &txs, const std::shared_ptr<ServersStruct> &servStruct) {
+void Transactions::newBalance(const QString &address, const QString &currency, uint64_t savedCountTxs, const BalanceInfo &balance, const std::vector<Transaction> &txs, const BlockInfo &lastBlock, const std::shared_ptr<ServersStruct> &servStruct) {
     const uint64_t currCountTxs = calcCountTxs(address, currency);
     CHECK(savedCountTxs == currCountTxs, "Trancastions in db on address " + address.toStdString() + " " + currency.toStdString() + " changed");
     auto transactionGuard = db.beginTransaction();
     for (const Transaction &tx: txs) {
         db.addPayment(tx);
     }
+    db.addCheckpoint(address, currency, lastBlock.number, lastBlock.hash);
     transactionGuard.commit();
     emit javascriptWrapper.newBalanceSig(address, currency, balance);
     updateBalanceTime(currency, servStruct);
@@ -188,7 +224,7 @@ void Transactions::processAddressMth(const QString &address, const QString &curr
                 tx.blockHash = bi.hash;
             }
         }
-        newBalance(address, currency, savedCountTxs, balance, txs, servStruct);
+        newBalance(address, currency, savedCountTxs, balance, txs, bi, servStruct);
     };
 
     const auto processNewTransactions = [this, address, currency, getBlockHeaderCallback](const BalanceInfo &balance, uint64_t savedCountTxs, const std::vector<Transaction> &txs, const QUrl &server) {
@@ -205,7 +241,7 @@ void Transactions::processAddressMth(const QString &address, const QString &curr
         CHECK(!exception.isSet(), "Server error: " + exception.toString());
         const std::vector<Transaction> txs = parseHistoryResponse(address, currency, QString::fromStdString(response));
 
-        LOG << "Txs geted2 " << address << " " << txs.size();
+        LOG_DEBUG << "Txs geted2 " << address << " " << txs.size();
         processNewTransactions(balance, savedCountTxs, txs, server);
     };
 
@@ -229,7 +265,7 @@ void Transactions::processAddressMth(const QString &address, const QString &curr
         CHECK(!exception.isSet(), "Server error: " + exception.toString());
         const std::vector<Transaction> txs = parseHistoryResponse(address, currency, QString::fromStdString(response));
 
-        LOG << "Txs geted " << address << " " << txs.size();
+        LOG_DEBUG << "Txs geted " << address << " " << txs.size();
 
         const QString requestBalance = makeGetBalanceRequest(address);
 
@@ -312,34 +348,67 @@ void Transactions::processCheckTxsOneServer(const QString &address, const QStrin
 
         const int64_t blockNumber = parseGetCountBlocksResponse(QString::fromStdString(response));
 
-        processCheckTxsInternal(address, currency, server, lastTx, blockNumber);
+        processCheckTxsInternal(address, currency, {std::make_pair(server, blockNumber)}, lastTx);
     };
 
     const QString countBlocksRequest = makeGetCountBlocksRequest();
     client.sendMessagePost(server, countBlocksRequest, std::bind(countBlocksCallback, server, _1, _2), timeout);
 }
 
-void Transactions::processCheckTxsInternal(const QString &address, const QString &currency, const QUrl &server, const Transaction &tx, int64_t serverBlockNumber) {
-    const auto removeAllTxs = [this](const QString &address, const QString &currency) {
-        LOG << "Remove txs " << address << " " << currency;
-        db.removePaymentsForDest(address, currency);
-    };
+void Transactions::requestBlockHash(const std::vector<std::pair<QUrl, int64_t>> &servers, size_t index, int64_t blockNumber, const ForkPointSearch::BlockHashCallback &callback) {
+    while (index < servers.size() && servers[index].second < blockNumber) {
+        index++;
+    }
+    if (index >= servers.size()) {
+        callback("", TypedException(TypeErrors::TRANSACTIONS_SERVER_NOT_FOUND, "No server returned block " + std::to_string(blockNumber)));
+        return;
+    }
 
-    const auto getBlockInfoCallback = [address, currency, removeAllTxs] (const QString &hash, const std::string &response, const SimpleClient::ServerException &exception) {
-        CHECK(!exception.isSet(), "Server error: " + exception.toString());
-        const BlockInfo bi = parseGetBlockInfoResponse(QString::fromStdString(response));
-        if (bi.hash != hash) {
-            removeAllTxs(address, currency);
+    const QUrl server = servers[index].first;
+    const auto getBlockInfoCallback = [this, servers, index, blockNumber, callback, server](const std::string &response, const SimpleClient::ServerException &exception) {
+        QString hash;
+        const TypedException error = apiVrapper2([&exception, &response, &hash]() {
+            CHECK(!exception.isSet(), "Server error: " + exception.toString());
+            hash = parseGetBlockInfoResponse(QString::fromStdString(response)).hash;
+        });
+        if (error.isSet()) {
+            LOG << "Get block " << blockNumber << " from " << server.toString() << " failed. Try next server";
+            requestBlockHash(servers, index + 1, blockNumber, callback);
+            return;
         }
+        callback(hash, TypedException());
     };
+    client.sendMessagePost(server, makeGetBlockInfoRequest(blockNumber), getBlockInfoCallback, timeout);
+}
 
-    if (tx.blockNumber > serverBlockNumber) {
-        removeAllTxs(address, currency);
-        return;
+void Transactions::processCheckTxsInternal(const QString &address, const QString &currency, const std::vector<std::pair<QUrl, int64_t>> &servers, const Transaction &tx) {
+    CHECK(!servers.empty(), "Servers empty");
+    const int64_t serverBlockNumber = servers.front().second;
+    std::vector<BlockCheckpoint> checkpoints = db.getCheckpoints(address, currency);
+    if (checkpoints.empty() || checkpoints.back().blockNumber < tx.blockNumber) {
+        // Транзакции, сохраненные до появления checkpoint-ов
+        checkpoints.emplace_back(address, currency, tx.blockNumber, tx.blockHash);
     }
 
-    const QString blockInfoRequest = makeGetBlockInfoRequest(tx.blockNumber);
-    client.sendMessagePost(server, blockInfoRequest, std::bind(getBlockInfoCallback, tx.blockHash, _1, _2));
+    const auto getBlockHash = [this, servers](int64_t blockNumber, const ForkPointSearch::BlockHashCallback &callback) {
+        requestBlockHash(servers, 0, blockNumber, callback);
+    };
+
+    const auto forkPointCallback = [this, address, currency](const ForkPointSearch::Result &result) {
+        if (result.isFailed) {
+            // Ничего не удаляем, проверка повторится по таймеру
+            LOG << "Fork point search " << address << " " << currency << " failed";
+        } else if (!result.isFound) {
+            LOG << "Remove txs " << address << " " << currency;
+            db.removePaymentsForDest(address, currency);
+        } else if (!result.isLast) {
+            // Транзакции после точки расхождения перезапросятся при следующей проверке баланса
+            LOG << "Rollback txs " << address << " " << currency << " after block " << result.forkPoint.blockNumber;
+            db.rollbackAfterBlock(address, currency, result.forkPoint.blockNumber);
+        }
+    };
+
+    ForkPointSearch::start(checkpoints, serverBlockNumber, getBlockHash, forkPointCallback);
 }
 
 void Transactions::processCheckTxs(const QString &address, const QString &currency, const std::vector<QString> &servers) {
@@ -355,22 +424,23 @@ void Transactions::processCheckTxs(const QString &address, const QString &curren
         CHECK(!urls.empty(), "Incorrect response size");
         CHECK(urls.size() == responses.size(), "Incorrect responses size");
 
-        int64_t maxBlockNumber = 0;
-        QUrl maxServer;
+        std::vector<std::pair<QUrl, int64_t>> servers;
         for (size_t i = 0; i < responses.size(); i++) {
             const SimpleClient::ServerException &exception = std::get<SimpleClient::ServerException>(responses[i]);
             if (!exception.isSet()) {
                 const QUrl &server = urls[i];
                 const std::string &response = std::get<std::string>(responses[i]);
                 const int64_t blockNumber = parseGetCountBlocksResponse(QString::fromStdString(response));
-                if (blockNumber > maxBlockNumber) {
-                    maxBlockNumber = blockNumber;
-                    maxServer = server;
+                if (blockNumber > 0) {
+                    servers.emplace_back(server, blockNumber);
                 }
             }
         }
-        CHECK(!maxServer.isEmpty(), "Best server with txs not found. Error: " + std::get<SimpleClient::ServerException>(responses[0]).toString());
-        processCheckTxsInternal(address, currency, maxServer, lastTx, maxBlockNumber);
+        CHECK(!servers.empty(), "Best server with txs not found. Error: " + std::get<SimpleClient::ServerException>(responses[0]).toString());
+        std::stable_sort(servers.begin(), servers.end(), [](const std::pair<QUrl, int64_t> &first, const std::pair<QUrl, int64_t> &second) {
+            return first.second > second.second;
+        });
+        processCheckTxsInternal(address, currency, servers, lastTx);
     };
 
     const QString countBlocksRequest = makeGetCountBlocksRequest();
@@ -380,37 +450,45 @@ void Transactions::processCheckTxs(const QString &address, const QString &curren
 
 void Transactions::onTimerEvent() {
 BEGIN_SLOT_WRAPPER
-    static const size_t MAXIMUM_ADDRESSES = 20;
+    const time_point now = ::now();
+
+    if (subscription != nullptr) {
+        processChangedAddresses();
+    }
 
+    bool isPollPaused = false;
     if (posInAddressInfos >= addressesInfos.size()) {
         if (!addressesInfos.empty()) {
             LOG << "All txs getted";
         }
         addressesInfos.clear();
+        // Пока подписка подтверждена и heartbeat-ы приходят, изменения приходят уведомлениями, а полный обход нужен только для сверки
+        isPollPaused = subscription != nullptr && subscription->isActive() && now - lastFullPollTime < subscriptionPollPeriod;
     }
 
-    if (addressesInfos.empty()) {
+    if (addressesInfos.empty() && !isPollPaused) {
         addressesInfos = getAddressesInfos(currentGroup);
         std::sort(addressesInfos.begin(), addressesInfos.end(), [](const AddressInfo &first, const AddressInfo &second) {
             return first.type < second.type;
         });
         posInAddressInfos = 0;
+        lastFullPollTime = now;
     }
     LOG << PeriodicLog::make("f_bln") << "Try fetch balance " << addressesInfos.size();
     std::vector<QString> servers;
     QString currentType;
     std::map<QString, std::shared_ptr<ServersStruct>> servStructs;
-    const time_point now = ::now();
     const auto checkTxsPeriod = 3min;
-    for (size_t i = posInAddressInfos; i < std::min(addressesInfos.size(), posInAddressInfos + MAXIMUM_ADDRESSES); i++) {
+    for (size_t i = posInAddressInfos; i < std::min(addressesInfos.size(), posInAddressInfos + pollAddresses); i++) {
         const AddressInfo &addr = addressesInfos[i];
         if (addr.type != currentType) {
-            servers = nsLookup.getRandom(addr.type, 3, 3);
+            servers = getServers(addr.type, 3, 3);
             if (servers.empty()) {
                 LOG << "Warn: servers empty: " << addr.type;
                 continue;
             }
             currentType = addr.type;
+            lastAddressType = addr.type;
         }
         const auto found = servStructs.find(addr.currency);
         if (found == servStructs.end()) {
@@ -426,13 +504,19 @@ BEGIN_SLOT_WRAPPER
         std::transform(pendingTxs.begin(), pendingTxs.end(), std::back_inserter(pendingTxsStrs), [](const Transaction &tx) { return tx.tx;});
         processAddressMth(addr.address, addr.currency, servers, servStructs.at(addr.currency), pendingTxsStrs);
     }
-    posInAddressInfos += MAXIMUM_ADDRESSES;
+    posInAddressInfos += pollAddresses;
 
-    if (now - lastCheckTxsTime >= checkTxsPeriod && posInAddressInfos >= addressesInfos.size()) {
+    if (!isPollPaused && now - lastCheckTxsTime >= checkTxsPeriod && posInAddressInfos >= addressesInfos.size()) {
         LOG << "All txs checked";
         lastCheckTxsTime = now;
     }
 
+    if (isPollPaused) {
+        if (!pendingTxsAfterSend.empty() && !lastAddressType.isEmpty()) {
+            servers = getServers(lastAddressType, 3, 3);
+        }
+    }
+
     processPendingsMth(servers);
 END_SLOT_WRAPPER
 }
@@ -445,7 +529,7 @@ void Transactions::fetchBalanceAddress(const QString &address) {
     });
 
     for (const AddressInfo &addr: addressInfos) {
-        const std::vector<QString> servers = nsLookup.getRandom(addr.type, 3, 3);
+        const std::vector<QString> servers = getServers(addr.type, 3, 3);
         if (servers.empty()) {
             LOG << "Warn: servers empty: " << addr.type;
             continue;
@@ -455,6 +539,56 @@ void Transactions::fetchBalanceAddress(const QString &address) {
     }
 }
 
+void Transactions::updateSubscription() {
+    if (subscription == nullptr) {
+        return;
+    }
+    std::vector<QString> addresses;
+    for (const AddressInfo &info: getAddressesInfos(currentGroup)) {
+        addresses.emplace_back(info.address);
+    }
+    subscription->setAddresses(addresses);
+}
+
+void Transactions::processChangedAddresses() {
+    static const size_t MAXIMUM_CHANGED_ADDRESSES = 100;
+
+    if (subscription->takeResyncNeeded()) {
+        LOG << "Subscription reconnected, full poll";
+        lastFullPollTime = time_point();
+    }
+
+    const std::vector<QString> changed = subscription->takeChanged(MAXIMUM_CHANGED_ADDRESSES);
+    if (changed.empty()) {
+        return;
+    }
+    LOG << "Changed addresses " << changed.size();
+    const std::set<QString> changedSet(changed.begin(), changed.end());
+    // Время обновления валюты сдвигается, только когда ответили все запросы по уведомлениям
+    std::map<QString, std::shared_ptr<ServersStruct>> servStructs;
+    for (const AddressInfo &addr: getAddressesInfos(currentGroup)) {
+        if (changedSet.find(addr.address) == changedSet.end()) {
+            continue;
+        }
+        const std::vector<QString> servers = getServers(addr.type, 3, 3);
+        if (servers.empty()) {
+            LOG << "Warn: servers empty: " << addr.type;
+            continue;
+        }
+        lastAddressType = addr.type;
+        std::shared_ptr<ServersStruct> &servStruct = servStructs[addr.currency];
+        if (servStruct == nullptr) {
+            servStruct = std::make_shared<ServersStruct>(addr.currency);
+        }
+        servStruct->countRequests++;
+        const std::vector<Transaction> pendingTxs = db.getPaymentsForAddressPending(addr.address, addr.currency, true);
+        std::vector<QString> pendingTxsStrs;
+        pendingTxsStrs.reserve(pendingTxs.size());
+        std::transform(pendingTxs.begin(), pendingTxs.end(), std::back_inserter(pendingTxsStrs), [](const Transaction &tx) { return tx.tx;});
+        processAddressMth(addr.address, addr.currency, servers, servStruct, pendingTxsStrs);
+    }
+}
+
 void Transactions::onRegisterAddresses(const std::vector<AddressInfo> &addresses, const RegisterAddressCallback &callback) {
 BEGIN_SLOT_WRAPPER
     const TypedException exception = apiVrapper2([&, this] {
@@ -463,6 +597,7 @@ BEGIN_SLOT_WRAPPER
             db.addTracked(address);
         }
         transactionGuard.commit();
+        updateSubscription();
     });
     runCallback(std::bind(callback, exception));
 END_SLOT_WRAPPER
@@ -484,7 +619,10 @@ END_SLOT_WRAPPER
 void Transactions::onSetCurrentGroup(const QString &group, const SetCurrentGroupCallback &callback) {
 BEGIN_SLOT_WRAPPER
     currentGroup = group;
-    runCallback(std::bind(callback, TypedException()));
+    const TypedException exception = apiVrapper2([&, this] {
+        updateSubscription();
+    });
+    runCallback(std::bind(callback, exception));
 END_SLOT_WRAPPER
 }
 
@@ -651,14 +789,14 @@ BEGIN_SLOT_WRAPPER
     const TypedException exception = apiVrapper2([&, this] {
         const QString request = makeSendTransactionRequest(to, value, nonce, data, fee, pubkey, sign);
         const size_t countServersSend = sendParams.countServersSend;
-        const std::vector<QString> servers = nsLookup.getRandom(sendParams.typeSend, countServersSend, countServersSend);
+        const std::vector<QString> servers = getServers(sendParams.typeSend, countServersSend, countServersSend);
         CHECK_TYPED(!servers.empty(), TypeErrors::TRANSACTIONS_SERVER_NOT_FOUND, "Not enough servers send");
         const size_t remainServersSend = countServersSend - servers.size();
         for (size_t i = 0; i < remainServersSend; i++) {
             emit javascriptWrapper.sendedTransactionsResponseSig(requestId, "", "", TypedException(TypeErrors::TRANSACTIONS_SERVER_NOT_FOUND, "dns return less laid"));
         }
 
-        const std::vector<QString> serversGet = nsLookup.getRandom(sendParams.typeGet, sendParams.countServersGet, sendParams.countServersGet); // Получаем список серверов здесь, чтобы здесь же обработать ошибки
+        const std::vector<QString> serversGet = getServers(sendParams.typeGet, sendParams.countServersGet, sendParams.countServersGet); // Получаем список серверов здесь, чтобы здесь же обработать ошибки
         CHECK_TYPED(!serversGet.empty(), TypeErrors::TRANSACTIONS_SERVER_NOT_FOUND, "Not enough servers get");
 
         for (const QString &server: servers) {
@@ -679,7 +817,7 @@ END_SLOT_WRAPPER
 
 void Transactions::onGetNonce(const QString &requestId, const QString &from, const SendParameters &sendParams, const GetNonceCallback &callback) {
 BEGIN_SLOT_WRAPPER
-    const std::vector<QString> servers = nsLookup.getRandom(sendParams.typeGet, sendParams.countServersGet, sendParams.countServersGet);
+    const std::vector<QString> servers = getServers(sendParams.typeGet, sendParams.countServersGet, sendParams.countServersGet);
     CHECK(!servers.empty(), "Not enough servers");
 
     struct NonceStruct {
@@ -729,7 +867,7 @@ BEGIN_SLOT_WRAPPER
     const TypedException exception = apiVrapper2([&, this] {
         const QString message = makeGetTxRequest(txHash);
 
-        const std::vector<QString> servers = nsLookup.getRandom(type, 1, 1);
+        const std::vector<QString> servers = getServers(type, 1, 1);
         CHECK(!servers.empty(), "Not enough servers");
         const QString &server = servers[0];
 
@@ -765,7 +903,9 @@ void Transactions::onClearDb(const QString &currency, const ClearDbCallback &cal
 BEGIN_SLOT_WRAPPER
     const TypedException exception = apiVrapper2([&, this] {
         db.removePaymentsForCurrency(currency);
-        nsLookup.resetFile();
+        if (nsLookup != nullptr) {
+            nsLookup->resetFile();
+        }
     });
     runCallback(std::bind(callback, exception));
 END_SLOT_WRAPPER
@@ -8,6 +8,7 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <memory>
 
 #include "client.h"
 #include "HttpClient.h"
@@ -16,6 +17,7 @@
 #include "CallbackWrapper.h"
 
 #include "Transaction.h"
+#include "ForkPointSearch.h"
 
 class NsLookup;
 struct TypedException;
@@ -26,6 +28,7 @@ namespace transactions {
 
 class TransactionsJavascript;
 class TransactionsDBStorage;
+class TransactionsSubscription;
 enum class DelegateStatus;
 
 class Transactions : public TimerClass {
@@ -139,10 +142,17 @@ public:
 
     using Callback = std::function<void()>;
 
+    using GetServersFunc = std::function<std::vector<QString>(const QString &type, size_t limit, size_t count)>;
+
 public:
 
     explicit Transactions(NsLookup &nsLookup, TransactionsJavascript &javascriptWrapper, TransactionsDBStorage &db, QObject *parent = nullptr);
 
+    // Сервера берутся из getServers, настройки из settingsPath. Нужен для прогона на локальных нодах без NsLookup
+    Transactions(const GetServersFunc &getServers, const QString &settingsPath, TransactionsJavascript &javascriptWrapper, TransactionsDBStorage &db, QObject *parent = nullptr);
+
+    ~Transactions();
+
 signals:
 
     void callbackCall(Transactions::Callback callback);
@@ -227,7 +237,11 @@ private:
 
     void processCheckTxsOneServer(const QString &address, const QString &currency, const QUrl &server);
 
-    void processCheckTxsInternal(const QString &address, const QString &currency, const QUrl &server, const Transaction &tx, int64_t serverBlockNumber);
+    // servers - сервера с их высотой, лучший первым
+    void processCheckTxsInternal(const QString &address, const QString &currency, const std::vector<std::pair<QUrl, int64_t>> &servers, const Transaction &tx);
+
+    // При ошибке запрашивает блок у следующего сервера, у которого он уже есть
+    void requestBlockHash(const std::vector<std::pair<QUrl, int64_t>> &servers, size_t index, int64_t blockNumber, const ForkPointSearch::BlockHashCallback &callback);
 
     void processAddressMth(const QString &address, const QString &currency, const std::vector<QString> &servers, const std::shared_ptr<ServersStruct> &servStruct, const std::vector<QString> &pendingTxs);
 
@@ -235,7 +249,7 @@ private:
 
     uint64_t calcCountTxs(const QString &address, const QString &currency) const;
 
-    void newBalance(const QString &address, const QString &currency, uint64_t savedCountTxs, const BalanceInfo &balance, const std::vector<Transaction> &txs, const std::shared_ptr<ServersStruct> &servStruct);
+    void newBalance(const QString &address, const QString &currency, uint64_t savedCountTxs, const BalanceInfo &balance, const std::vector<Transaction> &txs, const BlockInfo &lastBlock, const std::shared_ptr<ServersStruct> &servStruct);
 
     void updateBalanceTime(const QString &currency, const std::shared_ptr<ServersStruct> &servStruct);
 
@@ -252,9 +266,15 @@ private:
 
     void fetchBalanceAddress(const QString &address);
 
+    void updateSubscription();
+
+    void processChangedAddresses();
+
 private:
 
-    NsLookup &nsLookup;
+    NsLookup *nsLookup = nullptr;
+
+    GetServersFunc getServers;
 
     TransactionsJavascript &javascriptWrapper;
 
@@ -281,6 +301,17 @@ private:
     std::vector<AddressInfo> addressesInfos;
 
     size_t posInAddressInfos;
+
+    size_t pollAddresses;
+
+    // Если задан web_socket/transactions, адреса обновляются по уведомлениям, а полный обход идет раз в subscriptionPollPeriod
+    std::unique_ptr<TransactionsSubscription> subscription;
+
+    seconds subscriptionPollPeriod;
+
+    time_point lastFullPollTime;
+
+    QString lastAddressType;
 };
 
 SendParameters parseSendParams(const QString &paramsJson);
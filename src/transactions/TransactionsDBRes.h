@@ -7,7 +7,7 @@ namespace transactions {
 
 static const QString databaseName = "payments";
 static const QString databaseFileName = "payments.db";
-static const int databaseVersion = 4;
+static const int databaseVersion = 5;
 
 static const QString createPaymentsTable = "CREATE TABLE payments ( "
                                                 "id INTEGER PRIMARY KEY NOT NULL, "
@@ -52,6 +52,17 @@ static const QString createTrackedTable = "CREATE TABLE tracked ( "
 static const QString createTrackedUniqueIndex = "CREATE UNIQUE INDEX trackedUniqueIdx ON tracked ( "
                                                     "tgroup, address, currency) ";
 
+static const QString createCheckpointsTable = "CREATE TABLE checkpoints ( "
+                                                "id INTEGER PRIMARY KEY NOT NULL, "
+                                                "address TEXT, "
+                                                "currency VARCHAR(100), "
+                                                "blockNumber INTEGER, "
+                                                "blockHash TEXT NOT NULL DEFAULT '' "
+                                                ")";
+
+static const QString createCheckpointsUniqueIndex = "CREATE UNIQUE INDEX checkpointsUniqueIdx ON checkpoints ( "
+                                                    "address ASC, currency ASC, blockNumber ASC ) ";
+
 static const QString insertPayment = "INSERT OR IGNORE INTO payments (currency, txid, address, isInput, ufrom, uto, value, ts, data, fee, nonce, isSetDelegate, isDelegate, delegateValue, delegateHash, status, type, blockNumber, blockHash, intStatus) "
                                         "VALUES (:currency, :txid, :address, :isInput, :ufrom, :uto, :value, :ts, :data, :fee, :nonce, :isSetDelegate, :isDelegate, :delegateValue, :delegateHash, :status, :type, :blockNumber, :blockHash, :intStatus)";
 
@@ -130,6 +141,35 @@ static const QString  selectTrackedForGroup = "SELECT currency, address, name, t
                                                 "WHERE tgroup = :tgroup "
                                                 "ORDER BY address ASC";
 
+static const QString insertCheckpoint = "INSERT OR REPLACE INTO checkpoints (address, currency, blockNumber, blockHash) "
+                                            "VALUES (:address, :currency, :blockNumber, :blockHash)";
+
+static const QString selectCheckpointsForAddress = "SELECT * FROM checkpoints "
+                                                    "WHERE address = :address AND currency = :currency "
+                                                    "ORDER BY blockNumber ASC";
+
+static const QString selectOldestKeptCheckpoint = "SELECT blockNumber FROM checkpoints "
+                                                    "WHERE address = :address AND currency = :currency "
+                                                    "ORDER BY blockNumber DESC "
+                                                    "LIMIT 1 OFFSET :offset";
+
+static const QString deleteCheckpointsBeforeBlock = "DELETE FROM checkpoints "
+                                                    "WHERE address = :address AND currency = :currency "
+                                                    "AND blockNumber < :blockNumber";
+
+static const QString deleteCheckpointsAfterBlock = "DELETE FROM checkpoints "
+                                                    "WHERE address = :address AND currency = :currency "
+                                                    "AND blockNumber > :blockNumber";
+
+static const QString deletePaymentsAfterBlock = "DELETE FROM payments "
+                                                "WHERE address = :address AND currency = :currency "
+                                                "AND blockNumber > :blockNumber";
+
+static const QString deleteCheckpointsForAddress = "DELETE FROM checkpoints "
+                                                    "WHERE address = :address AND  currency = :currency";
+
+static const QString removeCheckpointsForCurrencyQuery = "DELETE FROM checkpoints %1";
+
 static const QString removePaymentsForCurrencyQuery = "DELETE FROM payments %1";
 
 static const QString removeTrackedForCurrencyQuery = "DELETE FROM tracked %1";
@@ -11,8 +11,8 @@ SET_LOG_NAMESPACE("TXS");
 
 namespace transactions {
 
-TransactionsDBStorage::TransactionsDBStorage(const QString &path)
-    : DBStorage(path, databaseName)
+TransactionsDBStorage::TransactionsDBStorage(const QString &path, const TuningProfile &profile)
+    : DBStorage(path, databaseName, profile)
 {
 
 }
@@ -28,29 +28,28 @@ void TransactionsDBStorage::addPayment(const QString &currency, const QString &t
                                        bool isSetDelegate, bool isDelegate, const QString &delegateValue, const QString &delegateHash,
                                        Transaction::Status status, Transaction::Type type, qint64 blockNumber, const QString &blockHash, int intStatus)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(insertPayment), query.lastError().text().toStdString());
-    query.bindValue(":currency", currency);
-    query.bindValue(":txid", txid);
-    query.bindValue(":address", address);
-    query.bindValue(":isInput", isInput);
-    query.bindValue(":ufrom", ufrom);
-    query.bindValue(":uto", uto);
-    query.bindValue(":value", value);
-    query.bindValue(":ts", ts);
-    query.bindValue(":data", data);
-    query.bindValue(":fee", fee);
-    query.bindValue(":nonce", nonce);
-    query.bindValue(":isSetDelegate", isSetDelegate);
-    query.bindValue(":isDelegate", isDelegate);
-    query.bindValue(":delegateValue", delegateValue);
-    query.bindValue(":delegateHash", delegateHash);
-    query.bindValue(":status", status);
-    query.bindValue(":type", type);
-    query.bindValue(":blockNumber", blockNumber);
-    query.bindValue(":blockHash", blockHash);
-    query.bindValue(":intStatus", intStatus);
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    CachedQuery query = cachedQuery(insertPayment);
+    query->bindValue(":currency", currency);
+    query->bindValue(":txid", txid);
+    query->bindValue(":address", address);
+    query->bindValue(":isInput", isInput);
+    query->bindValue(":ufrom", ufrom);
+    query->bindValue(":uto", uto);
+    query->bindValue(":value", value);
+    query->bindValue(":ts", ts);
+    query->bindValue(":data", data);
+    query->bindValue(":fee", fee);
+    query->bindValue(":nonce", nonce);
+    query->bindValue(":isSetDelegate", isSetDelegate);
+    query->bindValue(":isDelegate", isDelegate);
+    query->bindValue(":delegateValue", delegateValue);
+    query->bindValue(":delegateHash", delegateHash);
+    query->bindValue(":status", status);
+    query->bindValue(":type", type);
+    query->bindValue(":blockNumber", blockNumber);
+    query->bindValue(":blockHash", blockHash);
+    query->bindValue(":intStatus", intStatus);
+    CHECK(query->exec(), query->lastError().text().toStdString());
 
 }
 
@@ -76,15 +75,14 @@ std::vector<Transaction> TransactionsDBStorage::getPaymentsForAddress(const QStr
                                                                       qint64 offset, qint64 count, bool asc)
 {
     std::vector<Transaction> res;
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectPaymentsForDest.arg(asc ? QStringLiteral("ASC") : QStringLiteral("DESC"))),
-          query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    query.bindValue(":offset", offset);
-    query.bindValue(":count", count);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    createPaymentsList(query, res);
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectPaymentsForDest.arg(asc ? QStringLiteral("ASC") : QStringLiteral("DESC")));
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    query->bindValue(":offset", offset);
+    query->bindValue(":count", count);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    createPaymentsList(*query, res);
     return res;
 }
 
@@ -92,54 +90,51 @@ std::vector<Transaction> TransactionsDBStorage::getPaymentsForCurrency(const QSt
                                                                        qint64 offset, qint64 count, bool asc) const
 {
     std::vector<Transaction> res;
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectPaymentsForCurrency.arg(asc ? QStringLiteral("ASC") : QStringLiteral("DESC"))),
-          query.lastError().text().toStdString());
-    query.bindValue(":currency", currency);
-    query.bindValue(":offset", offset);
-    query.bindValue(":count", count);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    createPaymentsList(query, res);
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectPaymentsForCurrency.arg(asc ? QStringLiteral("ASC") : QStringLiteral("DESC")));
+    query->bindValue(":currency", currency);
+    query->bindValue(":offset", offset);
+    query->bindValue(":count", count);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    createPaymentsList(*query, res);
     return res;
 }
 
 std::vector<Transaction> TransactionsDBStorage::getPaymentsForAddressPending(const QString &address, const QString &currency, bool asc) const
 {
     std::vector<Transaction> res;
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectPaymentsForDestPending.arg(asc ? QStringLiteral("ASC") : QStringLiteral("DESC"))),
-          query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    createPaymentsList(query, res);
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectPaymentsForDestPending.arg(asc ? QStringLiteral("ASC") : QStringLiteral("DESC")));
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    createPaymentsList(*query, res);
     return res;
 }
 
 std::vector<transactions::Transaction> transactions::TransactionsDBStorage::getForgingPaymentsForAddress(const QString &address, const QString &currency, qint64 offset, qint64 count, bool asc)
 {
     std::vector<Transaction> res;
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectForgingPaymentsForDest.arg(asc ? QStringLiteral("ASC") : QStringLiteral("DESC")).arg(Transaction::FORGING)),
-          query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    query.bindValue(":offset", offset);
-    query.bindValue(":count", count);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    createPaymentsList(query, res);
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectForgingPaymentsForDest.arg(asc ? QStringLiteral("ASC") : QStringLiteral("DESC")).arg(Transaction::FORGING));
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    query->bindValue(":offset", offset);
+    query->bindValue(":count", count);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    createPaymentsList(*query, res);
     return res;
 }
 
 Transaction TransactionsDBStorage::getLastTransaction(const QString &address, const QString &currency) {
     Transaction trans;
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectLastTransaction), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    if (query.next()) {
-        setTransactionFromQuery(query, trans);
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectLastTransaction);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    if (query->next()) {
+        setTransactionFromQuery(*query, trans);
     }
     return trans;
 }
@@ -147,81 +142,89 @@ Transaction TransactionsDBStorage::getLastTransaction(const QString &address, co
 Transaction TransactionsDBStorage::getLastForgingTransaction(const QString &address, const QString &currency)
 {
     Transaction trans;
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectLastForgingTransaction.arg(Transaction::FORGING)), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    if (query.next()) {
-        setTransactionFromQuery(query, trans);
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectLastForgingTransaction.arg(Transaction::FORGING));
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    if (query->next()) {
+        setTransactionFromQuery(*query, trans);
     }
     return trans;
 }
 
 void TransactionsDBStorage::updatePayment(const QString &address, const QString &currency, const QString &txid, bool isInput, const Transaction &trans)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(updatePaymentForAddress), query.lastError().text().toStdString())
-            query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    query.bindValue(":txid", txid);
-    query.bindValue(":isInput", isInput);
-
-    query.bindValue(":ufrom", trans.from);
-    query.bindValue(":uto", trans.to);
-    query.bindValue(":value", trans.value);
-    query.bindValue(":ts", static_cast<qint64>(trans.timestamp));
-    query.bindValue(":data", trans.data);
-    query.bindValue(":fee", trans.fee);
-    query.bindValue(":nonce", static_cast<qint64>(trans.nonce));
-    query.bindValue(":isSetDelegate", trans.isSetDelegate);
-    query.bindValue(":isDelegate", trans.isDelegate);
-    query.bindValue(":delegateValue", trans.delegateValue);
-    query.bindValue(":delegateHash", trans.delegateHash);
-    query.bindValue(":status", trans.status);
-    query.bindValue(":type", trans.type);
-    query.bindValue(":blockNumber", static_cast<qint64>(trans.blockNumber));
-    query.bindValue(":blockHash", trans.blockHash);
-    query.bindValue(":intStatus", trans.intStatus);
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    CachedQuery query = cachedQuery(updatePaymentForAddress);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    query->bindValue(":txid", txid);
+    query->bindValue(":isInput", isInput);
+
+    query->bindValue(":ufrom", trans.from);
+    query->bindValue(":uto", trans.to);
+    query->bindValue(":value", trans.value);
+    query->bindValue(":ts", static_cast<qint64>(trans.timestamp));
+    query->bindValue(":data", trans.data);
+    query->bindValue(":fee", trans.fee);
+    query->bindValue(":nonce", static_cast<qint64>(trans.nonce));
+    query->bindValue(":isSetDelegate", trans.isSetDelegate);
+    query->bindValue(":isDelegate", trans.isDelegate);
+    query->bindValue(":delegateValue", trans.delegateValue);
+    query->bindValue(":delegateHash", trans.delegateHash);
+    query->bindValue(":status", trans.status);
+    query->bindValue(":type", trans.type);
+    query->bindValue(":blockNumber", static_cast<qint64>(trans.blockNumber));
+    query->bindValue(":blockHash", trans.blockHash);
+    query->bindValue(":intStatus", trans.intStatus);
+    CHECK(query->exec(), query->lastError().text().toStdString());
 }
 
 void TransactionsDBStorage::removePaymentsForDest(const QString &address, const QString &currency)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(deletePaymentsForAddress), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    auto transactionGuard = beginTransaction();
+    {
+        CachedQuery query = cachedQuery(deletePaymentsForAddress);
+        query->bindValue(":address", address);
+        query->bindValue(":currency", currency);
+        CHECK(query->exec(), query->lastError().text().toStdString());
+    }
+    {
+        CachedQuery query = cachedQuery(deleteCheckpointsForAddress);
+        query->bindValue(":address", address);
+        query->bindValue(":currency", currency);
+        CHECK(query->exec(), query->lastError().text().toStdString());
+    }
+    transactionGuard.commit();
 }
 
 qint64 TransactionsDBStorage::getPaymentsCountForAddress(const QString &address, const QString &currency, bool input)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectPaymentsCountForAddress), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    query.bindValue(":input", input);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    if (query.next()) {
-        return query.value("count").toLongLong();
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectPaymentsCountForAddress);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    query->bindValue(":input", input);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    if (query->next()) {
+        return query->value("count").toLongLong();
     }
     return 0;
 }
 
 BigNumber TransactionsDBStorage::calcInValueForAddress(const QString &address, const QString &currency)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectInPaymentsValuesForAddress), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectInPaymentsValuesForAddress);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    CHECK(query->exec(), query->lastError().text().toStdString());
     BigNumber res;
     BigNumber r;
-    while (query.next()) {
-        r.setDecimal(query.value("value").toByteArray());
+    while (query->next()) {
+        r.setDecimal(query->value("value").toByteArray());
         res += r;
-        r.setDecimal(query.value("fee").toByteArray());
+        r.setDecimal(query->value("fee").toByteArray());
         res += r;
     }
     return res;
@@ -229,15 +232,15 @@ BigNumber TransactionsDBStorage::calcInValueForAddress(const QString &address, c
 
 BigNumber TransactionsDBStorage::calcOutValueForAddress(const QString &address, const QString &currency)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectOutPaymentsValuesForAddress), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectOutPaymentsValuesForAddress);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    CHECK(query->exec(), query->lastError().text().toStdString());
     BigNumber res;
     BigNumber r;
-    while (query.next()) {
-        r.setDecimal(query.value("value").toByteArray());
+    while (query->next()) {
+        r.setDecimal(query->value("value").toByteArray());
         res += r;
     }
     return res;
@@ -245,32 +248,32 @@ BigNumber TransactionsDBStorage::calcOutValueForAddress(const QString &address,
 
 qint64 TransactionsDBStorage::getIsSetDelegatePaymentsCountForAddress(const QString &address, const QString &currency, Transaction::Status status)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectIsSetDelegatePaymentsCountForAddress), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    query.bindValue(":status", status);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    if (query.next()) {
-        return query.value("count").toLongLong();
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectIsSetDelegatePaymentsCountForAddress);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    query->bindValue(":status", status);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    if (query->next()) {
+        return query->value("count").toLongLong();
     }
     return 0;
 }
 
 BigNumber TransactionsDBStorage::calcIsSetDelegateValueForAddress(const QString &address, const QString &currency, bool isDelegate, bool isInput, Transaction::Status status)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectIsSetDelegatePaymentsValuesForAddress), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    query.bindValue(":isDelegate", isDelegate);
-    query.bindValue(":isInput", isInput);
-    query.bindValue(":status", status);
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectIsSetDelegatePaymentsValuesForAddress);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    query->bindValue(":isDelegate", isDelegate);
+    query->bindValue(":isInput", isInput);
+    query->bindValue(":status", status);
+    CHECK(query->exec(), query->lastError().text().toStdString());
     BigNumber res;
     BigNumber r;
-    while (query.next()) {
-        r.setDecimal(query.value("delegateValue").toByteArray());
+    while (query->next()) {
+        r.setDecimal(query->value("delegateValue").toByteArray());
         res += r;
     }
     return res;
@@ -279,11 +282,11 @@ BigNumber TransactionsDBStorage::calcIsSetDelegateValueForAddress(const QString
 void TransactionsDBStorage::calcBalance(const QString &address, const QString &currency,
                                         BalanceInfo &balance)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectAllPaymentsValuesForAddress), query.lastError().text().toStdString());
-    query.bindValue(":address", address);
-    query.bindValue(":currency", currency);
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectAllPaymentsValuesForAddress);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    CHECK(query->exec(), query->lastError().text().toStdString());
     balance.received = BigNumber();
     balance.spent = BigNumber();
     balance.delegate = BigNumber();
@@ -305,15 +308,15 @@ void TransactionsDBStorage::calcBalance(const QString &address, const QString &c
     Transaction::Status status;
     Transaction::Type type;
 
-    while (query.next()) {
-        value.setDecimal(query.value("value").toByteArray());
-        fee.setDecimal(query.value("fee").toByteArray());
-        delegateValue.setDecimal(query.value("delegateValue").toByteArray());
-        isSetDelegate = query.value("isSetDelegate").toBool();
-        isDelegate = query.value("isDelegate").toBool();
-        isInput = query.value("isInput").toBool();
-        status = static_cast<Transaction::Status>(query.value("status").toInt());
-        type = static_cast<Transaction::Type>(query.value("type").toInt());
+    while (query->next()) {
+        value.setDecimal(query->value("value").toByteArray());
+        fee.setDecimal(query->value("fee").toByteArray());
+        delegateValue.setDecimal(query->value("delegateValue").toByteArray());
+        isSetDelegate = query->value("isSetDelegate").toBool();
+        isDelegate = query->value("isDelegate").toBool();
+        isInput = query->value("isInput").toBool();
+        status = static_cast<Transaction::Status>(query->value("status").toInt());
+        type = static_cast<Transaction::Type>(query->value("type").toInt());
         if (isInput) {
             balance.spent += value;
             balance.spent += fee;
@@ -349,14 +352,13 @@ void TransactionsDBStorage::calcBalance(const QString &address, const QString &c
 
 void TransactionsDBStorage::addTracked(const QString &currency, const QString &address, const QString &name, const QString &type, const QString &tgroup)
 {
-    QSqlQuery query(database());
-    CHECK(query.prepare(insertTracked), query.lastError().text().toStdString());
-    query.bindValue(":currency", currency);
-    query.bindValue(":address", address);
-    query.bindValue(":name", name);
-    query.bindValue(":type", type);
-    query.bindValue(":tgroup", tgroup);
-    CHECK(query.exec(), query.lastError().text().toStdString());
+    CachedQuery query = cachedQuery(insertTracked);
+    query->bindValue(":currency", currency);
+    query->bindValue(":address", address);
+    query->bindValue(":name", name);
+    query->bindValue(":type", type);
+    query->bindValue(":tgroup", tgroup);
+    CHECK(query->exec(), query->lastError().text().toStdString());
 }
 
 void TransactionsDBStorage::addTracked(const AddressInfo &info)
@@ -367,16 +369,16 @@ void TransactionsDBStorage::addTracked(const AddressInfo &info)
 std::vector<AddressInfo> TransactionsDBStorage::getTrackedForGroup(const QString &tgroup)
 {
     std::vector<AddressInfo> res;
-    QSqlQuery query(database());
-    CHECK(query.prepare(selectTrackedForGroup), query.lastError().text().toStdString());
-    query.bindValue(":tgroup", tgroup);
-    CHECK(query.exec(), query.lastError().text().toStdString());
-    while (query.next()) {
-        AddressInfo info(query.value("currency").toString(),
-                         query.value("address").toString(),
-                         query.value("type").toString(),
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectTrackedForGroup);
+    query->bindValue(":tgroup", tgroup);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    while (query->next()) {
+        AddressInfo info(query->value("currency").toString(),
+                         query->value("address").toString(),
+                         query->value("type").toString(),
                          tgroup,
-                         query.value("name").toString()
+                         query->value("name").toString()
                          );
         res.push_back(info);
     }
@@ -391,6 +393,10 @@ void TransactionsDBStorage::removePaymentsForCurrency(const QString &currency)
     if (!currency.isEmpty())
         query.bindValue(":currency", currency);
     CHECK(query.exec(), query.lastError().text().toStdString());
+    CHECK(query.prepare(removeCheckpointsForCurrencyQuery.arg(currency.isEmpty() ? QStringLiteral(""): removePaymentsCurrencyWhere)), query.lastError().text().toStdString());
+    if (!currency.isEmpty())
+        query.bindValue(":currency", currency);
+    CHECK(query.exec(), query.lastError().text().toStdString());
     CHECK(query.prepare(removeTrackedForCurrencyQuery.arg(currency.isEmpty() ? QStringLiteral(""): removePaymentsCurrencyWhere)), query.lastError().text().toStdString());
     if (!currency.isEmpty())
         query.bindValue(":currency", currency);
@@ -398,15 +404,90 @@ void TransactionsDBStorage::removePaymentsForCurrency(const QString &currency)
     transactionGuard.commit();
 }
 
+void TransactionsDBStorage::addCheckpoint(const QString &address, const QString &currency, int64_t blockNumber, const QString &blockHash)
+{
+    {
+        CachedQuery query = cachedQuery(insertCheckpoint);
+        query->bindValue(":address", address);
+        query->bindValue(":currency", currency);
+        query->bindValue(":blockNumber", static_cast<qint64>(blockNumber));
+        query->bindValue(":blockHash", blockHash);
+        CHECK(query->exec(), query->lastError().text().toStdString());
+    }
+
+    qint64 oldestKept = -1;
+    {
+        CachedQuery query = cachedQuery(selectOldestKeptCheckpoint);
+        query->bindValue(":address", address);
+        query->bindValue(":currency", currency);
+        query->bindValue(":offset", MAX_CHECKPOINTS - 1);
+        CHECK(query->exec(), query->lastError().text().toStdString());
+        if (query->next()) {
+            oldestKept = query->value("blockNumber").toLongLong();
+        }
+    }
+    if (oldestKept != -1) {
+        CachedQuery query = cachedQuery(deleteCheckpointsBeforeBlock);
+        query->bindValue(":address", address);
+        query->bindValue(":currency", currency);
+        query->bindValue(":blockNumber", oldestKept);
+        CHECK(query->exec(), query->lastError().text().toStdString());
+    }
+}
+
+void TransactionsDBStorage::addCheckpoint(const BlockCheckpoint &checkpoint)
+{
+    addCheckpoint(checkpoint.address, checkpoint.currency, checkpoint.blockNumber, checkpoint.blockHash);
+}
+
+std::vector<BlockCheckpoint> TransactionsDBStorage::getCheckpoints(const QString &address, const QString &currency) const
+{
+    std::vector<BlockCheckpoint> res;
+    ReadGuard reader = beginRead();
+    CachedQuery query = reader.query(selectCheckpointsForAddress);
+    query->bindValue(":address", address);
+    query->bindValue(":currency", currency);
+    CHECK(query->exec(), query->lastError().text().toStdString());
+    while (query->next()) {
+        res.emplace_back(query->value("address").toString(),
+                         query->value("currency").toString(),
+                         query->value("blockNumber").toLongLong(),
+                         query->value("blockHash").toString());
+    }
+    return res;
+}
+
+void TransactionsDBStorage::rollbackAfterBlock(const QString &address, const QString &currency, int64_t blockNumber)
+{
+    auto transactionGuard = beginTransaction();
+    {
+        CachedQuery query = cachedQuery(deletePaymentsAfterBlock);
+        query->bindValue(":address", address);
+        query->bindValue(":currency", currency);
+        query->bindValue(":blockNumber", static_cast<qint64>(blockNumber));
+        CHECK(query->exec(), query->lastError().text().toStdString());
+    }
+    {
+        CachedQuery query = cachedQuery(deleteCheckpointsAfterBlock);
+        query->bindValue(":address", address);
+        query->bindValue(":currency", currency);
+        query->bindValue(":blockNumber", static_cast<qint64>(blockNumber));
+        CHECK(query->exec(), query->lastError().text().toStdString());
+    }
+    transactionGuard.commit();
+}
+
 void TransactionsDBStorage::createDatabase()
 {
     createTable(QStringLiteral("payments"), createPaymentsTable);
     createTable(QStringLiteral("tracked"), createTrackedTable);
+    createTable(QStringLiteral("checkpoints"), createCheckpointsTable);
     createIndex(createPaymentsIndex1);
     createIndex(createPaymentsIndex2);
     createIndex(createPaymentsIndex3);
     createIndex(createPaymentsUniqueIndex);
     createIndex(createTrackedUniqueIndex);
+    createIndex(createCheckpointsUniqueIndex);
 }
 
 void TransactionsDBStorage::setTransactionFromQuery(QSqlQuery &query, Transaction &trans) const
@@ -11,7 +11,7 @@ namespace transactions {
 class TransactionsDBStorage : public DBStorage
 {
 public:
-    TransactionsDBStorage(const QString &path = QString());
+    TransactionsDBStorage(const QString &path = QString(), const TuningProfile &profile = TuningProfile::largeDatabase());
 
     virtual int currentVersion() const final;
 
@@ -61,6 +61,21 @@ public:
 
     void removePaymentsForCurrency(const QString &currency);
 
+    // Хранится не больше MAX_CHECKPOINTS последних checkpoint-ов адреса.
+    // Своей транзакции не открывает, вызывается в транзакции вместе с addPayment
+    void addCheckpoint(const QString &address, const QString &currency, int64_t blockNumber, const QString &blockHash);
+    void addCheckpoint(const BlockCheckpoint &checkpoint);
+
+    // По возрастанию номера блока
+    std::vector<BlockCheckpoint> getCheckpoints(const QString &address, const QString &currency) const;
+
+    // Удаляет транзакции и checkpoint-ы адреса из блоков после blockNumber
+    void rollbackAfterBlock(const QString &address, const QString &currency, int64_t blockNumber);
+
+public:
+
+    static const int MAX_CHECKPOINTS = 64;
+
 protected:
     virtual void createDatabase() final;
 
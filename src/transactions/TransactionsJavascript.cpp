@@ -41,7 +41,8 @@ END_SLOT_WRAPPER
 
 template<typename... Args>
 void TransactionsJavascript::makeAndRunJsFuncParams(const QString &function, const TypedException &exception, Args&& ...args) {
-    const QString res = makeJsFunc3<false>(function, "", exception, std::forward<Args>(args)...);
+    const bool isLiteral = isJsonLiteralResults.load();
+    const QString res = makeJsFunc3<false>(function, "", exception, jsonArg(isLiteral, std::forward<Args>(args))...);
     runJs(res);
 }
 
@@ -158,7 +159,9 @@ BEGIN_SLOT_WRAPPER
 
     LOG << "New balance " << address << " " << currency << " " << balance.countReceived << " " << balance.countSpent << " " << QString(balance.calcBalance().getDecimal());
 
-    makeAndRunJsFuncParams(JS_NAME_RESULT, TypedException(), address, currency, balanceToJson(balance));
+    // Устаревшие балансы, еще не отданные странице, отбрасываются
+    const QString script = makeJsFunc3<false>(JS_NAME_RESULT, "", TypedException(), address, currency, jsonArg(isJsonLiteralResults.load(), balanceToJson(balance)));
+    emit jsRunLatestSig(JS_NAME_RESULT + " " + address + " " + currency, script);
 END_SLOT_WRAPPER
 }
 
@@ -537,6 +540,15 @@ BEGIN_SLOT_WRAPPER
 END_SLOT_WRAPPER
 }
 
+void TransactionsJavascript::setJsonLiteralResults(bool isLiteral) {
+BEGIN_SLOT_WRAPPER
+    const QString JS_NAME_RESULT = "txsSetJsonLiteralResultsResultJs";
+    LOG << "Txs set json literal results " << isLiteral;
+    isJsonLiteralResults = isLiteral;
+    makeAndRunJsFuncParams(JS_NAME_RESULT, TypedException(), isLiteral);
+END_SLOT_WRAPPER
+}
+
 void TransactionsJavascript::onSendedTransactionsResponse(const QString &requestId, const QString &server, const QString &response, const TypedException &error) {
 BEGIN_SLOT_WRAPPER
     const QString JS_NAME_RESULT = "txsSendedTxJs";
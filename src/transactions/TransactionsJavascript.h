@@ -4,6 +4,7 @@
 #include <QObject>
 
 #include <functional>
+#include <atomic>
 
 class QThread;
 
@@ -36,6 +37,8 @@ signals:
 
     void jsRunSig(QString jsString);
 
+    void jsRunLatestSig(QString key, QString jsString);
+
     void callbackCall(const TransactionsJavascript::Callback &callback);
 
 signals:
@@ -96,6 +99,9 @@ public slots:
 
     Q_INVOKABLE void clearDb(QString currency);
 
+    // Json результаты передаются в функции страницы объектами вместо строк
+    Q_INVOKABLE void setJsonLiteralResults(bool isLiteral);
+
 private:
 
     template<typename... Args>
@@ -106,6 +112,8 @@ private:
 private:
 
     Transactions *transactionsManager;
+
+    std::atomic<bool> isJsonLiteralResults{false};
 };
 
 }
@@ -259,6 +259,65 @@ int64_t parseGetCountBlocksResponse(const QString &response) {
     return obj.value("count_blocks").toInt();
 }
 
+QString makeSubscribeAddressesRequest(const std::vector<QString> &addresses, bool isReset, size_t id) {
+    QJsonObject request;
+    request.insert("jsonrpc", "2.0");
+    request.insert("id", static_cast<qint64>(id));
+    request.insert("method", "subscribe-addresses");
+    QJsonObject params;
+    QJsonArray addressesJson;
+    for (const QString &address: addresses) {
+        addressesJson.push_back(address);
+    }
+    params.insert("addresses", addressesJson);
+    params.insert("reset", isReset);
+    request.insert("params", params);
+    return QString(QJsonDocument(request).toJson(QJsonDocument::Compact));
+}
+
+SubscribeAddressesResponse parseSubscribeAddressesResponse(const QString &message) {
+    const QJsonDocument jsonResponse = QJsonDocument::fromJson(message.toUtf8());
+    CHECK(jsonResponse.isObject(), "Incorrect json ");
+    const QJsonObject &json1 = jsonResponse.object();
+
+    SubscribeAddressesResponse result;
+    if (!json1.contains("id") || json1.contains("method")) {
+        return result;
+    }
+    CHECK(json1.value("id").isDouble(), "Incorrect json: id field not number");
+    result.isResponse = true;
+    result.id = static_cast<size_t>(json1.value("id").toDouble());
+    if (json1.contains("error") && !json1.value("error").isNull()) {
+        result.isError = true;
+        if (json1.value("error").isObject()) {
+            result.error = json1.value("error").toObject().value("message").toString();
+        } else {
+            result.error = json1.value("error").toVariant().toString();
+        }
+    }
+    return result;
+}
+
+std::vector<QString> parseAddressChangedNotification(const QString &message) {
+    const QJsonDocument jsonResponse = QJsonDocument::fromJson(message.toUtf8());
+    CHECK(jsonResponse.isObject(), "Incorrect json ");
+    const QJsonObject &json1 = jsonResponse.object();
+    CHECK(!json1.contains("error") || !json1.value("error").isObject(), json1.value("error").toObject().value("message").toString().toStdString());
+
+    std::vector<QString> result;
+    if (json1.value("method").toString() != "address-changed") {
+        return result;
+    }
+    CHECK(json1.contains("params") && json1.value("params").isObject(), "Incorrect json: params field not found");
+    const QJsonObject &params = json1.value("params").toObject();
+    CHECK(params.contains("addresses") && params.value("addresses").isArray(), "Incorrect json: addresses field not found");
+    for (const QJsonValue &address: params.value("addresses").toArray()) {
+        CHECK(address.isString(), "Incorrect json: address not string");
+        result.emplace_back(address.toString());
+    }
+    return result;
+}
+
 SendParameters parseSendParamsInternal(const QString &paramsJson) {
     SendParameters result;
     const QJsonDocument doc = QJsonDocument::fromJson(paramsJson.toUtf8());
@@ -36,6 +36,21 @@ QString makeGetCountBlocksRequest();
 
 int64_t parseGetCountBlocksResponse(const QString &response);
 
+QString makeSubscribeAddressesRequest(const std::vector<QString> &addresses, bool isReset, size_t id);
+
+struct SubscribeAddressesResponse {
+    // false для уведомлений и других сообщений без id
+    bool isResponse = false;
+    size_t id = 0;
+    bool isError = false;
+    QString error;
+};
+
+SubscribeAddressesResponse parseSubscribeAddressesResponse(const QString &message);
+
+// Для остальных сообщений возвращает пустой список
+std::vector<QString> parseAddressChangedNotification(const QString &message);
+
 SendParameters parseSendParamsInternal(const QString &paramsJson);
 
 }
@@ -0,0 +1,149 @@
+#include "TransactionsSubscription.h"
+
+#include <algorithm>
+
+#include "check.h"
+#include "Log.h"
+#include "SlotWrapper.h"
+#include "QRegister.h"
+#include "TypedException.h"
+
+#include "TransactionsMessages.h"
+
+SET_LOG_NAMESPACE("TXS");
+
+namespace transactions {
+
+static const QString HELLO_TAG = "Transactions";
+
+TransactionsSubscription::TransactionsSubscription(const QString &url, QObject *parent)
+    : QObject(parent)
+    , wssClient(url)
+{
+    Q_REG2(TypedException, "TypedException", false);
+
+    CHECK(connect(&wssClient, &WebSocketClient::messageReceived, this, &TransactionsSubscription::onMessageReceived), "not connect onMessageReceived");
+    CHECK(connect(&wssClient, &WebSocketClient::connectedSock, this, &TransactionsSubscription::onConnected), "not connect onConnected");
+    CHECK(connect(&wssClient, &WebSocketClient::disconnectedSock, this, &TransactionsSubscription::onDisconnected), "not connect onDisconnected");
+}
+
+void TransactionsSubscription::start() {
+    wssClient.start();
+}
+
+void TransactionsSubscription::setAddresses(const std::vector<QString> &addresses) {
+    subscribed = std::set<QString>(addresses.begin(), addresses.end());
+    for (auto iter = changed.begin(); iter != changed.end();) {
+        if (subscribed.find(*iter) == subscribed.end()) {
+            iter = changed.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    const std::vector<QString> sorted(subscribed.begin(), subscribed.end());
+    std::vector<QString> messages;
+    subscribeIds.clear();
+    for (size_t i = 0; i < sorted.size(); i += MAX_ADDRESSES_IN_MESSAGE) {
+        const size_t end = std::min(sorted.size(), i + MAX_ADDRESSES_IN_MESSAGE);
+        subscribeIds.emplace_back(nextRequestId++);
+        messages.emplace_back(makeSubscribeAddressesRequest(std::vector<QString>(sorted.begin() + i, sorted.begin() + end), i == 0, subscribeIds.back()));
+    }
+    if (messages.empty()) {
+        subscribeIds.emplace_back(nextRequestId++);
+        messages.emplace_back(makeSubscribeAddressesRequest({}, true, subscribeIds.back()));
+    }
+    // Новая подписка действует только после подтверждения всех ее сообщений
+    notAcknowledged = std::set<size_t>(subscribeIds.begin(), subscribeIds.end());
+
+    LOG << "Subscribe addresses " << subscribed.size() << ", messages " << messages.size();
+    emit wssClient.setHelloString(messages, HELLO_TAG);
+    // Первое сообщение сбрасывает подписку, поэтому повтор вместе с hello безопасен
+    emit wssClient.sendMessages(messages);
+}
+
+bool TransactionsSubscription::isActive() const {
+    return isConnected && notAcknowledged.empty() && ::now() - lastMessageTime < heartbeatTimeout;
+}
+
+void TransactionsSubscription::setHeartbeatTimeout(seconds timeout) {
+    heartbeatTimeout = timeout;
+}
+
+std::vector<QString> TransactionsSubscription::takeChanged(size_t count) {
+    std::vector<QString> result;
+    auto iter = changed.begin();
+    while (iter != changed.end() && result.size() < count) {
+        result.emplace_back(*iter);
+        iter = changed.erase(iter);
+    }
+    return result;
+}
+
+bool TransactionsSubscription::takeResyncNeeded() {
+    const bool result = isResyncNeeded;
+    isResyncNeeded = false;
+    return result;
+}
+
+size_t TransactionsSubscription::countSubscribed() const {
+    return subscribed.size();
+}
+
+void TransactionsSubscription::onMessageReceived(QString message) {
+BEGIN_SLOT_WRAPPER
+    const time_point now = ::now();
+    if (isConnected && now - lastMessageTime >= heartbeatTimeout) {
+        LOG << "Subscription heartbeat restored";
+        isResyncNeeded = true;
+    }
+    lastMessageTime = now;
+
+    const SubscribeAddressesResponse response = parseSubscribeAddressesResponse(message);
+    if (response.isResponse) {
+        const auto found = notAcknowledged.find(response.id);
+        if (found == notAcknowledged.end()) {
+            return;
+        }
+        if (response.isError) {
+            LOG << "Subscribe addresses " << response.id << " rejected: " << response.error;
+            return;
+        }
+        notAcknowledged.erase(found);
+        if (notAcknowledged.empty()) {
+            LOG << "Subscription acknowledged, addresses " << subscribed.size();
+        }
+        return;
+    }
+
+    const std::vector<QString> addresses = parseAddressChangedNotification(message);
+    for (const QString &address: addresses) {
+        if (subscribed.find(address) != subscribed.end()) {
+            changed.insert(address);
+        }
+    }
+END_SLOT_WRAPPER
+}
+
+void TransactionsSubscription::onConnected(const TypedException &/*exception*/) {
+BEGIN_SLOT_WRAPPER
+    isConnected = true;
+    lastMessageTime = ::now();
+    // Подписка уходит заново в hello, ждем подтверждения на новом соединении
+    notAcknowledged = std::set<size_t>(subscribeIds.begin(), subscribeIds.end());
+    if (wasDisconnected) {
+        isResyncNeeded = true;
+    }
+    LOG << "Subscription connected";
+END_SLOT_WRAPPER
+}
+
+void TransactionsSubscription::onDisconnected() {
+BEGIN_SLOT_WRAPPER
+    isConnected = false;
+    wasDisconnected = true;
+    LOG << "Subscription disconnected";
+END_SLOT_WRAPPER
+}
+
+}
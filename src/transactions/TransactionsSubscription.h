@@ -0,0 +1,87 @@
+#ifndef TRANSACTIONSSUBSCRIPTION_H
+#define TRANSACTIONSSUBSCRIPTION_H
+
+#include <QObject>
+#include <QString>
+
+#include <vector>
+#include <set>
+
+#include "WebSocketClient.h"
+#include "duration.h"
+
+struct TypedException;
+
+namespace transactions {
+
+/*
+   Подписка на изменения отслеживаемых адресов через WebSocket ноды.
+   Нода подтверждает каждый subscribe-addresses ответом с тем же id и присылает уведомления address-changed,
+   адреса копятся до обработки в Transactions.
+   Любое сообщение ноды считается heartbeat-ом. Пока соединения нет или heartbeat-ы не приходят, уведомления теряются,
+   поэтому после восстановления нужна полная сверка.
+   */
+class TransactionsSubscription : public QObject {
+    Q_OBJECT
+public:
+
+    explicit TransactionsSubscription(const QString &url, QObject *parent = nullptr);
+
+    void start();
+
+    // Заменяет список подписанных адресов, при переподключении он отправляется заново
+    void setAddresses(const std::vector<QString> &addresses);
+
+    // Соединение есть, нода подтвердила текущую подписку и heartbeat-ы приходят
+    bool isActive() const;
+
+    void setHeartbeatTimeout(seconds timeout);
+
+    // Не больше count адресов, изменившихся с прошлого вызова
+    std::vector<QString> takeChanged(size_t count);
+
+    // Было переподключение после обрыва, изменения за это время не пришли
+    bool takeResyncNeeded();
+
+    size_t countSubscribed() const;
+
+public:
+
+    static const size_t MAX_ADDRESSES_IN_MESSAGE = 500;
+
+private slots:
+
+    void onMessageReceived(QString message);
+
+    void onConnected(const TypedException &exception);
+
+    void onDisconnected();
+
+private:
+
+    WebSocketClient wssClient;
+
+    std::set<QString> subscribed;
+
+    std::set<QString> changed;
+
+    bool isConnected = false;
+
+    bool wasDisconnected = false;
+
+    bool isResyncNeeded = false;
+
+    size_t nextRequestId = 1;
+
+    std::vector<size_t> subscribeIds;
+
+    std::set<size_t> notAcknowledged;
+
+    time_point lastMessageTime;
+
+    seconds heartbeatTimeout = 60s;
+};
+
+}
+
+#endif // TRANSACTIONSSUBSCRIPTION_H
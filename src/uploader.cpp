@@ -26,6 +26,7 @@
 #include "utils.h"
 #include "SlotWrapper.h"
 #include "Paths.h"
+#include "HtmlDeltaUpdate.h"
 
 SET_LOG_NAMESPACE("UPL");
 
@@ -98,6 +99,10 @@ Uploader::Uploader(MainWindow &mainWindow)
 
     CHECK(connect(&client, &SimpleClient::callbackCall, this, &Uploader::callbackCall), "not connect callbackCall");
 
+    downloader.setParent(this);
+    CHECK(connect(&downloader, &FileDownloader::callbackCall, this, &Uploader::callbackCall), "not connect callbackCall");
+    CHECK(connect(&downloader, &FileDownloader::progress, this, &Uploader::onDownloadProgress), "not connect progress");
+
     currentBeginPath = getPagesPath();
     const auto &lastVersionPair = Uploader::getLastVersion(currentBeginPath);
     currFolder = lastVersionPair.first;
@@ -111,6 +116,10 @@ Uploader::Uploader(MainWindow &mainWindow)
     QSettings settings(getSettingsPath(), QSettings::IniFormat);
     CHECK(settings.contains("timeouts_sec/uploader"), "settings timeouts not found");
     timeout = seconds(settings.value("timeouts_sec/uploader").toInt());
+    downloadStallTimeout = seconds(settings.value("timeouts_sec/uploader_stall", 60).toInt());
+    downloadTotalTimeout = seconds(settings.value("timeouts_sec/uploader_total", 1800).toInt());
+    isDeltaUpdates = settings.value("uploader/delta_updates", true).toBool();
+    deltaParallel = static_cast<size_t>(std::max(1, settings.value("uploader/delta_parallel", 4).toInt()));
 
     const milliseconds msTimer = 10s;
     qtimer.moveToThread(&thread1);
@@ -142,6 +151,34 @@ BEGIN_SLOT_WRAPPER
 END_SLOT_WRAPPER
 }
 
+void Uploader::onDownloadProgress(QString filePath, qint64 received, qint64 total) {
+BEGIN_SLOT_WRAPPER
+    if (total > 0) {
+        const int percent = static_cast<int>(received * 100 / total);
+        int &lastPercent = downloadPercents[filePath];
+        if (percent / 10 != lastPercent / 10 || percent == 100) {
+            LOG << "Download progress " << filePath << " " << received << "/" << total;
+        }
+        lastPercent = percent;
+        if (received == total) {
+            downloadPercents.erase(filePath);
+        }
+    }
+    emit downloadProgress(filePath, received, total);
+END_SLOT_WRAPPER
+}
+
+void Uploader::finishHtmlsUpdate(const QString &folderServer, const QString &version) {
+    Uploader::setLastVersion(currentBeginPath, folderServer, version);
+
+    lastVersion = version;
+    currFolder = folderServer;
+
+    emit generateUpdateHtmlsEvent();
+
+    emit checkedUpdatesHtmls(TypedException());
+}
+
 void Uploader::run() {
     emit uploadEvent();
 }
@@ -159,6 +196,18 @@ static void removeOlderFolders(const QString &folderHtmls, const QString &curren
     }
 }
 
+// Недокачанные файлы прошлых версий больше не понадобятся
+static void removeOlderDownloads(const QString &prefix, const QString &currentFileName) {
+    QDir sourceDir(getDownloadsPath());
+    for (const QString &fileName: sourceDir.entryList(QDir::Files)) {
+        if (fileName.startsWith(prefix) && !fileName.startsWith(currentFileName)) {
+            const QString pathRemove = makePath(getDownloadsPath(), fileName);
+            LOG << "Remove older download " << pathRemove;
+            removeFile(pathRemove);
+        }
+    }
+}
+
 void Uploader::uploadEvent() {
 BEGIN_SLOT_WRAPPER
     const QString UPDATE_API = serverName;
@@ -195,45 +244,93 @@ BEGIN_SLOT_WRAPPER
             return;
         }
 
-        auto interfaceGetCallback = [this, version, hash, UPDATE_API, folderServer](const std::string &result, const SimpleClient::ServerException &exception) {
+        auto interfaceGetCallback = [this, version, hash, UPDATE_API, folderServer](const FileDownloader::Result &result, const SimpleClient::ServerException &exception) {
             versionHtmlForUpdate = "";
             CHECK(!exception.isSet(), "Server error: " + exception.toString());
 
             if (version == lastVersion && folderServer == currFolder) { // Так как это callback, то проверим еще раз
+                removeFile(result.filePath);
                 return;
             }
 
-            QCryptographicHash hashAlg(QCryptographicHash::Md5);
-            hashAlg.addData(result.data(), result.size());
-            const QString hashStr(hashAlg.result().toHex());
-            CHECK(hashStr == hash, ("hash zip not equal response hash: hash zip: " + hashStr + ", hash response: " + hash).toStdString());
+            // Сервер публикует md5, sha256 посчитан при загрузке и пишется в лог
+            LOG << "Html zip " << result.filePath << " " << result.size << " sha256 " << result.sha256;
+            if (result.md5 != hash) {
+                removeFile(result.filePath);
+                throwErr(("hash zip not equal response hash: hash zip: " + result.md5 + ", hash response: " + hash).toStdString());
+            }
 
             removeOlderFolders(makePath(currentBeginPath, mainWindow.getCurrentHtmls().folderName), mainWindow.getCurrentHtmls().lastVersion);
 
-            const QString archiveFilePath = makePath(currentBeginPath, version + ".zip");
-            writeToFileBinary(archiveFilePath, result, false);
-
             const QString extractedPath = makePath(currentBeginPath, folderServer, version);
-            extractDir(archiveFilePath, extractedPath);
+            extractDir(result.filePath, extractedPath);
             LOG << "Extracted " << extractedPath << ".";
-            removeFile(archiveFilePath);
+            removeFile(result.filePath);
 
-            Uploader::setLastVersion(currentBeginPath, folderServer, version);
+            finishHtmlsUpdate(folderServer, version);
+        };
 
-            lastVersion = version;
-            currFolder = folderServer;
+        const auto downloadZip = [this, version, url, interfaceGetCallback]() {
+            LOG << "download html";
+            countDownloads["html_" + version]++;
+            CHECK(countDownloads["html_" + version] < 5, "Maximum download");
+            versionHtmlForUpdate = version;
+            const QString htmlFileName = "html_" + version + ".zip";
+            removeOlderDownloads("html_", htmlFileName);
+            downloader.download(QUrl(url), makePath(getDownloadsPath(), htmlFileName), interfaceGetCallback, downloadStallTimeout, downloadTotalTimeout);
+            id++;
+        };
 
-            emit generateUpdateHtmlsEvent();
+        const QString manifestUrl = dataJson.contains("manifest") && dataJson.value("manifest").isString() ? dataJson.value("manifest").toString() : "";
+        if (!isDeltaUpdates || manifestUrl.isEmpty()) {
+            downloadZip();
+            return;
+        }
 
-            emit checkedUpdatesHtmls(TypedException());
+        // Качаем только изменившиеся файлы, при любой ошибке откатываемся на полный zip
+        auto manifestCallback = [this, version, folderServer, manifestUrl, downloadZip](const std::string &result, const SimpleClient::ServerException &exception) {
+            versionHtmlForUpdate = "";
+            if (version == lastVersion && folderServer == currFolder) {
+                return;
+            }
+            const QString extractedPath = makePath(currentBeginPath, folderServer, version);
+            const auto fallback = [&](const std::string &reason) {
+                LOG << "Delta update " << version << " failed: " << reason << ". Download zip";
+                removeFolder(extractedPath);
+                downloadZip();
+            };
+            if (exception.isSet()) {
+                fallback(exception.toString());
+                return;
+            }
+
+            try {
+                const HtmlDeltaUpdate::Manifest manifest = HtmlDeltaUpdate::parseManifest(QUrl(manifestUrl), result);
+
+                removeOlderFolders(makePath(currentBeginPath, mainWindow.getCurrentHtmls().folderName), mainWindow.getCurrentHtmls().lastVersion);
+                const QString oldPath = mainWindow.getCurrentHtmls().fullPath;
+
+                versionHtmlForUpdate = version;
+                HtmlDeltaUpdate::start(downloader, manifest, oldPath, extractedPath, deltaParallel, downloadStallTimeout, downloadTotalTimeout, [this, version, folderServer, extractedPath, downloadZip](const HtmlDeltaUpdate::Stats &stats, const SimpleClient::ServerException &exception) {
+                    versionHtmlForUpdate = "";
+                    if (exception.isSet()) {
+                        LOG << "Delta update " << version << " failed: " << exception.toString() << ". Download zip";
+                        removeFolder(extractedPath);
+                        downloadZip();
+                        return;
+                    }
+                    LOG << "Delta update " << version << ": linked " << stats.countLinked << ", downloaded " << stats.countDownloaded << " files, " << stats.bytesDownloaded << " bytes, " << stats.time.count() << " ms";
+                    finishHtmlsUpdate(folderServer, version);
+                });
+            } catch (const Exception &e) {
+                versionHtmlForUpdate = "";
+                fallback(e);
+            }
         };
 
-        LOG << "download html";
-        countDownloads["html_" + version]++;
-        CHECK(countDownloads["html_" + version] < 5, "Maximum download");
+        LOG << "download html manifest";
         versionHtmlForUpdate = version;
-        client.sendMessageGet(url, interfaceGetCallback); // Без таймаута, так как загрузка большого бинарника
-        id++;
+        client.sendMessageGet(QUrl(manifestUrl), manifestCallback, timeout);
     };
 
     client.sendMessagePost(QUrl(UPDATE_API), QString::fromStdString("{\"id\": \"" + std::to_string(id) + "\",\"version\":\"1.0.0\",\"method\":\"interface.get.url\", \"token\":\"\", \"params\":[]}"), callbackGetHtmls, timeout);
@@ -264,15 +361,16 @@ BEGIN_SLOT_WRAPPER
             return;
         }
 
-        auto autoupdateGetCallback = [this, version, reference](const std::string &result, const SimpleClient::ServerException &exception) {
+        auto autoupdateGetCallback = [this, version, reference](const FileDownloader::Result &result, const SimpleClient::ServerException &exception) {
             versionForUpdate.clear();
             LOG << "autoupdater callback";
             CHECK(!exception.isSet(), "Server error: " + exception.toString());
+            LOG << "Autoupdater zip " << result.filePath << " " << result.size << " sha256 " << result.sha256;
 
             clearAutoupdatersPath();
             const QString autoupdaterPath = getAutoupdaterPath();
             const QString archiveFilePath = makePath(autoupdaterPath, version + ".zip");
-            writeToFileBinary(archiveFilePath, result, false);
+            CHECK(QFile::rename(result.filePath, archiveFilePath), "Not rename " + result.filePath.toStdString());
 
             extractDir(archiveFilePath, getTmpAutoupdaterPath());
             LOG << "Extracted autoupdater " << getTmpAutoupdaterPath();
@@ -284,7 +382,9 @@ BEGIN_SLOT_WRAPPER
         LOG << "New app version download";
         countDownloads["p_" + version]++;
         CHECK(countDownloads["p_" + version] < 5, "Maximum download");
-        client.sendMessageGet(QUrl(autoupdater), autoupdateGetCallback); // Без таймаута, так как загрузка большого бинарника
+        const QString appFileName = "app_" + version + ".zip";
+        removeOlderDownloads("app_", appFileName);
+        downloader.download(QUrl(autoupdater), makePath(getDownloadsPath(), appFileName), autoupdateGetCallback, downloadStallTimeout, downloadTotalTimeout);
 
         versionForUpdate = version;
     };
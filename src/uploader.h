@@ -10,6 +10,7 @@
 #include <QTimer>
 
 #include "client.h"
+#include "FileDownloader.h"
 
 #include "VersionWrapper.h"
 
@@ -70,10 +71,14 @@ public slots:
 
     void uploadEvent();
 
+    void onDownloadProgress(QString filePath, qint64 received, qint64 total);
+
 signals:
 
     void finished();
 
+    void downloadProgress(QString filePath, qint64 received, qint64 total);
+
     void generateUpdateHtmlsEvent();
 
     void generateUpdateApp(const QString version, const QString reference, const QString message);
@@ -88,6 +93,8 @@ private:
 
     SimpleClient client;
 
+    FileDownloader downloader;
+
     QString currentBeginPath;
 
     QString currFolder;
@@ -106,8 +113,22 @@ private:
 
     seconds timeout;
 
+    seconds downloadStallTimeout;
+
+    seconds downloadTotalTimeout;
+
+    bool isDeltaUpdates = true;
+
+    size_t deltaParallel = 4;
+
+    std::map<QString, int> downloadPercents;
+
     std::map<QString, int> countDownloads;
 
+private:
+
+    void finishHtmlsUpdate(const QString &folderServer, const QString &version);
+
 private:
 
     static std::mutex lastVersionMut;
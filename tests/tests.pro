@@ -6,3 +6,21 @@ SUBDIRS += tst_qrcoder
 SUBDIRS += tst_messengerdbstorage
 SUBDIRS += tst_transactionsdbstorage
 SUBDIRS += tst_walletnamesdbstorage
+SUBDIRS += tst_log
+SUBDIRS += tst_jsdeliveryqueue
+SUBDIRS += tst_makejsfunc
+SUBDIRS += tst_pagesmappings
+SUBDIRS += tst_mhcontentcache
+SUBDIRS += tst_hedgedrequest
+SUBDIRS += tst_streamingreplydevice
+SUBDIRS += tst_filedownloader
+SUBDIRS += tst_htmldeltaupdate
+SUBDIRS += tst_initializer
+SUBDIRS += tst_dbstorage
+SUBDIRS += tst_forkpointsearch
+SUBDIRS += tst_transactionssubscription
+SUBDIRS += tst_transactionssync
+SUBDIRS += tst_httpclient
+SUBDIRS += tst_httpcompression
+SUBDIRS += tst_nslookupcache
+SUBDIRS += tst_websocketclient
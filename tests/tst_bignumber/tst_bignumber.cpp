@@ -2,6 +2,8 @@
 
 #include <QTest>
 
+#include <openssl/bn.h>
+
 #include "BigNumber.h"
 
 tst_BigNumber::tst_BigNumber(QObject *parent)
@@ -167,4 +169,193 @@ void tst_BigNumber::testBigNumberSub()
     QCOMPARE(sub, res2);
 }
 
+void tst_BigNumber::testBigNumberOverflow_data()
+{
+    QTest::addColumn<QByteArray>("dec1");
+    QTest::addColumn<QByteArray>("dec2");
+    QTest::addColumn<QByteArray>("sum");
+    QTest::addColumn<bool>("isBig");
+    QTest::newRow("BigNumberOverflow 01")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << QByteArray("0")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << false;
+    QTest::newRow("BigNumberOverflow 02")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << QByteArray("1")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639936")
+            << true;
+    QTest::newRow("BigNumberOverflow 03")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639936")
+            << QByteArray("-1")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << false;
+    QTest::newRow("BigNumberOverflow 04")
+            << QByteArray("-115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << QByteArray("-1")
+            << QByteArray("-115792089237316195423570985008687907853269984665640564039457584007913129639936")
+            << true;
+    QTest::newRow("BigNumberOverflow 05")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << QByteArray("231584178474632390847141970017375815706539969331281128078915168015826259279870")
+            << true;
+    QTest::newRow("BigNumberOverflow 06")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639936")
+            << QByteArray("-115792089237316195423570985008687907853269984665640564039457584007913129639936")
+            << QByteArray("0")
+            << false;
+    QTest::newRow("BigNumberOverflow 07")
+            << QByteArray("-115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639935")
+            << QByteArray("0")
+            << false;
+    QTest::newRow("BigNumberOverflow 08")
+            << QByteArray("-0")
+            << QByteArray("000123")
+            << QByteArray("123")
+            << false;
+}
+
+void tst_BigNumber::testBigNumberOverflow()
+{
+    QFETCH(QByteArray, dec1);
+    QFETCH(QByteArray, dec2);
+    QFETCH(QByteArray, sum);
+    QFETCH(bool, isBig);
+    BigNumber num1(dec1);
+    const BigNumber num2(dec2);
+    num1 += num2;
+    QCOMPARE(num1.getDecimal(), sum);
+    QCOMPARE(num1.isBig(), isBig);
+    num1 -= num2;
+    QCOMPARE(num1, BigNumber(dec1));
+}
+
+void tst_BigNumber::testBigNumberCompare_data()
+{
+    QTest::addColumn<QByteArray>("dec1");
+    QTest::addColumn<QByteArray>("dec2");
+    QTest::addColumn<int>("result");
+    QTest::newRow("BigNumberCompare 01") << QByteArray("1") << QByteArray("2") << -1;
+    QTest::newRow("BigNumberCompare 02") << QByteArray("2") << QByteArray("1") << 1;
+    QTest::newRow("BigNumberCompare 03") << QByteArray("-1") << QByteArray("1") << -1;
+    QTest::newRow("BigNumberCompare 04") << QByteArray("-2") << QByteArray("-1") << -1;
+    QTest::newRow("BigNumberCompare 05") << QByteArray("0") << QByteArray("-0") << 0;
+    QTest::newRow("BigNumberCompare 06") << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639935") << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639936") << -1;
+    QTest::newRow("BigNumberCompare 07") << QByteArray("-115792089237316195423570985008687907853269984665640564039457584007913129639936") << QByteArray("-115792089237316195423570985008687907853269984665640564039457584007913129639935") << -1;
+    QTest::newRow("BigNumberCompare 08") << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639936") << QByteArray("115792089237316195423570985008687907853269984665640564039457584007913129639936") << 0;
+    QTest::newRow("BigNumberCompare 09") << QByteArray("12787328744987349849839843893434894894398") << QByteArray("12787328744987349849839843893434894894397") << 1;
+}
+
+void tst_BigNumber::testBigNumberCompare()
+{
+    QFETCH(QByteArray, dec1);
+    QFETCH(QByteArray, dec2);
+    QFETCH(int, result);
+    const BigNumber num1(dec1);
+    const BigNumber num2(dec2);
+    QCOMPARE(num1.compare(num2), result);
+    QCOMPARE(num2.compare(num1), -result);
+    QCOMPARE(num1 == num2, result == 0);
+    QCOMPARE(num1 < num2, result < 0);
+    QCOMPARE(num1 >= num2, result >= 0);
+}
+
+// Типичная сумма в минимальных единицах
+static const QByteArray BENCHMARK_AMOUNT("1234567890123456789012");
+static const QByteArray BENCHMARK_AMOUNT2("1234567890123456789013");
+
+// Реализации *Bignum повторяют прежнюю реализацию BigNumber поверх BIGNUM
+
+void tst_BigNumber::benchmarkParse()
+{
+    QBENCHMARK {
+        const BigNumber num(BENCHMARK_AMOUNT);
+        Q_UNUSED(num);
+    }
+}
+
+void tst_BigNumber::benchmarkParseBignum()
+{
+    QBENCHMARK {
+        BIGNUM *p = BN_new();
+        BN_dec2bn(&p, BENCHMARK_AMOUNT.constData());
+        BN_free(p);
+    }
+}
+
+void tst_BigNumber::benchmarkAdd()
+{
+    BigNumber sum;
+    const BigNumber amount(BENCHMARK_AMOUNT);
+    QBENCHMARK {
+        sum += amount;
+    }
+    QVERIFY(sum > amount);
+}
+
+void tst_BigNumber::benchmarkAddBignum()
+{
+    BIGNUM *sum = BN_new();
+    BIGNUM *amount = BN_new();
+    BN_dec2bn(&amount, BENCHMARK_AMOUNT.constData());
+    QBENCHMARK {
+        BN_add(sum, sum, amount);
+    }
+    QVERIFY(BN_cmp(sum, amount) > 0);
+    BN_free(amount);
+    BN_free(sum);
+}
+
+void tst_BigNumber::benchmarkCompare()
+{
+    const BigNumber num1(BENCHMARK_AMOUNT);
+    const BigNumber num2(BENCHMARK_AMOUNT2);
+    bool isLess = false;
+    QBENCHMARK {
+        isLess = num1 < num2;
+    }
+    QVERIFY(isLess);
+}
+
+void tst_BigNumber::benchmarkCompareBignum()
+{
+    BIGNUM *num1 = BN_new();
+    BIGNUM *num2 = BN_new();
+    BN_dec2bn(&num1, BENCHMARK_AMOUNT.constData());
+    BN_dec2bn(&num2, BENCHMARK_AMOUNT2.constData());
+    bool isLess = false;
+    QBENCHMARK {
+        isLess = BN_cmp(num1, num2) < 0;
+    }
+    QVERIFY(isLess);
+    BN_free(num2);
+    BN_free(num1);
+}
+
+void tst_BigNumber::benchmarkFormat()
+{
+    const BigNumber num(BENCHMARK_AMOUNT);
+    QByteArray res;
+    QBENCHMARK {
+        res = num.getDecimal();
+    }
+    QCOMPARE(res, BENCHMARK_AMOUNT);
+}
+
+void tst_BigNumber::benchmarkFormatBignum()
+{
+    BIGNUM *num = BN_new();
+    BN_dec2bn(&num, BENCHMARK_AMOUNT.constData());
+    QByteArray res;
+    QBENCHMARK {
+        char *str = BN_bn2dec(num);
+        res = QByteArray(str);
+        OPENSSL_free(str);
+    }
+    QCOMPARE(res, BENCHMARK_AMOUNT);
+    BN_free(num);
+}
+
 QTEST_MAIN(tst_BigNumber)
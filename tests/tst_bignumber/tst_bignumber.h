@@ -19,6 +19,24 @@ private slots:
 
     void testBigNumberSub_data();
     void testBigNumberSub();
+
+    void testBigNumberOverflow_data();
+    void testBigNumberOverflow();
+
+    void testBigNumberCompare_data();
+    void testBigNumberCompare();
+
+    void benchmarkParse();
+    void benchmarkParseBignum();
+
+    void benchmarkAdd();
+    void benchmarkAddBignum();
+
+    void benchmarkCompare();
+    void benchmarkCompareBignum();
+
+    void benchmarkFormat();
+    void benchmarkFormatBignum();
 };
 
 #endif // TST_BIGNUMBER_H
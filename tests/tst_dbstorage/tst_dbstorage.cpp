@@ -0,0 +1,276 @@
+#include "tst_dbstorage.h"
+
+#include <QTest>
+#include <QDir>
+#include <QtSql>
+#include <QDebug>
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "dbstorage.h"
+#include "check.h"
+#include "duration.h"
+
+namespace {
+
+const int COUNT_ACCOUNTS = 10;
+const qint64 INITIAL_BALANCE = 1000;
+const qint64 TOTAL_BALANCE = COUNT_ACCOUNTS * INITIAL_BALANCE;
+
+class AccountsDBStorage : public DBStorage {
+public:
+
+    struct Snapshot {
+        qint64 total = 0;
+        qint64 countTransfers = 0;
+    };
+
+public:
+
+    AccountsDBStorage(const QString &path)
+        : DBStorage(path, "accounts")
+    {}
+
+    int currentVersion() const override {
+        return 1;
+    }
+
+    void addBalance(int id, qint64 value) {
+        CachedQuery query = cachedQuery("UPDATE accounts SET balance = balance + :value WHERE id = :id");
+        query->bindValue(":value", value);
+        query->bindValue(":id", id);
+        CHECK(query->exec(), query->lastError().text().toStdString());
+    }
+
+    void transfer(int from, int to, qint64 value) {
+        auto transactionGuard = beginTransaction();
+        addBalance(from, -value);
+        addBalance(to, value);
+        CachedQuery query = cachedQuery("INSERT INTO transfers (ufrom, uto, value) VALUES (:from, :to, :value)");
+        query->bindValue(":from", from);
+        query->bindValue(":to", to);
+        query->bindValue(":value", value);
+        CHECK(query->exec(), query->lastError().text().toStdString());
+        transactionGuard.commit();
+    }
+
+    Snapshot snapshot() const {
+        ReadGuard reader = beginRead();
+        CachedQuery query = reader.query("SELECT (SELECT SUM(balance) FROM accounts) AS total, (SELECT COUNT(*) FROM transfers) AS countTransfers");
+        CHECK(query->exec(), query->lastError().text().toStdString());
+        CHECK(query->next(), "Empty result");
+        Snapshot result;
+        result.total = query->value("total").toLongLong();
+        result.countTransfers = query->value("countTransfers").toLongLong();
+        return result;
+    }
+
+protected:
+
+    void createDatabase() override {
+        createTable("accounts", "CREATE TABLE accounts (id INTEGER PRIMARY KEY, balance INTEGER NOT NULL)");
+        createTable("transfers", "CREATE TABLE transfers (id INTEGER PRIMARY KEY AUTOINCREMENT, ufrom INTEGER, uto INTEGER, value INTEGER)");
+        for (int i = 0; i < COUNT_ACCOUNTS; i++) {
+            CachedQuery query = cachedQuery("INSERT INTO accounts (id, balance) VALUES (:id, :balance)");
+            query->bindValue(":id", i);
+            query->bindValue(":balance", INITIAL_BALANCE);
+            CHECK(query->exec(), query->lastError().text().toStdString());
+        }
+    }
+};
+
+QString preparePath(const QString &name) {
+    QDir(name).removeRecursively();
+    CHECK(QDir().mkpath(name), "Not create folder");
+    return name;
+}
+
+}
+
+tst_DBStorage::tst_DBStorage(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_DBStorage::testCachedQuery()
+{
+    AccountsDBStorage db(preparePath("cached"));
+    db.init();
+
+    const QString sql = "SELECT balance FROM accounts WHERE id = :id";
+    QSqlQuery *first;
+    {
+        DBStorage::CachedQuery query1 = db.cachedQuery(sql);
+        first = &*query1;
+        // Пока запрос занят, выдается отдельный
+        DBStorage::CachedQuery query2 = db.cachedQuery(sql);
+        QVERIFY(&*query2 != first);
+    }
+    {
+        DBStorage::CachedQuery query = db.cachedQuery(sql);
+        QCOMPARE(&*query, first);
+        query->bindValue(":id", 1);
+        QVERIFY(query->exec());
+        QVERIFY(query->next());
+        QCOMPARE(query->value("balance").toLongLong(), INITIAL_BALANCE);
+    }
+
+    QString connectionName;
+    {
+        DBStorage::ReadGuard reader = db.beginRead();
+        connectionName = reader.database().connectionName();
+        QVERIFY(connectionName != db.dbName());
+    }
+    {
+        DBStorage::ReadGuard reader = db.beginRead();
+        QCOMPARE(reader.database().connectionName(), connectionName);
+    }
+}
+
+void tst_DBStorage::testThreadConnections()
+{
+    AccountsDBStorage db(preparePath("threads"));
+    db.init();
+    db.setMaxReadConnections(1);
+
+    QString mainConnectionName;
+    {
+        DBStorage::ReadGuard reader = db.beginRead();
+        mainConnectionName = reader.database().connectionName();
+        // Вложенное чтение в том же потоке идет через то же соединение
+        DBStorage::ReadGuard nested = db.beginRead();
+        QCOMPARE(nested.database().connectionName(), mainConnectionName);
+    }
+
+    // Лимит занят соединением основного потока, поток ждет, пока его отдадут
+    QString threadConnectionName;
+    milliseconds threadWait(0);
+    std::atomic<bool> isThreadStarted(false);
+    std::thread thread;
+    {
+        DBStorage::ReadGuard reader = db.beginRead();
+        thread = std::thread([&]{
+            isThreadStarted = true;
+            const time_point begin = ::now();
+            DBStorage::ReadGuard threadReader = db.beginRead();
+            threadWait = std::chrono::duration_cast<milliseconds>(::now() - begin);
+            threadConnectionName = threadReader.database().connectionName();
+            QSqlQuery query(threadReader.database());
+            CHECK(query.exec("SELECT COUNT(*) FROM accounts"), query.lastError().text().toStdString());
+        });
+        while (!isThreadStarted.load()) {
+            std::this_thread::sleep_for(1ms);
+        }
+        std::this_thread::sleep_for(300ms);
+    }
+    thread.join();
+    QVERIFY(threadWait >= 250ms);
+    QVERIFY(threadConnectionName != mainConnectionName);
+
+    // Соединение потока закрылось при его выходе, место в пуле свободно
+    const time_point begin = ::now();
+    {
+        DBStorage::ReadGuard reader = db.beginRead();
+        QVERIFY(reader.database().isOpen());
+    }
+    QVERIFY(::now() - begin < 1s);
+}
+
+void tst_DBStorage::testReadInTransaction()
+{
+    AccountsDBStorage db(preparePath("intransaction"));
+    db.init();
+
+    auto transactionGuard = db.beginTransaction();
+    db.addBalance(0, 5);
+    // Свой поток видит незакоммиченные изменения
+    QCOMPARE(db.snapshot().total, TOTAL_BALANCE + 5);
+
+    qint64 otherTotal = 0;
+    std::thread thread([&db, &otherTotal]{
+        otherTotal = db.snapshot().total;
+    });
+    thread.join();
+    QCOMPARE(otherTotal, TOTAL_BALANCE);
+
+    transactionGuard.commit();
+    QCOMPARE(db.snapshot().total, TOTAL_BALANCE + 5);
+}
+
+void tst_DBStorage::testReadersAndWriter_data()
+{
+    QTest::addColumn<int>("countReaders");
+    QTest::addColumn<int>("maxConnections");
+    QTest::newRow("1 reader") << 1 << 4;
+    QTest::newRow("4 readers") << 4 << 4;
+    QTest::newRow("8 readers, pool 3") << 8 << 3;
+}
+
+void tst_DBStorage::testReadersAndWriter()
+{
+    QFETCH(int, countReaders);
+    QFETCH(int, maxConnections);
+
+    const int countTransfers = 2000;
+
+    AccountsDBStorage db(preparePath("concurrent"));
+    db.init();
+    db.setMaxReadConnections(maxConnections);
+
+    std::atomic<bool> isFinished(false);
+    std::atomic<qint64> countReads(0);
+    std::mutex errorsMut;
+    std::vector<std::string> errors;
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < countReaders; i++) {
+        readers.emplace_back([&]{
+            qint64 lastCount = 0;
+            try {
+                while (!isFinished.load()) {
+                    const AccountsDBStorage::Snapshot snapshot = db.snapshot();
+                    CHECK(snapshot.total == TOTAL_BALANCE, "Incorrect total " + std::to_string(snapshot.total));
+                    CHECK(snapshot.countTransfers >= lastCount, "Transfers count decreased");
+                    lastCount = snapshot.countTransfers;
+                    countReads++;
+                }
+            } catch (const Exception &e) {
+                std::lock_guard<std::mutex> lock(errorsMut);
+                errors.emplace_back(e);
+            }
+        });
+    }
+
+    const time_point begin = ::now();
+    try {
+        for (int i = 0; i < countTransfers; i++) {
+            db.transfer(i % COUNT_ACCOUNTS, (i * 7 + 3) % COUNT_ACCOUNTS, i % 50 + 1);
+        }
+    } catch (const Exception &e) {
+        std::lock_guard<std::mutex> lock(errorsMut);
+        errors.emplace_back(e);
+    }
+    const milliseconds elapsed = std::chrono::duration_cast<milliseconds>(::now() - begin);
+    isFinished = true;
+    for (std::thread &reader: readers) {
+        reader.join();
+    }
+
+    for (const std::string &error: errors) {
+        qDebug() << QString::fromStdString(error);
+    }
+    QVERIFY(errors.empty());
+
+    const AccountsDBStorage::Snapshot snapshot = db.snapshot();
+    QCOMPARE(snapshot.total, TOTAL_BALANCE);
+    QCOMPARE(snapshot.countTransfers, qint64(countTransfers));
+    QVERIFY(countReads.load() > 0);
+
+    const double seconds = std::max<qint64>(elapsed.count(), 1) / 1000.;
+    qDebug() << "Writes:" << countTransfers / seconds << "/s, reads:" << countReads.load() / seconds << "/s," << elapsed.count() << "ms";
+}
+
+QTEST_MAIN(tst_DBStorage)
@@ -0,0 +1,24 @@
+#ifndef TST_DBSTORAGE_H
+#define TST_DBSTORAGE_H
+
+#include <QObject>
+
+class tst_DBStorage : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_DBStorage(QObject *parent = nullptr);
+
+private slots:
+
+    void testCachedQuery();
+
+    void testThreadConnections();
+
+    void testReadInTransaction();
+
+    void testReadersAndWriter_data();
+    void testReadersAndWriter();
+};
+
+#endif // TST_DBSTORAGE_H
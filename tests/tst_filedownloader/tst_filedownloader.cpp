@@ -0,0 +1,364 @@
+#include "tst_filedownloader.h"
+
+#include <QTest>
+#include <QTcpSocket>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QCryptographicHash>
+#include <QEventLoop>
+
+#include "FileDownloader.h"
+
+const static qint64 CHUNK_SIZE = 64 * 1024;
+
+BinaryServer::BinaryServer(qint64 bodySize, Mode mode, qint64 cutOffset, QObject *parent)
+    : QObject(parent)
+    , bodySize(bodySize)
+    , mode(mode)
+    , cutOffset(cutOffset)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &BinaryServer::onNewConnection);
+}
+
+QString BinaryServer::url() const {
+    return "http://127.0.0.1:" + QString::number(server.serverPort()) + "/app.zip";
+}
+
+QByteArray BinaryServer::makeChunk(qint64 offset, qint64 size) {
+    return QByteArray(size, char('a' + (offset / CHUNK_SIZE) % 26));
+}
+
+void BinaryServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            socket->readAll();
+            written = 0;
+            socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/zip\r\nContent-Length: " + QByteArray::number(bodySize) + "\r\nConnection: close\r\n\r\n");
+            writeMore(socket);
+        });
+        connect(socket, &QTcpSocket::bytesWritten, [this, socket]() {
+            writeMore(socket);
+        });
+    }
+}
+
+void BinaryServer::writeMore(QTcpSocket *socket) {
+    const qint64 limit = mode == Mode::Full ? bodySize : cutOffset;
+    while (written < limit && socket->bytesToWrite() < 2 * CHUNK_SIZE) {
+        const qint64 size = std::min(CHUNK_SIZE - written % CHUNK_SIZE, limit - written);
+        socket->write(makeChunk(written, size));
+        written += size;
+    }
+    if (written == limit && mode == Mode::Close && socket->bytesToWrite() == 0) {
+        socket->disconnectFromHost();
+    }
+}
+
+RangeServer::RangeServer(qint64 bodySize, bool isRangeSupported, int countCuts, QObject *parent)
+    : QObject(parent)
+    , bodySize(bodySize)
+    , isRangeSupported(isRangeSupported)
+    , countCuts(countCuts)
+    , random(12345)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &RangeServer::onNewConnection);
+}
+
+QString RangeServer::url() const {
+    return "http://127.0.0.1:" + QString::number(server.serverPort()) + "/html.zip";
+}
+
+void RangeServer::setVersion(int version) {
+    this->version = version;
+}
+
+QByteArray RangeServer::etag() const {
+    return "\"v" + QByteArray::number(version) + "\"";
+}
+
+QByteArray RangeServer::makeData(int version, qint64 offset, qint64 size) {
+    QByteArray result(size, 0);
+    for (qint64 i = 0; i < size; i++) {
+        const qint64 pos = offset + i;
+        result[int(i)] = char('a' + (pos / 1000 + pos * 7 + version) % 26);
+    }
+    return result;
+}
+
+void RangeServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connections[socket];
+        connect(socket, &QTcpSocket::disconnected, [this, socket]() {
+            connections.erase(socket);
+            socket->deleteLater();
+        });
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            Connection &connection = connections[socket];
+            connection.request += socket->readAll();
+            if (!connection.isStarted && connection.request.contains("\r\n\r\n")) {
+                startResponse(socket, connection);
+            }
+        });
+        connect(socket, &QTcpSocket::bytesWritten, [this, socket]() {
+            writeMore(socket);
+        });
+    }
+}
+
+void RangeServer::startResponse(QTcpSocket *socket, Connection &connection) {
+    connection.isStarted = true;
+    qint64 begin = 0;
+    QByteArray ifRange;
+    bool isRange = false;
+    for (const QByteArray &line: connection.request.split('\n')) {
+        const QByteArray header = line.trimmed();
+        if (header.toLower().startsWith("range: bytes=")) {
+            begin = header.mid(13, header.indexOf('-') - 13).toLongLong();
+            isRange = true;
+        } else if (header.toLower().startsWith("if-range: ")) {
+            ifRange = header.mid(10);
+        }
+    }
+    if (isRange) {
+        rangeBegins.emplace_back(begin);
+    }
+    if (!isRangeSupported || !isRange || (!ifRange.isEmpty() && ifRange != etag())) {
+        begin = 0;
+    }
+
+    QByteArray headers;
+    if (begin > 0) {
+        headers = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + QByteArray::number(begin) + "-" + QByteArray::number(bodySize - 1) + "/" + QByteArray::number(bodySize) + "\r\n";
+    } else {
+        headers = "HTTP/1.1 200 OK\r\n";
+    }
+    headers += "Content-Type: application/zip\r\nContent-Length: " + QByteArray::number(bodySize - begin) + "\r\nETag: " + etag() + "\r\nConnection: close\r\n\r\n";
+    socket->write(headers);
+
+    connection.written = begin;
+    connection.limit = bodySize;
+    if (countCuts > 0) {
+        countCuts--;
+        connection.limit = begin + std::uniform_int_distribution<qint64>(1, bodySize - begin - 1)(random);
+    }
+    writeMore(socket);
+}
+
+void RangeServer::writeMore(QTcpSocket *socket) {
+    const auto found = connections.find(socket);
+    if (found == connections.end() || !found->second.isStarted) {
+        return;
+    }
+    Connection &connection = found->second;
+    while (connection.written < connection.limit && socket->bytesToWrite() < 2 * CHUNK_SIZE) {
+        const qint64 size = std::min(CHUNK_SIZE, connection.limit - connection.written);
+        socket->write(makeData(version, connection.written, size));
+        connection.written += size;
+    }
+    if (connection.written == connection.limit && connection.limit != bodySize && socket->bytesToWrite() == 0) {
+        socket->disconnectFromHost();
+    }
+}
+
+static qint64 peakRssKb() {
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (const QByteArray &line: file.readAll().split('\n')) {
+        if (line.startsWith("VmHWM:")) {
+            return line.mid(6).trimmed().split(' ').front().toLongLong();
+        }
+    }
+    return -1;
+}
+
+static QString expectedHash(qint64 bodySize, QCryptographicHash::Algorithm algorithm) {
+    QCryptographicHash hash(algorithm);
+    for (qint64 offset = 0; offset < bodySize; offset += CHUNK_SIZE) {
+        hash.addData(BinaryServer::makeChunk(offset, std::min(CHUNK_SIZE, bodySize - offset)));
+    }
+    return QString(hash.result().toHex());
+}
+
+struct DownloadResult {
+    FileDownloader::Result result;
+    SimpleClient::ServerException exception;
+    qint64 lastProgress = 0;
+};
+
+static DownloadResult download(const QString &url, const QString &filePath, milliseconds stallTimeout, milliseconds totalTimeout) {
+    FileDownloader downloader;
+    DownloadResult result;
+    QEventLoop loop;
+    QObject::connect(&downloader, &FileDownloader::callbackCall, [&](SimpleClient::ReturnCallback callback) {
+        callback();
+        loop.quit();
+    });
+    QObject::connect(&downloader, &FileDownloader::progress, [&](QString, qint64 received, qint64) {
+        result.lastProgress = received;
+    });
+    downloader.download(QUrl(url), filePath, [&](const FileDownloader::Result &r, const SimpleClient::ServerException &exception) {
+        result.result = r;
+        result.exception = exception;
+    }, stallTimeout, totalTimeout);
+    loop.exec();
+    return result;
+}
+
+tst_FileDownloader::tst_FileDownloader(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_FileDownloader::testSmallFile() {
+    const qint64 BODY_SIZE = 1024 * 1024 + 100;
+    BinaryServer server(BODY_SIZE, BinaryServer::Mode::Full, 0);
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath("app.zip");
+
+    const DownloadResult result = download(server.url(), filePath, 5s, 60s);
+    QVERIFY(!result.exception.isSet());
+    QCOMPARE(result.result.filePath, filePath);
+    QCOMPARE(result.result.size, BODY_SIZE);
+    QCOMPARE(result.lastProgress, BODY_SIZE);
+    QCOMPARE(result.result.md5, expectedHash(BODY_SIZE, QCryptographicHash::Md5));
+    QCOMPARE(result.result.sha256, expectedHash(BODY_SIZE, QCryptographicHash::Sha256));
+    QCOMPARE(QFile(filePath).size(), BODY_SIZE);
+    QVERIFY(!QFile::exists(filePath + ".part"));
+}
+
+void tst_FileDownloader::testLargeFileMemory() {
+    const qint64 BODY_SIZE = 300LL * 1024 * 1024;
+    BinaryServer server(BODY_SIZE, BinaryServer::Mode::Full, 0);
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath("app.zip");
+
+    const QString sha256 = expectedHash(BODY_SIZE, QCryptographicHash::Sha256);
+    const qint64 rssBefore = peakRssKb();
+    if (rssBefore < 0) {
+        QSKIP("Peak RSS is not available on this platform");
+    }
+    const DownloadResult result = download(server.url(), filePath, 10s, 600s);
+    const qint64 rssAfter = peakRssKb();
+
+    QVERIFY(!result.exception.isSet());
+    QCOMPARE(result.result.size, BODY_SIZE);
+    QCOMPARE(result.result.sha256, sha256);
+    QCOMPARE(QFile(filePath).size(), BODY_SIZE);
+    qDebug() << "Peak RSS growth:" << (rssAfter - rssBefore) / 1024 << "MB";
+    QVERIFY(rssAfter - rssBefore < 64 * 1024);
+}
+
+void tst_FileDownloader::testStall() {
+    BinaryServer server(10 * 1024 * 1024, BinaryServer::Mode::Stall, 1024 * 1024);
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath("app.zip");
+
+    const DownloadResult result = download(server.url(), filePath, 2s, 60s);
+    QVERIFY(result.exception.isSet());
+    QVERIFY(result.exception.description.find("stalled") != std::string::npos);
+    QVERIFY(!QFile::exists(filePath));
+    // Полученная часть остается для докачки
+    QVERIFY(QFile::exists(filePath + ".part"));
+    QVERIFY(QFile::exists(filePath + ".part.meta"));
+    QVERIFY(QFile(filePath + ".part").size() > 0);
+    QVERIFY(QFile(filePath + ".part").size() <= 1024 * 1024);
+}
+
+void tst_FileDownloader::testIncomplete() {
+    BinaryServer server(10 * 1024 * 1024, BinaryServer::Mode::Close, 3 * 1024 * 1024 + 17);
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath("app.zip");
+
+    const DownloadResult result = download(server.url(), filePath, 5s, 60s);
+    QVERIFY(result.exception.isSet());
+    QVERIFY(!QFile::exists(filePath));
+    // Полученная часть остается для докачки
+    QVERIFY(QFile::exists(filePath + ".part"));
+    QVERIFY(QFile::exists(filePath + ".part.meta"));
+    QVERIFY(QFile(filePath + ".part").size() > 0);
+    QVERIFY(QFile(filePath + ".part").size() <= 3 * 1024 * 1024 + 17);
+}
+
+static QString expectedRangeHash(int version, qint64 bodySize) {
+    return QString(QCryptographicHash::hash(RangeServer::makeData(version, 0, bodySize), QCryptographicHash::Sha256).toHex());
+}
+
+// Качает, пока не получится, как Uploader на следующих циклах проверки
+static DownloadResult downloadWithRetries(const QString &url, const QString &filePath, int maxAttempts, int &countAttempts) {
+    DownloadResult result;
+    for (countAttempts = 1; countAttempts <= maxAttempts; countAttempts++) {
+        result = download(url, filePath, 5s, 60s);
+        if (!result.exception.isSet()) {
+            break;
+        }
+    }
+    return result;
+}
+
+void tst_FileDownloader::testResume() {
+    const qint64 BODY_SIZE = 5 * 1024 * 1024 + 333;
+    const int COUNT_CUTS = 6;
+    RangeServer server(BODY_SIZE, true, COUNT_CUTS);
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath("html.zip");
+
+    int countAttempts = 0;
+    const DownloadResult result = downloadWithRetries(server.url(), filePath, 20, countAttempts);
+    QVERIFY(!result.exception.isSet());
+    QCOMPARE(countAttempts, COUNT_CUTS + 1);
+    QCOMPARE(result.result.size, BODY_SIZE);
+    QVERIFY(result.result.resumedFrom > 0);
+    QCOMPARE(result.result.sha256, expectedRangeHash(0, BODY_SIZE));
+    QCOMPARE(QFile(filePath).size(), BODY_SIZE);
+    QVERIFY(!QFile::exists(filePath + ".part"));
+    QVERIFY(!QFile::exists(filePath + ".part.meta"));
+
+    QCOMPARE(int(server.rangeBegins.size()), COUNT_CUTS);
+    for (size_t i = 1; i < server.rangeBegins.size(); i++) {
+        QVERIFY(server.rangeBegins[i] > server.rangeBegins[i - 1]);
+    }
+}
+
+void tst_FileDownloader::testResumeIgnoredRange() {
+    const qint64 BODY_SIZE = 3 * 1024 * 1024;
+    RangeServer server(BODY_SIZE, false, 2);
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath("html.zip");
+
+    int countAttempts = 0;
+    const DownloadResult result = downloadWithRetries(server.url(), filePath, 20, countAttempts);
+    QVERIFY(!result.exception.isSet());
+    QCOMPARE(countAttempts, 3);
+    QCOMPARE(result.result.resumedFrom, qint64(0));
+    QCOMPARE(result.result.size, BODY_SIZE);
+    QCOMPARE(result.result.sha256, expectedRangeHash(0, BODY_SIZE));
+    QVERIFY(!server.rangeBegins.empty());
+}
+
+void tst_FileDownloader::testResumeChangedFile() {
+    const qint64 BODY_SIZE = 3 * 1024 * 1024;
+    RangeServer server(BODY_SIZE, true, 1);
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath("html.zip");
+
+    const DownloadResult first = download(server.url(), filePath, 5s, 60s);
+    QVERIFY(first.exception.isSet());
+    QVERIFY(QFile::exists(filePath + ".part"));
+
+    // Файл на сервере заменили, If-Range не совпадет и сервер отдаст его целиком
+    server.setVersion(1);
+    const DownloadResult second = download(server.url(), filePath, 5s, 60s);
+    QVERIFY(!second.exception.isSet());
+    QCOMPARE(second.result.resumedFrom, qint64(0));
+    QCOMPARE(second.result.sha256, expectedRangeHash(1, BODY_SIZE));
+    QCOMPARE(server.rangeBegins.size(), size_t(1));
+}
+
+QTEST_MAIN(tst_FileDownloader)
@@ -0,0 +1,130 @@
+#ifndef TST_FILEDOWNLOADER_H
+#define TST_FILEDOWNLOADER_H
+
+#include <QObject>
+#include <QTcpServer>
+
+#include <map>
+#include <random>
+#include <vector>
+
+class QTcpSocket;
+
+// Локальный сервер, отдающий большой файл кусками.
+// После cutOffset байт либо замолкает, либо рвет соединение
+class BinaryServer : public QObject {
+    Q_OBJECT
+public:
+
+    enum class Mode {
+        Full, Stall, Close
+    };
+
+public:
+
+    BinaryServer(qint64 bodySize, Mode mode, qint64 cutOffset, QObject *parent = nullptr);
+
+    QString url() const;
+
+    static QByteArray makeChunk(qint64 offset, qint64 size);
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    void writeMore(QTcpSocket *socket);
+
+private:
+
+    QTcpServer server;
+
+    const qint64 bodySize;
+
+    const Mode mode;
+
+    const qint64 cutOffset;
+
+    qint64 written = 0;
+};
+
+// Локальный сервер с поддержкой Range и If-Range.
+// Первые countCuts ответов рвутся на случайном смещении
+class RangeServer : public QObject {
+    Q_OBJECT
+public:
+
+    RangeServer(qint64 bodySize, bool isRangeSupported, int countCuts, QObject *parent = nullptr);
+
+    QString url() const;
+
+    // Меняет содержимое и ETag файла
+    void setVersion(int version);
+
+    static QByteArray makeData(int version, qint64 offset, qint64 size);
+
+    std::vector<qint64> rangeBegins;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    struct Connection {
+        QByteArray request;
+        bool isStarted = false;
+        qint64 written = 0;
+        qint64 limit = 0;
+    };
+
+private:
+
+    QByteArray etag() const;
+
+    void startResponse(QTcpSocket *socket, Connection &connection);
+
+    void writeMore(QTcpSocket *socket);
+
+private:
+
+    QTcpServer server;
+
+    const qint64 bodySize;
+
+    const bool isRangeSupported;
+
+    int countCuts;
+
+    int version = 0;
+
+    std::mt19937 random;
+
+    std::map<QTcpSocket*, Connection> connections;
+};
+
+class tst_FileDownloader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_FileDownloader(QObject *parent = nullptr);
+
+private slots:
+
+    void testSmallFile();
+
+    void testLargeFileMemory();
+
+    void testStall();
+
+    void testIncomplete();
+
+    void testResume();
+
+    void testResumeIgnoredRange();
+
+    void testResumeChangedFile();
+};
+
+#endif // TST_FILEDOWNLOADER_H
@@ -0,0 +1,30 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network
+TARGET = tst_filedownloader
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src
+
+SOURCES += \
+    tst_filedownloader.cpp \
+    ../../src/FileDownloader.cpp \
+    ../../src/QRegister.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp
+
+HEADERS += \
+    tst_filedownloader.h \
+    ../../src/FileDownloader.h \
+    ../../src/Log.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)
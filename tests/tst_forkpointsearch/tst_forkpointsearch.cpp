@@ -0,0 +1,349 @@
+#include "tst_forkpointsearch.h"
+
+#include <QTest>
+#include <QTcpSocket>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QEventLoop>
+
+#include <cmath>
+#include <cstring>
+
+#include "check.h"
+#include "ForkPointSearch.h"
+#include "TransactionsDBStorage.h"
+#include "TransactionsMessages.h"
+
+using namespace transactions;
+
+MockTorrentNode::MockTorrentNode(int64_t countBlocks, QObject *parent)
+    : QObject(parent)
+{
+    for (int64_t i = 0; i <= countBlocks; i++) {
+        hashes.emplace_back("hash_0_" + QString::number(i));
+    }
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &MockTorrentNode::onNewConnection);
+}
+
+QString MockTorrentNode::url() const {
+    return "http://127.0.0.1:" + QString::number(server.serverPort()) + "/";
+}
+
+QString MockTorrentNode::blockHash(int64_t number) const {
+    return hashes.at(static_cast<size_t>(number));
+}
+
+int64_t MockTorrentNode::lastBlock() const {
+    return static_cast<int64_t>(hashes.size()) - 1;
+}
+
+void MockTorrentNode::reorg(int64_t depth, int64_t addBlocks) {
+    countReorgs++;
+    const int64_t from = std::max<int64_t>(1, lastBlock() - depth + 1);
+    hashes.resize(static_cast<size_t>(from));
+    for (int64_t i = from; i <= from + depth + addBlocks - 1; i++) {
+        hashes.emplace_back("hash_" + QString::number(countReorgs) + "_" + QString::number(i));
+    }
+}
+
+QByteArray MockTorrentNode::processRequest(const QByteArray &body) {
+    const QJsonObject request = QJsonDocument::fromJson(body).object();
+    const QString method = request.value("method").toString();
+    QJsonObject response;
+    response.insert("jsonrpc", "2.0");
+    if (method == "get-count-blocks") {
+        QJsonObject result;
+        result.insert("count_blocks", static_cast<int>(lastBlock()));
+        response.insert("result", result);
+    } else if (method == "get-block-by-number") {
+        countBlockRequests++;
+        const int64_t number = request.value("params").toObject().value("number").toInt();
+        if (number < 0 || number > lastBlock()) {
+            QJsonObject error;
+            error.insert("message", "Block not found");
+            response.insert("error", error);
+        } else {
+            QJsonObject result;
+            result.insert("hash", blockHash(number));
+            result.insert("number", static_cast<int>(number));
+            response.insert("result", result);
+        }
+    } else {
+        QJsonObject error;
+        error.insert("message", "Unknown method");
+        response.insert("error", error);
+    }
+    return QJsonDocument(response).toJson(QJsonDocument::Compact);
+}
+
+void MockTorrentNode::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::destroyed, [this, socket]() {
+            buffers.erase(socket);
+        });
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            QByteArray &buffer = buffers[socket];
+            buffer += socket->readAll();
+            const int headersEnd = buffer.indexOf("\r\n\r\n");
+            if (headersEnd == -1) {
+                return;
+            }
+            int contentLength = 0;
+            for (const QByteArray &line: buffer.left(headersEnd).split('\n')) {
+                if (line.toLower().startsWith("content-length:")) {
+                    contentLength = line.mid(int(strlen("content-length:"))).trimmed().toInt();
+                }
+            }
+            if (buffer.size() < headersEnd + 4 + contentLength) {
+                return;
+            }
+            const QByteArray response = processRequest(buffer.mid(headersEnd + 4, contentLength));
+            buffer.clear();
+            socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + QByteArray::number(response.size()) + "\r\nConnection: close\r\n\r\n" + response);
+            socket->disconnectFromHost();
+        });
+    }
+}
+
+static QNetworkReply* post(QNetworkAccessManager &manager, const QString &url, const QString &message) {
+    QNetworkRequest request((QUrl(url)));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    return manager.post(request, message.toUtf8());
+}
+
+static int64_t getCountBlocks(QNetworkAccessManager &manager, const QString &url) {
+    QNetworkReply *reply = post(manager, url, makeGetCountBlocksRequest());
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    reply->deleteLater();
+    CHECK(reply->error() == QNetworkReply::NoError, reply->errorString().toStdString());
+    return parseGetCountBlocksResponse(QString(reply->readAll()));
+}
+
+static ForkPointSearch::Result searchOnNode(QNetworkAccessManager &manager, const QString &url, const std::vector<BlockCheckpoint> &checkpoints, int64_t serverBlockNumber) {
+    const auto getBlockHash = [&manager, url](int64_t blockNumber, const ForkPointSearch::BlockHashCallback &callback) {
+        QNetworkReply *reply = post(manager, url, makeGetBlockInfoRequest(blockNumber));
+        QObject::connect(reply, &QNetworkReply::finished, [reply, callback]() {
+            reply->deleteLater();
+            const BlockInfo bi = parseGetBlockInfoResponse(QString(reply->readAll()));
+            callback(bi.hash, TypedException());
+        });
+    };
+
+    ForkPointSearch::Result result;
+    bool isFinished = false;
+    QEventLoop loop;
+    ForkPointSearch::start(checkpoints, serverBlockNumber, getBlockHash, [&result, &isFinished, &loop](const ForkPointSearch::Result &r) {
+        result = r;
+        isFinished = true;
+        loop.quit();
+    });
+    if (!isFinished) {
+        loop.exec();
+    }
+    return result;
+}
+
+static size_t maxRequests(size_t countCheckpoints) {
+    return 1 + static_cast<size_t>(std::ceil(std::log2(std::max<size_t>(countCheckpoints, 1))));
+}
+
+tst_ForkPointSearch::tst_ForkPointSearch(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_ForkPointSearch::testSearch_data()
+{
+    QTest::addColumn<int>("countCheckpoints");
+    QTest::addColumn<int>("countEqual");
+    QTest::addColumn<int>("serverBlockNumber");
+
+    QTest::newRow("empty") << 0 << 0 << 1000;
+    QTest::newRow("one equal") << 1 << 1 << 1000;
+    QTest::newRow("one not equal") << 1 << 0 << 1000;
+    QTest::newRow("all equal") << 64 << 64 << 1000;
+    QTest::newRow("last not equal") << 64 << 63 << 1000;
+    QTest::newRow("half") << 64 << 32 << 1000;
+    QTest::newRow("first equal") << 64 << 1 << 1000;
+    QTest::newRow("none equal") << 64 << 0 << 1000;
+    QTest::newRow("server behind") << 64 << 64 << 200;
+}
+
+void tst_ForkPointSearch::testSearch()
+{
+    QFETCH(int, countCheckpoints);
+    QFETCH(int, countEqual);
+    QFETCH(int, serverBlockNumber);
+
+    // checkpoint i в блоке 10 * (i + 1)
+    std::vector<BlockCheckpoint> checkpoints;
+    for (int i = 0; i < countCheckpoints; i++) {
+        checkpoints.emplace_back("address", "mh", 10 * (i + 1), "hash" + QString::number(i));
+    }
+    std::vector<int64_t> requested;
+    const auto getBlockHash = [&requested, countEqual](int64_t blockNumber, const ForkPointSearch::BlockHashCallback &callback) {
+        requested.emplace_back(blockNumber);
+        const int64_t index = blockNumber / 10 - 1;
+        callback(index < countEqual ? "hash" + QString::number(index) : "other", TypedException());
+    };
+
+    ForkPointSearch::Result result;
+    ForkPointSearch::start(checkpoints, serverBlockNumber, getBlockHash, [&result](const ForkPointSearch::Result &r) {
+        result = r;
+    });
+
+    const int countCandidates = std::min(countCheckpoints, serverBlockNumber / 10);
+    const int expectedEqual = std::min(countEqual, countCandidates);
+    QCOMPARE(result.isFound, expectedEqual != 0);
+    if (result.isFound) {
+        QCOMPARE(result.forkPoint.blockNumber, int64_t(10 * expectedEqual));
+    }
+    QCOMPARE(result.isLast, countCheckpoints != 0 && expectedEqual == countCheckpoints);
+    QCOMPARE(result.countRequests, requested.size());
+    QVERIFY(result.countRequests <= maxRequests(size_t(countCandidates)));
+    for (const int64_t blockNumber: requested) {
+        QVERIFY(blockNumber <= serverBlockNumber);
+    }
+    if (countCandidates != 0) {
+        // Без реорганизации достаточно одного запроса
+        QCOMPARE(requested.front(), int64_t(10 * countCandidates));
+    }
+}
+
+void tst_ForkPointSearch::testProbeFailed()
+{
+    std::vector<BlockCheckpoint> checkpoints;
+    for (int i = 0; i < 64; i++) {
+        checkpoints.emplace_back("address", "mh", 10 * (i + 1), "hash" + QString::number(i));
+    }
+    // Последний checkpoint не совпал, второй запрос не отвечает ни один сервер
+    std::vector<int64_t> requested;
+    const auto getBlockHash = [&requested](int64_t blockNumber, const ForkPointSearch::BlockHashCallback &callback) {
+        requested.emplace_back(blockNumber);
+        if (requested.size() == 1) {
+            callback("other", TypedException());
+        } else {
+            callback("", TypedException(TypeErrors::TRANSACTIONS_SERVER_NOT_FOUND, "Not found"));
+        }
+    };
+
+    ForkPointSearch::Result result;
+    bool isFinished = false;
+    ForkPointSearch::start(checkpoints, 1000, getBlockHash, [&result, &isFinished](const ForkPointSearch::Result &r) {
+        result = r;
+        isFinished = true;
+    });
+    QVERIFY(isFinished);
+    QVERIFY(result.isFailed);
+    QVERIFY(!result.isFound);
+    QCOMPARE(requested.size(), size_t(2));
+}
+
+void tst_ForkPointSearch::testReorg_data()
+{
+    QTest::addColumn<int>("depth");
+    QTest::addColumn<int>("addBlocks");
+
+    QTest::newRow("no reorg") << 0 << 3;
+    QTest::newRow("depth 1") << 1 << 1;
+    QTest::newRow("depth 5") << 5 << 0;
+    QTest::newRow("depth 37") << 37 << 2;
+    QTest::newRow("depth 120") << 120 << 5;
+    QTest::newRow("beyond checkpoints") << 250 << 1;
+}
+
+void tst_ForkPointSearch::testReorg()
+{
+    QFETCH(int, depth);
+    QFETCH(int, addBlocks);
+
+    const QString address = "address1";
+    const QString currency = "mh";
+    const int64_t countBlocks = 300;
+    // Транзакции адреса в каждом втором блоке, начиная с 100
+    const int64_t firstTxBlock = 100;
+
+    MockTorrentNode node(countBlocks);
+    QNetworkAccessManager manager;
+
+    const QString dbName = "payments.db";
+    if (QFile::exists(dbName))
+        QFile::remove(dbName);
+    TransactionsDBStorage db;
+    db.init();
+    qint64 countTxs = 0;
+    for (int64_t block = firstTxBlock; block <= countBlocks; block += 2) {
+        auto transactionGuard = db.beginTransaction();
+        db.addPayment(currency, "tx" + QString::number(block), address, false, "from", address, "10", 1000 + block, "", "1", block, false, false, "", "", Transaction::OK, Transaction::SIMPLE, block, node.blockHash(block), 0);
+        db.addCheckpoint(address, currency, block, node.blockHash(block));
+        transactionGuard.commit();
+        countTxs++;
+    }
+    const std::vector<BlockCheckpoint> checkpoints = db.getCheckpoints(address, currency);
+    QCOMPARE(checkpoints.size(), size_t(TransactionsDBStorage::MAX_CHECKPOINTS));
+
+    node.reorg(depth, addBlocks);
+    const int64_t firstChangedBlock = countBlocks - depth + 1;
+
+    const int64_t serverBlockNumber = getCountBlocks(manager, node.url());
+    QCOMPARE(serverBlockNumber, countBlocks + addBlocks);
+
+    node.countBlockRequests = 0;
+    const ForkPointSearch::Result result = searchOnNode(manager, node.url(), checkpoints, serverBlockNumber);
+    QCOMPARE(result.countRequests, node.countBlockRequests);
+    QVERIFY(result.countRequests <= maxRequests(checkpoints.size()));
+
+    // Так же, как Transactions::processCheckTxsInternal
+    if (!result.isFound) {
+        db.removePaymentsForDest(address, currency);
+    } else if (!result.isLast) {
+        db.rollbackAfterBlock(address, currency, result.forkPoint.blockNumber);
+    }
+
+    if (depth == 0) {
+        QVERIFY(result.isLast);
+        QCOMPARE(result.countRequests, size_t(1));
+        QCOMPARE(db.getPaymentsCountForAddress(address, currency, false), countTxs);
+        return;
+    }
+
+    if (firstChangedBlock <= checkpoints.front().blockNumber) {
+        QVERIFY(!result.isFound);
+        QCOMPARE(db.getPaymentsCountForAddress(address, currency, false), qint64(0));
+        QCOMPARE(db.getCheckpoints(address, currency).size(), size_t(0));
+        return;
+    }
+
+    QVERIFY(result.isFound);
+    QVERIFY(!result.isLast);
+    QVERIFY(result.forkPoint.blockNumber < firstChangedBlock);
+    QCOMPARE(result.forkPoint.blockHash, node.blockHash(result.forkPoint.blockNumber));
+    // Точка расхождения - последний checkpoint до измененных блоков
+    for (const BlockCheckpoint &checkpoint: checkpoints) {
+        if (checkpoint.blockNumber > result.forkPoint.blockNumber) {
+            QVERIFY(checkpoint.blockNumber >= firstChangedBlock);
+        }
+    }
+
+    // Транзакции до точки расхождения не тронуты
+    const Transaction lastTx = db.getLastTransaction(address, currency);
+    QCOMPARE(lastTx.blockNumber, result.forkPoint.blockNumber);
+    QCOMPARE(lastTx.blockHash, node.blockHash(lastTx.blockNumber));
+    QCOMPARE(db.getPaymentsCountForAddress(address, currency, false), qint64((result.forkPoint.blockNumber - firstTxBlock) / 2 + 1));
+    QCOMPARE(db.getCheckpoints(address, currency).back().blockNumber, result.forkPoint.blockNumber);
+
+    // Повторная проверка после отката ничего не удаляет
+    const ForkPointSearch::Result again = searchOnNode(manager, node.url(), db.getCheckpoints(address, currency), serverBlockNumber);
+    QVERIFY(again.isLast);
+}
+
+QTEST_MAIN(tst_ForkPointSearch)
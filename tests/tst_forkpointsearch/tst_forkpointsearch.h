@@ -0,0 +1,64 @@
+#ifndef TST_FORKPOINTSEARCH_H
+#define TST_FORKPOINTSEARCH_H
+
+#include <QObject>
+#include <QTcpServer>
+
+#include <vector>
+#include <map>
+
+// Локальная нода торрента, отвечающая на get-block-by-number и get-count-blocks по своей цепочке
+class MockTorrentNode : public QObject {
+    Q_OBJECT
+public:
+    explicit MockTorrentNode(int64_t countBlocks, QObject *parent = nullptr);
+
+    QString url() const;
+
+    QString blockHash(int64_t number) const;
+
+    int64_t lastBlock() const;
+
+    // Заменяет depth последних блоков другой веткой и удлиняет цепочку на addBlocks
+    void reorg(int64_t depth, int64_t addBlocks);
+
+    size_t countBlockRequests = 0;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    QByteArray processRequest(const QByteArray &body);
+
+private:
+
+    QTcpServer server;
+
+    std::vector<QString> hashes;
+
+    int countReorgs = 0;
+
+    std::map<QObject*, QByteArray> buffers;
+};
+
+class tst_ForkPointSearch : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_ForkPointSearch(QObject *parent = nullptr);
+
+private slots:
+
+    void testSearch_data();
+    void testSearch();
+
+    void testProbeFailed();
+
+    void testReorg_data();
+    void testReorg();
+
+};
+
+#endif // TST_FORKPOINTSEARCH_H
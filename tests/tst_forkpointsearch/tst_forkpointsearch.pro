@@ -0,0 +1,38 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network sql
+TARGET = tst_forkpointsearch
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src ../../src/transactions
+
+SOURCES += \
+    tst_forkpointsearch.cpp \
+    ../../src/dbstorage.cpp \
+    ../../src/BigNumber.cpp \
+    ../../src/TypedException.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp \
+    ../../src/transactions/TransactionsDBStorage.cpp \
+    ../../src/transactions/TransactionsMessages.cpp \
+    ../../src/transactions/ForkPointSearch.cpp
+
+HEADERS += \
+    tst_forkpointsearch.h \
+    ../../src/dbstorage.h \
+    ../../src/BigNumber.h \
+    ../../src/Log.h \
+    ../../src/transactions/TransactionsDBStorage.h \
+    ../../src/transactions/TransactionsMessages.h \
+    ../../src/transactions/ForkPointSearch.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)
@@ -0,0 +1,143 @@
+#include "tst_hedgedrequest.h"
+
+#include <QTest>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QEventLoop>
+
+#include <vector>
+#include <algorithm>
+
+#include "HedgedRequest.h"
+
+DelayedHttpServer::DelayedHttpServer(milliseconds delay, QObject *parent)
+    : QObject(parent)
+    , delay(delay)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &DelayedHttpServer::onNewConnection);
+}
+
+QString DelayedHttpServer::ip() const {
+    return "127.0.0.1:" + QString::number(server.serverPort());
+}
+
+void DelayedHttpServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            socket->readAll();
+            countHits++;
+            QTimer::singleShot(delay.count(), socket, [socket]() {
+                socket->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok");
+                socket->disconnectFromHost();
+            });
+        });
+    }
+}
+
+tst_HedgedRequest::tst_HedgedRequest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+struct LoadResult {
+    milliseconds time;
+    QByteArray body;
+    size_t countStarted;
+};
+
+static LoadResult load(QNetworkAccessManager &manager, const std::vector<QString> &ips, const QString &firstIp, milliseconds delay, size_t maxRequests) {
+    HedgedRequest request(manager, [&ips](const std::set<QString> &excludes) {
+        for (const QString &ip: ips) {
+            if (excludes.find(ip) == excludes.end()) {
+                return ip;
+            }
+        }
+        return QString();
+    }, [](const QString &ip) {
+        return QNetworkRequest(QUrl("http://" + ip + "/"));
+    }, delay, maxRequests);
+
+    LoadResult result;
+    QEventLoop loop;
+    QObject::connect(&request, &HedgedRequest::finished, [&loop, &result](QNetworkReply *reply) {
+        result.body = reply->readAll();
+        loop.quit();
+    });
+    const time_point begin = ::now();
+    request.start(firstIp);
+    loop.exec();
+    result.time = std::chrono::duration_cast<milliseconds>(::now() - begin);
+    result.countStarted = request.countStarted();
+    return result;
+}
+
+static milliseconds p99(std::vector<milliseconds> times) {
+    std::sort(times.begin(), times.end());
+    return times[std::min(times.size() - 1, times.size() * 99 / 100)];
+}
+
+void tst_HedgedRequest::testLatencyTracker() {
+    LatencyTracker tracker(10);
+    for (int i = 1; i <= 20; i++) {
+        tracker.add(milliseconds(i));
+    }
+    QCOMPARE(tracker.count(), size_t(10));
+    QCOMPARE(tracker.percentile(0.0), 11ms);
+    QCOMPARE(tracker.percentile(0.95), 20ms);
+    QCOMPARE(tracker.percentile(0.5), 16ms);
+}
+
+void tst_HedgedRequest::testFailover() {
+    QTcpServer closed;
+    closed.listen(QHostAddress::LocalHost);
+    const QString deadIp = "127.0.0.1:" + QString::number(closed.serverPort());
+    closed.close();
+
+    DelayedHttpServer server(0ms);
+    QNetworkAccessManager manager;
+    // Отказ соединения запускает следующий ip сразу, не дожидаясь задержки
+    const LoadResult result = load(manager, {deadIp, server.ip()}, deadIp, 10s, 2);
+    QCOMPARE(result.body, QByteArray("ok"));
+    QCOMPARE(result.countStarted, size_t(2));
+    QVERIFY(result.time < 5s);
+}
+
+void tst_HedgedRequest::testLoserAborted() {
+    DelayedHttpServer slow(2s);
+    DelayedHttpServer fast(0ms);
+    QNetworkAccessManager manager;
+
+    const LoadResult result = load(manager, {slow.ip(), fast.ip()}, slow.ip(), 50ms, 2);
+    QCOMPARE(result.body, QByteArray("ok"));
+    QCOMPARE(result.countStarted, size_t(2));
+    QVERIFY(result.time < 1s);
+    QCOMPARE(slow.countHits, size_t(1));
+    QCOMPARE(fast.countHits, size_t(1));
+}
+
+void tst_HedgedRequest::testP99() {
+    DelayedHttpServer slow(400ms);
+    DelayedHttpServer fast(5ms);
+    QNetworkAccessManager manager;
+    const std::vector<QString> ips = {slow.ip(), fast.ip()};
+
+    const size_t COUNT = 20;
+    std::vector<milliseconds> plain;
+    std::vector<milliseconds> hedged;
+    for (size_t i = 0; i < COUNT; i++) {
+        const QString &firstIp = ips[i % ips.size()];
+        plain.emplace_back(load(manager, ips, firstIp, 50ms, 1).time);
+        hedged.emplace_back(load(manager, ips, firstIp, 50ms, 2).time);
+    }
+    qDebug() << "p99 plain:" << p99(plain).count() << "ms, hedged:" << p99(hedged).count() << "ms";
+    QVERIFY(p99(plain) >= 400ms);
+    QVERIFY(p99(hedged) < 300ms);
+}
+
+QTEST_MAIN(tst_HedgedRequest)
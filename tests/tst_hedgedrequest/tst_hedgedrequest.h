@@ -0,0 +1,49 @@
+#ifndef TST_HEDGEDREQUEST_H
+#define TST_HEDGEDREQUEST_H
+
+#include <QObject>
+#include <QTcpServer>
+
+#include "duration.h"
+
+class QTcpSocket;
+
+// Локальный сервер, отвечающий с заданной задержкой
+class DelayedHttpServer : public QObject {
+    Q_OBJECT
+public:
+    explicit DelayedHttpServer(milliseconds delay, QObject *parent = nullptr);
+
+    QString ip() const;
+
+    size_t countHits = 0;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    QTcpServer server;
+
+    const milliseconds delay;
+};
+
+class tst_HedgedRequest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_HedgedRequest(QObject *parent = nullptr);
+
+private slots:
+
+    void testLatencyTracker();
+
+    void testFailover();
+
+    void testLoserAborted();
+
+    void testP99();
+};
+
+#endif // TST_HEDGEDREQUEST_H
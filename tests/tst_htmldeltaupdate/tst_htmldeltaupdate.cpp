@@ -0,0 +1,287 @@
+#include "tst_htmldeltaupdate.h"
+
+#include <QTest>
+#include <QTcpSocket>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTemporaryDir>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QEventLoop>
+#include <QElapsedTimer>
+
+#include <random>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "HtmlDeltaUpdate.h"
+#include "FileDownloader.h"
+#include "unzip.h"
+#include "check.h"
+
+FilesServer::FilesServer(QObject *parent)
+    : QObject(parent)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &FilesServer::onNewConnection);
+}
+
+QString FilesServer::url() const {
+    return "http://127.0.0.1:" + QString::number(server.serverPort()) + "/v2/";
+}
+
+void FilesServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, [this, socket]() {
+            buffers.erase(socket);
+            socket->deleteLater();
+        });
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            QByteArray &buffer = buffers[socket];
+            buffer += socket->readAll();
+            const int end = buffer.indexOf("\r\n\r\n");
+            if (end < 0) {
+                return;
+            }
+            const QList<QByteArray> requestLine = buffer.left(buffer.indexOf("\r\n")).split(' ');
+            buffer.remove(0, end + 4);
+            countRequests++;
+
+            const QString path = QString(requestLine.value(1)).mid(QString("/v2/").size());
+            const auto found = files.find(path);
+            if (found == files.end()) {
+                socket->write("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            } else {
+                socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: " + QByteArray::number(found->second.size()) + "\r\nConnection: close\r\n\r\n");
+                socket->write(found->second);
+                bytesSent += found->second.size();
+            }
+            socket->disconnectFromHost();
+        });
+    }
+}
+
+// Содержимое почти не сжимается, чтобы zip не получал преимущества на синтетических данных
+static QByteArray makeFile(int index, int version, int size) {
+    std::mt19937 generator(index * 1000 + version);
+    std::uniform_int_distribution<int> distribution(0, 25);
+    QByteArray result(size, 0);
+    for (int i = 0; i < size; i++) {
+        result[i] = char('a' + distribution(generator));
+    }
+    return result;
+}
+
+static QString sha256(const QByteArray &data) {
+    return QString(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+}
+
+static QByteArray makeManifest(const std::map<QString, QByteArray> &files) {
+    QJsonArray filesJson;
+    for (const auto &pair: files) {
+        QJsonObject fileJson;
+        fileJson.insert("path", pair.first);
+        fileJson.insert("sha256", sha256(pair.second));
+        fileJson.insert("size", pair.second.size());
+        filesJson.push_back(fileJson);
+    }
+    QJsonObject root;
+    root.insert("files", filesJson);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+static void writeFiles(const QString &folder, const std::map<QString, QByteArray> &files) {
+    for (const auto &pair: files) {
+        const QString filePath = QDir(folder).filePath(pair.first);
+        QDir().mkpath(QFileInfo(filePath).absolutePath());
+        QFile file(filePath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(pair.second);
+    }
+}
+
+static void checkFiles(const QString &folder, const std::map<QString, QByteArray> &files) {
+    for (const auto &pair: files) {
+        QFile file(QDir(folder).filePath(pair.first));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(sha256(file.readAll()), sha256(pair.second));
+    }
+}
+
+struct UpdateResult {
+    HtmlDeltaUpdate::Stats stats;
+    SimpleClient::ServerException exception;
+};
+
+static UpdateResult runUpdate(FilesServer &server, const QString &oldPath, const QString &newPath) {
+    FileDownloader downloader;
+    UpdateResult result;
+    QEventLoop loop;
+    QObject::connect(&downloader, &FileDownloader::callbackCall, [](SimpleClient::ReturnCallback callback) {
+        callback();
+    });
+    bool isFinished = false;
+    const QUrl manifestUrl(server.url() + "manifest.json");
+    const HtmlDeltaUpdate::Manifest manifest = HtmlDeltaUpdate::parseManifest(manifestUrl, makeManifest(server.files).toStdString());
+    HtmlDeltaUpdate::start(downloader, manifest, oldPath, newPath, 4, 5s, 60s, [&](const HtmlDeltaUpdate::Stats &stats, const SimpleClient::ServerException &exception) {
+        result.stats = stats;
+        result.exception = exception;
+        isFinished = true;
+        loop.quit();
+    });
+    if (!isFinished) {
+        loop.exec();
+    }
+    return result;
+}
+
+// Как в Uploader: качаем zip версии, сверяем md5 и распаковываем
+static UpdateResult runFullUpdate(FilesServer &server, const QString &zipPath, const QString &newPath) {
+    FileDownloader downloader;
+    UpdateResult result;
+    QEventLoop loop;
+    QObject::connect(&downloader, &FileDownloader::callbackCall, [](SimpleClient::ReturnCallback callback) {
+        callback();
+    });
+    const QString expectedMd5 = QString(QCryptographicHash::hash(server.files.at("html.zip"), QCryptographicHash::Md5).toHex());
+    QElapsedTimer timer;
+    timer.start();
+    bool isFinished = false;
+    downloader.download(QUrl(server.url() + "html.zip"), zipPath, [&](const FileDownloader::Result &downloaded, const SimpleClient::ServerException &exception) {
+        result.exception = exception;
+        if (!exception.isSet()) {
+            if (downloaded.md5 != expectedMd5) {
+                result.exception = SimpleClient::ServerException(downloaded.filePath.toStdString(), -1, "hash zip not equal response hash", "");
+            } else {
+                try {
+                    extractDir(downloaded.filePath, newPath);
+                } catch (const Exception &e) {
+                    result.exception = SimpleClient::ServerException(downloaded.filePath.toStdString(), -1, e, "");
+                }
+                QFile::remove(downloaded.filePath);
+                result.stats.bytesDownloaded = downloaded.size;
+            }
+        }
+        isFinished = true;
+        loop.quit();
+    }, 5s, 60s);
+    if (!isFinished) {
+        loop.exec();
+    }
+    result.stats.time = milliseconds(timer.elapsed());
+    return result;
+}
+
+tst_HtmlDeltaUpdate::tst_HtmlDeltaUpdate(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_HtmlDeltaUpdate::testParseManifest() {
+    const std::string content = "{\"files\":[{\"path\":\"js/app.js\",\"sha256\":\"AB\",\"size\":10},{\"path\":\"index.html\",\"sha256\":\"cd\",\"size\":5,\"url\":\"http://cdn/index.html?secure=1\"}]}";
+    const HtmlDeltaUpdate::Manifest manifest = HtmlDeltaUpdate::parseManifest(QUrl("http://host/html/v2/manifest.json"), content);
+    QCOMPARE(manifest.files.size(), size_t(2));
+    QCOMPARE(manifest.files[0].path, QString("js/app.js"));
+    QCOMPARE(manifest.files[0].sha256, QString("ab"));
+    QCOMPARE(manifest.files[0].size, qint64(10));
+    QCOMPARE(manifest.files[0].url, QUrl("http://host/html/v2/js/app.js"));
+    QCOMPARE(manifest.files[1].url, QUrl("http://cdn/index.html?secure=1"));
+
+    QVERIFY_EXCEPTION_THROWN(HtmlDeltaUpdate::parseManifest(QUrl("http://host/"), "{\"files\":[{\"path\":\"../evil\",\"sha256\":\"ab\",\"size\":1}]}"), Exception);
+    QVERIFY_EXCEPTION_THROWN(HtmlDeltaUpdate::parseManifest(QUrl("http://host/"), "{\"files\":[{\"path\":\"/etc/passwd\",\"sha256\":\"ab\",\"size\":1}]}"), Exception);
+    QVERIFY_EXCEPTION_THROWN(HtmlDeltaUpdate::parseManifest(QUrl("http://host/"), "{}"), Exception);
+}
+
+void tst_HtmlDeltaUpdate::testDeltaVsFull() {
+    const int COUNT_FILES = 200;
+    const int FILE_SIZE = 50 * 1024;
+    const int COUNT_CHANGED = 5;
+
+    std::map<QString, QByteArray> oldFiles;
+    for (int i = 0; i < COUNT_FILES; i++) {
+        oldFiles["assets/" + QString::number(i / 20) + "/file" + QString::number(i) + ".js"] = makeFile(i, 1, FILE_SIZE);
+    }
+    std::map<QString, QByteArray> newFiles = oldFiles;
+    for (int i = 0; i < COUNT_CHANGED; i++) {
+        newFiles["assets/" + QString::number(i / 20) + "/file" + QString::number(i) + ".js"] = makeFile(i, 2, FILE_SIZE);
+    }
+    newFiles["index.html"] = makeFile(COUNT_FILES, 2, 1000);
+
+    QTemporaryDir dir;
+    const QString oldPath = dir.filePath("v1");
+    writeFiles(oldPath, oldFiles);
+
+    // Архив новой версии, который отдает сервер при полном обновлении
+    const QString sourcePath = dir.filePath("source");
+    writeFiles(sourcePath, newFiles);
+    const QString archivePath = dir.filePath("html_v2.zip");
+    compressDir(sourcePath, archivePath);
+    QFile archive(archivePath);
+    QVERIFY(archive.open(QIODevice::ReadOnly));
+
+    FilesServer server;
+    server.files = newFiles;
+    server.files["html.zip"] = archive.readAll();
+
+    const UpdateResult full = runFullUpdate(server, dir.filePath("download.zip"), dir.filePath("full"));
+    QVERIFY(!full.exception.isSet());
+    const qint64 fullBytes = server.bytesSent;
+    QCOMPARE(fullBytes, full.stats.bytesDownloaded);
+    checkFiles(dir.filePath("full"), newFiles);
+
+    server.files.erase("html.zip");
+    server.bytesSent = 0;
+    const UpdateResult delta = runUpdate(server, oldPath, dir.filePath("v2"));
+    QVERIFY(!delta.exception.isSet());
+    const qint64 deltaBytes = server.bytesSent;
+    checkFiles(dir.filePath("v2"), newFiles);
+
+    qDebug() << "Full zip (download + extract):" << fullBytes << "bytes" << full.stats.time.count() << "ms";
+    qDebug() << "Delta:" << deltaBytes << "bytes" << delta.stats.time.count() << "ms";
+
+    QCOMPARE(delta.stats.countDownloaded, size_t(COUNT_CHANGED + 1));
+    QCOMPARE(delta.stats.countLinked, size_t(COUNT_FILES - COUNT_CHANGED));
+    QCOMPARE(deltaBytes, delta.stats.bytesDownloaded);
+    QVERIFY(deltaBytes * 10 < fullBytes);
+
+#ifndef _WIN32
+    struct stat info;
+    QCOMPARE(::stat(QFile::encodeName(QDir(dir.filePath("v2")).filePath("assets/9/file199.js")).constData(), &info), 0);
+    QVERIFY(info.st_nlink >= 2);
+#endif
+
+    // Старая версия не должна меняться
+    checkFiles(oldPath, oldFiles);
+}
+
+void tst_HtmlDeltaUpdate::testHashMismatch() {
+    FilesServer server;
+    server.files["a.js"] = makeFile(1, 1, 1000);
+    server.files["b.js"] = makeFile(2, 1, 1000);
+
+    FileDownloader downloader;
+    QObject::connect(&downloader, &FileDownloader::callbackCall, [](SimpleClient::ReturnCallback callback) {
+        callback();
+    });
+    const HtmlDeltaUpdate::Manifest manifest = HtmlDeltaUpdate::parseManifest(QUrl(server.url() + "manifest.json"), makeManifest(server.files).toStdString());
+    server.files["b.js"] = makeFile(2, 2, 1000);
+
+    QTemporaryDir dir;
+    QEventLoop loop;
+    SimpleClient::ServerException result;
+    HtmlDeltaUpdate::start(downloader, manifest, "", dir.filePath("v2"), 1, 5s, 60s, [&](const HtmlDeltaUpdate::Stats &, const SimpleClient::ServerException &exception) {
+        result = exception;
+        loop.quit();
+    });
+    loop.exec();
+    QVERIFY(result.isSet());
+    QVERIFY(result.description.find("b.js") != std::string::npos);
+}
+
+QTEST_MAIN(tst_HtmlDeltaUpdate)
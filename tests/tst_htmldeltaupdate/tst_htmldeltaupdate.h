@@ -0,0 +1,51 @@
+#ifndef TST_HTMLDELTAUPDATE_H
+#define TST_HTMLDELTAUPDATE_H
+
+#include <QObject>
+#include <QTcpServer>
+
+#include <map>
+
+class QTcpSocket;
+
+// Локальный сервер, отдающий файлы версии по пути и считающий отданные байты
+class FilesServer : public QObject {
+    Q_OBJECT
+public:
+    explicit FilesServer(QObject *parent = nullptr);
+
+    QString url() const;
+
+    std::map<QString, QByteArray> files;
+
+    qint64 bytesSent = 0;
+
+    size_t countRequests = 0;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    QTcpServer server;
+
+    std::map<QTcpSocket*, QByteArray> buffers;
+};
+
+class tst_HtmlDeltaUpdate : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_HtmlDeltaUpdate(QObject *parent = nullptr);
+
+private slots:
+
+    void testParseManifest();
+
+    void testDeltaVsFull();
+
+    void testHashMismatch();
+};
+
+#endif // TST_HTMLDELTAUPDATE_H
@@ -0,0 +1,34 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network
+TARGET = tst_htmldeltaupdate
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src
+
+SOURCES += \
+    tst_htmldeltaupdate.cpp \
+    ../../src/HtmlDeltaUpdate.cpp \
+    ../../src/unzip.cpp \
+    ../../src/FileDownloader.cpp \
+    ../../src/QRegister.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp
+
+HEADERS += \
+    tst_htmldeltaupdate.h \
+    ../../src/HtmlDeltaUpdate.h \
+    ../../src/FileDownloader.h \
+    ../../src/unzip.h \
+    ../../src/Log.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)
@@ -0,0 +1,300 @@
+#include "tst_httpclient.h"
+
+#include <QTest>
+#include <QTcpSocket>
+
+#include <memory>
+#include <cstring>
+
+#include "check.h"
+#include "TypedException.h"
+#include "HttpClient.h"
+
+namespace {
+
+struct Result {
+    bool isFinished = false;
+    std::string response;
+    TypedException exception;
+};
+
+void connectCallbacks(HttpSimpleClient &client) {
+    QObject::connect(&client, &HttpSimpleClient::callbackCall, [](const HttpSimpleClient::ReturnCallback &callback) {
+        callback();
+    });
+}
+
+std::shared_ptr<Result> send(HttpSimpleClient &client, const QUrl &url, const QString &message, milliseconds timeout = 5s) {
+    std::shared_ptr<Result> result = std::make_shared<Result>();
+    client.sendMessagePost(url, message, [result](const std::string &response, const TypedException &exception) {
+        result->isFinished = true;
+        result->response = response;
+        result->exception = exception;
+    }, timeout);
+    return result;
+}
+
+bool isAllFinished(const std::vector<std::shared_ptr<Result>> &results) {
+    for (const auto &result: results) {
+        if (!result->isFinished) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+MockHttpServer::MockHttpServer(QObject *parent)
+    : QObject(parent)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &MockHttpServer::onNewConnection);
+}
+
+QUrl MockHttpServer::url() const {
+    return QUrl("http://127.0.0.1:" + QString::number(server.serverPort()));
+}
+
+void MockHttpServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        countConnections++;
+        connect(socket, &QTcpSocket::disconnected, [this]() {
+            countDisconnected++;
+        });
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::destroyed, [this, socket]() {
+            buffers.erase(socket);
+            pending.erase(socket);
+        });
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            QByteArray &buffer = buffers[socket];
+            buffer += socket->readAll();
+            while (true) {
+                const int headersEnd = buffer.indexOf("\r\n\r\n");
+                if (headersEnd == -1) {
+                    return;
+                }
+                int contentLength = 0;
+                for (const QByteArray &line: buffer.left(headersEnd).split('\n')) {
+                    if (line.toLower().startsWith("content-length:")) {
+                        contentLength = line.mid(int(strlen("content-length:"))).trimmed().toInt();
+                    }
+                }
+                if (buffer.size() < headersEnd + 4 + contentLength) {
+                    return;
+                }
+                std::vector<QByteArray> &requests = pending[socket];
+                requests.emplace_back(buffer.mid(headersEnd + 4, contentLength));
+                buffer.remove(0, headersEnd + 4 + contentLength);
+                countRequests++;
+                maxPipelined = std::max(maxPipelined, requests.size());
+
+                if (mode == Mode::DropWithoutResponse) {
+                    socket->disconnectFromHost();
+                    return;
+                }
+
+                if (mode == Mode::NoResponse || requests.size() < batchResponses) {
+                    continue;
+                }
+                const QByteArray connection = mode == Mode::ConnectionClose ? "close" : "keep-alive";
+                for (const QByteArray &request: requests) {
+                    const QByteArray response = "echo:" + request;
+                    socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + QByteArray::number(response.size()) + "\r\nConnection: " + connection + "\r\n\r\n" + response);
+                }
+                requests.clear();
+                if (mode == Mode::ConnectionClose || mode == Mode::DropAfterResponse) {
+                    socket->disconnectFromHost();
+                    return;
+                }
+            }
+        });
+    }
+}
+
+tst_HttpClient::tst_HttpClient(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_HttpClient::testKeepAlive()
+{
+    MockHttpServer server;
+    HttpSimpleClient client;
+    connectCallbacks(client);
+
+    for (int i = 0; i < 10; i++) {
+        const QString message = "request" + QString::number(i);
+        const std::shared_ptr<Result> result = send(client, server.url(), message);
+        QTRY_VERIFY(result->isFinished);
+        QVERIFY(!result->exception.isSet());
+        QCOMPARE(QString::fromStdString(result->response), "echo:" + message);
+    }
+    QCOMPARE(server.countConnections, 1);
+    QCOMPARE(server.countRequests, 10);
+}
+
+void tst_HttpClient::testMaxConnections_data()
+{
+    QTest::addColumn<int>("maxConnections");
+    QTest::newRow("1") << 1;
+    QTest::newRow("3") << 3;
+}
+
+void tst_HttpClient::testMaxConnections()
+{
+    QFETCH(int, maxConnections);
+
+    MockHttpServer server;
+    HttpSimpleClient client;
+    client.setMaxConnectionsPerHost(static_cast<size_t>(maxConnections));
+    connectCallbacks(client);
+
+    std::vector<std::shared_ptr<Result>> results;
+    for (int i = 0; i < 20; i++) {
+        results.emplace_back(send(client, server.url(), "request" + QString::number(i)));
+    }
+    QTRY_VERIFY(isAllFinished(results));
+    for (size_t i = 0; i < results.size(); i++) {
+        QVERIFY(!results[i]->exception.isSet());
+        QCOMPARE(QString::fromStdString(results[i]->response), "echo:request" + QString::number(i));
+    }
+    QCOMPARE(server.countConnections, maxConnections);
+    QCOMPARE(server.countRequests, 20);
+}
+
+void tst_HttpClient::testConnectionClose()
+{
+    MockHttpServer server;
+    server.mode = MockHttpServer::Mode::ConnectionClose;
+    HttpSimpleClient client;
+    client.setMaxConnectionsPerHost(1);
+    connectCallbacks(client);
+
+    // Ответ с Connection: close закрывает соединение, очередь переезжает на новое
+    std::vector<std::shared_ptr<Result>> results;
+    for (int i = 0; i < 5; i++) {
+        results.emplace_back(send(client, server.url(), "request" + QString::number(i)));
+    }
+    QTRY_VERIFY(isAllFinished(results));
+    for (size_t i = 0; i < results.size(); i++) {
+        QVERIFY(!results[i]->exception.isSet());
+        QCOMPARE(QString::fromStdString(results[i]->response), "echo:request" + QString::number(i));
+    }
+    QCOMPARE(server.countConnections, 5);
+}
+
+void tst_HttpClient::testServerDropsConnection()
+{
+    MockHttpServer server;
+    server.mode = MockHttpServer::Mode::DropAfterResponse;
+    HttpSimpleClient client;
+    connectCallbacks(client);
+
+    for (int i = 0; i < 3; i++) {
+        const std::shared_ptr<Result> result = send(client, server.url(), "request");
+        QTRY_VERIFY(result->isFinished);
+        QVERIFY(!result->exception.isSet());
+        QTRY_COMPARE(server.countDisconnected, i + 1);
+    }
+    QCOMPARE(server.countConnections, 3);
+}
+
+void tst_HttpClient::testSentRequestNotRetried()
+{
+    MockHttpServer server;
+    HttpSimpleClient client;
+    client.setMaxConnectionsPerHost(1);
+    connectCallbacks(client);
+
+    const std::shared_ptr<Result> first = send(client, server.url(), "first");
+    QTRY_VERIFY(first->isFinished);
+    QVERIFY(!first->exception.isSet());
+
+    // Запрос ушел по переиспользованному соединению, и сервер его получил: повторять нельзя
+    server.mode = MockHttpServer::Mode::DropWithoutResponse;
+    const std::shared_ptr<Result> second = send(client, server.url(), "second");
+    QTRY_VERIFY(second->isFinished);
+    QVERIFY(second->exception.isSet());
+    QCOMPARE(server.countRequests, 2);
+    QCOMPARE(server.countConnections, 1);
+}
+
+void tst_HttpClient::testIdleTimeout()
+{
+    MockHttpServer server;
+    HttpSimpleClient client;
+    client.setIdleTimeout(1s);
+    connectCallbacks(client);
+
+    const std::shared_ptr<Result> first = send(client, server.url(), "first");
+    QTRY_VERIFY(first->isFinished);
+    QCOMPARE(server.countDisconnected, 0);
+    QTRY_COMPARE_WITH_TIMEOUT(server.countDisconnected, 1, 5000);
+
+    const std::shared_ptr<Result> second = send(client, server.url(), "second");
+    QTRY_VERIFY(second->isFinished);
+    QVERIFY(!second->exception.isSet());
+    QCOMPARE(server.countConnections, 2);
+}
+
+void tst_HttpClient::testPipelining()
+{
+    MockHttpServer server;
+    // Сервер молчит, пока не получит все три запроса: без pipelining они бы не дошли
+    server.batchResponses = 3;
+    HttpSimpleClient client;
+    client.setMaxConnectionsPerHost(1);
+    client.setPipelining(true);
+    connectCallbacks(client);
+
+    std::vector<std::shared_ptr<Result>> results;
+    for (int i = 0; i < 3; i++) {
+        results.emplace_back(send(client, server.url(), "request" + QString::number(i)));
+    }
+    QTRY_VERIFY(isAllFinished(results));
+    for (size_t i = 0; i < results.size(); i++) {
+        QVERIFY(!results[i]->exception.isSet());
+        QCOMPARE(QString::fromStdString(results[i]->response), "echo:request" + QString::number(i));
+    }
+    QCOMPARE(server.countConnections, 1);
+    QCOMPARE(server.maxPipelined, size_t(3));
+}
+
+void tst_HttpClient::testTimeout()
+{
+    MockHttpServer server;
+    server.mode = MockHttpServer::Mode::NoResponse;
+    HttpSimpleClient client;
+    connectCallbacks(client);
+
+    const std::shared_ptr<Result> result = send(client, server.url(), "request", 500ms);
+    QTRY_VERIFY_WITH_TIMEOUT(result->isFinished, 3000);
+    QVERIFY(result->exception.isSet());
+
+    // Соединение с зависшим запросом закрывается, следующий идет по новому
+    server.mode = MockHttpServer::Mode::KeepAlive;
+    const std::shared_ptr<Result> next = send(client, server.url(), "next");
+    QTRY_VERIFY(next->isFinished);
+    QVERIFY(!next->exception.isSet());
+    QCOMPARE(server.countConnections, 2);
+}
+
+void tst_HttpClient::testConnectionRefused()
+{
+    QUrl url;
+    {
+        MockHttpServer server;
+        url = server.url();
+    }
+    HttpSimpleClient client;
+    connectCallbacks(client);
+
+    const std::shared_ptr<Result> result = send(client, url, "request");
+    QTRY_VERIFY(result->isFinished);
+    QVERIFY(result->exception.isSet());
+}
+
+QTEST_MAIN(tst_HttpClient)
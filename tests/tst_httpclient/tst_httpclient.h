@@ -0,0 +1,86 @@
+#ifndef TST_HTTPCLIENT_H
+#define TST_HTTPCLIENT_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QUrl>
+
+#include <map>
+#include <vector>
+
+// Локальный http сервер, считающий принятые соединения. Отвечает телом запроса с префиксом echo:
+class MockHttpServer : public QObject {
+    Q_OBJECT
+public:
+
+    enum class Mode {
+        KeepAlive,
+        ConnectionClose,
+        // Соединение закрывается сервером после ответа без заголовка Connection: close
+        DropAfterResponse,
+        // Соединение закрывается сервером сразу после получения запроса, без ответа
+        DropWithoutResponse,
+        NoResponse
+    };
+
+public:
+    explicit MockHttpServer(QObject *parent = nullptr);
+
+    QUrl url() const;
+
+    Mode mode = Mode::KeepAlive;
+
+    // Ответы отправляются, когда на соединении накопилось столько запросов
+    size_t batchResponses = 1;
+
+    int countConnections = 0;
+
+    int countDisconnected = 0;
+
+    int countRequests = 0;
+
+    size_t maxPipelined = 0;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    QTcpServer server;
+
+    std::map<QObject*, QByteArray> buffers;
+
+    std::map<QObject*, std::vector<QByteArray>> pending;
+};
+
+class tst_HttpClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_HttpClient(QObject *parent = nullptr);
+
+private slots:
+
+    void testKeepAlive();
+
+    void testMaxConnections_data();
+    void testMaxConnections();
+
+    void testConnectionClose();
+
+    void testServerDropsConnection();
+
+    void testSentRequestNotRetried();
+
+    void testIdleTimeout();
+
+    void testPipelining();
+
+    void testTimeout();
+
+    void testConnectionRefused();
+
+};
+
+#endif // TST_HTTPCLIENT_H
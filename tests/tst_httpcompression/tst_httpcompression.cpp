@@ -0,0 +1,340 @@
+#include "tst_httpcompression.h"
+
+#include <QTest>
+#include <QTcpSocket>
+
+#include <memory>
+#include <cstring>
+
+#include <zlib.h>
+
+#include "check.h"
+#include "TypedException.h"
+#include "HttpCompression.h"
+#include "HttpClient.h"
+#include "client.h"
+
+namespace {
+
+// windowBits как в deflateInit2: 15 + 16 - gzip, 15 - zlib, -15 - голый deflate
+QByteArray compress(const QByteArray &data, int windowBits) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    CHECK(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK, "deflateInit error");
+    QByteArray result(static_cast<int>(deflateBound(&stream, static_cast<uLong>(data.size()))), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = static_cast<uInt>(result.size());
+    const int ret = deflate(&stream, Z_FINISH);
+    const int size = static_cast<int>(stream.total_out);
+    deflateEnd(&stream);
+    CHECK(ret == Z_STREAM_END, "deflate error");
+    result.resize(size);
+    return result;
+}
+
+QByteArray encodingForPath(const QByteArray &path) {
+    if (path == "/gzip" || path == "/bomb") {
+        return "gzip";
+    } else if (path == "/zlib" || path == "/deflate") {
+        return "deflate";
+    } else if (path == "/corrupt") {
+        return "gzip";
+    } else {
+        return "";
+    }
+}
+
+struct SimpleResult {
+    bool isFinished = false;
+    std::string response;
+    SimpleClient::ServerException exception;
+};
+
+struct HttpResult {
+    bool isFinished = false;
+    std::string response;
+    TypedException exception;
+};
+
+std::shared_ptr<SimpleResult> send(SimpleClient &client, const QUrl &url) {
+    std::shared_ptr<SimpleResult> result = std::make_shared<SimpleResult>();
+    client.sendMessagePost(url, "{}", [result](const std::string &response, const SimpleClient::ServerException &exception) {
+        result->isFinished = true;
+        result->response = response;
+        result->exception = exception;
+    }, 5s);
+    return result;
+}
+
+std::shared_ptr<HttpResult> send(HttpSimpleClient &client, const QUrl &url) {
+    std::shared_ptr<HttpResult> result = std::make_shared<HttpResult>();
+    client.sendMessagePost(url, "{}", [result](const std::string &response, const TypedException &exception) {
+        result->isFinished = true;
+        result->response = response;
+        result->exception = exception;
+    }, 5s);
+    return result;
+}
+
+void connectCallbacks(SimpleClient &client) {
+    QObject::connect(&client, &SimpleClient::callbackCall, [](const SimpleClient::ReturnCallback &callback) {
+        callback();
+    });
+}
+
+void connectCallbacks(HttpSimpleClient &client) {
+    QObject::connect(&client, &HttpSimpleClient::callbackCall, [](const HttpSimpleClient::ReturnCallback &callback) {
+        callback();
+    });
+}
+
+void addEncodingRows() {
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<bool>("isCompressed");
+
+    QTest::newRow("identity") << "/identity" << false;
+    QTest::newRow("gzip") << "/gzip" << true;
+    QTest::newRow("zlib") << "/zlib" << true;
+    QTest::newRow("raw deflate") << "/deflate" << true;
+}
+
+}
+
+QByteArray CompressingHttpServer::body() {
+    QByteArray result = "{\"jsonrpc\":\"2.0\",\"result\":[";
+    for (int i = 0; i < 500; i++) {
+        if (i != 0) {
+            result += ",";
+        }
+        result += "{\"from\":\"0x00fa2a7f2d4d4a1a7bc3ba4f2a3e8e2b1c0d7f11\",\"value\":\"" + QByteArray::number(i * 1000) + "\",\"blockIndex\":" + QByteArray::number(i) + "}";
+    }
+    result += "]}";
+    return result;
+}
+
+CompressingHttpServer::CompressingHttpServer(QObject *parent)
+    : QObject(parent)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &CompressingHttpServer::onNewConnection);
+}
+
+QUrl CompressingHttpServer::url(const QString &path) const {
+    return QUrl("http://127.0.0.1:" + QString::number(server.serverPort()) + path);
+}
+
+QByteArray CompressingHttpServer::response(const QByteArray &path) const {
+    QByteArray content;
+    if (path == "/gzip") {
+        content = compress(body(), 15 + 16);
+    } else if (path == "/zlib") {
+        content = compress(body(), 15);
+    } else if (path == "/deflate") {
+        content = compress(body(), -15);
+    } else if (path == "/corrupt") {
+        content = compress(body(), 15 + 16);
+        content.truncate(content.size() / 2);
+    } else if (path == "/bomb") {
+        content = compress(QByteArray(BOMB_SIZE, '\0'), 15 + 16);
+    } else {
+        content = body();
+    }
+
+    QByteArray response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + QByteArray::number(content.size()) + "\r\n";
+    const QByteArray encoding = encodingForPath(path);
+    if (!encoding.isEmpty()) {
+        response += "Content-Encoding: " + encoding + "\r\n";
+    }
+    response += "Connection: keep-alive\r\n\r\n" + content;
+    return response;
+}
+
+void CompressingHttpServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::destroyed, [this, socket]() {
+            buffers.erase(socket);
+        });
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            QByteArray &buffer = buffers[socket];
+            buffer += socket->readAll();
+            while (true) {
+                const int headersEnd = buffer.indexOf("\r\n\r\n");
+                if (headersEnd == -1) {
+                    return;
+                }
+                const QList<QByteArray> lines = buffer.left(headersEnd).split('\n');
+                int contentLength = 0;
+                for (const QByteArray &line: lines) {
+                    const QByteArray lower = line.toLower();
+                    if (lower.startsWith("content-length:")) {
+                        contentLength = line.mid(int(strlen("content-length:"))).trimmed().toInt();
+                    } else if (lower.startsWith("accept-encoding:")) {
+                        lastAcceptEncoding = line.mid(int(strlen("accept-encoding:"))).trimmed();
+                    }
+                }
+                if (buffer.size() < headersEnd + 4 + contentLength) {
+                    return;
+                }
+                buffer.remove(0, headersEnd + 4 + contentLength);
+
+                const QList<QByteArray> requestLine = lines.front().split(' ');
+                const QByteArray path = requestLine.size() > 1 ? requestLine[1] : QByteArray("/");
+                socket->write(response(path));
+            }
+        });
+    }
+}
+
+tst_HttpCompression::tst_HttpCompression(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_HttpCompression::testDecode_data()
+{
+    QTest::addColumn<QByteArray>("encoding");
+    QTest::addColumn<QByteArray>("data");
+
+    const QByteArray body = CompressingHttpServer::body();
+    QTest::newRow("empty") << QByteArray() << body;
+    QTest::newRow("identity") << QByteArray("identity") << body;
+    QTest::newRow("gzip") << QByteArray("gzip") << compress(body, 15 + 16);
+    QTest::newRow("x-gzip") << QByteArray("x-gzip") << compress(body, 15 + 16);
+    QTest::newRow("GZIP") << QByteArray(" GZIP ") << compress(body, 15 + 16);
+    QTest::newRow("deflate zlib") << QByteArray("deflate") << compress(body, 15);
+    QTest::newRow("deflate raw") << QByteArray("deflate") << compress(body, -15);
+}
+
+void tst_HttpCompression::testDecode()
+{
+    QFETCH(QByteArray, encoding);
+    QFETCH(QByteArray, data);
+
+    const QByteArray body = CompressingHttpServer::body();
+    QCOMPARE(HttpCompression::decode(encoding, data, HttpCompression::DEFAULT_MAX_DECODED_SIZE), body);
+    if (HttpCompression::isCompressed(encoding)) {
+        QVERIFY_EXCEPTION_THROWN(HttpCompression::decode(encoding, data, body.size() - 1), Exception);
+        QCOMPARE(HttpCompression::decode(encoding, data, body.size()), body);
+    }
+    QVERIFY_EXCEPTION_THROWN(HttpCompression::decode("br", data, HttpCompression::DEFAULT_MAX_DECODED_SIZE), Exception);
+}
+
+void tst_HttpCompression::testSimpleClient_data()
+{
+    addEncodingRows();
+}
+
+void tst_HttpCompression::testSimpleClient()
+{
+    QFETCH(QString, path);
+    QFETCH(bool, isCompressed);
+
+    CompressingHttpServer server;
+    SimpleClient client;
+    connectCallbacks(client);
+    std::vector<HttpCompression::ResponseSize> sizes;
+    client.setSizeCallback([&sizes](const HttpCompression::ResponseSize &size) {
+        sizes.emplace_back(size);
+    });
+
+    const std::shared_ptr<SimpleResult> result = send(client, server.url(path));
+    QTRY_VERIFY(result->isFinished);
+    QVERIFY2(!result->exception.isSet(), result->exception.toString().c_str());
+    QCOMPARE(QByteArray::fromStdString(result->response), CompressingHttpServer::body());
+    QCOMPARE(server.lastAcceptEncoding, HttpCompression::ACCEPT_ENCODING);
+
+    QCOMPARE(sizes.size(), size_t(1));
+    QCOMPARE(sizes[0].decodedBytes, qint64(CompressingHttpServer::body().size()));
+    QCOMPARE(sizes[0].wireBytes < sizes[0].decodedBytes, isCompressed);
+
+    const HttpCompression::Stats &stats = client.getTrafficStats();
+    QCOMPARE(stats.countResponses, uint64_t(1));
+    QCOMPARE(stats.countCompressed, uint64_t(isCompressed ? 1 : 0));
+    QCOMPARE(stats.wireBytes, uint64_t(sizes[0].wireBytes));
+    QCOMPARE(stats.decodedBytes, uint64_t(sizes[0].decodedBytes));
+}
+
+void tst_HttpCompression::testHttpSimpleClient_data()
+{
+    addEncodingRows();
+}
+
+void tst_HttpCompression::testHttpSimpleClient()
+{
+    QFETCH(QString, path);
+    QFETCH(bool, isCompressed);
+
+    CompressingHttpServer server;
+    HttpSimpleClient client;
+    connectCallbacks(client);
+    std::vector<HttpCompression::ResponseSize> sizes;
+    client.setSizeCallback([&sizes](const HttpCompression::ResponseSize &size) {
+        sizes.emplace_back(size);
+    });
+
+    const std::shared_ptr<HttpResult> result = send(client, server.url(path));
+    QTRY_VERIFY(result->isFinished);
+    QVERIFY2(!result->exception.isSet(), result->exception.description.c_str());
+    QCOMPARE(QByteArray::fromStdString(result->response), CompressingHttpServer::body());
+    QCOMPARE(server.lastAcceptEncoding, HttpCompression::ACCEPT_ENCODING);
+
+    QCOMPARE(sizes.size(), size_t(1));
+    QCOMPARE(sizes[0].decodedBytes, qint64(CompressingHttpServer::body().size()));
+    QCOMPARE(sizes[0].wireBytes < sizes[0].decodedBytes, isCompressed);
+
+    const HttpCompression::Stats &stats = client.getTrafficStats();
+    QCOMPARE(stats.countResponses, uint64_t(1));
+    QCOMPARE(stats.countCompressed, uint64_t(isCompressed ? 1 : 0));
+    QCOMPARE(stats.wireBytes, uint64_t(sizes[0].wireBytes));
+    QCOMPARE(stats.decodedBytes, uint64_t(sizes[0].decodedBytes));
+}
+
+void tst_HttpCompression::testMaxDecodedSize()
+{
+    CompressingHttpServer server;
+
+    SimpleClient simpleClient;
+    simpleClient.setMaxDecodedSize(CompressingHttpServer::BOMB_SIZE / 4);
+    connectCallbacks(simpleClient);
+    const std::shared_ptr<SimpleResult> simpleResult = send(simpleClient, server.url("/bomb"));
+    QTRY_VERIFY(simpleResult->isFinished);
+    QVERIFY(simpleResult->exception.isSet());
+    QCOMPARE(simpleClient.getTrafficStats().countResponses, uint64_t(0));
+
+    HttpSimpleClient httpClient;
+    httpClient.setMaxDecodedSize(CompressingHttpServer::BOMB_SIZE / 4);
+    connectCallbacks(httpClient);
+    const std::shared_ptr<HttpResult> httpResult = send(httpClient, server.url("/bomb"));
+    QTRY_VERIFY(httpResult->isFinished);
+    QVERIFY(httpResult->exception.isSet());
+    QCOMPARE(httpClient.getTrafficStats().countResponses, uint64_t(0));
+
+    // Соединение остается рабочим
+    const std::shared_ptr<HttpResult> next = send(httpClient, server.url("/gzip"));
+    QTRY_VERIFY(next->isFinished);
+    QVERIFY(!next->exception.isSet());
+    QCOMPARE(QByteArray::fromStdString(next->response), CompressingHttpServer::body());
+}
+
+void tst_HttpCompression::testCorrupt()
+{
+    CompressingHttpServer server;
+
+    SimpleClient simpleClient;
+    connectCallbacks(simpleClient);
+    const std::shared_ptr<SimpleResult> simpleResult = send(simpleClient, server.url("/corrupt"));
+    QTRY_VERIFY(simpleResult->isFinished);
+    QVERIFY(simpleResult->exception.isSet());
+
+    HttpSimpleClient httpClient;
+    connectCallbacks(httpClient);
+    const std::shared_ptr<HttpResult> httpResult = send(httpClient, server.url("/corrupt"));
+    QTRY_VERIFY(httpResult->isFinished);
+    QVERIFY(httpResult->exception.isSet());
+}
+
+QTEST_MAIN(tst_HttpCompression)
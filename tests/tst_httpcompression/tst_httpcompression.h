@@ -0,0 +1,65 @@
+#ifndef TST_HTTPCOMPRESSION_H
+#define TST_HTTPCOMPRESSION_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QUrl>
+
+#include <map>
+
+// Локальный http сервер. Путь запроса задает кодировку ответа: /identity, /gzip, /zlib, /deflate, /corrupt, /bomb
+class CompressingHttpServer : public QObject {
+    Q_OBJECT
+public:
+
+    static QByteArray body();
+
+    // Размер распакованного /bomb
+    static const int BOMB_SIZE = 4 * 1024 * 1024;
+
+public:
+    explicit CompressingHttpServer(QObject *parent = nullptr);
+
+    QUrl url(const QString &path) const;
+
+    QByteArray lastAcceptEncoding;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    QByteArray response(const QByteArray &path) const;
+
+private:
+
+    QTcpServer server;
+
+    std::map<QObject*, QByteArray> buffers;
+};
+
+class tst_HttpCompression : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_HttpCompression(QObject *parent = nullptr);
+
+private slots:
+
+    void testDecode_data();
+    void testDecode();
+
+    void testSimpleClient_data();
+    void testSimpleClient();
+
+    void testHttpSimpleClient_data();
+    void testHttpSimpleClient();
+
+    void testMaxDecodedSize();
+
+    void testCorrupt();
+
+};
+
+#endif // TST_HTTPCOMPRESSION_H
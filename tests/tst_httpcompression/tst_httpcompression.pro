@@ -0,0 +1,35 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network
+TARGET = tst_httpcompression
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src
+
+SOURCES += \
+    tst_httpcompression.cpp \
+    ../../src/HttpCompression.cpp \
+    ../../src/HttpClient.cpp \
+    ../../src/client.cpp \
+    ../../src/QRegister.cpp \
+    ../../src/TypedException.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp
+
+HEADERS += \
+    tst_httpcompression.h \
+    ../../src/HttpCompression.h \
+    ../../src/HttpClient.h \
+    ../../src/client.h \
+    ../../src/Log.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)
@@ -0,0 +1,263 @@
+#include "tst_initializer.h"
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <thread>
+
+#include "Initializer/Initializer.h"
+#include "Initializer/InitInterface.h"
+#include "Initializer/InitializerJavascript.h"
+#include "check.h"
+
+using namespace initializer;
+
+// Синтетические шаги инициализации: спят заданное время и возвращают число
+class SleepInit: public InitInterface {
+public:
+
+    using Return = int;
+
+    SleepInit(const QString &name, QThread *mainThread, Initializer &manager)
+        : InitInterface(name, mainThread, manager, false)
+    {}
+
+    void completeImpl() override {}
+
+    static int countEvents() {
+        return 0;
+    }
+
+    static int countCriticalEvents() {
+        return 0;
+    }
+
+protected:
+
+    static int sleepAndReturn(milliseconds time, int value) {
+        std::this_thread::sleep_for(time);
+        return value;
+    }
+};
+
+class InitA: public SleepInit {
+public:
+    InitA(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "a"; }
+    static std::vector<QString> dependencies() { return {}; }
+    Return initialize() { return sleepAndReturn(300ms, 1); }
+};
+
+class InitB: public SleepInit {
+public:
+    InitB(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "b"; }
+    static std::vector<QString> dependencies() { return {}; }
+    Return initialize() { return sleepAndReturn(300ms, 2); }
+};
+
+class InitC: public SleepInit {
+public:
+    InitC(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "c"; }
+    static std::vector<QString> dependencies() { return {InitA::stateName(), InitB::stateName()}; }
+    Return initialize(std::shared_future<int> a, std::shared_future<int> b) { return sleepAndReturn(100ms, a.get() + b.get()); }
+};
+
+class InitDeferred: public SleepInit {
+public:
+    InitDeferred(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "deferred"; }
+    static std::vector<QString> dependencies() { return {InitA::stateName()}; }
+    Return initialize(std::shared_future<int> a, std::thread::id *threadId) {
+        *threadId = std::this_thread::get_id();
+        return a.get() * 10;
+    }
+};
+
+class InitFail: public SleepInit {
+public:
+    InitFail(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "fail"; }
+    static std::vector<QString> dependencies() { return {}; }
+    Return initialize() { throwErr("Synthetic error"); }
+};
+
+class InitAfterFail: public SleepInit {
+public:
+    InitAfterFail(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "after_fail"; }
+    static std::vector<QString> dependencies() { return {InitFail::stateName()}; }
+    Return initialize(std::shared_future<int> fail) {
+        try {
+            return fail.get();
+        } catch (const Exception &) {
+            return -1;
+        }
+    }
+};
+
+class InitString: public SleepInit {
+public:
+    using Return = QString;
+    InitString(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "string"; }
+    static std::vector<QString> dependencies() { return {}; }
+    Return initialize() { return "s"; }
+};
+
+// Зависимости перечислены не в порядке аргументов initialize
+class InitSwapped: public SleepInit {
+public:
+    InitSwapped(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "swapped"; }
+    static std::vector<QString> dependencies() { return {InitString::stateName(), InitA::stateName()}; }
+    Return initialize(std::shared_future<int> a, std::shared_future<QString> str) { return a.get() + str.get().size(); }
+};
+
+class InitOrdered: public SleepInit {
+public:
+    InitOrdered(QThread *mainThread, Initializer &manager): SleepInit(stateName(), mainThread, manager) {}
+    static QString stateName() { return "ordered"; }
+    static std::vector<QString> dependencies() { return {InitA::stateName(), InitString::stateName()}; }
+    Return initialize(std::shared_future<int> a, std::shared_future<QString> str) { return a.get() + str.get().size(); }
+};
+
+static const InitStepProfile& findProfile(const std::vector<InitStepProfile> &profiles, const QString &name) {
+    const auto found = std::find_if(profiles.begin(), profiles.end(), [&name](const InitStepProfile &profile) {
+        return profile.name == name;
+    });
+    CHECK(found != profiles.end(), "Profile not found " + name.toStdString());
+    return *found;
+}
+
+tst_Initializer::tst_Initializer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_Initializer::testParallelAndOrder() {
+    InitializerJavascript initJavascript;
+    Initializer initManager(initJavascript);
+
+    const time_point begin = ::now();
+    const std::shared_future<int> a = initManager.addInit<InitA>();
+    const std::shared_future<int> b = initManager.addInit<InitB>();
+    const std::shared_future<int> c = initManager.addInit<InitC>(a, b);
+    initManager.complete();
+    QCOMPARE(c.get(), 3);
+    const milliseconds elapsed = std::chrono::duration_cast<milliseconds>(::now() - begin);
+
+    // Последовательно было бы 700 мс
+    qDebug() << "Elapsed" << elapsed.count() << "ms";
+    QVERIFY(elapsed < 600ms);
+
+    // Профиль пишется после завершения шага, дожидаемся
+    while (!findProfile(initManager.getProfile(), "c").isFinished) {
+        std::this_thread::sleep_for(1ms);
+    }
+    const std::vector<InitStepProfile> profiles = initManager.getProfile();
+    const InitStepProfile &pa = findProfile(profiles, "a");
+    const InitStepProfile &pb = findProfile(profiles, "b");
+    const InitStepProfile &pc = findProfile(profiles, "c");
+    QVERIFY(pa.timeBegin < pb.timeEnd && pb.timeBegin < pa.timeEnd);
+    QVERIFY(pc.timeBegin >= pa.timeEnd);
+    QVERIFY(pc.timeBegin >= pb.timeEnd);
+    QVERIFY(pc.timeReady >= std::max(pa.timeEnd, pb.timeEnd));
+    QVERIFY(pa.isSuccess && pb.isSuccess && pc.isSuccess);
+}
+
+void tst_Initializer::testDeferred() {
+    InitializerJavascript initJavascript;
+    Initializer initManager(initJavascript);
+
+    std::thread::id threadId;
+    const std::shared_future<int> a = initManager.addInit<InitA>();
+    const std::shared_future<int> deferred = initManager.addInit<InitDeferred, true>(a, &threadId);
+    initManager.complete();
+
+    QCOMPARE(deferred.get(), 10);
+    QVERIFY(threadId == std::this_thread::get_id());
+
+    const std::vector<InitStepProfile> profiles = initManager.getProfile();
+    QVERIFY(findProfile(profiles, "deferred").timeBegin >= findProfile(profiles, "a").timeEnd);
+    QVERIFY(findProfile(profiles, "deferred").isDeferred);
+}
+
+void tst_Initializer::testDependencyNotAdded() {
+    InitializerJavascript initJavascript;
+    Initializer initManager(initJavascript);
+
+    std::promise<int> promise;
+    const std::shared_future<int> fake = promise.get_future().share();
+    QVERIFY_EXCEPTION_THROWN(initManager.addInit<InitC>(fake, fake), Exception);
+}
+
+void tst_Initializer::testDependencyTypeMismatch() {
+    InitializerJavascript initJavascript;
+    Initializer initManager(initJavascript);
+
+    const std::shared_future<int> a = initManager.addInit<InitA>();
+    const std::shared_future<QString> str = initManager.addInit<InitString>();
+    QVERIFY_EXCEPTION_THROWN(initManager.addInit<InitSwapped>(a, str), Exception);
+    const std::shared_future<int> ordered = initManager.addInit<InitOrdered>(a, str);
+    initManager.complete();
+    QCOMPARE(ordered.get(), 2);
+}
+
+void tst_Initializer::testFailedDependency() {
+    InitializerJavascript initJavascript;
+    Initializer initManager(initJavascript);
+
+    const std::shared_future<int> fail = initManager.addInit<InitFail>();
+    const std::shared_future<int> afterFail = initManager.addInit<InitAfterFail>(fail);
+    initManager.complete();
+    QCOMPARE(afterFail.get(), -1);
+
+    while (!findProfile(initManager.getProfile(), InitAfterFail::stateName()).isFinished) {
+        std::this_thread::sleep_for(1ms);
+    }
+    const std::vector<InitStepProfile> profiles = initManager.getProfile();
+    QVERIFY(!findProfile(profiles, InitFail::stateName()).isSuccess);
+    QVERIFY(findProfile(profiles, InitAfterFail::stateName()).isSuccess);
+}
+
+void tst_Initializer::testProfileJson() {
+    QTemporaryDir dir;
+    const QString profilePath = dir.filePath("startup_profile.json");
+    {
+        InitializerJavascript initJavascript;
+        Initializer initManager(initJavascript);
+        initManager.setProfilePath(profilePath);
+
+        const std::shared_future<int> a = initManager.addInit<InitA>();
+        const std::shared_future<int> b = initManager.addInit<InitB>();
+        const std::shared_future<int> c = initManager.addInit<InitC>(a, b);
+        initManager.complete();
+        c.get();
+    }
+
+    QFile file(profilePath);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    QVERIFY(root.value("total_ms").toDouble() >= 400);
+    const QJsonArray steps = root.value("steps").toArray();
+    QCOMPARE(steps.size(), 3);
+    for (const QJsonValue &stepJson: steps) {
+        const QJsonObject step = stepJson.toObject();
+        QVERIFY(step.value("finished").toBool());
+        QVERIFY(step.contains("begin_ms"));
+        QVERIFY(step.contains("end_ms"));
+        QVERIFY(step.contains("wait_dependencies_ms"));
+        if (step.value("name").toString() == "c") {
+            QCOMPARE(step.value("dependencies").toArray().size(), 2);
+            QVERIFY(step.value("wait_dependencies_ms").toDouble() >= 250);
+        }
+    }
+}
+
+QTEST_MAIN(tst_Initializer)
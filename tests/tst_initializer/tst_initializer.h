@@ -0,0 +1,27 @@
+#ifndef TST_INITIALIZER_H
+#define TST_INITIALIZER_H
+
+#include <QObject>
+
+class tst_Initializer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_Initializer(QObject *parent = nullptr);
+
+private slots:
+
+    void testParallelAndOrder();
+
+    void testDeferred();
+
+    void testDependencyNotAdded();
+
+    void testDependencyTypeMismatch();
+
+    void testFailedDependency();
+
+    void testProfileJson();
+};
+
+#endif // TST_INITIALIZER_H
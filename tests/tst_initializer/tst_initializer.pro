@@ -0,0 +1,35 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network
+TARGET = tst_initializer
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src
+
+SOURCES += \
+    tst_initializer.cpp \
+    ../../src/Initializer/Initializer.cpp \
+    ../../src/Initializer/InitInterface.cpp \
+    ../../src/Initializer/InitializerJavascript.cpp \
+    ../../src/TypedException.cpp \
+    ../../src/QRegister.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp
+
+HEADERS += \
+    tst_initializer.h \
+    ../../src/Initializer/Initializer.h \
+    ../../src/Initializer/InitInterface.h \
+    ../../src/Initializer/InitializerJavascript.h \
+    ../../src/Log.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)
@@ -0,0 +1,143 @@
+#include "tst_jsdeliveryqueue.h"
+
+#include <QTest>
+#include <QCoreApplication>
+#include <QEvent>
+
+#include <vector>
+
+#include "JsDeliveryQueue.h"
+
+tst_JsDeliveryQueue::tst_JsDeliveryQueue(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_JsDeliveryQueue::testOrder() {
+    std::vector<QString> scripts;
+    JsDeliveryQueue queue([&scripts](const QString &script) {
+        scripts.emplace_back(script);
+    }, 16ms);
+
+    queue.add("f(1);");
+    queue.add("g(2);");
+    queue.add("f(3);");
+    QCOMPARE(queue.countPending(), size_t(3));
+    QVERIFY(scripts.empty());
+
+    queue.flush();
+    QCOMPARE(scripts.size(), size_t(1));
+    const QString &script = scripts.front();
+    QVERIFY(script.indexOf("f(1);") < script.indexOf("g(2);"));
+    QVERIFY(script.indexOf("g(2);") < script.indexOf("f(3);"));
+    QCOMPARE(queue.countPending(), size_t(0));
+
+    queue.flush();
+    QCOMPARE(scripts.size(), size_t(1));
+}
+
+void tst_JsDeliveryQueue::testLatest() {
+    std::vector<QString> scripts;
+    JsDeliveryQueue queue([&scripts](const QString &script) {
+        scripts.emplace_back(script);
+    }, 16ms);
+
+    queue.addLatest("balance addr1", "balance(\"addr1\", 1);");
+    queue.add("other();");
+    queue.addLatest("balance addr2", "balance(\"addr2\", 5);");
+    queue.addLatest("balance addr1", "balance(\"addr1\", 2);");
+    QCOMPARE(queue.countPending(), size_t(3));
+
+    queue.flush();
+    QCOMPARE(scripts.size(), size_t(1));
+    const QString &script = scripts.front();
+    QVERIFY(!script.contains("balance(\"addr1\", 1);"));
+    QVERIFY(script.contains("balance(\"addr2\", 5);"));
+    QVERIFY(script.indexOf("other();") < script.indexOf("balance(\"addr1\", 2);"));
+}
+
+void tst_JsDeliveryQueue::testWithoutBatching() {
+    std::vector<QString> scripts;
+    JsDeliveryQueue queue([&scripts](const QString &script) {
+        scripts.emplace_back(script);
+    }, 16ms);
+    queue.setBatching(false);
+
+    queue.add("f(1);");
+    queue.addLatest("key", "f(2);");
+    queue.addLatest("key", "f(3);");
+    QCOMPARE(scripts.size(), size_t(3));
+    QCOMPARE(scripts.back(), QString("f(3);"));
+    QCOMPARE(queue.countPending(), size_t(0));
+}
+
+void tst_JsDeliveryQueue::testTimer() {
+    size_t runs = 0;
+    JsDeliveryQueue queue([&runs](const QString &) {
+        runs++;
+    }, 16ms);
+
+    for (size_t i = 0; i < 100; i++) {
+        queue.add("f();");
+    }
+    QCOMPARE(runs, size_t(0));
+    QTRY_COMPARE(runs, size_t(1));
+}
+
+void tst_JsDeliveryQueue::testClear() {
+    std::vector<QString> scripts;
+    JsDeliveryQueue queue([&scripts](const QString &script) {
+        scripts.emplace_back(script);
+    }, 16ms);
+
+    queue.add("f(1);");
+    queue.addLatest("key", "f(2);");
+    queue.clear();
+    QCOMPARE(queue.countPending(), size_t(0));
+
+    // Таймер остановлен, и после clear уходит только новый скрипт
+    queue.add("f(3);");
+    QTRY_COMPARE(scripts.size(), size_t(1));
+    QVERIFY(!scripts.front().contains("f(1);"));
+    QVERIFY(!scripts.front().contains("f(2);"));
+    QVERIFY(scripts.front().contains("f(3);"));
+}
+
+void tst_JsDeliveryQueue::benchmarkDelivery_data() {
+    QTest::addColumn<bool>("isBatching");
+    QTest::newRow("without batching") << false;
+    QTest::newRow("with batching") << true;
+}
+
+void tst_JsDeliveryQueue::benchmarkDelivery() {
+    QFETCH(bool, isBatching);
+
+    const size_t COUNT_ADDRESSES = 500;
+    const size_t COUNT_UPDATES = 4;
+
+    // Как и runJavaScript, каждый вызов сериализует скрипт и кладет одно событие в очередь главного потока,
+    // поэтому цена вызова в обоих вариантах одинаковая
+    QObject page;
+    size_t sentBytes = 0;
+    JsDeliveryQueue queue([&page, &sentBytes](const QString &script) {
+        sentBytes += size_t(script.toUtf8().size());
+        QCoreApplication::postEvent(&page, new QEvent(QEvent::User));
+    }, 16ms);
+    queue.setBatching(isBatching);
+
+    // add, а не addLatest: оба варианта доставляют на страницу одинаковое число скриптов
+    QBENCHMARK {
+        for (size_t update = 0; update < COUNT_UPDATES; update++) {
+            for (size_t i = 0; i < COUNT_ADDRESSES; i++) {
+                const QString address = "0x00" + QString::number(i);
+                const QString script = "txsNewBalanceJs(\"" + address + "\", \"mhc\", \"{\\\"received\\\":\\\"" + QString::number(update) + "\\\"}\", 0, \"\");";
+                queue.add(script);
+            }
+        }
+        queue.flush();
+        QCoreApplication::sendPostedEvents(&page);
+    }
+    qDebug() << "Calls to page:" << queue.countRuns() << ", bytes:" << sentBytes;
+}
+
+QTEST_MAIN(tst_JsDeliveryQueue)
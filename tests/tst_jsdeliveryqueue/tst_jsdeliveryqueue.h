@@ -0,0 +1,28 @@
+#ifndef TST_JSDELIVERYQUEUE_H
+#define TST_JSDELIVERYQUEUE_H
+
+#include <QObject>
+
+class tst_JsDeliveryQueue : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_JsDeliveryQueue(QObject *parent = nullptr);
+
+private slots:
+
+    void testOrder();
+
+    void testLatest();
+
+    void testWithoutBatching();
+
+    void testTimer();
+
+    void testClear();
+
+    void benchmarkDelivery_data();
+    void benchmarkDelivery();
+};
+
+#endif // TST_JSDELIVERYQUEUE_H
@@ -0,0 +1,148 @@
+#include "tst_log.h"
+
+#include <QTest>
+#include <QDir>
+#include <QFileInfo>
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "Log.h"
+#include "utils.h"
+
+SET_LOG_NAMESPACE("TST");
+
+static const size_t COUNT_THREADS = 8;
+
+static void logInThreads(size_t countPerThread) {
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < COUNT_THREADS; t++) {
+        threads.emplace_back([t, countPerThread]{
+            for (size_t i = 0; i < countPerThread; i++) {
+                LOG << "Thread " << t << " message " << i << " " << QString("some text");
+            }
+        });
+    }
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+}
+
+static void logBatches(size_t countBatches, size_t countPerBatch) {
+    for (size_t b = 0; b < countBatches; b++) {
+        for (size_t i = 0; i < countPerBatch; i++) {
+            LOG << "Batch " << b << " message " << i << " " << std::string(64, 'x');
+        }
+        flushLog();
+    }
+}
+
+static QStringList logFiles(const QString &path, const QString &pattern) {
+    return QDir(path).entryList(QStringList(pattern), QDir::Files);
+}
+
+tst_Log::tst_Log(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_Log::initTestCase() {
+    QVERIFY(logDir.isValid());
+    initLog(logDir.path());
+}
+
+void tst_Log::testLogAllWritten() {
+    const size_t countPerThread = 500;
+    const size_t droppedBefore = getLogDroppedCount();
+    logInThreads(countPerThread);
+    flushLog();
+    QCOMPARE(getLogDroppedCount(), droppedBefore);
+
+    const QStringList files = QDir(logDir.path()).entryList(QStringList("log.*.txt"), QDir::Files);
+    QCOMPARE(files.size(), 1);
+    const std::string content = readFile(makePath(logDir.path(), files.front()));
+    QCOMPARE(size_t(std::count(content.begin(), content.end(), '\n')), COUNT_THREADS * countPerThread);
+}
+
+void tst_Log::testLogLevels() {
+    int evaluated = 0;
+    const auto arg = [&evaluated]{
+        evaluated++;
+        return evaluated;
+    };
+
+    LOG_DEBUG << "debug " << arg();
+    QCOMPARE(evaluated, 0);
+    LOG << "info " << arg();
+    QCOMPARE(evaluated, 1);
+
+    setLogLevel("TST", LogLevel::Warning);
+    LOG << "info " << arg();
+    QCOMPARE(evaluated, 1);
+    LOG_WARN << "warning " << arg();
+    QCOMPARE(evaluated, 2);
+
+    setLogLevel("TST", LogLevel::Trace);
+    LOG_TRACE << "trace " << arg();
+    QCOMPARE(evaluated, 3);
+
+    setLogLevel("TST", LogLevel::Info);
+
+    // LOG внутри if без фигурных скобок не забирает себе else
+    bool isElse = false;
+    if (evaluated == 0)
+        LOG << "never " << arg();
+    else
+        isElse = true;
+    QVERIFY(isElse);
+    QCOMPARE(evaluated, 3);
+}
+
+void tst_Log::testRotationDisabled() {
+    setLogRotation(0, 0, 0);
+    const int countBefore = logFiles(logDir.path(), "log.*").size();
+    logBatches(10, 100);
+    QCOMPARE(logFiles(logDir.path(), "log.*").size(), countBefore);
+}
+
+void tst_Log::testRotation() {
+    setLogRotation(16 * 1024, 0, 0);
+    const int countBefore = logFiles(logDir.path(), "log.*").size();
+    logBatches(10, 300);
+    QVERIFY(logFiles(logDir.path(), "log.*").size() > countBefore);
+    QTRY_VERIFY(!logFiles(logDir.path(), "log.*.txt.gz").isEmpty());
+    QTRY_COMPARE(logFiles(logDir.path(), "log.*.txt").size(), 1);
+}
+
+void tst_Log::testRotationPrune() {
+    setLogRotation(4 * 1024, 0, 0);
+    logBatches(30, 100);
+    QTRY_VERIFY(logFiles(logDir.path(), "log.*").size() <= 20);
+
+    const int64_t maxTotalSize = 64 * 1024;
+    setLogRotation(4 * 1024, 0, maxTotalSize);
+    logBatches(5, 100);
+    QTRY_COMPARE(logFiles(logDir.path(), "log.*.txt").size(), 1);
+    const auto rotatedSize = [this]{
+        int64_t size = 0;
+        for (const QFileInfo &info: QDir(logDir.path()).entryInfoList(QStringList("log.*.txt.gz"), QDir::Files)) {
+            size += info.size();
+        }
+        return size;
+    };
+    QTRY_VERIFY(rotatedSize() <= maxTotalSize);
+
+    setLogRotation(50 * 1024 * 1024, 24 * 3600, 500 * 1024 * 1024);
+}
+
+void tst_Log::benchmarkLog8Threads() {
+    const size_t droppedBefore = getLogDroppedCount();
+    QBENCHMARK {
+        logInThreads(10000);
+    }
+    flushLog();
+    qDebug() << "Dropped" << getLogDroppedCount() - droppedBefore;
+}
+
+QTEST_MAIN(tst_Log)
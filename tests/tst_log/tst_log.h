@@ -0,0 +1,34 @@
+#ifndef TST_LOG_H
+#define TST_LOG_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+class tst_Log : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_Log(QObject *parent = nullptr);
+
+private slots:
+
+    void initTestCase();
+
+    void testLogAllWritten();
+
+    void testLogLevels();
+
+    void testRotationDisabled();
+
+    void testRotation();
+
+    void testRotationPrune();
+
+    void benchmarkLog8Threads();
+
+private:
+
+    QTemporaryDir logDir;
+};
+
+#endif // TST_LOG_H
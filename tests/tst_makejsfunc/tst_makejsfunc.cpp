@@ -0,0 +1,124 @@
+#include "tst_makejsfunc.h"
+
+#include <QTest>
+#include <QJSEngine>
+
+#include "makeJsFunc.h"
+
+// Прежняя реализация, для сравнения в бенчмарке
+static QString toJsStringOld(const QString &arg) {
+    QString copy = arg;
+    copy.replace("\\", "\\\\");
+    copy.replace('\"', "\\\"");
+    copy.replace("\n", "\\n");
+    copy.replace("\r", "");
+    return "\"" + copy + "\"";
+}
+
+static QJsonDocument makeBigArray(int count) {
+    QJsonArray array;
+    for (int i = 0; i < count; i++) {
+        QJsonObject tx;
+        tx.insert("from", "0x00fa2a5279f8f0fd2f0f9d3280ad70403f01f9d62f52373833");
+        tx.insert("to", QString("0x00a1b2") + QString::number(i));
+        tx.insert("value", QString::number(i * 1000));
+        tx.insert("data", QString::fromUtf8("комментарий \"с кавычками\" \\ и ☃ ") + QString::number(i));
+        tx.insert("isInput", i % 2 == 0);
+        array.push_back(tx);
+    }
+    return QJsonDocument(array);
+}
+
+tst_MakeJsFunc::tst_MakeJsFunc(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_MakeJsFunc::testString_data() {
+    QTest::addColumn<QString>("str");
+    QTest::newRow("String 01") << QString("simple");
+    QTest::newRow("String 02") << QString("with \"quotes\" and 'single'");
+    QTest::newRow("String 03") << QString("back\\slash \\\" \\n");
+    QTest::newRow("String 04") << QString("new\nline\ttab");
+    QTest::newRow("String 05") << QString::fromUtf8("юникод ☃ 😀");
+    QTest::newRow("String 06") << (QString("line") + QChar(0x2028) + QString("separator") + QChar(0x2029));
+    QTest::newRow("String 07") << QString("");
+}
+
+void tst_MakeJsFunc::testString() {
+    QFETCH(QString, str);
+    QJSEngine engine;
+    const QJSValue result = engine.evaluate(toJsString(str));
+    QVERIFY(!result.isError());
+    QCOMPARE(result.toString(), str);
+}
+
+void tst_MakeJsFunc::testJson_data() {
+    QTest::addColumn<QJsonDocument>("doc");
+    QTest::newRow("Json 01") << QJsonDocument::fromJson("{\"a\":\"b\",\"c\":[1,2,3]}");
+    QTest::newRow("Json 02") << QJsonDocument(QJsonArray{QString::fromUtf8("\"☃\" \\ ") + QChar(0x2028), QString("\n\r\t")});
+    QTest::newRow("Json 03") << makeBigArray(10000);
+}
+
+void tst_MakeJsFunc::testJson() {
+    QFETCH(QJsonDocument, doc);
+    QJSEngine engine;
+
+    const QJSValue str = engine.evaluate(toJsString(doc));
+    QVERIFY(!str.isError());
+    QCOMPARE(QJsonDocument::fromJson(str.toString().toUtf8()), doc);
+
+    const QJSValue raw = engine.evaluate("JSON.stringify(" + toJsString(JsJson(doc)) + ")");
+    QVERIFY(!raw.isError());
+    QCOMPARE(QJsonDocument::fromJson(raw.toString().toUtf8()), doc);
+}
+
+void tst_MakeJsFunc::testMakeJsFunc() {
+    QJSEngine engine;
+    engine.evaluate("function f(str, json, num, errNum, errDescr) { return JSON.stringify([str, json, num, errNum, errDescr]); }");
+    const QJsonObject obj{{"k", "v\""}};
+    const QString script = makeJsFunc3<false>("f", "", TypedException(), QString("s\"1"), JsJson(obj), 5);
+    const QJSValue result = engine.evaluate(script);
+    QVERIFY(!result.isError());
+    QCOMPARE(result.toString(), QString("[\"s\\\"1\",{\"k\":\"v\\\"\"},5,0,\"\"]"));
+}
+
+void tst_MakeJsFunc::testJsonArg() {
+    QJSEngine engine;
+    engine.evaluate("function f(str, json, errNum, errDescr) { return typeof(json) + ' ' + JSON.stringify(json); }");
+    const QJsonDocument doc(QJsonObject{{"k", "v\""}});
+
+    const QJSValue asString = engine.evaluate(makeJsFunc3<false>("f", "", TypedException(), jsonArg(false, QString("s")), jsonArg(false, doc)));
+    QCOMPARE(asString.toString(), QString("string \"{\\\"k\\\":\\\"v\\\\\\\"\\\"}\""));
+
+    const QJSValue asLiteral = engine.evaluate(makeJsFunc3<false>("f", "", TypedException(), jsonArg(true, QString("s")), jsonArg(true, doc)));
+    QCOMPARE(asLiteral.toString(), QString("object {\"k\":\"v\\\"\"}"));
+
+    const QJSValue empty = engine.evaluate(makeJsFunc3<false>("f", "", TypedException(), jsonArg(true, QString("s")), jsonArg(true, QJsonDocument())));
+    QCOMPARE(empty.toString(), QString("object null"));
+}
+
+void tst_MakeJsFunc::benchmarkJson_data() {
+    QTest::addColumn<int>("type");
+    QTest::newRow("old string escaping") << 0;
+    QTest::newRow("new string escaping") << 1;
+    QTest::newRow("json literal") << 2;
+}
+
+void tst_MakeJsFunc::benchmarkJson() {
+    QFETCH(int, type);
+    const QJsonDocument doc = makeBigArray(10000);
+    QString result;
+    QBENCHMARK {
+        if (type == 0) {
+            result = toJsStringOld(doc.toJson(QJsonDocument::Compact));
+        } else if (type == 1) {
+            result = toJsString(doc);
+        } else {
+            result = toJsString(JsJson(doc));
+        }
+    }
+    QVERIFY(!result.isEmpty());
+}
+
+QTEST_MAIN(tst_MakeJsFunc)
@@ -0,0 +1,28 @@
+#ifndef TST_MAKEJSFUNC_H
+#define TST_MAKEJSFUNC_H
+
+#include <QObject>
+
+class tst_MakeJsFunc : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_MakeJsFunc(QObject *parent = nullptr);
+
+private slots:
+
+    void testString_data();
+    void testString();
+
+    void testJson_data();
+    void testJson();
+
+    void testMakeJsFunc();
+
+    void testJsonArg();
+
+    void benchmarkJson_data();
+    void benchmarkJson();
+};
+
+#endif // TST_MAKEJSFUNC_H
@@ -0,0 +1,311 @@
+#include "tst_mhcontentcache.h"
+
+#include <QTest>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QEventLoop>
+#include <QFile>
+#include <QDateTime>
+#include <QLocale>
+
+#include <future>
+
+#include "MhContentCache.h"
+
+CountingHttpServer::CountingHttpServer(QObject *parent)
+    : QObject(parent)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &CountingHttpServer::onNewConnection);
+}
+
+QString CountingHttpServer::url(const QString &path) const {
+    return "http://127.0.0.1:" + QString::number(server.serverPort()) + path;
+}
+
+void CountingHttpServer::setBody(const QByteArray &body, const QByteArray &etag) {
+    this->body = body;
+    this->etag = etag;
+}
+
+void CountingHttpServer::setCacheControl(const QByteArray &cacheControl) {
+    this->cacheControl = cacheControl;
+}
+
+void CountingHttpServer::setExpires(const QByteArray &expires) {
+    this->expires = expires;
+}
+
+void CountingHttpServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            processRequest(socket);
+        });
+    }
+}
+
+void CountingHttpServer::processRequest(QTcpSocket *socket) {
+    QByteArray &buffer = buffers[socket];
+    buffer += socket->readAll();
+    if (!buffer.contains("\r\n\r\n")) {
+        return;
+    }
+    countHits++;
+
+    QByteArray ifNoneMatch;
+    for (const QByteArray &line: buffer.split('\n')) {
+        if (line.toLower().startsWith("if-none-match:")) {
+            ifNoneMatch = line.mid(line.indexOf(':') + 1).trimmed();
+        }
+    }
+
+    QByteArray response;
+    if (!ifNoneMatch.isEmpty() && ifNoneMatch == etag) {
+        countNotModified++;
+        response = "HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\nConnection: close\r\n\r\n";
+    } else {
+        response = "HTTP/1.1 200 OK\r\nContent-Type: text/javascript; charset=utf-8\r\nETag: " + etag + "\r\n";
+        if (!cacheControl.isEmpty()) {
+            response += "Cache-Control: " + cacheControl + "\r\n";
+        }
+        if (!expires.isEmpty()) {
+            response += "Expires: " + expires + "\r\n";
+        }
+        response += "Content-Length: " + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    }
+    buffers.erase(socket);
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+tst_MhContentCache::tst_MhContentCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+// Ждет тело, которое loadBody может отдать из потока записи
+static bool loadBody(MhContentCache &cache, const QString &url, MhContentCache::Entry &entry) {
+    std::promise<bool> done;
+    std::future<bool> future = done.get_future();
+    cache.loadBody(url, [&done, &entry](bool isFound, const MhContentCache::Entry &result) {
+        entry = result;
+        done.set_value(isFound);
+    });
+    return future.get();
+}
+
+// Повторяет работу MHUrlSchemeHandler: свежую запись отдает из кэша, иначе делает условный запрос
+static MhContentCache::Entry load(MhContentCache &cache, QNetworkAccessManager &manager, const QString &url) {
+    MhContentCache::Entry entry;
+    const bool hasCached = cache.findMeta(url, entry);
+    if (hasCached && entry.isFresh(::system_now())) {
+        if (!loadBody(cache, url, entry)) {
+            return MhContentCache::Entry();
+        }
+        return entry;
+    }
+    QNetworkRequest request(url);
+    if (hasCached) {
+        cache.addConditionalHeaders(request, entry);
+    }
+    QNetworkReply *reply = manager.get(request);
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    reply->deleteLater();
+    MhContentCache::Entry result;
+    if (cache.processNotModified(url, *reply)) {
+        if (!loadBody(cache, url, result)) {
+            return MhContentCache::Entry();
+        }
+        return result;
+    }
+    if (!cache.processReply(url, *reply, result)) {
+        return MhContentCache::Entry();
+    }
+    return result;
+}
+
+void tst_MhContentCache::testFresh() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    server.setBody("var a = 1;", "\"v1\"");
+    server.setCacheControl("max-age=60");
+    QNetworkAccessManager manager;
+    MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+
+    const QString url = server.url("/app.js");
+    for (size_t i = 0; i < 5; i++) {
+        const MhContentCache::Entry entry = load(cache, manager, url);
+        QCOMPARE(entry.body, QByteArray("var a = 1;"));
+        QCOMPARE(entry.mime, QByteArray("text/javascript"));
+    }
+    QCOMPARE(server.countHits, size_t(1));
+}
+
+void tst_MhContentCache::testRevalidate() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    server.setBody("var a = 1;", "\"v1\"");
+    QNetworkAccessManager manager;
+    MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+
+    const QString url = server.url("/app.js");
+    for (size_t i = 0; i < 3; i++) {
+        const MhContentCache::Entry entry = load(cache, manager, url);
+        QCOMPARE(entry.body, QByteArray("var a = 1;"));
+    }
+    QCOMPARE(server.countHits, size_t(3));
+    QCOMPARE(server.countNotModified, size_t(2));
+}
+
+void tst_MhContentCache::testChanged() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    server.setBody("var a = 1;", "\"v1\"");
+    QNetworkAccessManager manager;
+    MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+
+    const QString url = server.url("/app.js");
+    QCOMPARE(load(cache, manager, url).body, QByteArray("var a = 1;"));
+    server.setBody("var a = 2;", "\"v2\"");
+    QCOMPARE(load(cache, manager, url).body, QByteArray("var a = 2;"));
+    QCOMPARE(server.countNotModified, size_t(0));
+    cache.flush();
+    QCOMPARE(cache.countEntries(), size_t(1));
+    QCOMPARE(cache.getDiskSize(), size_t(10));
+}
+
+void tst_MhContentCache::testPersist() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    server.setBody("var a = 1;", "\"v1\"");
+    server.setCacheControl("max-age=60");
+    QNetworkAccessManager manager;
+
+    const QString url = server.url("/app.js");
+    {
+        MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+        load(cache, manager, url);
+        // Одинаковое содержимое хранится на диске один раз
+        load(cache, manager, server.url("/copy.js"));
+        cache.flush();
+        QCOMPARE(cache.getDiskSize(), size_t(10));
+    }
+    MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+    QCOMPARE(cache.countEntries(), size_t(2));
+    QCOMPARE(cache.getDiskSize(), size_t(10));
+    QCOMPARE(load(cache, manager, url).body, QByteArray("var a = 1;"));
+    QCOMPARE(server.countHits, size_t(2));
+}
+
+void tst_MhContentCache::testNoStore() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    server.setBody("var a = 1;", "\"v1\"");
+    server.setCacheControl("no-store");
+    QNetworkAccessManager manager;
+    MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+
+    const QString url = server.url("/app.js");
+    QCOMPARE(load(cache, manager, url).body, QByteArray("var a = 1;"));
+    QCOMPARE(load(cache, manager, url).body, QByteArray("var a = 1;"));
+    QCOMPARE(server.countHits, size_t(2));
+    QCOMPARE(cache.countEntries(), size_t(0));
+}
+
+void tst_MhContentCache::testDiskLimit() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    QNetworkAccessManager manager;
+    MhContentCache cache(dir.path(), 1024, 4500);
+
+    for (int i = 0; i < 5; i++) {
+        server.setBody(QByteArray(1000, char('a' + i)), "\"v" + QByteArray::number(i) + "\"");
+        load(cache, manager, server.url("/file" + QString::number(i)));
+        QTest::qWait(2);
+        cache.flush();
+    }
+    QVERIFY(cache.getDiskSize() <= 4500);
+    QCOMPARE(cache.countEntries(), size_t(4));
+    QVERIFY(cache.getMemorySize() <= 1024);
+
+    MhContentCache::Entry entry;
+    QVERIFY(!cache.findMeta(server.url("/file0"), entry));
+    QVERIFY(loadBody(cache, server.url("/file4"), entry));
+    QCOMPARE(entry.body, QByteArray(1000, 'e'));
+}
+
+void tst_MhContentCache::testNotCacheable() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    // Ни срока свежести, ни валидаторов - например, ответ api
+    server.setBody("{\"balance\":1}", "");
+    QNetworkAccessManager manager;
+    MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+
+    const QString url = server.url("/api");
+    QCOMPARE(load(cache, manager, url).body, QByteArray("{\"balance\":1}"));
+    server.setBody("{\"balance\":2}", "");
+    QCOMPARE(load(cache, manager, url).body, QByteArray("{\"balance\":2}"));
+    QCOMPARE(server.countHits, size_t(2));
+    QCOMPARE(cache.countEntries(), size_t(0));
+}
+
+void tst_MhContentCache::testExpires() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    server.setBody("var a = 1;", "");
+    const QDateTime expires = QDateTime::currentDateTimeUtc().addSecs(3600);
+    server.setExpires(QLocale::c().toString(expires, "ddd, dd MMM yyyy HH:mm:ss 'GMT'").toLatin1());
+    QNetworkAccessManager manager;
+    MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+
+    const QString url = server.url("/app.js");
+    for (size_t i = 0; i < 3; i++) {
+        QCOMPARE(load(cache, manager, url).body, QByteArray("var a = 1;"));
+    }
+    QCOMPARE(server.countHits, size_t(1));
+}
+
+void tst_MhContentCache::testStoreFile() {
+    QTemporaryDir dir;
+    CountingHttpServer server;
+    server.setBody("var a = 1;", "\"v1\"");
+    server.setCacheControl("max-age=60");
+    QNetworkAccessManager manager;
+    MhContentCache cache(dir.path(), 1024 * 1024, 1024 * 1024);
+
+    // Так тело сохраняет MHUrlSchemeHandler после потоковой отдачи
+    const QString url = server.url("/app.js");
+    QNetworkReply *reply = manager.get(QNetworkRequest(url));
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    reply->deleteLater();
+
+    const QString capturePath = cache.makeCapturePath();
+    QFile file(capturePath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(reply->readAll());
+    file.close();
+    cache.storeFile(url, *reply, capturePath);
+
+    MhContentCache::Entry entry;
+    QVERIFY(loadBody(cache, url, entry));
+    QCOMPARE(entry.body, QByteArray("var a = 1;"));
+
+    cache.flush();
+    QVERIFY(!QFile::exists(capturePath));
+    QCOMPARE(cache.getDiskSize(), size_t(10));
+    QVERIFY(loadBody(cache, url, entry));
+    QCOMPARE(entry.body, QByteArray("var a = 1;"));
+    QCOMPARE(server.countHits, size_t(1));
+}
+
+QTEST_MAIN(tst_MhContentCache)
@@ -0,0 +1,75 @@
+#ifndef TST_MHCONTENTCACHE_H
+#define TST_MHCONTENTCACHE_H
+
+#include <QObject>
+#include <QTcpServer>
+
+#include <map>
+
+class QTcpSocket;
+
+// Локальная замена сервера mh: отдает тело с ETag и считает запросы
+class CountingHttpServer : public QObject {
+    Q_OBJECT
+public:
+    explicit CountingHttpServer(QObject *parent = nullptr);
+
+    QString url(const QString &path) const;
+
+    void setBody(const QByteArray &body, const QByteArray &etag);
+
+    void setCacheControl(const QByteArray &cacheControl);
+
+    void setExpires(const QByteArray &expires);
+
+    size_t countHits = 0;
+    size_t countNotModified = 0;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    void processRequest(QTcpSocket *socket);
+
+private:
+
+    QTcpServer server;
+
+    std::map<QTcpSocket*, QByteArray> buffers;
+
+    QByteArray body;
+    QByteArray etag;
+    QByteArray cacheControl;
+    QByteArray expires;
+};
+
+class tst_MhContentCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_MhContentCache(QObject *parent = nullptr);
+
+private slots:
+
+    void testFresh();
+
+    void testRevalidate();
+
+    void testChanged();
+
+    void testPersist();
+
+    void testNoStore();
+
+    void testDiskLimit();
+
+    void testNotCacheable();
+
+    void testExpires();
+
+    void testStoreFile();
+};
+
+#endif // TST_MHCONTENTCACHE_H
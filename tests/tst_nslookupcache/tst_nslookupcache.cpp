@@ -0,0 +1,239 @@
+#include "tst_nslookupcache.h"
+
+#include <QTest>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QDir>
+
+#include <memory>
+#include <algorithm>
+
+#include "check.h"
+#include "utils.h"
+#include "client.h"
+#include "NsLookupCache.h"
+
+namespace {
+
+const QByteArray NODES_HASH = "nodes hash";
+
+const QString NODE_NAME = "tor.net-main.metahashnetwork.com";
+
+NsLookupCache makeCache(const std::vector<QString> &addresses) {
+    NsLookupCache cache;
+    cache.scanTime = intToSystemTimePoint(1500000000000);
+    cache.dnsTime = intToSystemTimePoint(1500000001000);
+    cache.dns[NODE_NAME] = addresses;
+    for (size_t i = 0; i < addresses.size(); i++) {
+        NodeInfo info;
+        info.address = addresses[i];
+        info.ping = 10 + i;
+        info.isChecked = true;
+        info.isTimeout = i % 3 == 2;
+        info.lastCheck = intToSystemTimePoint(1500000002000 + i);
+        cache.nodes[NODE_NAME].emplace_back(info);
+    }
+    return cache;
+}
+
+QString firstUsable(std::vector<NodeInfo> nodes) {
+    std::sort(nodes.begin(), nodes.end(), std::less<NodeInfo>{});
+    if (nodes.empty() || nodes.front().isTimeout) {
+        return "";
+    }
+    return nodes.front().address;
+}
+
+// Холодный старт: кеша нет, все ноды пингуются заново. Dns не учитывается
+std::vector<NodeInfo> pingNodes(const std::vector<QString> &addresses) {
+    SimpleClient client;
+    QObject::connect(&client, &SimpleClient::callbackCall, [](const SimpleClient::ReturnCallback &callback) {
+        callback();
+    });
+
+    std::vector<NodeInfo> result;
+    QEventLoop loop;
+    client.pings("bench", addresses, [&result, &loop](const std::vector<std::tuple<QString, milliseconds, std::string>> &responses) {
+        for (const auto &response: responses) {
+            NodeInfo info;
+            info.address = std::get<0>(response);
+            info.ping = std::get<1>(response).count();
+            info.isChecked = true;
+            info.isTimeout = std::get<2>(response).empty();
+            info.lastCheck = system_now();
+            result.emplace_back(info);
+        }
+        loop.quit();
+    }, 2s);
+    loop.exec();
+    return result;
+}
+
+}
+
+MockPingNode::MockPingNode(QObject *parent)
+    : QObject(parent)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &MockPingNode::onNewConnection);
+}
+
+QString MockPingNode::address() const {
+    return "http://127.0.0.1:" + QString::number(server.serverPort());
+}
+
+void MockPingNode::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::destroyed, [this, socket]() {
+            buffers.erase(socket);
+        });
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            QByteArray &buffer = buffers[socket];
+            buffer += socket->readAll();
+            const int headersEnd = buffer.indexOf("\r\n\r\n");
+            if (headersEnd == -1) {
+                return;
+            }
+            buffer.remove(0, headersEnd + 4);
+            const QByteArray response = "{\"result\":\"ok\"}";
+            socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + QByteArray::number(response.size()) + "\r\n\r\n" + response);
+        });
+    }
+}
+
+tst_NsLookupCache::tst_NsLookupCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_NsLookupCache::testSaveLoad()
+{
+    QTemporaryDir dir;
+    const QString file = makePath(dir.path(), "fill_nodes.bin");
+    const NsLookupCache cache = makeCache({"http://1.1.1.1:5795", "http://2.2.2.2:5795", "http://3.3.3.3:5795", "http://4.4.4.4:5795"});
+    NsLookupCache::save(file, NODES_HASH, cache);
+
+    NsLookupCache loaded;
+    QVERIFY(NsLookupCache::load(file, NODES_HASH, loaded));
+    QCOMPARE(systemTimePointToInt(loaded.scanTime), systemTimePointToInt(cache.scanTime));
+    QCOMPARE(systemTimePointToInt(loaded.dnsTime), systemTimePointToInt(cache.dnsTime));
+    QVERIFY(loaded.dns == cache.dns);
+    QCOMPARE(loaded.nodes.size(), size_t(1));
+    const std::vector<NodeInfo> &infos = loaded.nodes[NODE_NAME];
+    const std::vector<NodeInfo> &expected = cache.nodes.at(NODE_NAME);
+    QCOMPARE(infos.size(), expected.size());
+    for (size_t i = 0; i < infos.size(); i++) {
+        QCOMPARE(infos[i].address, expected[i].address);
+        QCOMPARE(infos[i].ping, expected[i].ping);
+        QCOMPARE(infos[i].isChecked, expected[i].isChecked);
+        QCOMPARE(infos[i].isTimeout, expected[i].isTimeout);
+        QCOMPARE(systemTimePointToInt(infos[i].lastCheck), systemTimePointToInt(expected[i].lastCheck));
+    }
+
+    // Перезапись поверх существующего файла
+    NsLookupCache::save(file, NODES_HASH, makeCache({"http://5.5.5.5:5795"}));
+    QVERIFY(NsLookupCache::load(file, NODES_HASH, loaded));
+    QCOMPARE(loaded.nodes[NODE_NAME].size(), size_t(1));
+    // Временный файл QSaveFile не остается рядом с кешем
+    QCOMPARE(QDir(dir.path()).entryList(QDir::Files), QStringList{"fill_nodes.bin"});
+}
+
+void tst_NsLookupCache::testRejected_data()
+{
+    QTest::addColumn<QString>("damage");
+
+    QTest::newRow("missing") << "missing";
+    QTest::newRow("version") << "version";
+    QTest::newRow("payload") << "payload";
+    QTest::newRow("truncated") << "truncated";
+    QTest::newRow("nodes changed") << "nodes";
+}
+
+void tst_NsLookupCache::testRejected()
+{
+    QFETCH(QString, damage);
+
+    QTemporaryDir dir;
+    const QString file = makePath(dir.path(), "fill_nodes.bin");
+    NsLookupCache::save(file, NODES_HASH, makeCache({"http://1.1.1.1:5795", "http://2.2.2.2:5795"}));
+
+    QFile f(file);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    QByteArray content = f.readAll();
+    f.close();
+
+    QByteArray nodesHash = NODES_HASH;
+    if (damage == "missing") {
+        removeFile(file);
+    } else if (damage == "version") {
+        // magic, затем версия big endian
+        content[7] = content[7] + 1;
+    } else if (damage == "payload") {
+        content[content.size() / 2] = content[content.size() / 2] ^ 0x55;
+    } else if (damage == "truncated") {
+        content.truncate(content.size() - 10);
+    } else if (damage == "nodes") {
+        nodesHash = "other nodes hash";
+    }
+    if (damage != "missing") {
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        f.write(content);
+        f.close();
+    }
+
+    NsLookupCache loaded = makeCache({"http://9.9.9.9:5795"});
+    QVERIFY(!NsLookupCache::load(file, nodesHash, loaded));
+    // Неудачная загрузка не портит переданный кеш
+    QCOMPARE(loaded.nodes[NODE_NAME].size(), size_t(1));
+}
+
+void tst_NsLookupCache::benchmarkFirstServer_data()
+{
+    QTest::addColumn<int>("countNodes");
+
+    QTest::newRow("20 nodes") << 20;
+    QTest::newRow("100 nodes") << 100;
+}
+
+void tst_NsLookupCache::benchmarkFirstServer()
+{
+    QFETCH(int, countNodes);
+
+    std::vector<std::unique_ptr<MockPingNode>> nodes;
+    std::vector<QString> addresses;
+    for (int i = 0; i < countNodes; i++) {
+        nodes.emplace_back(std::make_unique<MockPingNode>());
+        addresses.emplace_back(nodes.back()->address());
+    }
+
+    QTemporaryDir dir;
+    const QString file = makePath(dir.path(), "fill_nodes.bin");
+
+    QElapsedTimer timer;
+    timer.start();
+    const std::vector<NodeInfo> pinged = pingNodes(addresses);
+    const QString coldServer = firstUsable(pinged);
+    const qint64 coldTime = timer.nsecsElapsed();
+    QVERIFY(!coldServer.isEmpty());
+
+    NsLookupCache cache;
+    cache.scanTime = system_now();
+    cache.nodes[NODE_NAME] = pinged;
+    NsLookupCache::save(file, NODES_HASH, cache);
+
+    timer.restart();
+    NsLookupCache loaded;
+    QVERIFY(NsLookupCache::load(file, NODES_HASH, loaded));
+    const QString warmServer = firstUsable(loaded.nodes[NODE_NAME]);
+    const qint64 warmTime = timer.nsecsElapsed();
+    QCOMPARE(warmServer, coldServer);
+
+    qDebug() << "First usable server of" << countNodes << "nodes: cold" << coldTime / 1000 << "us, warm" << warmTime / 1000 << "us";
+}
+
+QTEST_MAIN(tst_NsLookupCache)
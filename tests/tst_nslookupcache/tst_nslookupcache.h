@@ -0,0 +1,47 @@
+#ifndef TST_NSLOOKUPCACHE_H
+#define TST_NSLOOKUPCACHE_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QUrl>
+
+#include <map>
+
+// Нода, отвечающая на пинг валидным json
+class MockPingNode : public QObject {
+    Q_OBJECT
+public:
+    explicit MockPingNode(QObject *parent = nullptr);
+
+    QString address() const;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    QTcpServer server;
+
+    std::map<QObject*, QByteArray> buffers;
+};
+
+class tst_NsLookupCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_NsLookupCache(QObject *parent = nullptr);
+
+private slots:
+
+    void testSaveLoad();
+
+    void testRejected_data();
+    void testRejected();
+
+    void benchmarkFirstServer_data();
+    void benchmarkFirstServer();
+
+};
+
+#endif // TST_NSLOOKUPCACHE_H
@@ -0,0 +1,99 @@
+#include "tst_pagesmappings.h"
+
+#include <QTest>
+
+#include <QUrl>
+
+#include "PagesMappings.h"
+#include "check.h"
+
+tst_PagesMappings::tst_PagesMappings(QObject *parent)
+    : QObject(parent)
+{
+}
+
+static QString makeMhMapping(const QString &name, const std::vector<QString> &ips) {
+    QString ipsStr;
+    for (const QString &ip: ips) {
+        if (!ipsStr.isEmpty()) {
+            ipsStr += ",";
+        }
+        ipsStr += "\"" + ip + "\"";
+    }
+    return "{\"type\":\"mh\",\"name\":\"" + name + "\",\"url\":\"" + name + "\",\"isExternal\":false,\"ip\":[" + ipsStr + "]}";
+}
+
+static const QString DEFAULT_GATEWAY = "{\"type\":\"defaultGateway\",\"ip\":[\"9.9.9.9:80\"]}";
+
+void tst_PagesMappings::testGetIp() {
+    PagesMappings mappings;
+    mappings.addMappingsMh(DEFAULT_GATEWAY);
+    mappings.addMappingsMh(makeMhMapping("site", {"1.1.1.1:80", "2.2.2.2:80"}));
+
+    const QString ip = mappings.getIp("mh://site");
+    QVERIFY(ip == "http://1.1.1.1:80" || ip == "http://2.2.2.2:80");
+    // Выбранный ip запоминается
+    for (size_t i = 0; i < 10; i++) {
+        QCOMPARE(mappings.getIp("mh://site"), ip);
+    }
+    QCOMPARE(mappings.getIp("mh://site/path/index.html"), ip);
+
+    QCOMPARE(mappings.getIp("mh://unknown"), QString("http://9.9.9.9:80"));
+}
+
+void tst_PagesMappings::testGetIpExcludes() {
+    PagesMappings mappings;
+    mappings.addMappingsMh(DEFAULT_GATEWAY);
+    mappings.addMappingsMh(makeMhMapping("site", {"1.1.1.1:80", "2.2.2.2:80", "3.3.3.3:80"}));
+
+    std::set<QString> excludes;
+    std::set<QString> results;
+    for (size_t i = 0; i < 3; i++) {
+        const QString ip = mappings.getIp("mh://site", excludes);
+        QVERIFY(results.find(ip) == results.end());
+        results.insert(ip);
+        excludes.insert(QUrl(ip).host());
+    }
+    QCOMPARE(results.size(), size_t(3));
+    QCOMPARE(mappings.getIp("mh://site", excludes), QString("http://9.9.9.9:80"));
+}
+
+void tst_PagesMappings::testSetMappingsError() {
+    PagesMappings mappings;
+    mappings.setMappings("{\"routes\":[{\"url\":\"wallet/index.html\",\"name\":\"app://wallet\",\"isExternal\":false,\"isDefault\":true}]}");
+    QCOMPARE(mappings.find("app://wallet").page, QString("wallet/index.html"));
+
+    QVERIFY_EXCEPTION_THROWN(mappings.setMappings("{\"routes\":[{\"url\":\"other/index.html\",\"name\":\"app://other\",\"isExternal\":false}, {\"name\":\"broken\"}]}"), Exception);
+    // Неудачная загрузка не портит старые таблицы
+    QCOMPARE(mappings.find("app://wallet").page, QString("wallet/index.html"));
+    QVERIFY(mappings.find("app://other").page.isEmpty());
+}
+
+void tst_PagesMappings::benchmarkGetIp_data() {
+    QTest::addColumn<int>("countPages");
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("50000") << 50000;
+}
+
+void tst_PagesMappings::benchmarkGetIp() {
+    QFETCH(int, countPages);
+
+    PagesMappings mappings;
+    mappings.addMappingsMh(DEFAULT_GATEWAY);
+    for (int i = 0; i < countPages; i++) {
+        mappings.addMappingsMh(makeMhMapping("site" + QString::number(i), {"1.1.1." + QString::number(i % 256) + ":80", "2.2.2." + QString::number(i % 256) + ":80"}));
+    }
+    std::vector<QString> names;
+    for (int i = 0; i < countPages; i += 7) {
+        names.emplace_back("mh://site" + QString::number(i) + "/index.html");
+    }
+    const std::set<QString> excludes = {"1.1.1.1", "2.2.2.2"};
+
+    QBENCHMARK {
+        for (const QString &name: names) {
+            mappings.getIp(name, excludes);
+        }
+    }
+}
+
+QTEST_MAIN(tst_PagesMappings)
@@ -0,0 +1,24 @@
+#ifndef TST_PAGESMAPPINGS_H
+#define TST_PAGESMAPPINGS_H
+
+#include <QObject>
+
+class tst_PagesMappings : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_PagesMappings(QObject *parent = nullptr);
+
+private slots:
+
+    void testGetIp();
+
+    void testGetIpExcludes();
+
+    void testSetMappingsError();
+
+    void benchmarkGetIp_data();
+    void benchmarkGetIp();
+};
+
+#endif // TST_PAGESMAPPINGS_H
@@ -0,0 +1,172 @@
+#include "tst_streamingreplydevice.h"
+
+#include <QTest>
+#include <QTcpSocket>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QEventLoop>
+#include <QTemporaryDir>
+
+#include <memory>
+
+#include "StreamingReplyDevice.h"
+
+const static qint64 CHUNK_SIZE = 64 * 1024;
+
+LargeBodyServer::LargeBodyServer(qint64 bodySize, QObject *parent)
+    : QObject(parent)
+    , bodySize(bodySize)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &LargeBodyServer::onNewConnection);
+}
+
+QString LargeBodyServer::url() const {
+    return "http://127.0.0.1:" + QString::number(server.serverPort()) + "/big.bin";
+}
+
+void LargeBodyServer::setAbortAt(qint64 abortAt) {
+    this->abortAt = abortAt;
+}
+
+void LargeBodyServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            socket->readAll();
+            written = 0;
+            socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: " + QByteArray::number(bodySize) + "\r\nConnection: close\r\n\r\n");
+            writeMore(socket);
+        });
+        connect(socket, &QTcpSocket::bytesWritten, [this, socket]() {
+            writeMore(socket);
+        });
+    }
+}
+
+void LargeBodyServer::writeMore(QTcpSocket *socket) {
+    // Держим в очереди сокета не больше пары кусков, чтобы сервер сам не раздувал память
+    while (written < bodySize && socket->bytesToWrite() < 2 * CHUNK_SIZE) {
+        const qint64 size = std::min(CHUNK_SIZE, bodySize - written);
+        socket->write(QByteArray(size, char('a' + (written / CHUNK_SIZE) % 26)));
+        written += size;
+        if (abortAt >= 0 && written >= abortAt) {
+            socket->flush();
+            socket->abort();
+            return;
+        }
+    }
+}
+
+static qint64 peakRssKb() {
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (const QByteArray &line: file.readAll().split('\n')) {
+        if (line.startsWith("VmHWM:")) {
+            return line.mid(6).trimmed().split(' ').front().toLongLong();
+        }
+    }
+    return -1;
+}
+
+struct StreamResult {
+    qint64 countRead = 0;
+    bool isCaptured = false;
+    bool isFailed = false;
+    QByteArray captured;
+};
+
+static StreamResult stream(QNetworkAccessManager &manager, const QString &url, const QString &capturePath, qint64 captureLimit) {
+    QNetworkReply *reply = manager.get(QNetworkRequest(QUrl(url)));
+    std::unique_ptr<QNetworkReply> replyHolder(reply);
+    std::unique_ptr<StreamingReplyDevice> device;
+
+    StreamResult result;
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::metaDataChanged, [&]() {
+        if (device != nullptr) {
+            return;
+        }
+        // Так же, как MHUrlSchemeHandler отдает устройство в QWebEngineUrlRequestJob сразу после заголовков
+        device.reset(new StreamingReplyDevice(reply));
+        device->setCaptureFile(capturePath, captureLimit);
+        QObject::connect(device.get(), &QIODevice::readyRead, [&]() {
+            while (device->bytesAvailable() > 0) {
+                result.countRead += device->read(CHUNK_SIZE).size();
+            }
+        });
+        QObject::connect(device.get(), &QIODevice::readChannelFinished, &loop, &QEventLoop::quit);
+    });
+    loop.exec();
+
+    while (!device->atEnd()) {
+        result.countRead += device->read(CHUNK_SIZE).size();
+    }
+    result.isCaptured = device->isCaptured();
+    result.isFailed = device->isFailed();
+    if (result.isCaptured) {
+        QFile file(device->takeCaptured());
+        if (file.open(QIODevice::ReadOnly)) {
+            result.captured = file.readAll();
+        }
+    }
+    return result;
+}
+
+tst_StreamingReplyDevice::tst_StreamingReplyDevice(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_StreamingReplyDevice::testSmallBody() {
+    LargeBodyServer server(100 * 1024);
+    QNetworkAccessManager manager;
+    QTemporaryDir dir;
+
+    const StreamResult result = stream(manager, server.url(), dir.filePath("capture.tmp"), 1024 * 1024);
+    QCOMPARE(result.countRead, qint64(100 * 1024));
+    QVERIFY(result.isCaptured);
+    QCOMPARE(result.captured.size(), 100 * 1024);
+    QCOMPARE(result.captured.at(0), 'a');
+    QCOMPARE(result.captured.at(CHUNK_SIZE), 'b');
+}
+
+void tst_StreamingReplyDevice::testLargeBodyMemory() {
+    const qint64 BODY_SIZE = 200LL * 1024 * 1024;
+    LargeBodyServer server(BODY_SIZE);
+    QNetworkAccessManager manager;
+
+    const qint64 rssBefore = peakRssKb();
+    if (rssBefore < 0) {
+        QSKIP("Peak RSS is not available on this platform");
+    }
+    QTemporaryDir dir;
+    const StreamResult result = stream(manager, server.url(), dir.filePath("capture.tmp"), 4 * 1024 * 1024);
+    const qint64 rssAfter = peakRssKb();
+
+    QCOMPARE(result.countRead, BODY_SIZE);
+    QVERIFY(!result.isCaptured);
+    QVERIFY(!QFile::exists(dir.filePath("capture.tmp")));
+    qDebug() << "Peak RSS growth:" << (rssAfter - rssBefore) / 1024 << "MB";
+    QVERIFY(rssAfter - rssBefore < 64 * 1024);
+}
+
+void tst_StreamingReplyDevice::testBrokenBody() {
+    LargeBodyServer server(1024 * 1024);
+    server.setAbortAt(256 * 1024);
+    QNetworkAccessManager manager;
+    QTemporaryDir dir;
+
+    const StreamResult result = stream(manager, server.url(), dir.filePath("capture.tmp"), 4 * 1024 * 1024);
+    QVERIFY(result.isFailed);
+    QVERIFY(!result.isCaptured);
+    QVERIFY(result.countRead < 1024 * 1024);
+    QVERIFY(!QFile::exists(dir.filePath("capture.tmp")));
+}
+
+QTEST_MAIN(tst_StreamingReplyDevice)
@@ -0,0 +1,54 @@
+#ifndef TST_STREAMINGREPLYDEVICE_H
+#define TST_STREAMINGREPLYDEVICE_H
+
+#include <QObject>
+#include <QTcpServer>
+
+class QTcpSocket;
+
+// Локальный сервер, отдающий тело заданного размера кусками по мере отправки
+class LargeBodyServer : public QObject {
+    Q_OBJECT
+public:
+    explicit LargeBodyServer(qint64 bodySize, QObject *parent = nullptr);
+
+    QString url() const;
+
+    // Обрывает соединение, отправив abortAt байт тела
+    void setAbortAt(qint64 abortAt);
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    void writeMore(QTcpSocket *socket);
+
+private:
+
+    QTcpServer server;
+
+    const qint64 bodySize;
+
+    qint64 written = 0;
+
+    qint64 abortAt = -1;
+};
+
+class tst_StreamingReplyDevice : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_StreamingReplyDevice(QObject *parent = nullptr);
+
+private slots:
+
+    void testSmallBody();
+
+    void testLargeBodyMemory();
+
+    void testBrokenBody();
+};
+
+#endif // TST_STREAMINGREPLYDEVICE_H
@@ -0,0 +1,29 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network
+TARGET = tst_streamingreplydevice
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src
+
+SOURCES += \
+    tst_streamingreplydevice.cpp \
+    ../../src/StreamingReplyDevice.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp
+
+HEADERS += \
+    tst_streamingreplydevice.h \
+    ../../src/StreamingReplyDevice.h \
+    ../../src/Log.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)
@@ -1,8 +1,13 @@
 #include "tst_transactionsdbstorage.h"
 
 #include <QTest>
+#include <QDir>
+#include <QtSql>
+#include <QDebug>
 
 #include "TransactionsDBStorage.h"
+#include "check.h"
+#include "duration.h"
 
 const QString dbName = "payments.db";
 
@@ -281,4 +286,331 @@ void tst_TransactionsDBStorage::testAddressInfos()
     }
 }
 
+void tst_TransactionsDBStorage::testCheckpoints()
+{
+    if (QFile::exists(dbName))
+        QFile::remove(dbName);
+    transactions::TransactionsDBStorage db;
+    db.init();
+
+    const int countBlocks = transactions::TransactionsDBStorage::MAX_CHECKPOINTS + 10;
+    for (int i = 1; i <= countBlocks; i++) {
+        db.addPayment("mh", "tx" + QString::number(i), "address1", true, "address1", "address2", "10", 1000 + i, "", "1", i, false, false, "", "", transactions::Transaction::OK, transactions::Transaction::SIMPLE, i * 10, "hash" + QString::number(i), 0);
+        db.addCheckpoint("address1", "mh", i * 10, "hash" + QString::number(i));
+    }
+    db.addCheckpoint("address2", "mh", 10, "other");
+
+    std::vector<transactions::BlockCheckpoint> checkpoints = db.getCheckpoints("address1", "mh");
+    QCOMPARE(checkpoints.size(), size_t(transactions::TransactionsDBStorage::MAX_CHECKPOINTS));
+    QCOMPARE(checkpoints.front().blockNumber, int64_t(11 * 10));
+    QCOMPARE(checkpoints.back().blockNumber, int64_t(countBlocks * 10));
+    QCOMPARE(checkpoints.back().blockHash, "hash" + QString::number(countBlocks));
+
+    // Повторное сохранение заменяет хэш
+    db.addCheckpoint("address1", "mh", countBlocks * 10, "newhash");
+    QCOMPARE(db.getCheckpoints("address1", "mh").back().blockHash, QString("newhash"));
+
+    db.rollbackAfterBlock("address1", "mh", 500);
+    QCOMPARE(db.getPaymentsCountForAddress("address1", "mh", true), 50);
+    checkpoints = db.getCheckpoints("address1", "mh");
+    QCOMPARE(checkpoints.back().blockNumber, int64_t(500));
+    QCOMPARE(checkpoints.size(), size_t(50 - 10));
+    QCOMPARE(db.getLastTransaction("address1", "mh").blockNumber, int64_t(500));
+
+    db.removePaymentsForDest("address1", "mh");
+    QCOMPARE(db.getCheckpoints("address1", "mh").size(), size_t(0));
+    QCOMPARE(db.getCheckpoints("address2", "mh").size(), size_t(1));
+
+    db.removePaymentsForCurrency("mh");
+    QCOMPARE(db.getCheckpoints("address2", "mh").size(), size_t(0));
+}
+
+void tst_TransactionsDBStorage::testTuningProfile()
+{
+    const QString path = "tuning";
+    QDir(path).removeRecursively();
+    QVERIFY(QDir().mkpath(path));
+    {
+        transactions::TransactionsDBStorage db(path);
+        db.init();
+        QCOMPARE(db.tuningProfile().journalMode, QString("WAL"));
+        db.addPayment("mh", "gfklklkltrklklgfmjgfhg", "address100", true, "user7", "user1", "1000", 568869455886, "nvcmnjkdfjkgf", "100", 8896865, false, false, "100", "jkgh", transactions::Transaction::OK, transactions::Transaction::SIMPLE, 11112, "", 1);
+        const DBStorage::CheckpointResult result = db.walCheckpoint(DBStorage::CheckpointMode::Truncate);
+        QCOMPARE(result.isBusy, false);
+        QCOMPARE(result.logFrames, 0);
+    }
+    {
+        transactions::TransactionsDBStorage db(path, DBStorage::TuningProfile::sqliteDefault());
+        db.init();
+        QCOMPARE(db.getPaymentsCountForAddress("address100", "mh", true), 1);
+        // Не в режиме WAL checkpoint ничего не делает
+        const DBStorage::CheckpointResult result = db.walCheckpoint();
+        QCOMPARE(result.logFrames, -1);
+    }
+}
+
+// Схема payments версий 1 и 2, как до миграций из dbupdates
+static void createSyntheticDatabase(const QString &path, int version, int countPayments, int countTracked)
+{
+    QDir(path).removeRecursively();
+    CHECK(QDir().mkpath(path), "Not create folder");
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "synthetic");
+        db.setDatabaseName(path + "/payments.db");
+        CHECK(db.open(), "DB open error");
+        QSqlQuery query(db);
+        const auto exec = [&query](const QString &sql) {
+            CHECK(query.exec(sql), query.lastError().text().toStdString());
+        };
+        exec("CREATE TABLE settings (key VARCHAR(256) UNIQUE, value TEXT)");
+        exec(QString("INSERT INTO settings (key, value) VALUES ('dbversion', '%1')").arg(version));
+        exec(QString("CREATE TABLE payments (id INTEGER PRIMARY KEY NOT NULL, currency VARCHAR(100), txid TEXT, address TEXT, "
+                     "isInput BOOLEAN, ufrom TEXT, uto TEXT, value TEXT, ts INT8, data TEXT, fee TEXT, nonce INTEGER, "
+                     "isSetDelegate BOOLEAN, isDelegate BOOLEAN, delegateValue TEXT, delegateHash TEXT, %1status INT8)")
+             .arg(version >= 2 ? "blockNumber INTEGER DEFAULT 0, type INTEGER DEFAULT 0, " : ""));
+        exec(QString("CREATE UNIQUE INDEX paymentsUniqueIdx ON payments (currency ASC, address ASC, txid ASC, isInput ASC%1)")
+             .arg(version >= 2 ? ", blockNumber ASC" : ""));
+        exec("CREATE INDEX paymentsIdx1 ON payments(address, currency, isInput, isDelegate, isSetDelegate)");
+        exec("CREATE INDEX paymentsIdx2 ON payments(address, currency, ts, txid)");
+        exec("CREATE INDEX paymentsIdx3 ON payments(currency, ts, txid)");
+        exec("CREATE TABLE tracked (id INTEGER PRIMARY KEY NOT NULL, address TEXT, currency VARCHAR(100), name TEXT, type TEXT, tgroup TEXT)");
+        exec("CREATE UNIQUE INDEX trackedUniqueIdx ON tracked (tgroup, address, currency)");
+
+        CHECK(db.transaction(), "Transaction not open");
+        CHECK(query.prepare("INSERT INTO payments (currency, txid, address, isInput, ufrom, uto, value, ts, fee, nonce, isSetDelegate, isDelegate, status) "
+                            "VALUES ('mh', :txid, :address, :isInput, 'user1', 'user2', :value, :ts, '100', 0, 0, 0, 0)"), query.lastError().text().toStdString());
+        for (int i = 0; i < countPayments; i++) {
+            query.bindValue(":txid", QString::number(i));
+            query.bindValue(":address", "address" + QString::number(i % 1000));
+            query.bindValue(":isInput", i % 2 == 0);
+            query.bindValue(":value", QString::number(1000 + i));
+            query.bindValue(":ts", 568869455886 + i);
+            CHECK(query.exec(), query.lastError().text().toStdString());
+        }
+        CHECK(query.prepare("INSERT INTO tracked (address, currency, name, type, tgroup) VALUES (:address, 'mh', '', 'key', 'tmh')"), query.lastError().text().toStdString());
+        for (int i = 0; i < countTracked; i++) {
+            query.bindValue(":address", "address" + QString::number(i));
+            CHECK(query.exec(), query.lastError().text().toStdString());
+        }
+        CHECK(db.commit(), "Transaction not commit");
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("synthetic");
+}
+
+class FuturePaymentsDBStorage : public DBStorage {
+public:
+    FuturePaymentsDBStorage(const QString &path)
+        : DBStorage(path, "payments")
+    {}
+
+    // Файла миграции 5 -> 6 нет
+    int currentVersion() const override {
+        return 6;
+    }
+
+protected:
+    void createDatabase() override {}
+};
+
+// Полный размер базы только вместе с бенчмарками, см. METAGATE_BENCHMARKS
+static int migrationCountPayments() {
+    return qEnvironmentVariableIsSet("METAGATE_BENCHMARKS") ? 500000 : 20000;
+}
+
+void tst_TransactionsDBStorage::testMigration_data()
+{
+    QTest::addColumn<int>("version");
+    QTest::addColumn<qint64>("expectedPayments");
+    // Миграция 1 -> 2 очищает payments
+    QTest::newRow("v1") << 1 << qint64(0);
+    QTest::newRow("v2") << 2 << qint64(migrationCountPayments());
+}
+
+void tst_TransactionsDBStorage::testMigration()
+{
+    QFETCH(int, version);
+    QFETCH(qint64, expectedPayments);
+
+    const QString path = "migration";
+    createSyntheticDatabase(path, version, migrationCountPayments(), 100);
+
+    transactions::TransactionsDBStorage db(path);
+    const time_point begin = ::now();
+    QVERIFY(db.init());
+    const milliseconds elapsed = std::chrono::duration_cast<milliseconds>(::now() - begin);
+    qDebug() << "Migration from" << version << ":" << elapsed.count() << "ms";
+    QVERIFY(elapsed < 60s);
+
+    QCOMPARE(db.getSettings("dbversion").toInt(), db.currentVersion());
+
+    DBStorage::ReadGuard reader = db.beginRead();
+    QSqlQuery query(reader.database());
+    QVERIFY(query.exec("PRAGMA integrity_check"));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toString(), QString("ok"));
+    QVERIFY(query.exec("SELECT COUNT(*) FROM payments"));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toLongLong(), expectedPayments);
+    QVERIFY(query.exec("SELECT COUNT(*) FROM tracked"));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toLongLong(), qint64(100));
+    query.finish();
+
+    if (expectedPayments != 0) {
+        const std::vector<transactions::Transaction> payments = db.getPaymentsForAddress("address1", "mh", 0, 1, true);
+        QCOMPARE(payments.size(), size_t(1));
+        QCOMPARE(payments.at(0).blockHash, QString(""));
+        QCOMPARE(payments.at(0).intStatus, 0);
+        QCOMPARE(payments.at(0).value, QString("1001"));
+    }
+    QCOMPARE(db.getTrackedForGroup("tmh").size(), size_t(100));
+}
+
+void tst_TransactionsDBStorage::testMigrationDryRun()
+{
+    const QString path = "migration_dryrun";
+    createSyntheticDatabase(path, 2, 1000, 10);
+    {
+        transactions::TransactionsDBStorage db(path);
+        QVERIFY(db.dryRunUpdate());
+        // База не изменилась
+        QCOMPARE(db.getSettings("dbversion").toInt(), 2);
+        db.setMigrationDryRun(true);
+        QVERIFY(db.init());
+        QCOMPARE(db.getSettings("dbversion").toInt(), db.currentVersion());
+    }
+
+    createSyntheticDatabase(path, 2, 1000, 10);
+    {
+        FuturePaymentsDBStorage db(path);
+        QVERIFY(!db.dryRunUpdate());
+        db.setMigrationDryRun(true);
+        QVERIFY_EXCEPTION_THROWN(db.init(), Exception);
+        QCOMPARE(db.getSettings("dbversion").toInt(), 2);
+    }
+}
+
+void tst_TransactionsDBStorage::testMigrationResume()
+{
+    const QString path = "migration_resume";
+    createSyntheticDatabase(path, 2, 1000, 10);
+    {
+        FuturePaymentsDBStorage db(path);
+        QVERIFY_EXCEPTION_THROWN(db.init(), Exception);
+        // Успешные шаги закоммичены
+        QCOMPARE(db.getSettings("dbversion").toInt(), 5);
+    }
+    {
+        transactions::TransactionsDBStorage db(path);
+        QVERIFY(db.init());
+        QCOMPARE(db.getPaymentsCountForAddress("address0", "mh", true), 1);
+    }
+}
+
+static const int BENCHMARK_COUNT_PAYMENTS = 1000000;
+static const int BENCHMARK_COUNT_ADDRESSES = 1000;
+static const int BENCHMARK_BATCH_SIZE = 10000;
+
+// Бенчмарки пишут миллион строк, поэтому в обычном прогоне тестов они пропускаются
+static const char BENCHMARK_ENV[] = "METAGATE_BENCHMARKS";
+
+static bool isBenchmarkEnabled() {
+    return qEnvironmentVariableIsSet(BENCHMARK_ENV);
+}
+
+static QString benchmarkPath(const QString &name, const QString &profileName) {
+    const QString path = "benchmark_" + name + "_" + profileName;
+    QDir(path).removeRecursively();
+    QDir().mkpath(path);
+    return path;
+}
+
+static DBStorage::TuningProfile benchmarkProfile(const QString &profileName) {
+    if (profileName == "default") {
+        return DBStorage::TuningProfile::sqliteDefault();
+    } else {
+        return DBStorage::TuningProfile::largeDatabase();
+    }
+}
+
+static void fillBenchmarkPayments(transactions::TransactionsDBStorage &db) {
+    std::vector<transactions::Transaction> batch;
+    batch.reserve(BENCHMARK_BATCH_SIZE);
+    for (int i = 0; i < BENCHMARK_COUNT_PAYMENTS; i++) {
+        transactions::Transaction trans;
+        trans.currency = "mh";
+        trans.tx = QString::number(i);
+        trans.address = "address" + QString::number(i % BENCHMARK_COUNT_ADDRESSES);
+        trans.isInput = i % 2 == 0;
+        trans.from = "user1";
+        trans.to = "user2";
+        trans.value = QString::number(1000000 + i);
+        trans.timestamp = 568869455886 + i;
+        trans.fee = "100";
+        trans.isDelegate = false;
+        trans.blockNumber = i;
+        batch.emplace_back(trans);
+        if (batch.size() == BENCHMARK_BATCH_SIZE) {
+            db.addPayments(batch);
+            batch.clear();
+        }
+    }
+    db.addPayments(batch);
+}
+
+void tst_TransactionsDBStorage::benchmarkInsertPayments_data()
+{
+    QTest::addColumn<QString>("profileName");
+    QTest::newRow("default") << QString("default");
+    QTest::newRow("tuned") << QString("tuned");
+}
+
+void tst_TransactionsDBStorage::benchmarkInsertPayments()
+{
+    if (!isBenchmarkEnabled()) {
+        QSKIP("Set METAGATE_BENCHMARKS=1 to run benchmarks");
+    }
+    QFETCH(QString, profileName);
+    const QString path = benchmarkPath("insert", profileName);
+
+    transactions::TransactionsDBStorage db(path, benchmarkProfile(profileName));
+    db.init();
+
+    QBENCHMARK_ONCE {
+        fillBenchmarkPayments(db);
+    }
+    QCOMPARE(db.getPaymentsCountForAddress("address0", "mh", true), BENCHMARK_COUNT_PAYMENTS / BENCHMARK_COUNT_ADDRESSES);
+}
+
+void tst_TransactionsDBStorage::benchmarkQueryPayments_data()
+{
+    benchmarkInsertPayments_data();
+}
+
+void tst_TransactionsDBStorage::benchmarkQueryPayments()
+{
+    if (!isBenchmarkEnabled()) {
+        QSKIP("Set METAGATE_BENCHMARKS=1 to run benchmarks");
+    }
+    QFETCH(QString, profileName);
+    const QString path = benchmarkPath("query", profileName);
+
+    transactions::TransactionsDBStorage db(path, benchmarkProfile(profileName));
+    db.init();
+    fillBenchmarkPayments(db);
+
+    QBENCHMARK {
+        for (int i = 0; i < BENCHMARK_COUNT_ADDRESSES; i += 10) {
+            const QString address = "address" + QString::number(i);
+            const std::vector<transactions::Transaction> payments = db.getPaymentsForAddress(address, "mh", 0, 100, false);
+            QCOMPARE(payments.size(), size_t(100));
+            transactions::BalanceInfo balance;
+            db.calcBalance(address, "mh", balance);
+            QCOMPARE(balance.countReceived + balance.countSpent, uint64_t(BENCHMARK_COUNT_PAYMENTS / BENCHMARK_COUNT_ADDRESSES));
+        }
+    }
+}
+
 QTEST_MAIN(tst_TransactionsDBStorage)
@@ -16,6 +16,22 @@ private slots:
     void testGetPayments();
     void testAddressInfos();
 
+    void testCheckpoints();
+
+    void testTuningProfile();
+
+    void testMigration_data();
+    void testMigration();
+
+    void testMigrationDryRun();
+    void testMigrationResume();
+
+    void benchmarkInsertPayments_data();
+    void benchmarkInsertPayments();
+
+    void benchmarkQueryPayments_data();
+    void benchmarkQueryPayments();
+
 private:
 };
 
@@ -28,6 +28,9 @@ HEADERS += \
     ../../src/Log.h \
     ../../src/transactions/TransactionsDBStorage.h
 
+RESOURCES += \
+    ../../dbupdates/dbupdates.qrc
+
 QMAKE_LFLAGS += -rdynamic
 unix:!macx: include(../../libs-unix.pri)
 win32: include(../../libs-win.pri)
@@ -0,0 +1,268 @@
+#include "tst_transactionssubscription.h"
+
+#include <QTest>
+#include <QWebSocket>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QStringList>
+
+#include <algorithm>
+
+#include "check.h"
+#include "TransactionsMessages.h"
+#include "TransactionsSubscription.h"
+
+using namespace transactions;
+
+static QString makeNotification(const std::vector<QString> &addresses) {
+    QJsonObject notification;
+    notification.insert("jsonrpc", "2.0");
+    notification.insert("method", "address-changed");
+    QJsonArray addressesJson;
+    for (const QString &address: addresses) {
+        addressesJson.push_back(address);
+    }
+    QJsonObject params;
+    params.insert("addresses", addressesJson);
+    notification.insert("params", params);
+    return QString(QJsonDocument(notification).toJson(QJsonDocument::Compact));
+}
+
+MockSubscriptionNode::MockSubscriptionNode(QObject *parent)
+    : QObject(parent)
+    , server("mock", QWebSocketServer::NonSecureMode)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QWebSocketServer::newConnection, this, &MockSubscriptionNode::onNewConnection);
+}
+
+QString MockSubscriptionNode::url() const {
+    return "ws://127.0.0.1:" + QString::number(server.serverPort());
+}
+
+void MockSubscriptionNode::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QWebSocket *socket = server.nextPendingConnection();
+        clients.emplace_back(socket);
+        connect(socket, &QWebSocket::textMessageReceived, [this, socket](const QString &message) {
+            processMessage(socket, message);
+        });
+        connect(socket, &QWebSocket::disconnected, [this, socket]() {
+            clients.erase(std::remove(clients.begin(), clients.end(), socket), clients.end());
+            socket->deleteLater();
+        });
+    }
+}
+
+void MockSubscriptionNode::processMessage(QWebSocket *socket, const QString &message) {
+    const QJsonObject request = QJsonDocument::fromJson(message.toUtf8()).object();
+    if (request.value("method").toString() != "subscribe-addresses") {
+        return;
+    }
+    const QJsonObject params = request.value("params").toObject();
+    if (params.value("reset").toBool()) {
+        subscribed.clear();
+        countResets++;
+    }
+    for (const QJsonValue &address: params.value("addresses").toArray()) {
+        subscribed.insert(address.toString());
+    }
+    if (isAcknowledge) {
+        QJsonObject response;
+        response.insert("jsonrpc", "2.0");
+        response.insert("id", request.value("id"));
+        response.insert("result", QJsonObject());
+        socket->sendTextMessage(QString(QJsonDocument(response).toJson(QJsonDocument::Compact)));
+    }
+}
+
+void MockSubscriptionNode::sendHeartbeat() {
+    for (QWebSocket *client: clients) {
+        client->sendTextMessage("{\"jsonrpc\":\"2.0\",\"method\":\"heartbeat\"}");
+    }
+}
+
+void MockSubscriptionNode::notify(const std::vector<QString> &addresses) {
+    for (QWebSocket *client: clients) {
+        client->sendTextMessage(makeNotification(addresses));
+    }
+}
+
+void MockSubscriptionNode::notifyBatch(const std::vector<std::vector<QString>> &notifications) {
+    QStringList parts;
+    for (const std::vector<QString> &addresses: notifications) {
+        parts << makeNotification(addresses);
+    }
+    for (QWebSocket *client: clients) {
+        client->sendTextMessage("[" + parts.join(",") + "]");
+    }
+}
+
+void MockSubscriptionNode::dropClients() {
+    // disconnected может прийти сразу и изменить clients
+    const std::vector<QWebSocket*> copyClients = clients;
+    for (QWebSocket *client: copyClients) {
+        client->close();
+    }
+}
+
+size_t MockSubscriptionNode::countClients() const {
+    return clients.size();
+}
+
+static std::vector<QString> makeAddresses(size_t count) {
+    std::vector<QString> addresses;
+    for (size_t i = 0; i < count; i++) {
+        addresses.emplace_back("0x" + QString::number(i).rightJustified(6, '0'));
+    }
+    return addresses;
+}
+
+static std::set<QString>& takeAll(TransactionsSubscription &subscription, std::set<QString> &received) {
+    for (const QString &address: subscription.takeChanged(1000)) {
+        received.insert(address);
+    }
+    return received;
+}
+
+tst_TransactionsSubscription::tst_TransactionsSubscription(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_TransactionsSubscription::testMessages()
+{
+    const QString request = makeSubscribeAddressesRequest({"0x01", "0x02"}, true, 7);
+    const QJsonObject requestJson = QJsonDocument::fromJson(request.toUtf8()).object();
+    QCOMPARE(requestJson.value("method").toString(), QString("subscribe-addresses"));
+    QCOMPARE(requestJson.value("id").toInt(), 7);
+    QCOMPARE(requestJson.value("params").toObject().value("addresses").toArray().size(), 2);
+    QCOMPARE(requestJson.value("params").toObject().value("reset").toBool(), true);
+
+    const std::vector<QString> addresses = parseAddressChangedNotification(makeNotification({"0x01", "0x03"}));
+    QCOMPARE(addresses.size(), size_t(2));
+    QCOMPARE(addresses[1], QString("0x03"));
+
+    QVERIFY(parseAddressChangedNotification("{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{}}").empty());
+
+    const SubscribeAddressesResponse response = parseSubscribeAddressesResponse("{\"jsonrpc\":\"2.0\",\"id\":3,\"result\":{}}");
+    QVERIFY(response.isResponse);
+    QCOMPARE(response.id, size_t(3));
+    QVERIFY(!response.isError);
+    const SubscribeAddressesResponse errorResponse = parseSubscribeAddressesResponse("{\"jsonrpc\":\"2.0\",\"id\":4,\"error\":{\"message\":\"fail\"}}");
+    QVERIFY(errorResponse.isResponse && errorResponse.isError);
+    QCOMPARE(errorResponse.error, QString("fail"));
+    QVERIFY(!parseSubscribeAddressesResponse(makeNotification({"0x01"})).isResponse);
+    QVERIFY_EXCEPTION_THROWN(parseAddressChangedNotification("{\"jsonrpc\":\"2.0\",\"error\":{\"message\":\"fail\"}}"), Exception);
+}
+
+void tst_TransactionsSubscription::testSubscribe()
+{
+    MockSubscriptionNode node;
+    TransactionsSubscription subscription(node.url());
+
+    const std::vector<QString> addresses = makeAddresses(TransactionsSubscription::MAX_ADDRESSES_IN_MESSAGE * 2 + 100);
+    // До подключения список уходит в hello
+    subscription.setAddresses(addresses);
+    subscription.start();
+    QTRY_VERIFY_WITH_TIMEOUT(subscription.isActive(), 10000);
+    QTRY_COMPARE_WITH_TIMEOUT(node.subscribed.size(), addresses.size(), 10000);
+    QCOMPARE(subscription.countSubscribed(), addresses.size());
+
+    // Новый список заменяет старый
+    const std::vector<QString> fewAddresses(addresses.begin(), addresses.begin() + 10);
+    const size_t countResets = node.countResets;
+    subscription.setAddresses(fewAddresses);
+    QTRY_VERIFY_WITH_TIMEOUT(node.countResets > countResets, 10000);
+    QTRY_COMPARE_WITH_TIMEOUT(node.subscribed.size(), fewAddresses.size(), 10000);
+    QVERIFY(node.subscribed == std::set<QString>(fewAddresses.begin(), fewAddresses.end()));
+}
+
+void tst_TransactionsSubscription::testNotifications()
+{
+    MockSubscriptionNode node;
+    TransactionsSubscription subscription(node.url());
+    const std::vector<QString> addresses = makeAddresses(20);
+    subscription.setAddresses(addresses);
+    subscription.start();
+    QTRY_VERIFY_WITH_TIMEOUT(subscription.isActive() && node.countClients() == 1, 10000);
+    QVERIFY(!subscription.takeResyncNeeded());
+
+    std::set<QString> received;
+    // Неподписанные адреса игнорируются, повторы схлопываются
+    node.notify({addresses[0], addresses[1], "0xunknown"});
+    node.notify({addresses[1]});
+    node.notifyBatch({{addresses[2]}, {addresses[3], addresses[0]}});
+    QTRY_COMPARE_WITH_TIMEOUT(takeAll(subscription, received).size(), size_t(4), 10000);
+    QVERIFY(received.find("0xunknown") == received.end());
+    QVERIFY(subscription.takeChanged(10).empty());
+
+    node.notify(std::vector<QString>(addresses.begin() + 5, addresses.begin() + 15));
+    std::vector<QString> part;
+    QTRY_VERIFY_WITH_TIMEOUT((part = subscription.takeChanged(4)).size() == 4, 10000);
+    QCOMPARE(subscription.takeChanged(100).size(), size_t(6));
+}
+
+void tst_TransactionsSubscription::testReconnect()
+{
+    MockSubscriptionNode node;
+    TransactionsSubscription subscription(node.url());
+    const std::vector<QString> addresses = makeAddresses(5);
+    subscription.setAddresses(addresses);
+    subscription.start();
+    QTRY_VERIFY_WITH_TIMEOUT(subscription.isActive() && node.subscribed.size() == addresses.size(), 10000);
+
+    node.dropClients();
+    QTRY_VERIFY_WITH_TIMEOUT(!subscription.isActive(), 10000);
+    node.subscribed.clear();
+    // Уведомление без клиента теряется
+    node.notify({addresses[0]});
+
+    QTRY_VERIFY_WITH_TIMEOUT(subscription.isActive() && node.countClients() == 1, 20000);
+    // Подписка восстановлена из hello
+    QTRY_COMPARE_WITH_TIMEOUT(node.subscribed.size(), addresses.size(), 10000);
+    QVERIFY(subscription.takeResyncNeeded());
+    QVERIFY(!subscription.takeResyncNeeded());
+    QVERIFY(subscription.takeChanged(10).empty());
+}
+
+void tst_TransactionsSubscription::testAcknowledge()
+{
+    MockSubscriptionNode node;
+    node.isAcknowledge = false;
+    TransactionsSubscription subscription(node.url());
+    const std::vector<QString> addresses = makeAddresses(TransactionsSubscription::MAX_ADDRESSES_IN_MESSAGE + 10);
+    subscription.setAddresses(addresses);
+    subscription.start();
+    QTRY_COMPARE_WITH_TIMEOUT(node.subscribed.size(), addresses.size(), 10000);
+    // Соединение есть, но подписку нода не подтвердила
+    QTest::qWait(500);
+    QVERIFY(!subscription.isActive());
+
+    node.isAcknowledge = true;
+    subscription.setAddresses(addresses);
+    QTRY_VERIFY_WITH_TIMEOUT(subscription.isActive(), 10000);
+}
+
+void tst_TransactionsSubscription::testHeartbeat()
+{
+    MockSubscriptionNode node;
+    TransactionsSubscription subscription(node.url());
+    subscription.setHeartbeatTimeout(1s);
+    subscription.setAddresses(makeAddresses(5));
+    subscription.start();
+    QTRY_VERIFY_WITH_TIMEOUT(subscription.isActive(), 10000);
+    QVERIFY(!subscription.takeResyncNeeded());
+
+    // Нода молчит дольше таймаута, возвращаемся к опросу
+    QTRY_VERIFY_WITH_TIMEOUT(!subscription.isActive(), 5000);
+    QCOMPARE(node.countClients(), size_t(1));
+
+    node.sendHeartbeat();
+    QTRY_VERIFY_WITH_TIMEOUT(subscription.isActive(), 5000);
+    // Уведомления за время тишины могли потеряться
+    QVERIFY(subscription.takeResyncNeeded());
+}
+
+QTEST_MAIN(tst_TransactionsSubscription)
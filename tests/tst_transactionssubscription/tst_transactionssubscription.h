@@ -0,0 +1,75 @@
+#ifndef TST_TRANSACTIONSSUBSCRIPTION_H
+#define TST_TRANSACTIONSSUBSCRIPTION_H
+
+#include <QObject>
+#include <QWebSocketServer>
+
+#include <vector>
+#include <set>
+
+class QWebSocket;
+
+// Локальная замена WebSocket ноды: хранит подписку и рассылает уведомления address-changed
+class MockSubscriptionNode : public QObject {
+    Q_OBJECT
+public:
+    explicit MockSubscriptionNode(QObject *parent = nullptr);
+
+    QString url() const;
+
+    void notify(const std::vector<QString> &addresses);
+
+    // Несколько уведомлений одним batch-фреймом
+    void notifyBatch(const std::vector<std::vector<QString>> &notifications);
+
+    void dropClients();
+
+    void sendHeartbeat();
+
+    size_t countClients() const;
+
+    std::set<QString> subscribed;
+
+    size_t countResets = 0;
+
+    // Отвечать на subscribe-addresses
+    bool isAcknowledge = true;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    void processMessage(QWebSocket *socket, const QString &message);
+
+private:
+
+    QWebSocketServer server;
+
+    std::vector<QWebSocket*> clients;
+};
+
+class tst_TransactionsSubscription : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_TransactionsSubscription(QObject *parent = nullptr);
+
+private slots:
+
+    void testMessages();
+
+    void testSubscribe();
+
+    void testNotifications();
+
+    void testReconnect();
+
+    void testAcknowledge();
+
+    void testHeartbeat();
+
+};
+
+#endif // TST_TRANSACTIONSSUBSCRIPTION_H
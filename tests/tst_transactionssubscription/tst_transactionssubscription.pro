@@ -0,0 +1,38 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network websockets
+TARGET = tst_transactionssubscription
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src ../../src/transactions
+
+SOURCES += \
+    tst_transactionssubscription.cpp \
+    ../../src/WebSocketClient.cpp \
+    ../../src/TimerClass.cpp \
+    ../../src/QRegister.cpp \
+    ../../src/TypedException.cpp \
+    ../../src/BigNumber.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp \
+    ../../src/transactions/TransactionsMessages.cpp \
+    ../../src/transactions/TransactionsSubscription.cpp
+
+HEADERS += \
+    tst_transactionssubscription.h \
+    ../../src/WebSocketClient.h \
+    ../../src/TimerClass.h \
+    ../../src/Log.h \
+    ../../src/transactions/TransactionsMessages.h \
+    ../../src/transactions/TransactionsSubscription.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)
@@ -0,0 +1,449 @@
+#include "tst_transactionssync.h"
+
+#include <QTest>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QDir>
+#include <QSettings>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QDebug>
+
+#include <set>
+#include <memory>
+#include <functional>
+#include <cstring>
+
+#include "check.h"
+#include "TypedException.h"
+#include "Transaction.h"
+#include "Transactions.h"
+#include "TransactionsJavascript.h"
+#include "TransactionsDBStorage.h"
+
+using namespace transactions;
+
+namespace {
+
+const QString CURRENCY = "tmh";
+const QString TYPE = "torrent";
+const QString GROUP = "sync";
+
+bool isSpentTx(int index) {
+    return index % MockLedger::TX_SPENT_PERIOD == MockLedger::TX_SPENT_PERIOD - 1;
+}
+
+QString preparePath(const QString &name) {
+    QDir(name).removeRecursively();
+    CHECK(QDir().mkpath(name), "Not create folder");
+    return name;
+}
+
+bool waitFor(const std::function<bool()> &condition, milliseconds maxTime) {
+    const time_point begin = ::now();
+    while (!condition()) {
+        if (::now() - begin >= maxTime) {
+            return false;
+        }
+        QTest::qWait(5);
+    }
+    return true;
+}
+
+// Transactions, гоняемый по локальным нодам вместо NsLookup
+class SyncHarness {
+public:
+
+    SyncHarness(const QString &name, const std::vector<QString> &urls, size_t pollAddresses)
+        : db(preparePath(name))
+    {
+        db.init();
+
+        const QString settingsPath = QDir(name).filePath("settings.ini");
+        {
+            QSettings settings(settingsPath, QSettings::IniFormat);
+            settings.setValue("timeouts_sec/transactions", 60);
+            settings.setValue("transactions/poll_period_ms", 50);
+            settings.setValue("transactions/poll_addresses", static_cast<int>(pollAddresses));
+            settings.sync();
+        }
+
+        const auto getServers = [urls](const QString &/*type*/, size_t /*limit*/, size_t count) {
+            return std::vector<QString>(urls.begin(), urls.begin() + std::min(count, urls.size()));
+        };
+        transactions = std::make_unique<Transactions>(getServers, settingsPath, javascript, db);
+
+        QObject::connect(&javascript, &TransactionsJavascript::newBalanceSig, &javascript, [this](const QString &address, const QString &/*currency*/, const BalanceInfo &balance) {
+            const auto found = expected.find(address);
+            if (found != expected.end() && static_cast<int>(balance.countReceived + balance.countSpent) == found->second) {
+                synced.insert(address);
+            }
+        });
+    }
+
+    // Регистрирует адреса ledger и ждет, пока по всем не придет полная история
+    bool sync(const MockLedger &ledger, milliseconds maxTime) {
+        expected = ledger.countTxs;
+        std::vector<AddressInfo> infos;
+        for (const auto &pair: ledger.countTxs) {
+            infos.emplace_back(CURRENCY, pair.first, TYPE, GROUP, "");
+        }
+
+        const time_point begin = ::now();
+        transactions->start();
+        bool isRegistered = false;
+        emit transactions->registerAddresses(infos, [&isRegistered](const TypedException &exception) {
+            CHECK(!exception.isSet(), exception.description);
+            isRegistered = true;
+        });
+        bool isGroupSet = false;
+        emit transactions->setCurrentGroup(GROUP, [&isGroupSet](const TypedException &exception) {
+            CHECK(!exception.isSet(), exception.description);
+            isGroupSet = true;
+        });
+        if (!waitFor([&isRegistered, &isGroupSet]{ return isRegistered && isGroupSet; }, maxTime)) {
+            return false;
+        }
+
+        const bool isSynced = waitFor([this]{ return synced.size() == expected.size(); }, maxTime);
+        syncTime = std::chrono::duration_cast<milliseconds>(::now() - begin);
+        return isSynced;
+    }
+
+public:
+
+    TransactionsDBStorage db;
+
+    TransactionsJavascript javascript;
+
+    std::unique_ptr<Transactions> transactions;
+
+    std::map<QString, int> expected;
+
+    std::set<QString> synced;
+
+    milliseconds syncTime{0};
+};
+
+}
+
+void MockLedger::addAddress(const QString &address, int count) {
+    countTxs[address] = count;
+    lastBlock = std::max<int64_t>(lastBlock, count + 10);
+}
+
+QJsonObject MockLedger::transaction(const QString &address, int index) const {
+    const bool isSpent = isSpentTx(index);
+    QJsonObject tx;
+    tx.insert("from", isSpent ? address : "0x00src" + QString::number(index % 7));
+    tx.insert("to", isSpent ? QString("0x00dst") : address);
+    tx.insert("value", QString::number(1000 + index));
+    tx.insert("transaction", address + "_" + QString::number(index));
+    tx.insert("timestamp", 1500000000 + index);
+    tx.insert("fee", isSpent ? "1" : "0");
+    tx.insert("nonce", index);
+    tx.insert("status", "ok");
+    tx.insert("blockNumber", index + 1);
+    return tx;
+}
+
+QString MockLedger::blockHash(int64_t number) const {
+    return "hash_" + QString::number(number);
+}
+
+QString MockLedger::received(const QString &/*address*/, int count) const {
+    qint64 sum = 0;
+    for (int i = 0; i < count; i++) {
+        if (!isSpentTx(i)) {
+            sum += 1000 + i;
+        }
+    }
+    return QString::number(sum);
+}
+
+QString MockLedger::spent(const QString &/*address*/, int count) const {
+    qint64 sum = 0;
+    for (int i = 0; i < count; i++) {
+        if (isSpentTx(i)) {
+            sum += 1000 + i + 1;
+        }
+    }
+    return QString::number(sum);
+}
+
+MockTorrentNode::MockTorrentNode(const MockLedger &ledger, const Faults &faults, QObject *parent)
+    : QObject(parent)
+    , ledger(ledger)
+    , faults(faults)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QTcpServer::newConnection, this, &MockTorrentNode::onNewConnection);
+}
+
+QString MockTorrentNode::url() const {
+    return "http://127.0.0.1:" + QString::number(server.serverPort()) + "/";
+}
+
+int64_t MockTorrentNode::visibleBlock() const {
+    return std::max<int64_t>(0, ledger.lastBlock - faults.lagBlocks);
+}
+
+int MockTorrentNode::visibleTxs(const QString &address) const {
+    const auto found = ledger.countTxs.find(address);
+    if (found == ledger.countTxs.end()) {
+        return 0;
+    }
+    return static_cast<int>(std::min<int64_t>(found->second, visibleBlock()));
+}
+
+QByteArray MockTorrentNode::processRequest(const QByteArray &body) {
+    const QJsonObject request = QJsonDocument::fromJson(body).object();
+    const QString method = request.value("method").toString();
+    const QJsonObject params = request.value("params").toObject();
+    QJsonObject response;
+    response.insert("jsonrpc", "2.0");
+    const auto setError = [&response](const QString &message) {
+        QJsonObject error;
+        error.insert("message", message);
+        response.insert("error", error);
+    };
+
+    if (method == "fetch-balance") {
+        const QString address = params.value("address").toString();
+        const int count = visibleTxs(address);
+        int countSpent = 0;
+        for (int i = 0; i < count; i++) {
+            countSpent += isSpentTx(i) ? 1 : 0;
+        }
+        QJsonObject result;
+        result.insert("address", address);
+        result.insert("received", ledger.received(address, count));
+        result.insert("spent", ledger.spent(address, count));
+        result.insert("count_received", count - countSpent);
+        result.insert("count_spent", countSpent);
+        result.insert("currentBlock", static_cast<int>(visibleBlock()));
+        response.insert("result", result);
+    } else if (method == "fetch-history") {
+        const QString address = params.value("address").toString();
+        const int count = visibleTxs(address);
+        // countTxs 0 или отсутствует - вся история
+        const int countTxs = params.value("countTxs").toInt();
+        const int from = countTxs > 0 ? std::max(0, count - countTxs) : 0;
+        QJsonArray result;
+        for (int i = from; i < count; i++) {
+            result.push_back(ledger.transaction(address, i));
+        }
+        response.insert("result", result);
+    } else if (method == "get-count-blocks") {
+        QJsonObject result;
+        result.insert("count_blocks", static_cast<int>(visibleBlock()));
+        response.insert("result", result);
+    } else if (method == "get-block-by-number") {
+        const int64_t number = params.value("number").toInt();
+        if (number < 0 || number > visibleBlock()) {
+            setError("Block not found");
+        } else {
+            QJsonObject result;
+            result.insert("hash", ledger.blockHash(number));
+            result.insert("number", static_cast<int>(number));
+            response.insert("result", result);
+        }
+    } else if (method == "get-tx") {
+        setError("Transaction not found");
+    } else {
+        setError("Unknown method");
+    }
+    return QJsonDocument(response).toJson(QJsonDocument::Compact);
+}
+
+void MockTorrentNode::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::destroyed, [this, socket]() {
+            buffers.erase(socket);
+        });
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            QByteArray &buffer = buffers[socket];
+            buffer += socket->readAll();
+            // Соединение держится открытым, запросы идут по нему друг за другом
+            while (true) {
+                const int headersEnd = buffer.indexOf("\r\n\r\n");
+                if (headersEnd == -1) {
+                    return;
+                }
+                int contentLength = 0;
+                for (const QByteArray &line: buffer.left(headersEnd).split('\n')) {
+                    if (line.toLower().startsWith("content-length:")) {
+                        contentLength = line.mid(int(strlen("content-length:"))).trimmed().toInt();
+                    }
+                }
+                if (buffer.size() < headersEnd + 4 + contentLength) {
+                    return;
+                }
+                const QByteArray body = buffer.mid(headersEnd + 4, contentLength);
+                buffer.remove(0, headersEnd + 4 + contentLength);
+
+                countRequests++;
+                QByteArray status = "200 OK";
+                QByteArray response;
+                if (faults.errorPeriod > 0 && countRequests % faults.errorPeriod == 0) {
+                    countErrors++;
+                    if (countErrors % 2 == 1) {
+                        status = "500 Internal Server Error";
+                        response = "Injected error";
+                    } else {
+                        response = "{\"jsonrpc\":\"2.0\",\"error\":{\"message\":\"Injected error\"}}";
+                    }
+                } else {
+                    response = processRequest(body);
+                }
+
+                const QByteArray answer = "HTTP/1.1 " + status + "\r\nContent-Type: application/json\r\nContent-Length: " + QByteArray::number(response.size()) + "\r\nConnection: keep-alive\r\n\r\n" + response;
+                if (faults.latency.count() > 0) {
+                    QTimer::singleShot(faults.latency.count(), socket, [socket, answer]() {
+                        socket->write(answer);
+                    });
+                } else {
+                    socket->write(answer);
+                }
+            }
+        });
+    }
+}
+
+static MockLedger makeLedger(int countAddresses, const std::function<int(int)> &countTxs) {
+    MockLedger ledger;
+    for (int i = 0; i < countAddresses; i++) {
+        ledger.addAddress(QString("0x%1").arg(i, 48, 16, QChar('0')), countTxs(i));
+    }
+    return ledger;
+}
+
+static std::vector<QString> urls(const std::vector<std::unique_ptr<MockTorrentNode>> &nodes) {
+    std::vector<QString> result;
+    for (const auto &node: nodes) {
+        result.emplace_back(node->url());
+    }
+    return result;
+}
+
+tst_TransactionsSync::tst_TransactionsSync(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_TransactionsSync::testSync()
+{
+    const MockLedger ledger = makeLedger(200, [](int i) { return i % 30 + 1; });
+    std::vector<std::unique_ptr<MockTorrentNode>> nodes;
+    for (int i = 0; i < 3; i++) {
+        nodes.emplace_back(std::make_unique<MockTorrentNode>(ledger, MockTorrentNode::Faults()));
+    }
+
+    SyncHarness harness("sync", urls(nodes), 50);
+    QVERIFY(harness.sync(ledger, 60s));
+
+    for (const auto &pair: ledger.countTxs) {
+        const QString &address = pair.first;
+        const int count = pair.second;
+        BalanceInfo balance;
+        harness.db.calcBalance(address, CURRENCY, balance);
+        QCOMPARE(static_cast<int>(balance.countReceived + balance.countSpent), count);
+        QCOMPARE(QString(balance.received.getDecimal()), ledger.received(address, count));
+        QCOMPARE(QString(balance.spent.getDecimal()), ledger.spent(address, count));
+
+        const std::vector<BlockCheckpoint> checkpoints = harness.db.getCheckpoints(address, CURRENCY);
+        QVERIFY(!checkpoints.empty());
+        QCOMPARE(checkpoints.back().blockNumber, int64_t(count));
+        QCOMPARE(checkpoints.back().blockHash, ledger.blockHash(count));
+    }
+}
+
+void tst_TransactionsSync::testFaults_data()
+{
+    // latency на всех нодах, errorPeriod на первой, lagBlocks на второй
+    QTest::addColumn<int>("latency");
+    QTest::addColumn<int>("errorPeriod");
+    QTest::addColumn<int>("lagBlocks");
+
+    QTest::newRow("latency") << 20 << 0 << 0;
+    QTest::newRow("errors") << 0 << 5 << 0;
+    QTest::newRow("lagging replica") << 0 << 0 << 15;
+    QTest::newRow("all") << 10 << 7 << 15;
+}
+
+void tst_TransactionsSync::testFaults()
+{
+    QFETCH(int, latency);
+    QFETCH(int, errorPeriod);
+    QFETCH(int, lagBlocks);
+
+    const MockLedger ledger = makeLedger(100, [](int i) { return i % 30 + 1; });
+    std::vector<std::unique_ptr<MockTorrentNode>> nodes;
+    for (int i = 0; i < 3; i++) {
+        MockTorrentNode::Faults faults;
+        faults.latency = milliseconds(latency);
+        if (i == 0) {
+            faults.errorPeriod = errorPeriod;
+        } else if (i == 1) {
+            faults.lagBlocks = lagBlocks;
+        }
+        nodes.emplace_back(std::make_unique<MockTorrentNode>(ledger, faults));
+    }
+
+    SyncHarness harness("faults", urls(nodes), 50);
+    QVERIFY(harness.sync(ledger, 120s));
+
+    // Ошибки и отставшая реплика не должны оставить в базе неполную или лишнюю историю
+    for (const auto &pair: ledger.countTxs) {
+        BalanceInfo balance;
+        harness.db.calcBalance(pair.first, CURRENCY, balance);
+        QCOMPARE(static_cast<int>(balance.countReceived + balance.countSpent), pair.second);
+        QCOMPARE(QString(balance.received.getDecimal()), ledger.received(pair.first, pair.second));
+    }
+    if (errorPeriod > 0) {
+        QVERIFY(nodes[0]->countErrors > 0);
+    }
+    qDebug() << "Synced in" << harness.syncTime.count() << "ms, requests:" << nodes[0]->countRequests << nodes[1]->countRequests << nodes[2]->countRequests << ", injected errors:" << nodes[0]->countErrors;
+}
+
+void tst_TransactionsSync::benchmarkSync_data()
+{
+    QTest::addColumn<int>("countAddresses");
+    QTest::addColumn<int>("countTxs");
+
+    QTest::newRow("1k x 100") << 1000 << 100;
+    QTest::newRow("10k x 100") << 10000 << 100;
+}
+
+void tst_TransactionsSync::benchmarkSync()
+{
+    // Прогон через миллион транзакций идет минуты, поэтому в обычном make check он пропускается
+    if (!qEnvironmentVariableIsSet("METAGATE_BENCHMARKS")) {
+        QSKIP("Set METAGATE_BENCHMARKS=1 to run benchmarks");
+    }
+    QFETCH(int, countAddresses);
+    QFETCH(int, countTxs);
+
+    const MockLedger ledger = makeLedger(countAddresses, [countTxs](int) { return countTxs; });
+    std::vector<std::unique_ptr<MockTorrentNode>> nodes;
+    for (int i = 0; i < 3; i++) {
+        nodes.emplace_back(std::make_unique<MockTorrentNode>(ledger, MockTorrentNode::Faults()));
+    }
+
+    SyncHarness harness("benchmark", urls(nodes), 100);
+    QVERIFY(harness.sync(ledger, 30min));
+
+    const QString sampleAddress = ledger.countTxs.rbegin()->first;
+    QCOMPARE(harness.db.getPaymentsCountForAddress(sampleAddress, CURRENCY, false) + harness.db.getPaymentsCountForAddress(sampleAddress, CURRENCY, true), qint64(countTxs));
+
+    size_t countRequests = 0;
+    for (const auto &node: nodes) {
+        countRequests += node->countRequests;
+    }
+    const double seconds = std::max<qint64>(harness.syncTime.count(), 1) / 1000.;
+    qDebug() << "Sync" << countAddresses << "addresses x" << countTxs << "txs:" << harness.syncTime.count() << "ms," << countAddresses / seconds << "addresses/s," << countRequests << "requests";
+}
+
+QTEST_MAIN(tst_TransactionsSync)
@@ -0,0 +1,97 @@
+#ifndef TST_TRANSACTIONSSYNC_H
+#define TST_TRANSACTIONSSYNC_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QJsonObject>
+
+#include <map>
+
+#include "duration.h"
+
+// Состояние сети, общее для всех нод: адреса, их история и текущий блок.
+// Транзакция i адреса лежит в блоке i + 1, каждая TX_SPENT_PERIOD-я исходящая
+struct MockLedger {
+    static const int TX_SPENT_PERIOD = 10;
+
+    std::map<QString, int> countTxs;
+
+    int64_t lastBlock = 0;
+
+    void addAddress(const QString &address, int count);
+
+    QJsonObject transaction(const QString &address, int index) const;
+
+    QString blockHash(int64_t number) const;
+
+    // Ожидаемые значения после синхронизации
+    QString received(const QString &address, int count) const;
+    QString spent(const QString &address, int count) const;
+};
+
+// Нода торрента поверх общего MockLedger с внесением сбоев
+class MockTorrentNode : public QObject {
+    Q_OBJECT
+public:
+
+    struct Faults {
+        // Задержка каждого ответа
+        milliseconds latency{0};
+        // Каждый errorPeriod-й запрос завершается ошибкой: нечетные HTTP 500, четные json error
+        int errorPeriod = 0;
+        // Реплика отстает на lagBlocks блоков и не видит их транзакций
+        int64_t lagBlocks = 0;
+    };
+
+public:
+
+    MockTorrentNode(const MockLedger &ledger, const Faults &faults, QObject *parent = nullptr);
+
+    QString url() const;
+
+    size_t countRequests = 0;
+
+    size_t countErrors = 0;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    QByteArray processRequest(const QByteArray &body);
+
+    int64_t visibleBlock() const;
+
+    int visibleTxs(const QString &address) const;
+
+private:
+
+    const MockLedger &ledger;
+
+    const Faults faults;
+
+    QTcpServer server;
+
+    std::map<QObject*, QByteArray> buffers;
+};
+
+class tst_TransactionsSync : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_TransactionsSync(QObject *parent = nullptr);
+
+private slots:
+
+    void testSync();
+
+    void testFaults_data();
+    void testFaults();
+
+    void benchmarkSync_data();
+    void benchmarkSync();
+
+};
+
+#endif // TST_TRANSACTIONSSYNC_H
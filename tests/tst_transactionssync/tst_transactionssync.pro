@@ -0,0 +1,63 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network sql websockets
+TARGET = tst_transactionssync
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src ../../src/transactions
+
+SOURCES += \
+    tst_transactionssync.cpp \
+    ../../src/dbstorage.cpp \
+    ../../src/client.cpp \
+    ../../src/HttpClient.cpp \
+    ../../src/HttpCompression.cpp \
+    ../../src/WebSocketClient.cpp \
+    ../../src/UdpSocketClient.cpp \
+    ../../src/NsLookup.cpp \
+    ../../src/NsLookupCache.cpp \
+    ../../src/dns/datatransformer.cpp \
+    ../../src/dns/dnspacket.cpp \
+    ../../src/dns/resourcerecord.cpp \
+    ../../src/TimerClass.cpp \
+    ../../src/QRegister.cpp \
+    ../../src/TypedException.cpp \
+    ../../src/BigNumber.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp \
+    ../../src/transactions/Transactions.cpp \
+    ../../src/transactions/TransactionsJavascript.cpp \
+    ../../src/transactions/TransactionsDBStorage.cpp \
+    ../../src/transactions/TransactionsMessages.cpp \
+    ../../src/transactions/TransactionsSubscription.cpp \
+    ../../src/transactions/ForkPointSearch.cpp
+
+HEADERS += \
+    tst_transactionssync.h \
+    ../../src/dbstorage.h \
+    ../../src/client.h \
+    ../../src/HttpClient.h \
+    ../../src/HttpCompression.h \
+    ../../src/WebSocketClient.h \
+    ../../src/UdpSocketClient.h \
+    ../../src/NsLookup.h \
+    ../../src/NsLookupCache.h \
+    ../../src/TimerClass.h \
+    ../../src/Log.h \
+    ../../src/transactions/Transactions.h \
+    ../../src/transactions/TransactionsJavascript.h \
+    ../../src/transactions/TransactionsDBStorage.h \
+    ../../src/transactions/TransactionsMessages.h \
+    ../../src/transactions/TransactionsSubscription.h \
+    ../../src/transactions/ForkPointSearch.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)
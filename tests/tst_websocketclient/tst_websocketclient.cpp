@@ -0,0 +1,227 @@
+#include "tst_websocketclient.h"
+
+#include <QTest>
+#include <QThread>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <atomic>
+#include <algorithm>
+
+#include "check.h"
+#include "WebSocketClient.h"
+
+MockWssServer::MockWssServer(QObject *parent)
+    : QObject(parent)
+    , server("mock", QWebSocketServer::NonSecureMode)
+{
+    server.listen(QHostAddress::LocalHost);
+    connect(&server, &QWebSocketServer::newConnection, this, &MockWssServer::onNewConnection);
+}
+
+MockWssServer::~MockWssServer() {
+    closeClients();
+}
+
+QUrl MockWssServer::url() const {
+    return QUrl("ws://127.0.0.1:" + QString::number(server.serverPort()));
+}
+
+void MockWssServer::closeClients() {
+    for (QWebSocket *client: clients) {
+        client->close();
+        client->deleteLater();
+    }
+    clients.clear();
+}
+
+void MockWssServer::sendBinary(const QByteArray &message) {
+    for (QWebSocket *client: clients) {
+        client->sendBinaryMessage(message);
+    }
+}
+
+void MockWssServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        QWebSocket *client = server.nextPendingConnection();
+        countConnections++;
+        clients.emplace_back(client);
+        connect(client, &QWebSocket::textMessageReceived, [this, client](const QString &message) {
+            const QJsonObject request = QJsonDocument::fromJson(message.toUtf8()).object();
+            if (request.value("method").toString() != "capabilities") {
+                textMessages.emplace_back(message);
+                return;
+            }
+            countCapabilityRequests++;
+            QJsonObject response;
+            response.insert("jsonrpc", "2.0");
+            response.insert("id", request.value("id"));
+            if (isOldServer) {
+                QJsonObject error;
+                error.insert("code", -32601);
+                error.insert("message", "Method not found");
+                response.insert("error", error);
+            } else {
+                response.insert("result", request.value("params"));
+            }
+            client->sendTextMessage(QJsonDocument(response).toJson(QJsonDocument::Compact));
+        });
+        connect(client, &QWebSocket::binaryMessageReceived, [this](const QByteArray &message) {
+            binaryMessages.emplace_back(QString::fromUtf8(qUncompress(message)));
+        });
+    }
+}
+
+static bool contains(const std::vector<QString> &messages, const QString &message) {
+    return std::find(messages.begin(), messages.end(), message) != messages.end();
+}
+
+tst_WebSocketClient::tst_WebSocketClient(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void tst_WebSocketClient::testHelloOnReconnect()
+{
+    MockWssServer server;
+
+    std::atomic<int> counter{0};
+    std::atomic<bool> isBuiltInMainThread{false};
+    QThread *mainThread = QThread::currentThread();
+
+    WebSocketClient client(server.url().toString());
+    client.setHelloBuilder("test", [&counter, &isBuiltInMainThread, mainThread]() {
+        if (QThread::currentThread() == mainThread) {
+            isBuiltInMainThread = true;
+        }
+        return std::vector<QString>{"hello" + QString::number(counter.load())};
+    });
+    emit client.setHelloString("static", "other");
+    client.start();
+
+    QTRY_VERIFY(contains(server.textMessages, "hello0"));
+    QVERIFY(contains(server.textMessages, "static"));
+    QCOMPARE(client.getReconnectCount(), size_t(0));
+
+    // Hello собирается в момент переподключения и видит новое значение
+    counter = 5;
+    server.closeClients();
+    QTRY_VERIFY_WITH_TIMEOUT(contains(server.textMessages, "hello5"), 10000);
+    QCOMPARE(server.countConnections, 2);
+    QCOMPARE(client.getReconnectCount(), size_t(1));
+    QVERIFY(client.getOfflineTime() > milliseconds(0));
+    QVERIFY(!isBuiltInMainThread.load());
+}
+
+static std::vector<QString> makeMessages() {
+    return {
+        "{\"id\":1,\"method\":\"big\",\"params\":\"" + QString(2000, 'a') + "\"}",
+        "{\"id\":2,\"method\":\"small\"}"
+    };
+}
+
+void tst_WebSocketClient::testOldServer()
+{
+    MockWssServer server;
+    server.isOldServer = true;
+
+    WebSocketClient client(server.url().toString());
+    client.setBatchMessages(true);
+    client.setCompressMessages(true);
+    client.start();
+    QTRY_COMPARE(server.countCapabilityRequests, 1);
+
+    // Без подтверждения от сервера сообщения уходят как раньше: по одному текстовому фрейму
+    const std::vector<QString> messages = makeMessages();
+    emit client.sendMessages(messages);
+    QTRY_COMPARE(server.textMessages.size(), size_t(2));
+    QVERIFY(server.textMessages == messages);
+    QVERIFY(server.binaryMessages.empty());
+    QVERIFY(!client.isBatchNegotiated());
+    QVERIFY(!client.isCompressNegotiated());
+}
+
+void tst_WebSocketClient::testNegotiated()
+{
+    MockWssServer server;
+
+    WebSocketClient client(server.url().toString());
+    client.setBatchMessages(true);
+    client.setCompressMessages(true);
+    client.start();
+    QTRY_VERIFY(client.isBatchNegotiated() && client.isCompressNegotiated());
+
+    const std::vector<QString> messages = makeMessages();
+    emit client.sendMessages(messages);
+    QTRY_COMPARE(server.binaryMessages.size(), size_t(1));
+    QCOMPARE(server.binaryMessages[0], "[" + messages[0] + "," + messages[1] + "]");
+    QVERIFY(server.textMessages.empty());
+}
+
+void tst_WebSocketClient::testReconnectBurst()
+{
+    MockWssServer server;
+
+    WebSocketClient client(server.url().toString());
+    client.setBatchMessages(true);
+    client.setCompressMessages(true);
+    const std::vector<QString> hello = {"{\"id\":10,\"method\":\"hello1\"}", "{\"id\":11,\"method\":\"hello2\"}"};
+    emit client.setHelloString(hello, "test");
+    // Очередь, накопленная до подключения
+    const std::vector<QString> messages = makeMessages();
+    emit client.sendMessages(messages);
+    client.start();
+
+    // Hello и очередь ждут ответа на capabilities и уходят одним сжатым batch-фреймом
+    QTRY_COMPARE(server.binaryMessages.size(), size_t(1));
+    QCOMPARE(server.binaryMessages[0], "[" + hello[0] + "," + hello[1] + "," + messages[0] + "," + messages[1] + "]");
+    QVERIFY(server.textMessages.empty());
+}
+
+void tst_WebSocketClient::testCompressUtf8Size()
+{
+    MockWssServer server;
+
+    WebSocketClient client(server.url().toString());
+    client.setCompressMessages(true);
+    client.start();
+    QTRY_VERIFY(client.isCompressNegotiated());
+
+    // 600 символов, но больше 1 Кб в utf-8
+    const QString message = "{\"id\":1,\"method\":\"text\",\"params\":\"" + QString(600, QChar(0x044F)) + "\"}";
+    emit client.sendMessage(message);
+    QTRY_COMPARE(server.binaryMessages.size(), size_t(1));
+    QCOMPARE(server.binaryMessages[0], message);
+    QVERIFY(server.textMessages.empty());
+}
+
+void tst_WebSocketClient::testCompressedSizeCap()
+{
+    MockWssServer server;
+
+    WebSocketClient client(server.url().toString());
+    std::vector<QString> received;
+    QObject::connect(&client, &WebSocketClient::messageReceived, [&received](QString message) {
+        received.emplace_back(message);
+    });
+    client.start();
+    QTRY_COMPARE(server.countConnections, 1);
+
+    const QString message = "{\"id\":1,\"result\":\"ok\"}";
+    server.sendBinary(qCompress(message.toUtf8()));
+    QTRY_COMPARE(received.size(), size_t(1));
+
+    // Заголовок обещает 4 Гб: фрейм отбрасывается без распаковки, соединение живо
+    QByteArray bomb = qCompress(QByteArray(1024, '\0'));
+    bomb[0] = char(0xFF);
+    bomb[1] = char(0xFF);
+    bomb[2] = char(0xFF);
+    bomb[3] = char(0xFF);
+    server.sendBinary(bomb);
+    server.sendBinary(qCompress(message.toUtf8()));
+    QTRY_COMPARE(received.size(), size_t(2));
+    QCOMPARE(received[1], message);
+    QCOMPARE(server.countConnections, 1);
+}
+
+QTEST_MAIN(tst_WebSocketClient)
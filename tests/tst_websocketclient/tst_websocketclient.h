@@ -0,0 +1,71 @@
+#ifndef TST_WEBSOCKETCLIENT_H
+#define TST_WEBSOCKETCLIENT_H
+
+#include <QObject>
+#include <QUrl>
+#include <QtWebSockets/QWebSocketServer>
+#include <QtWebSockets/QWebSocket>
+
+#include <vector>
+
+// Локальный ws сервер, запоминающий принятые фреймы
+class MockWssServer : public QObject {
+    Q_OBJECT
+public:
+    explicit MockWssServer(QObject *parent = nullptr);
+
+    ~MockWssServer() override;
+
+    QUrl url() const;
+
+    // Закрывает все соединения со стороны сервера
+    void closeClients();
+
+    void sendBinary(const QByteArray &message);
+
+    // Старый сервер отвечает ошибкой на запрос capabilities
+    bool isOldServer = false;
+
+    std::vector<QString> textMessages;
+
+    // Распакованные бинарные фреймы
+    std::vector<QString> binaryMessages;
+
+    int countConnections = 0;
+
+    int countCapabilityRequests = 0;
+
+private slots:
+
+    void onNewConnection();
+
+private:
+
+    QWebSocketServer server;
+
+    std::vector<QWebSocket*> clients;
+};
+
+class tst_WebSocketClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_WebSocketClient(QObject *parent = nullptr);
+
+private slots:
+
+    void testHelloOnReconnect();
+
+    void testOldServer();
+
+    void testNegotiated();
+
+    void testReconnectBurst();
+
+    void testCompressUtf8Size();
+
+    void testCompressedSizeCap();
+
+};
+
+#endif // TST_WEBSOCKETCLIENT_H
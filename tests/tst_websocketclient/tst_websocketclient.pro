@@ -0,0 +1,33 @@
+QT       += testlib
+QT       -= gui
+QT += widgets network websockets
+TARGET = tst_websocketclient
+CONFIG   += testcase
+CONFIG += c++14
+CONFIG += static
+
+TEMPLATE = app
+
+INCLUDEPATH = ../../src
+
+SOURCES += \
+    tst_websocketclient.cpp \
+    ../../src/WebSocketClient.cpp \
+    ../../src/TimerClass.cpp \
+    ../../src/QRegister.cpp \
+    ../../src/TypedException.cpp \
+    ../../src/Log.cpp \
+    ../../src/utils.cpp \
+    ../../src/Paths.cpp \
+    ../../src/btctx/Base58.cpp
+
+HEADERS += \
+    tst_websocketclient.h \
+    ../../src/WebSocketClient.h \
+    ../../src/TimerClass.h \
+    ../../src/Log.h
+
+QMAKE_LFLAGS += -rdynamic
+unix:!macx: include(../../libs-unix.pri)
+win32: include(../../libs-win.pri)
+macx: include(../../libs-macos.pri)